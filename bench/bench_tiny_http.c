@@ -0,0 +1,335 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/tiny_http/tiny_http_server_lib.h"
+
+/**
+ * Microbenchmarks for the parse and render hot paths.
+ *
+ * Every case runs against every corpus entry for about `BENCH_TARGET_NS`, timing each call on its own
+ * so the latency percentiles are per call. Allocations are counted by interposing malloc & co.
+ *
+ * usage: bench_tiny_http [substring of the case or corpus names to run]
+ */
+
+#define BENCH_TARGET_NS 200000000ULL
+#define BENCH_MIN_ITERATIONS 16
+#define BENCH_MAX_ITERATIONS 2000000
+
+// region allocation counting
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static size_t allocations;
+
+void *malloc(const size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(const size_t count, const size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, const size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// endregion allocation counting
+
+// region corpus
+
+typedef struct corpus_entry {
+    const char *name;
+    uint8_t *packet;
+    size_t packet_len;
+} corpus_entry;
+
+static const http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 8192,
+    .max_body_length = 8 * 1024 * 1024,
+    .max_url_length = 8000,
+};
+
+static const char curl_get[] = "GET / HTTP/1.1\r\n"
+        "Host: localhost:8085\r\n"
+        "User-Agent: curl/8.7.1\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+
+static const char browser_get[] = "GET /app/dashboard/index.html HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"130\", \"Google Chrome\";v=\"130\", \"Not?A_Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "sec-ch-ua-platform: \"macOS\"\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) "
+        "Chrome/130.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,"
+        "application/signed-exchange;v=b3;q=0.7\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Referer: https://www.example.com/app/login?next=%2Fapp%2Fdashboard\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: en-GB,en-US;q=0.9,en;q=0.8\r\n"
+        "Cookie: session=6f1c2b7e9a0d4c3f8e5b1a2d7c9e0f3a; theme=dark; _ga=GA1.1.1234567890.1700000000; "
+        "_gid=GA1.1.987654321.1700000000; consent=analytics%3Dtrue%26ads%3Dfalse\r\n"
+        "If-None-Match: \"5f3a-61b2c3d4e5f60\"\r\n"
+        "If-Modified-Since: Mon, 28 Oct 2024 10:00:00 GMT\r\n"
+        "Priority: u=0, i\r\n"
+        "DNT: 1\r\n"
+        "X-Requested-With: XMLHttpRequest\r\n"
+        "X-Forwarded-For: 203.0.113.7, 198.51.100.23\r\n"
+        "\r\n";
+
+static corpus_entry make_entry(const char *name, const char *packet) {
+    const size_t packet_len = strlen(packet);
+    corpus_entry entry = {.name = name, .packet = malloc(packet_len), .packet_len = packet_len};
+    memcpy(entry.packet, packet, packet_len);
+    return entry;
+}
+
+/**
+ * A GET whose path is `segments` percent-encoded segments long.
+ */
+static corpus_entry make_long_path_entry(const char *name, const size_t segments) {
+    const char *segment = "/caf%C3%A9%20na%C3%AFve%2Fr%C3%A9sum%C3%A9";
+    const size_t segment_len = strlen(segment);
+    const char *head = "GET ";
+    const char *tail = " HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    const size_t packet_len = strlen(head) + segments * segment_len + strlen(tail);
+    corpus_entry entry = {.name = name, .packet = malloc(packet_len), .packet_len = packet_len};
+    uint8_t *out = entry.packet;
+    memcpy(out, head, strlen(head));
+    out += strlen(head);
+    for (size_t i = 0; i < segments; i++) {
+        memcpy(out, segment, segment_len);
+        out += segment_len;
+    }
+    memcpy(out, tail, strlen(tail));
+    return entry;
+}
+
+static corpus_entry make_post_entry(const char *name, const size_t body_len) {
+    char head[256];
+    const int head_len = snprintf(head, sizeof(head),
+                                  "POST /upload HTTP/1.1\r\n"
+                                  "Host: localhost\r\n"
+                                  "Content-Type: application/octet-stream\r\n"
+                                  "Content-Length: %zu\r\n"
+                                  "\r\n", body_len);
+    corpus_entry entry = {.name = name, .packet = malloc((size_t) head_len + body_len)};
+    entry.packet_len = (size_t) head_len + body_len;
+    memcpy(entry.packet, head, (size_t) head_len);
+    for (size_t i = 0; i < body_len; i++) entry.packet[head_len + i] = (uint8_t) ('a' + i % 26);
+    return entry;
+}
+
+// endregion corpus
+
+// region cases
+
+typedef struct bench_state {
+    const corpus_entry *entry;
+    http_arena *arena;
+    http_response response;
+    size_t sink;
+} bench_state;
+
+static void bench_parse(bench_state *state) {
+    http_request *request = parse_http_request(&settings, state->entry->packet, state->entry->packet_len);
+    state->sink += request->headers_cnt;
+    destroy_http_request(request);
+}
+
+static void bench_parse_in_arena(bench_state *state) {
+    http_request *request = parse_http_request_in_arena(
+        &settings, state->arena, state->entry->packet, state->entry->packet_len);
+    state->sink += request->headers_cnt;
+    http_arena_reset(state->arena);
+}
+
+static void bench_parse_view(bench_state *state) {
+    http_request_view request;
+    parse_http_request_view(&settings, state->entry->packet, state->entry->packet_len, &request);
+    state->sink += request.headers_cnt;
+}
+
+static void bench_render(bench_state *state) {
+    uint8_t *octets = nullptr;
+    size_t octets_len = 0;
+    render_http_response(&settings, &state->response, &octets, &octets_len);
+    state->sink += octets_len;
+    free(octets);
+}
+
+static void bench_render_iov_in_arena(bench_state *state) {
+    struct iovec iov[2];
+    size_t iov_cnt = 0;
+    render_http_response_iov(&settings, state->arena, &state->response, iov, &iov_cnt);
+    state->sink += iov[0].iov_len;
+    http_arena_reset(state->arena);
+}
+
+static const http_header_fragment response_fragments[] = {
+    HTTP_HEADER_FRAGMENT("Content-Type", "application/octet-stream"),
+    HTTP_HEADER_FRAGMENT("Cache-Control", "no-cache"),
+    HTTP_HEADER_FRAGMENT("Server", "TinyLittleHTTP"),
+};
+
+/// the same head as the other render cases, from the pre-built status line and header fragments
+static void bench_render_iov_fragments(bench_state *state) {
+    http_response response = state->response;
+    response.reason_phrase = nullptr;
+    response.headers = nullptr;
+    response.headers_cnt = 0;
+    response.header_fragments = response_fragments;
+    response.header_fragments_cnt = sizeof(response_fragments) / sizeof(response_fragments[0]);
+    struct iovec iov[2];
+    size_t iov_cnt = 0;
+    render_http_response_iov(&settings, state->arena, &response, iov, &iov_cnt);
+    state->sink += iov[0].iov_len;
+    http_arena_reset(state->arena);
+}
+
+typedef struct bench_case {
+    const char *name;
+    void (*run)(bench_state *state);
+} bench_case;
+
+/// the render cases answer every corpus entry with a response carrying the entry's packet as its body
+static const bench_case cases[] = {
+    {"parse", bench_parse},
+    {"parse_in_arena", bench_parse_in_arena},
+    {"parse_view", bench_parse_view},
+    {"render", bench_render},
+    {"render_iov_in_arena", bench_render_iov_in_arena},
+    {"render_iov_fragments", bench_render_iov_fragments},
+};
+
+static http_header response_headers[] = {
+    {.name = "Content-Type", .value = "application/octet-stream"},
+    {.name = "Cache-Control", .value = "no-cache"},
+    {.name = "Server", .value = "TinyLittleHTTP"},
+};
+
+// endregion cases
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *) a;
+    const uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_case(const bench_case *bench, const corpus_entry *entry, uint64_t *samples) {
+    bench_state state = {
+        .entry = entry,
+        .arena = http_arena_create(entry->packet_len + 64 * 1024),
+        .response = {
+            .version = HTTP_1_1,
+            .status_code = 200,
+            .reason_phrase = (uint8_t *) "OK",
+            .headers = response_headers,
+            .headers_cnt = sizeof(response_headers) / sizeof(response_headers[0]),
+            .body = entry->packet,
+            .body_len = entry->packet_len,
+        },
+    };
+
+    // warm up, and size the run to about BENCH_TARGET_NS
+    const uint64_t warmup_start = now_ns();
+    size_t warmup_iterations = 0;
+    do {
+        bench->run(&state);
+        warmup_iterations++;
+    } while (now_ns() - warmup_start < BENCH_TARGET_NS / 10 && warmup_iterations < BENCH_MAX_ITERATIONS);
+    const uint64_t per_call = (now_ns() - warmup_start) / warmup_iterations + 1;
+    size_t iterations = (size_t) (BENCH_TARGET_NS / per_call);
+    if (iterations < BENCH_MIN_ITERATIONS) iterations = BENCH_MIN_ITERATIONS;
+    if (iterations > BENCH_MAX_ITERATIONS) iterations = BENCH_MAX_ITERATIONS;
+
+    const size_t allocations_before = allocations;
+    uint64_t total_ns = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        const uint64_t start = now_ns();
+        bench->run(&state);
+        samples[i] = now_ns() - start;
+        total_ns += samples[i];
+    }
+    const double allocations_per_call = (double) (allocations - allocations_before) / (double) iterations;
+
+    qsort(samples, iterations, sizeof(uint64_t), compare_u64);
+    const double ns_per_call = (double) total_ns / (double) iterations;
+    const double mib_per_sec = (double) entry->packet_len * 1e9 / ns_per_call / (1024.0 * 1024.0);
+    printf("%-20s %-16s %10zu %12.1f %10llu %10llu %10llu %12.1f %8.2f\n",
+           bench->name,
+           entry->name,
+           iterations,
+           ns_per_call,
+           (unsigned long long) samples[iterations / 2],
+           (unsigned long long) samples[iterations * 99 / 100],
+           (unsigned long long) samples[iterations * 999 / 1000],
+           mib_per_sec,
+           allocations_per_call);
+    fflush(stdout);
+
+    if (state.sink == 42) printf(" "); // keeps the calls from being optimized away
+    http_arena_destroy(state.arena);
+}
+
+int main(const int argc, const char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    corpus_entry corpus[] = {
+        make_entry("curl_get", curl_get),
+        make_entry("browser_get", browser_get),
+        make_long_path_entry("long_path_2k", 48),
+        make_post_entry("post_1k", 1024),
+        make_post_entry("post_64k", 64 * 1024),
+        make_post_entry("post_1m", 1024 * 1024),
+        make_post_entry("post_8m", 8 * 1024 * 1024 - 512),
+    };
+    const size_t corpus_cnt = sizeof(corpus) / sizeof(corpus[0]);
+    uint64_t *samples = malloc(BENCH_MAX_ITERATIONS * sizeof(uint64_t));
+
+    printf("%-20s %-16s %10s %12s %10s %10s %10s %12s %8s\n",
+           "case", "corpus", "calls", "ns/call", "p50 ns", "p99 ns", "p999 ns", "MiB/s", "allocs");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (size_t e = 0; e < corpus_cnt; e++) {
+            if (filter != nullptr && strstr(cases[c].name, filter) == nullptr && strstr(corpus[e].name, filter) == nullptr) {
+                continue;
+            }
+            run_case(&cases[c], &corpus[e], samples);
+        }
+    }
+
+    free(samples);
+    for (size_t e = 0; e < corpus_cnt; e++) free(corpus[e].packet);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,650 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_metrics.h"
+#include "../src/tiny_http/tiny_http_server.h"
+
+/**
+ * End-to-end load generator: drives an `http_server` over loopback and reports throughput and latency.
+ *
+ * By default the server runs in this process on 127.0.0.1 with an ephemeral port, so no network is
+ * needed; `--port` points the generator at a server that is already running instead.
+ *
+ * Closed loop (the default) keeps exactly one request in flight per connection and sends the next as
+ * soon as the previous answer is in, so its latencies are service times. Open loop (`--rate`) sends on
+ * a fixed schedule instead, and a request is timed from when it *should* have been sent: a stalled
+ * server cannot hide its stall by keeping the generator from sending (coordinated omission). Both the
+ * corrected latency and the service time are reported then.
+ *
+ * usage: load_tiny_http [options], see `--help`
+ */
+
+#define LOAD_HEAD_CAPACITY (16 * 1024)
+#define LOAD_MAX_EVENTS 256
+
+typedef struct load_options {
+    size_t connections;
+    size_t threads;
+    size_t server_workers;
+    http_io_engine server_io_engine;
+    double duration_sec;
+    double warmup_sec;
+    double rate;
+    bool keep_alive;
+    unsigned post_percent;
+    size_t body_size;
+    size_t response_size;
+    const char *host;
+    uint16_t port;
+} load_options;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+// region histogram
+
+/**
+ * Log-linear latency histogram in nanoseconds: exact below 128 ns, then 64 buckets per power of two,
+ * so any recorded value is off by less than 1/64 (1.6%).
+ */
+#define HISTOGRAM_SUB_BUCKETS 64
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_SUB_BUCKETS + 56 * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct load_histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} load_histogram;
+
+static size_t histogram_bucket(const uint64_t value) {
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS) return (size_t) value;
+    const unsigned shift = (unsigned) (63 - __builtin_clzll(value)) - 6;
+    const size_t bucket = 2 * HISTOGRAM_SUB_BUCKETS + (size_t) (shift - 1) * HISTOGRAM_SUB_BUCKETS
+                          + (size_t) (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * @return the highest value that lands in `bucket`
+ */
+static uint64_t histogram_bucket_value(const size_t bucket) {
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) return bucket;
+    const unsigned shift = (unsigned) ((bucket - 2 * HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS) + 1;
+    const uint64_t mantissa = HISTOGRAM_SUB_BUCKETS + (bucket - 2 * HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static void histogram_record(load_histogram *histogram, const uint64_t value) {
+    histogram->counts[histogram_bucket(value)]++;
+    histogram->total++;
+    if (value > histogram->max) histogram->max = value;
+}
+
+static void histogram_merge(load_histogram *into, const load_histogram *from) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    if (from->max > into->max) into->max = from->max;
+}
+
+static uint64_t histogram_percentile(const load_histogram *histogram, const double percentile) {
+    if (histogram->total == 0) return 0;
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) histogram->total + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            const uint64_t value = histogram_bucket_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+// endregion histogram
+
+// region server
+
+static uint8_t *response_body;
+static size_t response_body_len;
+
+static const http_header_fragment response_headers[] = {
+    HTTP_HEADER_FRAGMENT("Content-Type", "application/octet-stream"),
+};
+
+static void answer(const http_request *request, http_response *response, void *user_data) {
+    (void) request;
+    (void) user_data;
+    response->status_code = 200;
+    response->header_fragments = response_headers;
+    response->header_fragments_cnt = sizeof(response_headers) / sizeof(response_headers[0]);
+    response->body = response_body;
+    response->body_len = response_body_len;
+}
+
+static void *run_server(void *server) {
+    if (http_server_run(server) != 0) fprintf(stderr, "load: the server's event loop failed\n");
+    return nullptr;
+}
+
+// endregion server
+
+// region client
+
+typedef struct load_request {
+    uint8_t *packet;
+    size_t packet_len;
+} load_request;
+
+enum load_connection_state {
+    LOAD_IDLE,
+    LOAD_SENDING,
+    LOAD_RECEIVING,
+};
+
+typedef struct load_connection {
+    int fd;
+    enum load_connection_state state;
+    const load_request *request;
+    size_t sent;
+    /// the response head is gathered here; the body is read over it and thrown away
+    uint8_t head[LOAD_HEAD_CAPACITY];
+    size_t head_len;
+    bool head_complete;
+    size_t received;
+    size_t expected;
+    /// when the current request was (closed loop) or should have been (open loop) sent
+    uint64_t intended_ns;
+    uint64_t sent_ns;
+} load_connection;
+
+typedef struct load_thread {
+    pthread_t thread;
+    const load_options *options;
+    struct sockaddr_in addr;
+    const load_request *get;
+    const load_request *post;
+    load_connection *connections;
+    size_t connections_cnt;
+    /// open loop: time between two requests on one connection
+    uint64_t interval_ns;
+    uint64_t start_ns;
+    uint64_t measure_ns;
+    uint64_t end_ns;
+    uint64_t random;
+    int epoll_fd;
+    int timer_fd;
+    uint64_t timer_ns;
+
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t bytes_received;
+    load_histogram latency;
+    load_histogram service_time;
+} load_thread;
+
+static uint64_t next_random(load_thread *thread) {
+    thread->random ^= thread->random << 13;
+    thread->random ^= thread->random >> 7;
+    thread->random ^= thread->random << 17;
+    return thread->random;
+}
+
+static bool connection_open(load_thread *thread, load_connection *connection) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    // loopback connects are quick enough to do blocking; the socket only goes non-blocking afterwards
+    if (connect(fd, (const struct sockaddr *) &thread->addr, sizeof(thread->addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (!thread->options->keep_alive) {
+        // reset instead of lingering in TIME_WAIT, or a long run exhausts the ephemeral ports
+        const struct linger linger = {.l_onoff = 1, .l_linger = 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = connection};
+    if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        return false;
+    }
+    connection->fd = fd;
+    return true;
+}
+
+static void connection_close(load_connection *connection) {
+    if (connection->fd >= 0) close(connection->fd);
+    connection->fd = -1;
+}
+
+/**
+ * Schedules the connection's next request and records the one that just ended.
+ */
+static void connection_finish(load_thread *thread, load_connection *connection, const bool ok) {
+    const uint64_t now = now_ns();
+    if (connection->intended_ns >= thread->measure_ns && now <= thread->end_ns) {
+        if (ok) {
+            thread->completed++;
+            thread->bytes_received += connection->received;
+            histogram_record(&thread->latency, now - connection->intended_ns);
+            histogram_record(&thread->service_time, now - connection->sent_ns);
+        } else {
+            thread->errors++;
+        }
+    }
+    if (!ok || !thread->options->keep_alive) connection_close(connection);
+    connection->state = LOAD_IDLE;
+    connection->intended_ns = thread->interval_ns != 0 ? connection->intended_ns + thread->interval_ns : now;
+}
+
+/**
+ * Parses the status line and `Content-Length` of a complete response head.
+ *
+ * @return false unless the response is a 200 with a `Content-Length`
+ */
+static bool connection_parse_head(load_connection *connection, const size_t head_len) {
+    connection->head_complete = true;
+    if (head_len < 12 || memcmp(connection->head, "HTTP/1.", 7) != 0 || memcmp(connection->head + 8, " 200", 4) != 0) {
+        return false;
+    }
+    const char *line = (const char *) connection->head;
+    const char *head_end = line + head_len;
+    while ((line = memchr(line, '\n', (size_t) (head_end - line))) != nullptr) {
+        line++;
+        if (head_end - line > 15 && strncasecmp(line, "Content-Length:", 15) == 0) {
+            connection->expected = head_len + strtoull(line + 15, nullptr, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Moves the connection's request along as far as the socket allows.
+ */
+static void connection_pump(load_thread *thread, load_connection *connection) {
+    if (connection->state == LOAD_SENDING) {
+        const load_request *request = connection->request;
+        while (connection->sent < request->packet_len) {
+            const ssize_t sent = send(connection->fd, request->packet + connection->sent,
+                                      request->packet_len - connection->sent, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EAGAIN) return;
+                connection_finish(thread, connection, false);
+                return;
+            }
+            connection->sent += (size_t) sent;
+        }
+        connection->state = LOAD_RECEIVING;
+    }
+    while (connection->state == LOAD_RECEIVING) {
+        uint8_t *into = connection->head_complete ? connection->head : connection->head + connection->head_len;
+        const size_t room = connection->head_complete ? LOAD_HEAD_CAPACITY : LOAD_HEAD_CAPACITY - connection->head_len;
+        const ssize_t received = recv(connection->fd, into, room, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EAGAIN) return;
+            connection_finish(thread, connection, false);
+            return;
+        }
+        connection->received += (size_t) received;
+        if (!connection->head_complete) {
+            const size_t searched_from = connection->head_len >= 3 ? connection->head_len - 3 : 0;
+            connection->head_len += (size_t) received;
+            const uint8_t *end = memmem(connection->head + searched_from, connection->head_len - searched_from,
+                                        "\r\n\r\n", 4);
+            if (end != nullptr) {
+                if (!connection_parse_head(connection, (size_t) (end - connection->head) + 4)) {
+                    connection_finish(thread, connection, false);
+                    return;
+                }
+            } else if (connection->head_len == LOAD_HEAD_CAPACITY) {
+                connection_finish(thread, connection, false);
+                return;
+            }
+        }
+        if (connection->head_complete && connection->received >= connection->expected) {
+            // one request in flight at a time, so anything past the response is the server misbehaving
+            connection_finish(thread, connection, connection->received == connection->expected);
+        }
+    }
+}
+
+static void connection_send(load_thread *thread, load_connection *connection, const uint64_t now) {
+    if (connection->fd < 0 && !connection_open(thread, connection)) {
+        connection_finish(thread, connection, false);
+        return;
+    }
+    const bool post = next_random(thread) % 100 < thread->options->post_percent;
+    connection->request = post ? thread->post : thread->get;
+    connection->state = LOAD_SENDING;
+    connection->sent = 0;
+    connection->head_len = 0;
+    connection->head_complete = false;
+    connection->received = 0;
+    connection->expected = SIZE_MAX;
+    connection->sent_ns = now;
+    if (thread->interval_ns == 0) connection->intended_ns = now;
+    connection_pump(thread, connection);
+}
+
+static void arm_timer(const load_thread *thread, const uint64_t at_ns) {
+    struct itimerspec timer = {
+        .it_value = {.tv_sec = (time_t) (at_ns / 1000000000ULL), .tv_nsec = (long) (at_ns % 1000000000ULL)},
+    };
+    timerfd_settime(thread->timer_fd, TFD_TIMER_ABSTIME, &timer, nullptr);
+}
+
+static void *run_client(void *arg) {
+    load_thread *thread = arg;
+    struct epoll_event events[LOAD_MAX_EVENTS];
+    thread->epoll_fd = epoll_create1(0);
+    thread->timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    struct epoll_event timer_event = {.events = EPOLLIN, .data.ptr = nullptr};
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, thread->timer_fd, &timer_event);
+
+    for (size_t i = 0; i < thread->connections_cnt; i++) {
+        load_connection *connection = &thread->connections[i];
+        connection->fd = -1;
+        connection->state = LOAD_IDLE;
+        // spread the open loop's connections evenly over one interval, so they do not send in bursts
+        connection->intended_ns = thread->start_ns + (thread->interval_ns != 0
+                                                          ? next_random(thread) % thread->interval_ns
+                                                          : 0);
+        if (thread->options->keep_alive && !connection_open(thread, connection)) {
+            fprintf(stderr, "load: cannot connect: %s\n", strerror(errno));
+        }
+    }
+
+    while (true) {
+        const uint64_t now = now_ns();
+        if (now >= thread->end_ns) break;
+        uint64_t next_send = thread->end_ns;
+        for (size_t i = 0; i < thread->connections_cnt; i++) {
+            load_connection *connection = &thread->connections[i];
+            if (connection->state == LOAD_IDLE && connection->intended_ns <= now) {
+                connection_send(thread, connection, now);
+            }
+            if (connection->state == LOAD_IDLE && connection->intended_ns < next_send) {
+                next_send = connection->intended_ns;
+            }
+        }
+        if (next_send != thread->timer_ns) {
+            arm_timer(thread, next_send);
+            thread->timer_ns = next_send;
+        }
+
+        const int ready = epoll_wait(thread->epoll_fd, events, LOAD_MAX_EVENTS, -1);
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == nullptr) {
+                uint64_t expirations;
+                if (read(thread->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    thread->timer_ns = 0;
+                }
+                continue;
+            }
+            load_connection *connection = events[i].data.ptr;
+            if (connection->state != LOAD_IDLE) connection_pump(thread, connection);
+        }
+    }
+
+    for (size_t i = 0; i < thread->connections_cnt; i++) connection_close(&thread->connections[i]);
+    close(thread->timer_fd);
+    close(thread->epoll_fd);
+    return nullptr;
+}
+
+static load_request make_request(const char *method, const size_t body_size, const bool keep_alive) {
+    char head[256];
+    const int head_len = snprintf(head, sizeof(head),
+                                  "%s /load HTTP/1.1\r\n"
+                                  "Host: localhost\r\n"
+                                  "%s"
+                                  "Content-Length: %zu\r\n"
+                                  "\r\n",
+                                  method, keep_alive ? "" : "Connection: close\r\n", body_size);
+    load_request request = {.packet = malloc((size_t) head_len + body_size)};
+    request.packet_len = (size_t) head_len + body_size;
+    memcpy(request.packet, head, (size_t) head_len);
+    for (size_t i = 0; i < body_size; i++) request.packet[head_len + i] = (uint8_t) ('a' + i % 26);
+    return request;
+}
+
+// endregion client
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: load_tiny_http [options]\n"
+            "  -c, --connections N     concurrent connections (default 16)\n"
+            "  -t, --threads N         client threads (default 2)\n"
+            "  -w, --workers N         worker threads of the in-process server (default 2)\n"
+            "      --io-uring          run the in-process server on io_uring rather than epoll\n"
+            "  -d, --duration SEC      measured run time (default 5)\n"
+            "      --warmup SEC        unmeasured run time before that (default 1)\n"
+            "  -r, --rate N            open loop at N requests/s in total; 0 = closed loop (default 0)\n"
+            "  -k, --no-keep-alive     a new connection for every request\n"
+            "  -p, --post-percent P    share of POST requests, the rest are GETs (default 0)\n"
+            "  -b, --body-size N       octets in a POST body (default 1024)\n"
+            "  -s, --response-size N   octets in a response body (default 128)\n"
+            "      --host ADDR         IPv4 address of the server (default 127.0.0.1)\n"
+            "      --port N            load an already running server instead of an in-process one\n");
+}
+
+static bool parse_options(const int argc, char *argv[], load_options *options) {
+    static const struct option long_options[] = {
+        {"connections", required_argument, nullptr, 'c'},
+        {"threads", required_argument, nullptr, 't'},
+        {"workers", required_argument, nullptr, 'w'},
+        {"io-uring", no_argument, nullptr, 'U'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"warmup", required_argument, nullptr, 'W'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"no-keep-alive", no_argument, nullptr, 'k'},
+        {"post-percent", required_argument, nullptr, 'p'},
+        {"body-size", required_argument, nullptr, 'b'},
+        {"response-size", required_argument, nullptr, 's'},
+        {"host", required_argument, nullptr, 'H'},
+        {"port", required_argument, nullptr, 'P'},
+        {"help", no_argument, nullptr, 'h'},
+        {},
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "c:t:w:d:r:kp:b:s:h", long_options, nullptr)) != -1) {
+        switch (option) {
+            case 'c': options->connections = strtoull(optarg, nullptr, 10); break;
+            case 't': options->threads = strtoull(optarg, nullptr, 10); break;
+            case 'w': options->server_workers = strtoull(optarg, nullptr, 10); break;
+            case 'U': options->server_io_engine = HTTP_IO_ENGINE_IO_URING; break;
+            case 'd': options->duration_sec = strtod(optarg, nullptr); break;
+            case 'W': options->warmup_sec = strtod(optarg, nullptr); break;
+            case 'r': options->rate = strtod(optarg, nullptr); break;
+            case 'k': options->keep_alive = false; break;
+            case 'p': options->post_percent = (unsigned) strtoul(optarg, nullptr, 10); break;
+            case 'b': options->body_size = strtoull(optarg, nullptr, 10); break;
+            case 's': options->response_size = strtoull(optarg, nullptr, 10); break;
+            case 'H': options->host = optarg; break;
+            case 'P': options->port = (uint16_t) strtoul(optarg, nullptr, 10); break;
+            default: return false;
+        }
+    }
+    if (options->connections == 0 || options->threads == 0 || options->duration_sec <= 0
+        || options->warmup_sec < 0 || options->rate < 0 || options->post_percent > 100) {
+        return false;
+    }
+    if (options->threads > options->connections) options->threads = options->connections;
+    return true;
+}
+
+static void print_latencies(const char *name, const load_histogram *histogram) {
+    printf("%-14s %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           name,
+           (double) histogram_percentile(histogram, 50.0) / 1e3,
+           (double) histogram_percentile(histogram, 90.0) / 1e3,
+           (double) histogram_percentile(histogram, 99.0) / 1e3,
+           (double) histogram_percentile(histogram, 99.9) / 1e3,
+           (double) histogram->max / 1e3);
+}
+
+/**
+ * Prints the in-process server's own mean parse, handler and render times, warm-up included.
+ */
+static void print_server_times(void) {
+    http_metrics_snapshot snapshot;
+    http_metrics_load(&snapshot);
+    double means[HTTP_METRIC_HISTOGRAM_COUNT];
+    for (size_t i = 0; i < HTTP_METRIC_HISTOGRAM_COUNT; i++) {
+        uint64_t count = 0;
+        for (size_t bucket = 0; bucket <= HTTP_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+            count += snapshot.histograms[i].buckets[bucket];
+        }
+        // built without metrics
+        if (count == 0) return;
+        means[i] = (double) snapshot.histograms[i].sum_ns / (double) count;
+    }
+    printf("\n%-14s %10s %10s %10s\n", "server (ns)", "parse", "handler", "render");
+    printf("%-14s %10.0f %10.0f %10.0f\n", "mean",
+           means[HTTP_METRIC_PARSE_TIME], means[HTTP_METRIC_HANDLER_TIME], means[HTTP_METRIC_RENDER_TIME]);
+}
+
+int main(const int argc, char *argv[]) {
+    load_options options = {
+        .connections = 16,
+        .threads = 2,
+        .server_workers = 2,
+        .duration_sec = 5,
+        .warmup_sec = 1,
+        .keep_alive = true,
+        .body_size = 1024,
+        .response_size = 128,
+        .host = "127.0.0.1",
+    };
+    if (!parse_options(argc, argv, &options)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    http_server *server = nullptr;
+    pthread_t server_thread;
+    const http_server_settings settings = {
+        .max_header_name_length = 256,
+        .max_header_value_length = 8192,
+        .max_body_length = options.body_size > 1024 * 1024 ? options.body_size : 1024 * 1024,
+        .max_url_length = 8000,
+        .worker_count = options.server_workers,
+        .io_engine = options.server_io_engine,
+    };
+    uint16_t port = options.port;
+    if (port == 0) {
+        response_body_len = options.response_size;
+        response_body = malloc(response_body_len + 1);
+        memset(response_body, 'x', response_body_len);
+        server = http_server_create(&settings, options.host, 0, answer, nullptr);
+        if (server == nullptr) {
+            fprintf(stderr, "load: cannot start the server on %s\n", options.host);
+            return EXIT_FAILURE;
+        }
+        port = http_server_port(server);
+        pthread_create(&server_thread, nullptr, run_server, server);
+    }
+
+    const load_request get = make_request("GET", 0, options.keep_alive);
+    const load_request post = make_request("POST", options.body_size, options.keep_alive);
+    load_connection *connections = calloc(options.connections, sizeof(load_connection));
+    load_thread *threads = calloc(options.threads, sizeof(load_thread));
+    const uint64_t start_ns = now_ns();
+    const uint64_t measure_ns = start_ns + (uint64_t) (options.warmup_sec * 1e9);
+    const uint64_t end_ns = measure_ns + (uint64_t) (options.duration_sec * 1e9);
+    size_t assigned = 0;
+    for (size_t i = 0; i < options.threads; i++) {
+        load_thread *thread = &threads[i];
+        thread->options = &options;
+        thread->addr = (struct sockaddr_in){.sin_family = AF_INET, .sin_port = htons(port)};
+        inet_pton(AF_INET, options.host, &thread->addr.sin_addr);
+        thread->get = &get;
+        thread->post = &post;
+        thread->connections = connections + assigned;
+        thread->connections_cnt = (options.connections - assigned) / (options.threads - i);
+        assigned += thread->connections_cnt;
+        thread->interval_ns = options.rate > 0 ? (uint64_t) ((double) options.connections * 1e9 / options.rate) : 0;
+        thread->start_ns = start_ns;
+        thread->measure_ns = measure_ns;
+        thread->end_ns = end_ns;
+        thread->random = 0x9e3779b97f4a7c15ULL * (i + 1);
+        pthread_create(&thread->thread, nullptr, run_client, thread);
+    }
+
+    load_histogram *latency = calloc(1, sizeof(load_histogram));
+    load_histogram *service_time = calloc(1, sizeof(load_histogram));
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t bytes_received = 0;
+    for (size_t i = 0; i < options.threads; i++) {
+        pthread_join(threads[i].thread, nullptr);
+        completed += threads[i].completed;
+        errors += threads[i].errors;
+        bytes_received += threads[i].bytes_received;
+        histogram_merge(latency, &threads[i].latency);
+        histogram_merge(service_time, &threads[i].service_time);
+    }
+
+    if (options.rate > 0) {
+        printf("open loop at %.0f req/s", options.rate);
+    } else {
+        printf("closed loop");
+    }
+    printf(", %zu connections on %zu threads, keep-alive %s, %u%% POST of %zu B, %zu B responses",
+           options.connections, options.threads, options.keep_alive ? "on" : "off",
+           options.post_percent, options.body_size, options.response_size);
+    if (server != nullptr) {
+        printf(", %zu server workers on %s", options.server_workers ? options.server_workers : 1,
+               http_server_io_engine(server) == HTTP_IO_ENGINE_IO_URING ? "io_uring" : "epoll");
+    }
+    printf("\n\n");
+    const double seconds = options.duration_sec;
+    printf("%-14s %12s %10s %12s %10s\n", "", "requests", "errors", "req/s", "MiB/s in");
+    printf("%-14s %12llu %10llu %12.0f %10.1f\n\n",
+           "total", (unsigned long long) completed, (unsigned long long) errors,
+           (double) completed / seconds, (double) bytes_received / seconds / (1024.0 * 1024.0));
+    printf("%-14s %10s %10s %10s %10s %10s\n", "latency (us)", "p50", "p90", "p99", "p99.9", "max");
+    if (options.rate > 0) print_latencies("corrected", latency);
+    print_latencies("service time", service_time);
+    if (server != nullptr) print_server_times();
+
+    if (server != nullptr) {
+        http_server_stop(server);
+        pthread_join(server_thread, nullptr);
+        http_server_destroy(server);
+    }
+    free(latency);
+    free(service_time);
+    free(threads);
+    free(connections);
+    free(get.packet);
+    free(post.packet);
+    free(response_body);
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_admission.h"
+
+#include <time.h>
+
+#define ADMISSION_DEFAULT_TARGET_DELAY_US 5000
+#define ADMISSION_DEFAULT_INTERVAL_US 100000
+#define ADMISSION_DEFAULT_MIN_CONCURRENCY 8
+#define ADMISSION_DEFAULT_MAX_CONCURRENCY 1024
+
+// only the worker owning the admission writes its atomics, so they are read and written relaxed
+
+uint64_t http_admission_clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+void http_admission_init(http_admission *admission, const http_admission_settings *settings, const uint64_t now_ns) {
+    const uint32_t target_delay_us = settings->target_delay_us > 0 ? settings->target_delay_us : ADMISSION_DEFAULT_TARGET_DELAY_US;
+    const uint32_t interval_us = settings->interval_us > 0 ? settings->interval_us : ADMISSION_DEFAULT_INTERVAL_US;
+    size_t min_concurrency = settings->min_concurrency > 0 ? settings->min_concurrency : ADMISSION_DEFAULT_MIN_CONCURRENCY;
+    const size_t max_concurrency = settings->max_concurrency > 0 ? settings->max_concurrency : ADMISSION_DEFAULT_MAX_CONCURRENCY;
+    if (min_concurrency > max_concurrency) min_concurrency = max_concurrency;
+    *admission = (http_admission){
+        .target_delay_ns = (uint64_t) target_delay_us * 1000,
+        .interval_ns = (uint64_t) interval_us * 1000,
+        .min_concurrency = min_concurrency,
+        .max_concurrency = max_concurrency,
+        .interval_end_ns = now_ns + (uint64_t) interval_us * 1000,
+        .interval_min_delay_ns = UINT64_MAX,
+    };
+    atomic_init(&admission->limit, max_concurrency);
+}
+
+/**
+ * Closes the interval `now_ns` is past: overloaded if even its quickest request queued for longer than
+ * the target, the limit adapting to that.
+ */
+static void admission_next_interval(http_admission *admission, const uint64_t now_ns) {
+    // an interval without any request had no queue at all
+    const bool overloaded = admission->interval_min_delay_ns != UINT64_MAX
+                            && admission->interval_min_delay_ns > admission->target_delay_ns;
+    size_t limit = atomic_load_explicit(&admission->limit, memory_order_relaxed);
+    if (overloaded) {
+        limit -= limit / 5;
+        if (limit < admission->min_concurrency) limit = admission->min_concurrency;
+    } else if (admission->limited) {
+        limit += limit / 8 + 1;
+        if (limit > admission->max_concurrency) limit = admission->max_concurrency;
+    }
+    atomic_store_explicit(&admission->limit, limit, memory_order_relaxed);
+    atomic_store_explicit(&admission->overloaded, overloaded, memory_order_relaxed);
+    admission->limited = false;
+    admission->interval_min_delay_ns = UINT64_MAX;
+    admission->interval_end_ns = now_ns + admission->interval_ns;
+}
+
+static void admission_count(atomic_size_t *counter, const size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+http_admission_verdict http_admission_admit(http_admission *admission, const uint64_t now_ns, const uint64_t queued_ns) {
+    const uint64_t delay = now_ns > queued_ns ? now_ns - queued_ns : 0;
+    if (now_ns >= admission->interval_end_ns) admission_next_interval(admission, now_ns);
+    if (delay < admission->interval_min_delay_ns) admission->interval_min_delay_ns = delay;
+
+    const bool overloaded = atomic_load_explicit(&admission->overloaded, memory_order_relaxed);
+    if (delay > (overloaded ? admission->target_delay_ns : admission->interval_ns)) {
+        admission_count(&admission->shed_delay, 1);
+        return HTTP_ADMISSION_SHED_DELAY;
+    }
+    const size_t in_flight = atomic_load_explicit(&admission->in_flight, memory_order_relaxed);
+    if (in_flight >= atomic_load_explicit(&admission->limit, memory_order_relaxed)) {
+        admission->limited = true;
+        admission_count(&admission->shed_concurrency, 1);
+        return HTTP_ADMISSION_SHED_CONCURRENCY;
+    }
+    atomic_store_explicit(&admission->in_flight, in_flight + 1, memory_order_relaxed);
+    admission_count(&admission->admitted, 1);
+    return HTTP_ADMISSION_ADMIT;
+}
+
+void http_admission_complete(http_admission *admission) {
+    atomic_store_explicit(
+        &admission->in_flight, atomic_load_explicit(&admission->in_flight, memory_order_relaxed) - 1, memory_order_relaxed);
+}
+
+void http_admission_stats_add(const http_admission *admission, http_admission_stats *out_stats) {
+    out_stats->limit += atomic_load_explicit(&admission->limit, memory_order_relaxed);
+    out_stats->in_flight += atomic_load_explicit(&admission->in_flight, memory_order_relaxed);
+    out_stats->admitted += atomic_load_explicit(&admission->admitted, memory_order_relaxed);
+    out_stats->shed_delay += atomic_load_explicit(&admission->shed_delay, memory_order_relaxed);
+    out_stats->shed_concurrency += atomic_load_explicit(&admission->shed_concurrency, memory_order_relaxed);
+    out_stats->overloaded += atomic_load_explicit(&admission->overloaded, memory_order_relaxed) ? 1 : 0;
+}
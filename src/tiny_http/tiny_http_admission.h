@@ -0,0 +1,105 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_ADMISSION_H
+#define TINY_HTTP_ADMISSION_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * How an `http_server` sheds load (see `http_server_settings::admission`).
+ */
+typedef struct http_admission_settings {
+    /// the queueing delay a request may see while the server keeps up, in microseconds; 0 means 5 ms
+    uint32_t target_delay_us;
+    /// how long the delay has to stay above the target before the server counts as overloaded, and how
+    /// long a request may queue while it is not, in microseconds; 0 means 100 ms
+    uint32_t interval_us;
+    /// bounds of each worker's adaptive limit on requests in flight; 0 means 8 and 1024
+    uint32_t min_concurrency;
+    uint32_t max_concurrency;
+    /// what `Retry-After` tells a shed client, in seconds; 0 means 1
+    uint32_t retry_after_s;
+} http_admission_settings;
+
+typedef enum http_admission_verdict {
+    HTTP_ADMISSION_ADMIT = 0,
+    /// the request queued for longer than the server currently allows
+    HTTP_ADMISSION_SHED_DELAY = 1,
+    /// the limit on requests in flight has been reached
+    HTTP_ADMISSION_SHED_CONCURRENCY = 2,
+} http_admission_verdict;
+
+/**
+ * Decides, once a request's head has arrived, whether the server takes it on. Two signals, both in
+ * the manner of CoDel: a request that waited longer than `interval_us` is shed, and once no request
+ * of a whole interval got through in under `target_delay_us` (a standing queue, not a burst) the
+ * server counts as overloaded and sheds every request that waited longer than the target. On top
+ * of that requests in flight, from admission until the response is written, are capped by a limit
+ * that adapts once per interval: cut by a fifth while overloaded, raised by an eighth when it was
+ * reached without any overload.
+ *
+ * Not thread-safe: each server worker keeps one of its own; the counters may be read from any
+ * thread (see `http_admission_stats_add`).
+ */
+typedef struct http_admission {
+    uint64_t target_delay_ns;
+    uint64_t interval_ns;
+    size_t min_concurrency;
+    size_t max_concurrency;
+
+    atomic_size_t limit;
+    atomic_size_t in_flight;
+    /// the end of the current interval, and the shortest delay a request saw in it (UINT64_MAX for none)
+    uint64_t interval_end_ns;
+    uint64_t interval_min_delay_ns;
+    /// no request of the last interval got through in under the target
+    atomic_bool overloaded;
+    /// the limit turned a request away in the current interval
+    bool limited;
+
+    atomic_size_t admitted;
+    atomic_size_t shed_delay;
+    atomic_size_t shed_concurrency;
+} http_admission;
+
+/**
+ * A snapshot of how admission control has been doing.
+ */
+typedef struct http_admission_stats {
+    /// requests in flight may not exceed this
+    size_t limit;
+    size_t in_flight;
+    size_t admitted;
+    /// requests shed for having queued too long
+    size_t shed_delay;
+    /// requests shed for the limit on requests in flight
+    size_t shed_concurrency;
+    /// workers that counted as overloaded
+    size_t overloaded;
+} http_admission_stats;
+
+/**
+ * @return nanoseconds of `CLOCK_MONOTONIC`, which queueing delays are measured in
+ */
+uint64_t http_admission_clock_ns(void);
+
+void http_admission_init(http_admission *admission, const http_admission_settings *settings, uint64_t now_ns);
+
+/**
+ * Decides on a request that has been waiting since `queued_ns`; an admitted request is in flight until
+ * `http_admission_complete`.
+ */
+http_admission_verdict http_admission_admit(http_admission *admission, uint64_t now_ns, uint64_t queued_ns);
+
+void http_admission_complete(http_admission *admission);
+
+/**
+ * Adds the admission's counters to `out_stats`.
+ */
+void http_admission_stats_add(const http_admission *admission, http_admission_stats *out_stats);
+
+#endif //TINY_HTTP_ADMISSION_H
@@ -0,0 +1,109 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+#define ARENA_ALIGN_UP(n) (((n) + (ARENA_ALIGNMENT - 1)) & ~(ARENA_ALIGNMENT - 1))
+
+struct http_arena_chunk {
+    http_arena_chunk *next;
+    size_t size;
+    alignas(max_align_t) uint8_t data[];
+};
+
+void http_arena_init(http_arena *arena, void *block, const size_t capacity) {
+    *arena = (http_arena){
+        .block = block,
+        .capacity = capacity,
+        .used = 0,
+        .last_alloc_offset = SIZE_MAX,
+        .owns_block = false,
+        .overflow = nullptr,
+        .overflow_bytes = 0,
+    };
+}
+
+http_arena *http_arena_create(const size_t capacity) {
+    http_arena *arena = malloc(sizeof(http_arena));
+    if (arena == nullptr) return nullptr;
+    uint8_t *block = malloc(capacity);
+    if (block == nullptr) {
+        free(arena);
+        return nullptr;
+    }
+    http_arena_init(arena, block, capacity);
+    arena->owns_block = true;
+    return arena;
+}
+
+void *http_arena_alloc(http_arena *arena, const size_t size) {
+    const size_t aligned_used = ARENA_ALIGN_UP(arena->used);
+    if (aligned_used <= arena->capacity && size <= arena->capacity - aligned_used) {
+        arena->last_alloc_offset = aligned_used;
+        arena->used = aligned_used + size;
+        return arena->block + aligned_used;
+    }
+    http_arena_chunk *chunk = malloc(sizeof(http_arena_chunk) + size);
+    if (chunk == nullptr) return nullptr;
+    chunk->size = size;
+    chunk->next = arena->overflow;
+    arena->overflow = chunk;
+    arena->overflow_bytes += ARENA_ALIGN_UP(size);
+    return chunk->data;
+}
+
+void *http_arena_realloc(http_arena *arena, void *ptr, const size_t old_size, const size_t new_size) {
+    if (ptr == nullptr) return http_arena_alloc(arena, new_size);
+    if (new_size <= old_size) return ptr;
+    if (arena->last_alloc_offset != SIZE_MAX
+        && (uint8_t *) ptr == arena->block + arena->last_alloc_offset
+        && new_size <= arena->capacity - arena->last_alloc_offset) {
+        arena->used = arena->last_alloc_offset + new_size;
+        return ptr;
+    }
+    void *grown = http_arena_alloc(arena, new_size);
+    if (grown == nullptr) return nullptr;
+    memcpy(grown, ptr, old_size);
+    return grown;
+}
+
+static void free_overflow(http_arena *arena) {
+    while (arena->overflow != nullptr) {
+        http_arena_chunk *next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+}
+
+void http_arena_reset(http_arena *arena) {
+    if (arena == nullptr) return;
+    free_overflow(arena);
+    if (arena->owns_block && arena->overflow_bytes > 0) {
+        // the last cycle did not fit: grow so that the next one does
+        const size_t new_capacity = arena->capacity + arena->overflow_bytes;
+        uint8_t *new_block = malloc(new_capacity);
+        if (new_block != nullptr) {
+            free(arena->block);
+            arena->block = new_block;
+            arena->capacity = new_capacity;
+        }
+    }
+    arena->overflow_bytes = 0;
+    arena->used = 0;
+    arena->last_alloc_offset = SIZE_MAX;
+}
+
+void http_arena_destroy(http_arena *arena) {
+    if (arena == nullptr) return;
+    free_overflow(arena);
+    if (arena->owns_block) {
+        free(arena->block);
+        free(arena);
+    }
+}
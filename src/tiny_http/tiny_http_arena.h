@@ -0,0 +1,64 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_ARENA_H
+#define TINY_HTTP_ARENA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct http_arena_chunk http_arena_chunk;
+
+/**
+ * A bump allocator for everything that lives exactly as long as one request/response cycle.
+ *
+ * Allocations are carved out of `block` front to back; nothing is freed individually and the whole
+ * arena is released with a single `http_arena_reset`. When `block` runs out the arena spills into
+ * malloc'd overflow chunks; an arena that owns its block grows it on the next reset so the steady
+ * state stays inside one block.
+ */
+typedef struct http_arena {
+    uint8_t *block;
+    size_t capacity;
+    size_t used;
+    size_t last_alloc_offset;
+    bool owns_block;
+    http_arena_chunk *overflow;
+    size_t overflow_bytes;
+} http_arena;
+
+/**
+ * Initialises an arena over a caller-owned block (e.g. a stack buffer or a pooled slab).
+ * The block is never freed nor grown by the arena.
+ */
+void http_arena_init(http_arena *arena, void *block, size_t capacity);
+
+/**
+ * @return a heap allocated arena owning a `capacity` octet block, or nullptr on allocation failure
+ */
+http_arena *http_arena_create(size_t capacity);
+
+/**
+ * @return `size` octets aligned to `max_align_t`, or nullptr if the overflow chunk cannot be allocated
+ */
+void *http_arena_alloc(http_arena *arena, size_t size);
+
+/**
+ * Grows `ptr` (previously returned by this arena with `old_size` octets); extends in place when `ptr`
+ * is the most recent allocation, otherwise copies into a new allocation.
+ */
+void *http_arena_realloc(http_arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Releases every allocation made since the last reset.
+ */
+void http_arena_reset(http_arena *arena);
+
+/**
+ * Releases the overflow chunks, the block if the arena owns it and, for `http_arena_create`d arenas,
+ * the arena itself.
+ */
+void http_arena_destroy(http_arena *arena);
+
+#endif //TINY_HTTP_ARENA_H
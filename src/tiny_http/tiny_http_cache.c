@@ -0,0 +1,477 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_cache.h"
+#include "tiny_http_compress.h"
+#include "tiny_http_log.h"
+#include "tiny_http_lru.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define CACHE_DEFAULT_SHARDS 16
+/// marks a `vary` header the request did not send, as opposed to one sent empty
+#define CACHE_KEY_ABSENT UINT32_MAX
+
+/**
+ * One cached response, allocated in one piece together with its key and octets.
+ */
+struct http_cached_response {
+    /// the hash of the key; `size` is the octets charged against the shard's budget
+    http_lru_entry lru;
+    const uint8_t *key;
+    size_t key_len;
+    /// " 200 OK\r\n" and the header lines: neither the version in front nor the blank line after
+    const uint8_t *head;
+    size_t head_len;
+    /// likewise for the `304 Not Modified` variant
+    const uint8_t *not_modified_head;
+    size_t not_modified_head_len;
+    const uint8_t *body;
+    size_t body_len;
+    const char *etag;
+    size_t etag_len;
+    /// -1 if the response has no `Last-Modified`
+    time_t last_modified;
+    /// 0 if it never expires
+    time_t expires_at;
+};
+
+/**
+ * What an entry is looked up by.
+ */
+typedef struct cache_key {
+    const uint8_t *octets;
+    size_t len;
+} cache_key;
+
+struct http_response_cache {
+    http_lru entries;
+    unsigned ttl_seconds;
+    http_header_id *vary;
+    size_t vary_cnt;
+    bool vary_content_coding;
+};
+
+static time_t now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return now.tv_sec;
+}
+
+// region keys
+
+static uint64_t hash_octets(const uint8_t *octets, const size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash ^= octets[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Appends a length-prefixed piece of the key at `out + at`, or only measures it if `out` is nullptr.
+ */
+static size_t key_append(uint8_t *out, const size_t at, const void *piece, const uint32_t len) {
+    if (out != nullptr) {
+        memcpy(out + at, &len, sizeof(len));
+        if (len != CACHE_KEY_ABSENT && len > 0) memcpy(out + at + sizeof(len), piece, len);
+    }
+    return at + sizeof(len) + (len != CACHE_KEY_ABSENT ? len : 0);
+}
+
+/**
+ * Writes the key of `request` to `out`: the path, the query, the value of every `vary` header, then the
+ * content coding if the cache varies on it.
+ *
+ * @return the length of the key; `out` may be nullptr to only measure it
+ */
+static size_t build_key(const http_response_cache *cache, const http_request *request, uint8_t *out) {
+    size_t len = key_append(out, 0, request->path, (uint32_t) strlen(request->path));
+    len = request->query.ptr != nullptr
+              ? key_append(out, len, request->query.ptr, (uint32_t) request->query.len)
+              : key_append(out, len, nullptr, CACHE_KEY_ABSENT);
+    for (size_t i = 0; i < cache->vary_cnt; i++) {
+        const http_header *header = http_request_header(request, cache->vary[i]);
+        len = header != nullptr
+                  ? key_append(out, len, header->value, (uint32_t) strlen(header->value))
+                  : key_append(out, len, nullptr, CACHE_KEY_ABSENT);
+    }
+    if (cache->vary_content_coding) {
+        const uint8_t coding = (uint8_t) http_content_coding_negotiate(request);
+        len = key_append(out, len, &coding, sizeof(coding));
+    }
+    return len;
+}
+
+/**
+ * @return the key of `request`, allocated from its arena if it has one or else from malloc (see `free_key`)
+ */
+static uint8_t *alloc_key(const http_response_cache *cache, const http_request *request, size_t *out_len) {
+    *out_len = build_key(cache, request, nullptr);
+    uint8_t *key = request->arena != nullptr ? http_arena_alloc(request->arena, *out_len) : malloc(*out_len);
+    if (key != nullptr) build_key(cache, request, key);
+    return key;
+}
+
+static void free_key(const http_request *request, uint8_t *key) {
+    if (request->arena == nullptr) free(key);
+}
+
+// endregion keys
+
+// region entries
+
+static bool entry_matches(const http_lru_entry *entry, const void *key) {
+    const http_cached_response *cached = (const http_cached_response *) entry;
+    const cache_key *wanted = key;
+    return cached->key_len == wanted->len && memcmp(cached->key, wanted->octets, wanted->len) == 0;
+}
+
+static void entry_free(http_lru_entry *entry) {
+    free(entry);
+}
+
+// endregion entries
+
+http_response_cache *http_response_cache_create(const http_response_cache_settings *settings) {
+    http_response_cache *cache = calloc(1, sizeof(http_response_cache));
+    if (cache == nullptr) return nullptr;
+    cache->ttl_seconds = settings->ttl_seconds;
+    cache->vary_cnt = settings->vary_cnt;
+    cache->vary_content_coding = settings->vary_content_coding;
+    cache->vary = calloc(settings->vary_cnt + 1, sizeof(http_header_id));
+    const size_t shards_cnt = settings->shards > 0 ? settings->shards : CACHE_DEFAULT_SHARDS;
+    if (cache->vary == nullptr
+        || !http_lru_init(&cache->entries, shards_cnt, settings->max_bytes, entry_matches, entry_free)) {
+        free(cache->vary);
+        free(cache);
+        return nullptr;
+    }
+    if (settings->vary_cnt > 0) memcpy(cache->vary, settings->vary, settings->vary_cnt * sizeof(http_header_id));
+    return cache;
+}
+
+void http_response_cache_destroy(http_response_cache *cache) {
+    if (cache == nullptr) return;
+    http_lru_destroy(&cache->entries);
+    free(cache->vary);
+    free(cache);
+}
+
+// region conditional requests
+
+/**
+ * @return true if the comma separated `Cache-Control` value has `directive` (with or without an argument)
+ */
+static bool cache_control_has(const char *value, const char *directive) {
+    const size_t directive_len = strlen(directive);
+    while (*value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        const size_t len = strcspn(value, ",=");
+        size_t name_len = len;
+        while (name_len > 0 && (value[name_len - 1] == ' ' || value[name_len - 1] == '\t')) name_len--;
+        if (name_len == directive_len && strncasecmp(value, directive, directive_len) == 0) return true;
+        value += len;
+        value += strcspn(value, ",");
+    }
+    return false;
+}
+
+/**
+ * @return the IMF-fixdate `value` (RFC 9110 §5.6.7) as a `time_t`, or -1 if it is not one
+ */
+static time_t parse_http_date(const char *value) {
+    struct tm tm = {};
+    const char *end = strptime(value, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0') return -1;
+    return timegm(&tm);
+}
+
+/**
+ * @return true if the `If-None-Match` list `value` has `etag` (weak comparison) or is "*"
+ */
+static bool etag_list_matches(const char *value, const char *etag, size_t etag_len) {
+    if (etag_len > 2 && etag[0] == 'W' && etag[1] == '/') {
+        etag += 2;
+        etag_len -= 2;
+    }
+    while (*value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        const size_t len = strcspn(value, ",");
+        size_t tag_len = len;
+        while (tag_len > 0 && (value[tag_len - 1] == ' ' || value[tag_len - 1] == '\t')) tag_len--;
+        const char *tag = value;
+        if (tag_len == 1 && tag[0] == '*') return true;
+        if (tag_len > 2 && tag[0] == 'W' && tag[1] == '/') {
+            tag += 2;
+            tag_len -= 2;
+        }
+        if (tag_len == etag_len && memcmp(tag, etag, etag_len) == 0) return true;
+        value += len;
+    }
+    return false;
+}
+
+/**
+ * Evaluates the request's preconditions against `entry` (RFC 9110 §13.2.2): `If-None-Match` if the
+ * request has it, otherwise `If-Modified-Since`.
+ */
+static bool is_not_modified(const http_request *request, const http_cached_response *entry) {
+    const http_header *if_none_match = http_request_header(request, HTTP_HEADER_IF_NONE_MATCH);
+    if (if_none_match != nullptr) return etag_list_matches(if_none_match->value, entry->etag, entry->etag_len);
+    const http_header *if_modified_since = http_request_header(request, HTTP_HEADER_IF_MODIFIED_SINCE);
+    if (if_modified_since == nullptr || entry->last_modified < 0) return false;
+    const time_t since = parse_http_date(if_modified_since->value);
+    return since >= 0 && entry->last_modified <= since;
+}
+
+// endregion conditional requests
+
+static bool request_is_cacheable(const http_request *request) {
+    if (request->path == nullptr || http_request_header(request, HTTP_HEADER_AUTHORIZATION) != nullptr) return false;
+    const http_header *cache_control = http_request_header(request, HTTP_HEADER_CACHE_CONTROL);
+    return cache_control == nullptr
+           || !(cache_control_has(cache_control->value, "no-cache") || cache_control_has(cache_control->value, "no-store"));
+}
+
+enum http_cache_lookup_result http_response_cache_lookup(
+    http_response_cache *cache,
+    const http_request *request,
+    http_cached_response **out_cached) {
+    *out_cached = nullptr;
+    if ((request->method != GET && request->method != HEAD) || !request_is_cacheable(request)) return HTTP_CACHE_MISS;
+    size_t key_len = 0;
+    uint8_t *key = alloc_key(cache, request, &key_len);
+    if (key == nullptr) return HTTP_CACHE_MISS;
+    const uint64_t hash = hash_octets(key, key_len);
+    const cache_key wanted = {.octets = key, .len = key_len};
+    http_lru_shard *shard = http_lru_shard_of(&cache->entries, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    http_cached_response *entry = (http_cached_response *) http_lru_find(&cache->entries, shard, hash, &wanted);
+    if (entry != nullptr && entry->expires_at != 0 && now_seconds() >= entry->expires_at) {
+        http_lru_remove(shard, &entry->lru);
+        entry = nullptr;
+    }
+    if (entry != nullptr) http_lru_touch(shard, &entry->lru);
+    pthread_mutex_unlock(&shard->lock);
+    free_key(request, key);
+
+    if (entry == nullptr) return HTTP_CACHE_MISS;
+    *out_cached = entry;
+    return is_not_modified(request, entry) ? HTTP_CACHE_NOT_MODIFIED : HTTP_CACHE_HIT;
+}
+
+void http_cached_response_release(http_cached_response *cached) {
+    if (cached != nullptr) http_lru_release(&cached->lru);
+}
+
+// region storing
+
+static const char *find_response_header(const http_response *response, const char *name) {
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        if (response->headers[i].name != nullptr && strcasecmp(response->headers[i].name, name) == 0) {
+            return response->headers[i].value;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @return true if the key has every request header the `Vary` list `value` names
+ */
+static bool cache_keys_on(const http_response_cache *cache, const char *value) {
+    while (*value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        const size_t len = strcspn(value, ",");
+        size_t name_len = len;
+        while (name_len > 0 && (value[name_len - 1] == ' ' || value[name_len - 1] == '\t')) name_len--;
+        if (name_len > 0) {
+            const http_header_id id = http_header_lookup((const uint8_t *) value, name_len);
+            bool keyed = id == HTTP_HEADER_ACCEPT_ENCODING && cache->vary_content_coding;
+            for (size_t i = 0; i < cache->vary_cnt && !keyed && id != HTTP_HEADER_UNKNOWN; i++) {
+                keyed = cache->vary[i] == id;
+            }
+            // "*" and names the parser does not intern are never keyed on
+            if (!keyed) return false;
+        }
+        value += len;
+    }
+    return true;
+}
+
+static bool response_is_cacheable(const http_response_cache *cache, const http_response *response) {
+    if (response->status_code != 200 || response->body_producer != nullptr || response->body_file.len > 0) {
+        return false;
+    }
+    if (find_response_header(response, "Set-Cookie") != nullptr
+        || find_response_header(response, "Connection") != nullptr
+        || find_response_header(response, "Transfer-Encoding") != nullptr) {
+        return false;
+    }
+    const char *vary = find_response_header(response, "Vary");
+    if (vary != nullptr && !cache_keys_on(cache, vary)) return false;
+    const char *cache_control = find_response_header(response, "Cache-Control");
+    return cache_control == nullptr
+           || !(cache_control_has(cache_control, "no-store")
+                || cache_control_has(cache_control, "no-cache")
+                || cache_control_has(cache_control, "private"));
+}
+
+/// the headers a `304` repeats from the `200` (RFC 9110 §15.4.5); `Date` is added to either as it is sent
+static const char *const not_modified_headers[] = {
+    "Cache-Control", "Content-Location", "ETag", "Expires", "Last-Modified", "Vary",
+};
+
+/**
+ * Renders the head of `response` without the version in front and the blank line after.
+ *
+ * @return the malloc'd head, or nullptr
+ */
+static uint8_t *render_head(const http_response *response, size_t *out_len) {
+    struct iovec iov[2];
+    size_t iov_cnt = 0;
+    const http_response head_only = {
+        .version = response->version,
+        .status_code = response->status_code,
+        .reason_phrase = response->reason_phrase,
+        .headers = response->headers,
+        .headers_cnt = response->headers_cnt,
+        .header_fragments = response->header_fragments,
+        .header_fragments_cnt = response->header_fragments_cnt,
+    };
+    if (render_http_response_iov(nullptr, nullptr, &head_only, iov, &iov_cnt) != RENDER_OK) return nullptr;
+    // "HTTP/1.x" ... "\r\n\r\n"; there always is a header, so always a blank line
+    *out_len = iov[0].iov_len - 8 - 2;
+    return iov[0].iov_base;
+}
+
+bool http_response_cache_store(
+    http_response_cache *cache,
+    const http_request *request,
+    const http_response *response) {
+    if (request->method != GET || !request_is_cacheable(request) || !response_is_cacheable(cache, response)) return false;
+    const size_t body_len = response->body != nullptr ? response->body_len : 0;
+
+    // the handler's headers, plus `Content-Length` and an `ETag` if it did not set them
+    http_header *headers = malloc((response->headers_cnt + 2) * sizeof(http_header));
+    if (headers == nullptr) return false;
+    if (response->headers_cnt > 0) memcpy(headers, response->headers, response->headers_cnt * sizeof(http_header));
+    size_t headers_cnt = response->headers_cnt;
+    char content_length[24];
+    char etag[24];
+    if (find_response_header(response, "Content-Length") == nullptr) {
+        snprintf(content_length, sizeof(content_length), "%zu", body_len);
+        headers[headers_cnt++] = (http_header){.name = "Content-Length", .value = content_length};
+    }
+    if (find_response_header(response, "ETag") == nullptr) {
+        snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) hash_octets(response->body, body_len));
+        headers[headers_cnt++] = (http_header){.name = "ETag", .value = etag};
+    }
+    http_header not_modified[sizeof(not_modified_headers) / sizeof(not_modified_headers[0])];
+    size_t not_modified_cnt = 0;
+    for (size_t i = 0; i < headers_cnt; i++) {
+        for (size_t j = 0; j < sizeof(not_modified_headers) / sizeof(not_modified_headers[0]); j++) {
+            if (strcasecmp(headers[i].name, not_modified_headers[j]) == 0
+                && not_modified_cnt < sizeof(not_modified) / sizeof(not_modified[0])) {
+                not_modified[not_modified_cnt++] = headers[i];
+            }
+        }
+    }
+
+    http_response full = *response;
+    full.headers = headers;
+    full.headers_cnt = headers_cnt;
+    const http_response not_modified_response = {
+        .version = response->version,
+        .status_code = 304,
+        .headers = not_modified,
+        .headers_cnt = not_modified_cnt,
+    };
+    size_t head_len = 0;
+    size_t not_modified_head_len = 0;
+    size_t key_len = 0;
+    uint8_t *head = render_head(&full, &head_len);
+    uint8_t *not_modified_head = render_head(&not_modified_response, &not_modified_head_len);
+    uint8_t *key = alloc_key(cache, request, &key_len);
+    const char *etag_value = find_response_header(&full, "ETag");
+    const size_t etag_len = strlen(etag_value);
+    const char *last_modified = find_response_header(&full, "Last-Modified");
+    free(headers);
+
+    http_cached_response *entry = nullptr;
+    if (head != nullptr && not_modified_head != nullptr && key != nullptr) {
+        entry = malloc(sizeof(http_cached_response) + key_len + head_len + not_modified_head_len + body_len + etag_len);
+    }
+    if (entry == nullptr) {
+        free(head);
+        free(not_modified_head);
+        if (key != nullptr) free_key(request, key);
+        return false;
+    }
+    uint8_t *octets = (uint8_t *) (entry + 1);
+    *entry = (http_cached_response){
+        .key = memcpy(octets, key, key_len),
+        .key_len = key_len,
+        .head = memcpy(octets + key_len, head + 8, head_len),
+        .head_len = head_len,
+        .not_modified_head = memcpy(octets + key_len + head_len, not_modified_head + 8, not_modified_head_len),
+        .not_modified_head_len = not_modified_head_len,
+        .body = body_len > 0 ? memcpy(octets + key_len + head_len + not_modified_head_len, response->body, body_len) : nullptr,
+        .body_len = body_len,
+        .etag = memcpy(octets + key_len + head_len + not_modified_head_len + body_len, etag_value, etag_len),
+        .etag_len = etag_len,
+        .last_modified = last_modified != nullptr ? parse_http_date(last_modified) : -1,
+        .expires_at = cache->ttl_seconds > 0 ? now_seconds() + cache->ttl_seconds : 0,
+    };
+    const size_t size = sizeof(http_cached_response) + key_len + head_len + not_modified_head_len + body_len + etag_len;
+    http_lru_entry_init(&cache->entries, &entry->lru, hash_octets(key, key_len), size);
+    free(head);
+    free(not_modified_head);
+    const cache_key stored_key = {.octets = entry->key, .len = key_len};
+    const bool stored = http_lru_add(&cache->entries, &entry->lru, &stored_key);
+    free_key(request, key);
+    http_lru_release(&entry->lru);
+    return stored;
+}
+
+// endregion storing
+
+size_t http_cached_response_iov(
+    const http_cached_response *cached,
+    const http_version version,
+    const bool keep_alive,
+    const bool not_modified,
+    const bool head_only,
+    const http_header_fragment *date,
+    struct iovec out_iov[static 5]) {
+    static const char close_suffix[] = "Connection: close\r\n\r\n";
+    static const char keep_alive_suffix[] = "Connection: keep-alive\r\n\r\n";
+    // `Connection` is only needed where the version's default does not already say what happens next
+    const char *suffix = "\r\n";
+    size_t suffix_len = 2;
+    if (version == HTTP_1_1 && !keep_alive) {
+        suffix = close_suffix;
+        suffix_len = sizeof(close_suffix) - 1;
+    } else if (version != HTTP_1_1 && keep_alive) {
+        suffix = keep_alive_suffix;
+        suffix_len = sizeof(keep_alive_suffix) - 1;
+    }
+    out_iov[0] = (struct iovec){.iov_base = version == HTTP_1_1 ? "HTTP/1.1" : "HTTP/1.0", .iov_len = 8};
+    out_iov[1] = not_modified
+                     ? (struct iovec){.iov_base = (void *) cached->not_modified_head, .iov_len = cached->not_modified_head_len}
+                     : (struct iovec){.iov_base = (void *) cached->head, .iov_len = cached->head_len};
+    size_t iov_cnt = 2;
+    if (date != nullptr) out_iov[iov_cnt++] = (struct iovec){.iov_base = (void *) date->octets, .iov_len = date->len};
+    out_iov[iov_cnt++] = (struct iovec){.iov_base = (void *) suffix, .iov_len = suffix_len};
+    if (not_modified || head_only || cached->body_len == 0) return iov_cnt;
+    out_iov[iov_cnt++] = (struct iovec){.iov_base = (void *) cached->body, .iov_len = cached->body_len};
+    return iov_cnt;
+}
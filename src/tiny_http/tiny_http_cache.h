@@ -0,0 +1,116 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_CACHE_H
+#define TINY_HTTP_CACHE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "tiny_http_server_lib.h"
+
+/**
+ * Keeps pre-rendered `GET` responses in memory, keyed by path (query included) and the values of the
+ * configured request headers, and serves them by reference: a hit costs no handler call, no rendering
+ * and no copy.
+ *
+ * Only `200` responses with an in-memory body are stored, and none that set a cookie, say
+ * `Cache-Control: no-store`, `no-cache` or `private` or `Vary` on a request header the cache is not keyed
+ * by; requests with `Authorization` or
+ * `Cache-Control: no-cache` bypass the cache. An `ETag` is added to responses without one, and
+ * `If-None-Match` / `If-Modified-Since` are answered with `304` straight from the cache. Header fragments
+ * are stored as they are and the checks above only look at `headers`, so a `Date` belongs in neither:
+ * it is given to `http_cached_response_iov` each time the response is sent instead.
+ *
+ * The cache is split into independently locked shards, so workers looking up different paths rarely
+ * wait for each other; an entry stays alive while a response is still being sent from it, even if it
+ * is evicted meanwhile.
+ */
+typedef struct http_response_cache http_response_cache;
+
+typedef struct http_cached_response http_cached_response;
+
+typedef struct http_response_cache_settings {
+    /// octets of cached heads and bodies the cache may hold in total
+    size_t max_bytes;
+    /// how long a response is served from the cache after it was stored; 0 means until it is evicted
+    unsigned ttl_seconds;
+    /// request headers whose values are part of the key, as a `Vary` response header would name them
+    const http_header_id *vary;
+    size_t vary_cnt;
+    /// key responses by the content coding `Accept-Encoding` negotiates (see `http_content_coding_negotiate`)
+    /// rather than by its raw value, as a cache in front of an `http_compressor` should
+    bool vary_content_coding;
+    /// independently locked parts of the cache; 0 means 16
+    size_t shards;
+} http_response_cache_settings;
+
+enum http_cache_lookup_result {
+    HTTP_CACHE_MISS = 0,
+    HTTP_CACHE_HIT = 1,
+    /// the client's copy is still good: answer with `304 Not Modified`
+    HTTP_CACHE_NOT_MODIFIED = 2,
+};
+
+/**
+ * @return the cache, or nullptr on allocation failure
+ */
+http_response_cache *http_response_cache_create(const http_response_cache_settings *settings);
+
+/**
+ * Frees the cache; no response served from it may still be in flight.
+ */
+void http_response_cache_destroy(http_response_cache *cache);
+
+/**
+ * Looks up the response to a `GET` or `HEAD` request.
+ *
+ * @param cache
+ * @param request
+ * @param out_cached Set on a hit (or not modified) to the entry, referenced until `http_cached_response_release`.
+ */
+enum http_cache_lookup_result http_response_cache_lookup(
+    http_response_cache *cache,
+    const http_request *request,
+    http_cached_response **out_cached);
+
+/**
+ * Renders and stores `response` to `request`, unless either is not cacheable.
+ *
+ * @return true if the response was stored
+ */
+bool http_response_cache_store(
+    http_response_cache *cache,
+    const http_request *request,
+    const http_response *response);
+
+/**
+ * Fills `out_iov` with the cached response, referencing the entry's octets in place.
+ *
+ * @param cached
+ * @param version The version of the status line.
+ * @param keep_alive Whether the connection stays open afterwards, for the `Connection` header.
+ * @param not_modified Send the `304 Not Modified` variant.
+ * @param head_only Leave the body out (`HEAD`).
+ * @param date The `Date` header line to send with either variant, e.g. a copy of `http_date_header`,
+ * or nullptr; referenced, not copied.
+ * @param out_iov Receives up to 5 entries.
+ *
+ * @return the number of entries of `out_iov` used
+ */
+size_t http_cached_response_iov(
+    const http_cached_response *cached,
+    http_version version,
+    bool keep_alive,
+    bool not_modified,
+    bool head_only,
+    const http_header_fragment *date,
+    struct iovec out_iov[static 5]);
+
+/**
+ * Drops the reference taken by `http_response_cache_lookup`.
+ */
+void http_cached_response_release(http_cached_response *cached);
+
+#endif //TINY_HTTP_CACHE_H
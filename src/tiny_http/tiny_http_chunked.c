@@ -0,0 +1,220 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_chunked.h"
+#include "tiny_http_log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/// chunk sizes are limited to 15 hex digits so they can never overflow
+#define CHUNK_SIZE_MAX_DIGITS 15
+/// "0\r\n\r\n": the last chunk with an empty trailer section
+#define LAST_CHUNK_LENGTH 5
+
+// region decoder
+
+static int hex_digit_value(const uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void http_chunked_decoder_init(http_chunked_decoder *decoder, const size_t max_body_len) {
+    *decoder = (http_chunked_decoder){
+        .state = HTTP_CHUNKED_STATE_SIZE,
+        .max_body_len = max_body_len,
+    };
+}
+
+static enum http_chunked_decode_result fail(
+    http_chunked_decoder *decoder,
+    const enum http_chunked_decode_result result,
+    const size_t consumed,
+    size_t *out_consumed) {
+    decoder->state = HTTP_CHUNKED_STATE_ERROR;
+    *out_consumed = consumed;
+    return result;
+}
+
+enum http_chunked_decode_result http_chunked_decoder_feed(
+    http_chunked_decoder *decoder,
+    const uint8_t *data,
+    const size_t data_len,
+    size_t *out_consumed,
+    http_slice *out_data) {
+    *out_data = (http_slice){};
+    size_t i = 0;
+    while (i < data_len && decoder->state != HTTP_CHUNKED_STATE_DONE && decoder->state != HTTP_CHUNKED_STATE_ERROR) {
+        const uint8_t c = data[i];
+        switch (decoder->state) {
+            case HTTP_CHUNKED_STATE_SIZE: {
+                const int digit = hex_digit_value(c);
+                if (digit >= 0) {
+                    if (decoder->size_digits == CHUNK_SIZE_MAX_DIGITS) {
+                        http_log_debug("chunk size too long\n");
+                        return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                    }
+                    decoder->chunk_remaining = decoder->chunk_remaining * 16 + (uint64_t) digit;
+                    decoder->size_digits++;
+                } else if (decoder->size_digits > 0 && (c == ';' || c == ' ' || c == '\t')) {
+                    decoder->extension_len = 0;
+                    decoder->state = HTTP_CHUNKED_STATE_EXTENSION;
+                } else if (decoder->size_digits > 0 && c == '\r') {
+                    decoder->state = HTTP_CHUNKED_STATE_SIZE_LF;
+                } else {
+                    http_log_debug("malformed chunk size\n");
+                    return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                }
+                i++;
+                break;
+            }
+            case HTTP_CHUNKED_STATE_EXTENSION:
+                if (c == '\r') {
+                    decoder->state = HTTP_CHUNKED_STATE_SIZE_LF;
+                } else if (c == '\n' || ++decoder->extension_len > HTTP_CHUNKED_MAX_EXTENSION_LENGTH) {
+                    http_log_debug("malformed chunk extension\n");
+                    return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                }
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_SIZE_LF:
+                if (c != '\n') return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                i++;
+                if (decoder->chunk_remaining == 0) {
+                    decoder->state = HTTP_CHUNKED_STATE_TRAILER_START;
+                } else if (decoder->chunk_remaining > decoder->max_body_len - decoder->body_len) {
+                    http_log_debug("Error: body length too large\n");
+                    return fail(decoder, HTTP_CHUNKED_TOO_LARGE, i, out_consumed);
+                } else {
+                    decoder->state = HTTP_CHUNKED_STATE_DATA;
+                }
+                break;
+            case HTTP_CHUNKED_STATE_DATA: {
+                const size_t available = data_len - i;
+                const size_t len = available < decoder->chunk_remaining ? available : (size_t) decoder->chunk_remaining;
+                *out_data = (http_slice){.ptr = data + i, .len = len};
+                decoder->chunk_remaining -= len;
+                decoder->body_len += len;
+                if (decoder->chunk_remaining == 0) decoder->state = HTTP_CHUNKED_STATE_DATA_CR;
+                *out_consumed = i + len;
+                return HTTP_CHUNKED_DATA;
+            }
+            case HTTP_CHUNKED_STATE_DATA_CR:
+                if (c != '\r') return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                decoder->state = HTTP_CHUNKED_STATE_DATA_LF;
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_DATA_LF:
+                if (c != '\n') return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                decoder->state = HTTP_CHUNKED_STATE_SIZE;
+                decoder->size_digits = 0;
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_TRAILER_START:
+                if (c == '\r') {
+                    decoder->state = HTTP_CHUNKED_STATE_END_LF;
+                    i++;
+                } else {
+                    // a trailer field: skipped, like the chunk extensions
+                    decoder->state = HTTP_CHUNKED_STATE_TRAILER;
+                }
+                break;
+            case HTTP_CHUNKED_STATE_TRAILER:
+                if (c == '\r') {
+                    decoder->state = HTTP_CHUNKED_STATE_TRAILER_LF;
+                } else if (c == '\n' || ++decoder->trailer_len > HTTP_CHUNKED_MAX_TRAILER_LENGTH) {
+                    http_log_debug("malformed or too large trailer section\n");
+                    return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                }
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_TRAILER_LF:
+                if (c != '\n') return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                decoder->state = HTTP_CHUNKED_STATE_TRAILER_START;
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_END_LF:
+                if (c != '\n') return fail(decoder, HTTP_CHUNKED_MALFORMED, i, out_consumed);
+                decoder->state = HTTP_CHUNKED_STATE_DONE;
+                i++;
+                break;
+            case HTTP_CHUNKED_STATE_DONE:
+            case HTTP_CHUNKED_STATE_ERROR:
+                break;
+        }
+    }
+    *out_consumed = i;
+    switch (decoder->state) {
+        case HTTP_CHUNKED_STATE_DONE:
+            return HTTP_CHUNKED_COMPLETE;
+        case HTTP_CHUNKED_STATE_ERROR:
+            return HTTP_CHUNKED_MALFORMED;
+        default:
+            return HTTP_CHUNKED_NEED_MORE;
+    }
+}
+
+// endregion decoder
+
+// region writer
+
+void http_response_writer_init(http_response_writer *writer, uint8_t *buf, const size_t capacity, const bool chunked) {
+    *writer = (http_response_writer){
+        .buf = buf,
+        .capacity = capacity,
+        .chunked = chunked,
+    };
+}
+
+static size_t hex_digits(size_t value) {
+    size_t digits = 1;
+    while (value >= 16) {
+        value /= 16;
+        digits++;
+    }
+    return digits;
+}
+
+size_t http_response_writer_write(http_response_writer *writer, const void *data, const size_t data_len) {
+    if (writer->ended || data_len == 0) return 0;
+    if (!writer->chunked) {
+        const size_t room = writer->capacity - writer->len;
+        const size_t len = data_len < room ? data_len : room;
+        memcpy(writer->buf + writer->len, data, len);
+        writer->len += len;
+        return len;
+    }
+
+    // always leave room for the last chunk, so `http_response_writer_end` cannot fail
+    const size_t room = writer->capacity - writer->len - LAST_CHUNK_LENGTH;
+    // the framing is the chunk size in hex and two CRLFs: take as much data as still fits around it
+    if (room <= 5) return 0;
+    size_t len = data_len < room - 5 ? data_len : room - 5;
+    while (hex_digits(len) + 4 + len > room) len--;
+
+    uint8_t *out = writer->buf + writer->len;
+    out += sprintf((char *) out, "%zx\r\n", len);
+    memcpy(out, data, len);
+    out += len;
+    *out++ = '\r';
+    *out++ = '\n';
+    writer->len = (size_t) (out - writer->buf);
+    return len;
+}
+
+void http_response_writer_end(http_response_writer *writer) {
+    if (writer->ended) return;
+    writer->ended = true;
+    if (!writer->chunked) return;
+    memcpy(writer->buf + writer->len, "0\r\n\r\n", LAST_CHUNK_LENGTH);
+    writer->len += LAST_CHUNK_LENGTH;
+}
+
+void http_response_writer_clear(http_response_writer *writer) {
+    writer->len = 0;
+}
+
+// endregion writer
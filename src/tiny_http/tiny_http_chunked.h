@@ -0,0 +1,131 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_CHUNKED_H
+#define TINY_HTTP_CHUNKED_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiny_http_server_lib.h"
+
+/// the most octets of chunk extensions allowed on a single chunk-size line
+#define HTTP_CHUNKED_MAX_EXTENSION_LENGTH 256
+/// the most octets the trailer section may take in total
+#define HTTP_CHUNKED_MAX_TRAILER_LENGTH 4096
+/// room for the framing of one chunk of data plus the last chunk
+#define HTTP_RESPONSE_WRITER_MIN_CAPACITY 32
+
+typedef enum http_chunked_decoder_state {
+    HTTP_CHUNKED_STATE_SIZE = 0,
+    HTTP_CHUNKED_STATE_EXTENSION,
+    HTTP_CHUNKED_STATE_SIZE_LF,
+    HTTP_CHUNKED_STATE_DATA,
+    HTTP_CHUNKED_STATE_DATA_CR,
+    HTTP_CHUNKED_STATE_DATA_LF,
+    HTTP_CHUNKED_STATE_TRAILER_START,
+    HTTP_CHUNKED_STATE_TRAILER,
+    HTTP_CHUNKED_STATE_TRAILER_LF,
+    HTTP_CHUNKED_STATE_END_LF,
+    HTTP_CHUNKED_STATE_DONE,
+    HTTP_CHUNKED_STATE_ERROR,
+} http_chunked_decoder_state;
+
+enum http_chunked_decode_result {
+    HTTP_CHUNKED_NEED_MORE = 0,
+    HTTP_CHUNKED_DATA = 1,
+    HTTP_CHUNKED_COMPLETE = 2,
+    HTTP_CHUNKED_MALFORMED = -1,
+    HTTP_CHUNKED_TOO_LARGE = -2,
+};
+
+/**
+ * An incremental decoder for a `Transfer-Encoding: chunked` body (RFC 9112 §7.1).
+ *
+ * The decoder only keeps a few counters: the chunk data is handed back as slices of the caller's
+ * own input, so the framing can arrive split at any octet without anything being buffered.
+ * Chunk extensions and trailer fields are skipped.
+ */
+typedef struct http_chunked_decoder {
+    http_chunked_decoder_state state;
+    uint64_t chunk_remaining;
+    size_t size_digits;
+    size_t extension_len;
+    size_t trailer_len;
+    size_t body_len;
+    size_t max_body_len;
+} http_chunked_decoder;
+
+/**
+ * @param decoder
+ * @param max_body_len The most decoded body octets to accept.
+ */
+void http_chunked_decoder_init(http_chunked_decoder *decoder, size_t max_body_len);
+
+/**
+ * Feeds the next piece of a chunked body to the decoder.
+ *
+ * Call repeatedly, advancing `data` by `*out_consumed` each time, until every octet is consumed or
+ * `HTTP_CHUNKED_COMPLETE` is returned; any octets left over after that belong to the next request.
+ *
+ * @param decoder
+ * @param data The newly received octets.
+ * @param data_len The number of newly received octets.
+ * @param out_consumed Set to the number of octets of `data` this call used up.
+ * @param out_data Set to the chunk data within `data` when `HTTP_CHUNKED_DATA` is returned.
+ *
+ * @retval HTTP_CHUNKED_NEED_MORE every octet was consumed and the body is not complete yet
+ * @retval HTTP_CHUNKED_DATA `*out_data` is the next piece of the decoded body
+ * @retval HTTP_CHUNKED_COMPLETE the last chunk and the trailer section have been consumed
+ * @retval HTTP_CHUNKED_MALFORMED the framing is invalid
+ * @retval HTTP_CHUNKED_TOO_LARGE the decoded body would exceed `max_body_len`
+ */
+enum http_chunked_decode_result http_chunked_decoder_feed(
+    http_chunked_decoder *decoder,
+    const uint8_t *data,
+    size_t data_len,
+    size_t *out_consumed,
+    http_slice *out_data);
+
+/**
+ * Encodes a streamed response body into a caller-provided buffer, either as `Transfer-Encoding: chunked`
+ * or as is (for a body delimited by `Content-Length` or by closing the connection).
+ *
+ * The buffer bounds the memory a streamed body takes: once it is full `http_response_writer_write`
+ * accepts less than it was given, and the producer is called again after the buffer has been sent.
+ */
+struct http_response_writer {
+    uint8_t *buf;
+    size_t len;
+    size_t capacity;
+    bool chunked;
+    bool ended;
+};
+
+/**
+ * @param writer
+ * @param buf The buffer to encode into.
+ * @param capacity The size of `buf`; at least `HTTP_RESPONSE_WRITER_MIN_CAPACITY`.
+ * @param chunked Whether to frame every write as a chunk.
+ */
+void http_response_writer_init(http_response_writer *writer, uint8_t *buf, size_t capacity, bool chunked);
+
+/**
+ * Appends the next piece of the body (as a single chunk if the writer is chunked).
+ *
+ * @return the number of octets of `data` taken, less than `data_len` once the buffer is full
+ */
+size_t http_response_writer_write(http_response_writer *writer, const void *data, size_t data_len);
+
+/**
+ * Ends the body, appending the last chunk if the writer is chunked; there is always room for it.
+ */
+void http_response_writer_end(http_response_writer *writer);
+
+/**
+ * Empties the buffer once its contents have been sent.
+ */
+void http_response_writer_clear(http_response_writer *writer);
+
+#endif //TINY_HTTP_CHUNKED_H
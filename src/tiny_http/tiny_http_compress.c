@@ -0,0 +1,577 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_compress.h"
+#include "tiny_http_log.h"
+#include "tiny_http_lru.h"
+#include "tiny_http_metrics.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef TINY_HTTP_NO_COMPRESSION
+#include <zlib.h>
+#endif
+
+#define COMPRESS_DEFAULT_LEVEL 6
+#define COMPRESS_DEFAULT_MIN_LENGTH 1024
+#define COMPRESS_DEFAULT_MAX_LENGTH (8 * 1024 * 1024)
+/// zlib takes the input length as a 32-bit `uInt`
+#define COMPRESS_MAX_LENGTH ((size_t) UINT32_MAX)
+#define COMPRESS_DEFAULT_SHARDS 16
+
+static const char *const default_content_types[] = {
+    "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml",
+};
+
+static const char *const coding_names[HTTP_CODING_COUNT] = {
+    [HTTP_CODING_GZIP] = "gzip",
+    [HTTP_CODING_DEFLATE] = "deflate",
+};
+
+/**
+ * One compressed body, allocated in one piece together with its key and octets.
+ */
+struct http_compressed_variant {
+    /// `size` is the octets charged against the shard's budget
+    http_lru_entry lru;
+    http_content_coding coding;
+    bool from_file;
+    /// the uncompressed body itself or, for a file, its `file_identity`
+    const uint8_t *key;
+    size_t key_len;
+    /// nullptr if the body did not get any smaller
+    const uint8_t *octets;
+    size_t len;
+};
+
+/**
+ * What a variant is looked up by.
+ */
+typedef struct variant_key {
+    http_content_coding coding;
+    bool from_file;
+    const uint8_t *octets;
+    size_t len;
+} variant_key;
+
+/**
+ * What a file body is looked up by instead of its contents: the file changing on disk changes it too.
+ */
+typedef struct file_identity {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+    off_t offset;
+    size_t len;
+} file_identity;
+
+struct http_compressor {
+    int level;
+    size_t min_length;
+    size_t max_length;
+    const char *const *content_types;
+    size_t content_types_cnt;
+    /// keeps nothing if `http_compression_settings::max_cached_bytes` is 0
+    http_lru variants;
+    pthread_mutex_t streams_lock;
+    /// deflate streams not in use, by coding: set up once, reset between bodies
+    struct deflate_stream *idle_streams[HTTP_CODING_COUNT];
+};
+
+// region negotiation
+
+/**
+ * @return the qvalue of an `Accept-Encoding` element in thousandths, given its parameters
+ * `params[0, len)`; 1000 without one, 0 if it is malformed
+ */
+static int parse_qvalue(const char *params, const size_t len) {
+    size_t i = 0;
+    while (i < len && (params[i] == ' ' || params[i] == '\t' || params[i] == ';')) i++;
+    if (i + 2 > len || (params[i] != 'q' && params[i] != 'Q') || params[i + 1] != '=') return 1000;
+    i += 2;
+    if (i >= len || (params[i] != '0' && params[i] != '1')) return 0;
+    int qvalue = (params[i++] - '0') * 1000;
+    if (i < len && params[i] == '.') {
+        i++;
+        for (int scale = 100; scale > 0 && i < len && params[i] >= '0' && params[i] <= '9'; scale /= 10) {
+            qvalue += (params[i++] - '0') * scale;
+        }
+    }
+    return qvalue > 1000 ? 0 : qvalue;
+}
+
+http_content_coding http_content_coding_negotiate(const http_request *request) {
+    const http_header *accept_encoding = http_request_header(request, HTTP_HEADER_ACCEPT_ENCODING);
+    if (accept_encoding == nullptr) return HTTP_CODING_IDENTITY;
+    // -1 for a coding the header does not name, which then gets the qvalue of "*", if that is there
+    int qvalues[HTTP_CODING_COUNT] = {-1, -1, -1};
+    int any = -1;
+    const char *value = accept_encoding->value;
+    while (*value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        const size_t len = strcspn(value, ",");
+        const size_t token_len = strcspn(value, ",; \t");
+        const int qvalue = parse_qvalue(value + token_len, len - token_len);
+        if ((token_len == 4 && strncasecmp(value, "gzip", 4) == 0)
+            || (token_len == 6 && strncasecmp(value, "x-gzip", 6) == 0)) {
+            qvalues[HTTP_CODING_GZIP] = qvalue;
+        } else if (token_len == 7 && strncasecmp(value, "deflate", 7) == 0) {
+            qvalues[HTTP_CODING_DEFLATE] = qvalue;
+        } else if (token_len == 1 && value[0] == '*') {
+            any = qvalue;
+        }
+        value += len;
+    }
+    http_content_coding best = HTTP_CODING_IDENTITY;
+    int best_qvalue = 0;
+    for (http_content_coding coding = HTTP_CODING_GZIP; coding < HTTP_CODING_COUNT; coding++) {
+        const int qvalue = qvalues[coding] >= 0 ? qvalues[coding] : any;
+        if (qvalue > best_qvalue) {
+            best = coding;
+            best_qvalue = qvalue;
+        }
+    }
+    return best;
+}
+
+const char *http_content_coding_name(const http_content_coding coding) {
+    if (coding <= HTTP_CODING_IDENTITY || coding >= HTTP_CODING_COUNT) return nullptr;
+    return coding_names[coding];
+}
+
+// endregion negotiation
+
+// region deflate
+
+#ifndef TINY_HTTP_NO_COMPRESSION
+
+typedef struct deflate_stream {
+    z_stream z;
+    struct deflate_stream *next;
+} deflate_stream;
+
+static deflate_stream *acquire_stream(http_compressor *compressor, const http_content_coding coding) {
+    pthread_mutex_lock(&compressor->streams_lock);
+    deflate_stream *stream = compressor->idle_streams[coding];
+    if (stream != nullptr) compressor->idle_streams[coding] = stream->next;
+    pthread_mutex_unlock(&compressor->streams_lock);
+    if (stream != nullptr) return stream;
+
+    stream = calloc(1, sizeof(deflate_stream));
+    if (stream == nullptr) return nullptr;
+    // 16 on top of the window bits asks for the gzip wrapper instead of the zlib one
+    const int window_bits = coding == HTTP_CODING_GZIP ? 15 + 16 : 15;
+    if (deflateInit2(&stream->z, compressor->level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        http_log_error("cannot set up a deflate stream\n");
+        free(stream);
+        return nullptr;
+    }
+    return stream;
+}
+
+static void release_stream(http_compressor *compressor, const http_content_coding coding, deflate_stream *stream) {
+    deflateReset(&stream->z);
+    pthread_mutex_lock(&compressor->streams_lock);
+    stream->next = compressor->idle_streams[coding];
+    compressor->idle_streams[coding] = stream;
+    pthread_mutex_unlock(&compressor->streams_lock);
+}
+
+static void destroy_streams(http_compressor *compressor) {
+    for (size_t coding = 0; coding < HTTP_CODING_COUNT; coding++) {
+        while (compressor->idle_streams[coding] != nullptr) {
+            deflate_stream *stream = compressor->idle_streams[coding];
+            compressor->idle_streams[coding] = stream->next;
+            deflateEnd(&stream->z);
+            free(stream);
+        }
+    }
+}
+
+/**
+ * Compresses `src` into `out`, which has room for `len` octets: if it does not fit, it is not worth it.
+ *
+ * @return 1 with the compressed length in `out_len`, 0 if it did not get any smaller, -1 on failure
+ */
+static int deflate_octets(
+    http_compressor *compressor,
+    const http_content_coding coding,
+    const uint8_t *src,
+    const size_t len,
+    uint8_t *out,
+    size_t *out_len) {
+    deflate_stream *stream = acquire_stream(compressor, coding);
+    if (stream == nullptr) return -1;
+    stream->z.next_in = (Bytef *) src;
+    stream->z.avail_in = (uInt) len;
+    stream->z.next_out = out;
+    stream->z.avail_out = (uInt) len;
+    const int status = deflate(&stream->z, Z_FINISH);
+    *out_len = len - stream->z.avail_out;
+    release_stream(compressor, coding, stream);
+    if (status == Z_STREAM_END) return *out_len < len ? 1 : 0;
+    if (status == Z_OK || status == Z_BUF_ERROR) return 0;
+    http_log_error("cannot deflate a response body: %d\n", status);
+    return -1;
+}
+
+#else
+
+static void destroy_streams(http_compressor *compressor) {
+    (void) compressor;
+}
+
+static int deflate_octets(
+    http_compressor *compressor,
+    const http_content_coding coding,
+    const uint8_t *src,
+    const size_t len,
+    uint8_t *out,
+    size_t *out_len) {
+    (void) compressor, (void) coding, (void) src, (void) len, (void) out, (void) out_len;
+    return -1;
+}
+
+#endif
+
+// endregion deflate
+
+// region variants
+
+static uint64_t hash_key(const http_content_coding coding, const bool from_file, const uint8_t *key, const size_t len) {
+    // eight octets at a time, each word mixed in with a multiply and a shift
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ ((uint64_t) coding << 1 | from_file) ^ (uint64_t) len << 8;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, key + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, key + i, len - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ hash >> 29;
+}
+
+#ifndef TINY_HTTP_NO_COMPRESSION
+
+static bool variant_matches(const http_lru_entry *entry, const void *key) {
+    const http_compressed_variant *variant = (const http_compressed_variant *) entry;
+    const variant_key *wanted = key;
+    return variant->coding == wanted->coding && variant->from_file == wanted->from_file
+           && variant->key_len == wanted->len && memcmp(variant->key, wanted->octets, wanted->len) == 0;
+}
+
+static void variant_free(http_lru_entry *entry) {
+    free(entry);
+}
+
+#endif
+
+static bool file_identity_of(const http_file_body *file, file_identity *out_identity) {
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) return false;
+    // compared with memcmp, padding included
+    memset(out_identity, 0, sizeof(file_identity));
+    out_identity->dev = st.st_dev;
+    out_identity->ino = st.st_ino;
+    out_identity->size = st.st_size;
+    out_identity->mtime = st.st_mtim;
+    out_identity->ctime = st.st_ctim;
+    out_identity->offset = file->offset;
+    out_identity->len = file->len;
+    return true;
+}
+
+/**
+ * @return the `len` octets of `file`, malloc'd, or nullptr if they cannot be read
+ */
+static uint8_t *read_file_body(const http_file_body *file) {
+    uint8_t *octets = malloc(file->len);
+    if (octets == nullptr) return nullptr;
+    size_t done = 0;
+    while (done < file->len) {
+        const ssize_t read_len = pread(file->fd, octets + done, file->len - done, file->offset + (off_t) done);
+        if (read_len < 0 && errno == EINTR) continue;
+        if (read_len <= 0) {
+            http_log_error("cannot read a file body to compress: %s\n", read_len < 0 ? strerror(errno) : "truncated");
+            free(octets);
+            return nullptr;
+        }
+        done += (size_t) read_len;
+    }
+    return octets;
+}
+
+/**
+ * Compresses `src` into a new variant, referenced once for the caller.
+ *
+ * @return the variant, or nullptr on failure
+ */
+static http_compressed_variant *create_variant(
+    http_compressor *compressor,
+    const variant_key *key,
+    const uint64_t hash,
+    const uint8_t *src,
+    const size_t src_len) {
+    const size_t key_len = key->len;
+    // compressed straight into the variant, then shrunk to what it took
+    http_compressed_variant *variant = malloc(sizeof(http_compressed_variant) + key_len + src_len);
+    if (variant == nullptr) return nullptr;
+    size_t len = 0;
+    const int compressed = deflate_octets(
+        compressor, key->coding, src, src_len, (uint8_t *) (variant + 1) + key_len, &len);
+    if (compressed < 0) {
+        free(variant);
+        return nullptr;
+    }
+    if (compressed == 0) len = 0;
+    const size_t size = sizeof(http_compressed_variant) + key_len + len;
+    http_compressed_variant *shrunk = realloc(variant, size);
+    if (shrunk != nullptr) variant = shrunk;
+    uint8_t *octets = (uint8_t *) (variant + 1);
+    *variant = (http_compressed_variant){
+        .coding = key->coding,
+        .from_file = key->from_file,
+        .key = memcpy(octets, key->octets, key_len),
+        .key_len = key_len,
+        .octets = compressed ? octets + key_len : nullptr,
+        .len = len,
+    };
+    http_lru_entry_init(&compressor->variants, &variant->lru, hash, size);
+    return variant;
+}
+
+/**
+ * Looks up the `coding` variant of the body of `response`, compressing it on a miss.
+ *
+ * @return the variant, referenced once for the caller, or nullptr on failure
+ */
+static http_compressed_variant *acquire_variant(
+    http_compressor *compressor,
+    const http_content_coding coding,
+    const http_response *response) {
+    const bool from_file = response->body_file.len > 0;
+    file_identity identity;
+    const uint8_t *key = response->body;
+    size_t key_len = response->body_len;
+    if (from_file) {
+        if (!file_identity_of(&response->body_file, &identity)) return nullptr;
+        key = (const uint8_t *) &identity;
+        key_len = sizeof(identity);
+    }
+    const uint64_t hash = hash_key(coding, from_file, key, key_len);
+    const variant_key wanted = {.coding = coding, .from_file = from_file, .octets = key, .len = key_len};
+    http_compressed_variant *variant =
+            (http_compressed_variant *) http_lru_acquire(&compressor->variants, hash, &wanted);
+    if (variant != nullptr) {
+        http_metrics_count(HTTP_METRIC_COMPRESSION_CACHE_HITS, 1);
+        return variant;
+    }
+
+    uint8_t *file_octets = from_file ? read_file_body(&response->body_file) : nullptr;
+    if (from_file && file_octets == nullptr) return nullptr;
+    variant = create_variant(
+        compressor, &wanted, hash,
+        from_file ? file_octets : response->body, from_file ? response->body_file.len : response->body_len);
+    free(file_octets);
+    if (variant == nullptr) return nullptr;
+    const variant_key stored_key = {.coding = coding, .from_file = from_file, .octets = variant->key, .len = key_len};
+    http_lru_add(&compressor->variants, &variant->lru, &stored_key);
+    return variant;
+}
+
+void http_compressed_variant_release(http_compressed_variant *variant) {
+    if (variant != nullptr) http_lru_release(&variant->lru);
+}
+
+// endregion variants
+
+http_compressor *http_compressor_create(const http_compression_settings *settings) {
+#ifdef TINY_HTTP_NO_COMPRESSION
+    (void) settings;
+    http_log_error("tiny_http was built without compression\n");
+    return nullptr;
+#else
+    http_compressor *compressor = calloc(1, sizeof(http_compressor));
+    if (compressor == nullptr) return nullptr;
+    compressor->level = settings->level > 0 ? settings->level : COMPRESS_DEFAULT_LEVEL;
+    compressor->min_length = settings->min_length > 0 ? settings->min_length : COMPRESS_DEFAULT_MIN_LENGTH;
+    compressor->max_length = settings->max_length > 0 ? settings->max_length : COMPRESS_DEFAULT_MAX_LENGTH;
+    if (compressor->max_length > COMPRESS_MAX_LENGTH) compressor->max_length = COMPRESS_MAX_LENGTH;
+    compressor->content_types = settings->content_types != nullptr ? settings->content_types : default_content_types;
+    compressor->content_types_cnt = settings->content_types != nullptr
+                                        ? settings->content_types_cnt
+                                        : sizeof(default_content_types) / sizeof(default_content_types[0]);
+    pthread_mutex_init(&compressor->streams_lock, nullptr);
+    const size_t shards_cnt = settings->max_cached_bytes == 0 ? 0
+                              : settings->shards > 0 ? settings->shards : COMPRESS_DEFAULT_SHARDS;
+    if (!http_lru_init(&compressor->variants, shards_cnt, settings->max_cached_bytes, variant_matches, variant_free)) {
+        http_compressor_destroy(compressor);
+        return nullptr;
+    }
+    return compressor;
+#endif
+}
+
+void http_compressor_destroy(http_compressor *compressor) {
+    if (compressor == nullptr) return;
+    http_lru_destroy(&compressor->variants);
+    destroy_streams(compressor);
+    pthread_mutex_destroy(&compressor->streams_lock);
+    free(compressor);
+}
+
+// region responses
+
+static const char *find_response_header(const http_response *response, const char *name) {
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        if (response->headers[i].name != nullptr && strcasecmp(response->headers[i].name, name) == 0) {
+            return response->headers[i].value;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @return true if the comma separated list `value` has `token`, ignoring case
+ */
+static bool list_has_token(const char *value, const char *token) {
+    const size_t token_len = strlen(token);
+    while (*value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        const size_t len = strcspn(value, ",");
+        size_t element_len = len;
+        while (element_len > 0 && (value[element_len - 1] == ' ' || value[element_len - 1] == '\t')) element_len--;
+        if (element_len == token_len && strncasecmp(value, token, token_len) == 0) return true;
+        value += len;
+    }
+    return false;
+}
+
+static bool response_is_compressible(const http_compressor *compressor, const http_response *response) {
+    if (response->status_code < 200 || response->status_code >= 300
+        || response->status_code == 204 || response->status_code == 206
+        || response->body_producer != nullptr) {
+        return false;
+    }
+    const size_t len = response->body_file.len > 0
+                           ? response->body_file.len
+                           : response->body != nullptr ? response->body_len : 0;
+    if (len < compressor->min_length || len > compressor->max_length) return false;
+    if (find_response_header(response, "Content-Encoding") != nullptr
+        || find_response_header(response, "Content-Range") != nullptr) {
+        return false;
+    }
+    const char *cache_control = find_response_header(response, "Cache-Control");
+    if (cache_control != nullptr && list_has_token(cache_control, "no-transform")) return false;
+    const char *content_type = find_response_header(response, "Content-Type");
+    if (content_type == nullptr) return false;
+    for (size_t i = 0; i < compressor->content_types_cnt; i++) {
+        const char *type = compressor->content_types[i];
+        if (strncasecmp(content_type, type, strlen(type)) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @return `first` followed by `second`, nul-terminated, allocated in `arena`
+ */
+static char *arena_concat(http_arena *arena, const char *first, const char *second) {
+    const size_t first_len = strlen(first);
+    const size_t second_len = strlen(second);
+    char *joined = http_arena_alloc(arena, first_len + second_len + 1);
+    if (joined == nullptr) return nullptr;
+    memcpy(joined, first, first_len);
+    memcpy(joined + first_len, second, second_len + 1);
+    return joined;
+}
+
+/**
+ * Rewrites the headers of a response worth compressing for a body in `coding` (see
+ * `http_compress_response`), into a copy allocated in `arena`.
+ *
+ * @return false if the arena ran out of memory
+ */
+static bool rewrite_headers(http_arena *arena, http_response *response, const http_content_coding coding) {
+    // room for `Vary` and `Content-Encoding`
+    http_header *headers = http_arena_alloc(arena, (response->headers_cnt + 2) * sizeof(http_header));
+    if (headers == nullptr) return false;
+    size_t headers_cnt = 0;
+    bool has_vary = false;
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        http_header header = response->headers[i];
+        if (coding != HTTP_CODING_IDENTITY && strcasecmp(header.name, "Content-Length") == 0) continue;
+        if (strcasecmp(header.name, "Vary") == 0) {
+            has_vary = true;
+            if (!list_has_token(header.value, "Accept-Encoding") && !list_has_token(header.value, "*")) {
+                header.value = arena_concat(arena, header.value, ", Accept-Encoding");
+                if (header.value == nullptr) return false;
+            }
+        }
+        // a strong validator belongs to one representation, and the compressed body is another one
+        const size_t etag_len = strlen(header.value);
+        if (coding != HTTP_CODING_IDENTITY && strcasecmp(header.name, "ETag") == 0
+            && etag_len >= 2 && header.value[0] == '"' && header.value[etag_len - 1] == '"') {
+            // "tag" becomes "tag-gzip"
+            const size_t name_len = strlen(coding_names[coding]);
+            char *etag = http_arena_alloc(arena, etag_len + 1 + name_len + 1);
+            if (etag == nullptr) return false;
+            memcpy(etag, header.value, etag_len - 1);
+            etag[etag_len - 1] = '-';
+            memcpy(etag + etag_len, coding_names[coding], name_len);
+            memcpy(etag + etag_len + name_len, "\"", 2);
+            header.value = etag;
+        }
+        headers[headers_cnt++] = header;
+    }
+    if (!has_vary) headers[headers_cnt++] = (http_header){.name = "Vary", .value = "Accept-Encoding"};
+    if (coding != HTTP_CODING_IDENTITY) {
+        headers[headers_cnt++] = (http_header){.name = "Content-Encoding", .value = (char *) coding_names[coding]};
+    }
+    response->headers = headers;
+    response->headers_cnt = headers_cnt;
+    return true;
+}
+
+bool http_compress_response(
+    http_compressor *compressor,
+    const http_request *request,
+    http_response *response,
+    http_compressed_variant **out_variant) {
+    *out_variant = nullptr;
+    if (!response_is_compressible(compressor, response)) return true;
+    const http_content_coding coding = http_content_coding_negotiate(request);
+    // on failure the body goes out as it is, which is still a correct response
+    http_compressed_variant *variant = coding != HTTP_CODING_IDENTITY
+                                           ? acquire_variant(compressor, coding, response)
+                                           : nullptr;
+    const bool compressed = variant != nullptr && variant->octets != nullptr;
+    if (!rewrite_headers(request->arena, response, compressed ? coding : HTTP_CODING_IDENTITY)) {
+        http_compressed_variant_release(variant);
+        return false;
+    }
+    if (!compressed) {
+        http_compressed_variant_release(variant);
+        return true;
+    }
+    if (response->body_file.release != nullptr) response->body_file.release(response->body_file.release_state);
+    response->body_file = (http_file_body){};
+    response->body = (uint8_t *) variant->octets;
+    response->body_len = variant->len;
+    *out_variant = variant;
+    http_metrics_count(HTTP_METRIC_COMPRESSED_RESPONSES, 1);
+    return true;
+}
+
+// endregion responses
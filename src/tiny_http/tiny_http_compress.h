@@ -0,0 +1,104 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_COMPRESS_H
+#define TINY_HTTP_COMPRESS_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "tiny_http_server_lib.h"
+
+/**
+ * The content codings a response can be compressed with.
+ */
+typedef enum http_content_coding {
+    HTTP_CODING_IDENTITY = 0,
+    HTTP_CODING_GZIP = 1,
+    /// the zlib format, as RFC 9110 §8.4.1.2 has it
+    HTTP_CODING_DEFLATE = 2,
+    HTTP_CODING_COUNT = 3,
+} http_content_coding;
+
+/**
+ * Picks the coding to compress the response to `request` with from its `Accept-Encoding` (RFC 9110
+ * §12.5.3): the acceptable one with the highest qvalue, gzip before deflate on a tie. Without the
+ * header, or with nothing acceptable in it, the response is left as it is.
+ */
+http_content_coding http_content_coding_negotiate(const http_request *request);
+
+/**
+ * @return the token of `coding` for `Content-Encoding`, or nullptr for `HTTP_CODING_IDENTITY`
+ */
+const char *http_content_coding_name(http_content_coding coding);
+
+/**
+ * Compresses response bodies, and remembers what it compressed so that the same body (or file) sent
+ * again costs a lookup instead of another pass through deflate.
+ *
+ * Compressed variants are kept in a bounded cache, split into independently locked shards like the
+ * response cache; a variant stays alive while a response is still being sent from it, even if it is
+ * evicted meanwhile. Bodies that do not get any smaller are remembered too, and then sent as they are.
+ * Two workers asking for the same body at the same time may both compress it once.
+ */
+typedef struct http_compressor http_compressor;
+
+typedef struct http_compressed_variant http_compressed_variant;
+
+typedef struct http_compression_settings {
+    /// the zlib level, 1 (fastest) to 9 (smallest); 0 means 6
+    int level;
+    /// smaller bodies are sent as they are, the few octets saved would not pay for the CPU; 0 means 1 KiB
+    size_t min_length;
+    /// larger bodies are sent as they are, rather than keeping a worker busy for long; 0 means 8 MiB
+    size_t max_length;
+    /// media types worth compressing, each matching every `Content-Type` it is a prefix of (ignoring
+    /// case), e.g. "text/"; nullptr means text, JSON, JavaScript, XML and SVG; must outlive the compressor
+    const char *const *content_types;
+    size_t content_types_cnt;
+    /// octets of compressed variants (and the bodies they are looked up by) the cache may hold in
+    /// total; 0 means nothing is kept and every body is compressed afresh
+    size_t max_cached_bytes;
+    /// independently locked parts of the cache; 0 means 16
+    size_t shards;
+} http_compression_settings;
+
+/**
+ * @return the compressor, or nullptr on allocation failure (or if the library was built without
+ * compression, see `TINY_HTTP_COMPRESSION`)
+ */
+http_compressor *http_compressor_create(const http_compression_settings *settings);
+
+/**
+ * Frees the compressor; no response compressed by it may still be in flight.
+ */
+void http_compressor_destroy(http_compressor *compressor);
+
+/**
+ * Compresses the body of `response` with the coding `request` negotiates, if the response is worth
+ * it: a `2xx` (but `204` or `206`) with a body in memory or a file (see `http_file_body`) within the
+ * length limits, a `Content-Type` among `content_types`, no `Content-Encoding` and no
+ * `Cache-Control: no-transform`.
+ *
+ * The compressed body replaces the original one, a file body is released. `Content-Encoding` is added,
+ * a `Content-Length` set by the handler is dropped, a strong `ETag` gets the coding appended and every
+ * response worth compressing, compressed or not, names `Accept-Encoding` in `Vary`. The new headers
+ * are allocated in `request->arena`, which must be set.
+ *
+ * @param out_variant Set to the variant the new body points into, referenced until
+ * `http_compressed_variant_release`; nullptr if the body was left as it is.
+ *
+ * @return false if the arena ran out of memory; the response is unchanged then
+ */
+bool http_compress_response(
+    http_compressor *compressor,
+    const http_request *request,
+    http_response *response,
+    http_compressed_variant **out_variant);
+
+/**
+ * Drops the reference taken by `http_compress_response`.
+ */
+void http_compressed_variant_release(http_compressed_variant *variant);
+
+#endif //TINY_HTTP_COMPRESS_H
@@ -0,0 +1,68 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_head.h"
+
+#include <stdio.h>
+#include <time.h>
+
+typedef struct status_line {
+    const char *octets;
+    size_t len;
+} status_line;
+
+#define STATUS_LINE(version, code, reason) \
+    {.octets = version " " #code " " reason "\r\n", .len = sizeof(version " " #code " " reason "\r\n") - 1}
+
+// indexed by `status_code - 100`; codes without a reason phrase are left zeroed
+#define STATUS_LINE_1_0(code, reason) [code - 100] = STATUS_LINE("HTTP/1.0", code, reason),
+#define STATUS_LINE_1_1(code, reason) [code - 100] = STATUS_LINE("HTTP/1.1", code, reason),
+#define STATUS_REASON(code, reason) [code - 100] = reason,
+
+static const status_line status_lines_1_0[500] = {HTTP_STATUS_CODES(STATUS_LINE_1_0)};
+static const status_line status_lines_1_1[500] = {HTTP_STATUS_CODES(STATUS_LINE_1_1)};
+static const char *const status_reasons[500] = {HTTP_STATUS_CODES(STATUS_REASON)};
+
+#undef STATUS_LINE_1_0
+#undef STATUS_LINE_1_1
+#undef STATUS_REASON
+#undef STATUS_LINE
+
+const char *http_status_reason(const uint16_t status_code) {
+    if (status_code < 100 || status_code >= 600) return nullptr;
+    return status_reasons[status_code - 100];
+}
+
+const char *http_status_line(const bool http_1_1, const uint16_t status_code, size_t *out_len) {
+    if (status_code < 100 || status_code >= 600) return nullptr;
+    const status_line *line = http_1_1 ? &status_lines_1_1[status_code - 100] : &status_lines_1_0[status_code - 100];
+    if (line->octets == nullptr) return nullptr;
+    *out_len = line->len;
+    return line->octets;
+}
+
+static _Thread_local struct {
+    time_t second;
+    // "Date: " IMF-fixdate "\r\n", e.g. "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+    char octets[64];
+    size_t len;
+} date_header = {.second = -1};
+
+http_header_fragment http_date_header(void) {
+    const time_t now = time(nullptr);
+    if (now != date_header.second) {
+        // not strftime: %a and %b follow the locale, HTTP dates are always in English
+        static const char days[7][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+        static const char months[12][4] = {
+            "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+        };
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        date_header.len = (size_t) snprintf(
+            date_header.octets, sizeof(date_header.octets), "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+            days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        date_header.second = now;
+    }
+    return (http_header_fragment){.octets = date_header.octets, .len = date_header.len};
+}
@@ -0,0 +1,102 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_HEAD_H
+#define TINY_HTTP_HEAD_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The status codes the library knows a reason phrase for (RFC 9110 §15): X(code, reason phrase).
+ */
+#define HTTP_STATUS_CODES(X) \
+    X(100, "Continue") \
+    X(101, "Switching Protocols") \
+    X(200, "OK") \
+    X(201, "Created") \
+    X(202, "Accepted") \
+    X(203, "Non-Authoritative Information") \
+    X(204, "No Content") \
+    X(205, "Reset Content") \
+    X(206, "Partial Content") \
+    X(300, "Multiple Choices") \
+    X(301, "Moved Permanently") \
+    X(302, "Found") \
+    X(303, "See Other") \
+    X(304, "Not Modified") \
+    X(305, "Use Proxy") \
+    X(307, "Temporary Redirect") \
+    X(308, "Permanent Redirect") \
+    X(400, "Bad Request") \
+    X(401, "Unauthorized") \
+    X(402, "Payment Required") \
+    X(403, "Forbidden") \
+    X(404, "Not Found") \
+    X(405, "Method Not Allowed") \
+    X(406, "Not Acceptable") \
+    X(407, "Proxy Authentication Required") \
+    X(408, "Request Timeout") \
+    X(409, "Conflict") \
+    X(410, "Gone") \
+    X(411, "Length Required") \
+    X(412, "Precondition Failed") \
+    X(413, "Content Too Large") \
+    X(414, "URI Too Long") \
+    X(415, "Unsupported Media Type") \
+    X(416, "Range Not Satisfiable") \
+    X(417, "Expectation Failed") \
+    X(421, "Misdirected Request") \
+    X(422, "Unprocessable Content") \
+    X(426, "Upgrade Required") \
+    X(428, "Precondition Required") \
+    X(429, "Too Many Requests") \
+    X(431, "Request Header Fields Too Large") \
+    X(500, "Internal Server Error") \
+    X(501, "Not Implemented") \
+    X(502, "Bad Gateway") \
+    X(503, "Service Unavailable") \
+    X(504, "Gateway Timeout") \
+    X(505, "HTTP Version Not Supported")
+
+/**
+ * A header line rendered ahead of time, "<name>: <value>\r\n", copied into a response head as one block.
+ */
+typedef struct http_header_fragment {
+    const char *octets;
+    size_t len;
+} http_header_fragment;
+
+/**
+ * A fragment for a header whose name and value are both string literals, its length known at compile time,
+ * e.g. `HTTP_HEADER_FRAGMENT("Content-Type", "application/json")`.
+ */
+#define HTTP_HEADER_FRAGMENT(name, value) \
+    ((http_header_fragment){.octets = name ": " value "\r\n", .len = sizeof(name ": " value "\r\n") - 1})
+
+/**
+ * @return the standard reason phrase of `status_code`, or nullptr if it is not one of `HTTP_STATUS_CODES`
+ */
+const char *http_status_reason(uint16_t status_code);
+
+/**
+ * The complete status line "HTTP/1.x <code> <reason phrase>\r\n" of a standard status code, pre-built.
+ *
+ * @param http_1_1 Whether the line is for HTTP/1.1 rather than HTTP/1.0.
+ * @param status_code
+ * @param out_len Set to the length of the line.
+ *
+ * @return the line (not nul-terminated), or nullptr if `status_code` is not one of `HTTP_STATUS_CODES`
+ */
+const char *http_status_line(bool http_1_1, uint16_t status_code, size_t *out_len);
+
+/**
+ * The "Date: <IMF-fixdate>\r\n" header for the current second.
+ *
+ * The line is formatted at most once per second and thread, so every other call costs one `time(2)`.
+ * The octets stay valid until the calling thread asks again in a later second.
+ */
+http_header_fragment http_date_header(void);
+
+#endif //TINY_HTTP_HEAD_H
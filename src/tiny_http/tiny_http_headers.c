@@ -0,0 +1,44 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_headers.h"
+
+#include <strings.h>
+
+/// "Content-Disposition" and "If-Unmodified-Since"
+#define HTTP_HEADER_MAX_KNOWN_LENGTH 19
+
+typedef struct known_header {
+    const char *name;
+    size_t len;
+} known_header;
+
+#define KNOWN_HEADER_ENTRY(id, name, first, last) [HTTP_HEADER_##id] = {name, sizeof(name) - 1},
+
+static const known_header known_headers[HTTP_HEADER_ID_COUNT] = {
+    HTTP_KNOWN_HEADERS(KNOWN_HEADER_ENTRY)
+};
+
+#undef KNOWN_HEADER_ENTRY
+
+http_header_id http_header_lookup(const uint8_t *name, const size_t len) {
+    if (len == 0 || len > HTTP_HEADER_MAX_KNOWN_LENGTH) return HTTP_HEADER_UNKNOWN;
+    // the hash is perfect over the known names, so at most one candidate is left to compare against
+    http_header_id id;
+    switch (HTTP_HEADER_HASH(len, name[0], name[len - 1])) {
+#define KNOWN_HEADER_CASE(id_, name_, first_, last_) \
+        case HTTP_HEADER_HASH(sizeof(name_) - 1, first_, last_): id = HTTP_HEADER_##id_; break;
+        HTTP_KNOWN_HEADERS(KNOWN_HEADER_CASE)
+#undef KNOWN_HEADER_CASE
+        default:
+            return HTTP_HEADER_UNKNOWN;
+    }
+    const known_header *known = &known_headers[id];
+    return known->len == len && strncasecmp(known->name, (const char *) name, len) == 0 ? id : HTTP_HEADER_UNKNOWN;
+}
+
+const char *http_header_id_name(const http_header_id id) {
+    if (id <= HTTP_HEADER_UNKNOWN || id >= HTTP_HEADER_ID_COUNT) return nullptr;
+    return known_headers[id].name;
+}
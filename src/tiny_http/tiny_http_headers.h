@@ -0,0 +1,98 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_HEADERS_H
+#define TINY_HTTP_HEADERS_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The header fields the library knows by name: X(id, canonical name, first octet, last octet).
+ *
+ * The first and last octets feed `HTTP_HEADER_HASH`, which `http_header_lookup` switches on; two names
+ * that hash alike would be duplicate `case` labels, so a collision added here fails the build.
+ */
+#define HTTP_KNOWN_HEADERS(X) \
+    X(ACCEPT, "Accept", 'A', 't') \
+    X(ACCEPT_CHARSET, "Accept-Charset", 'A', 't') \
+    X(ACCEPT_ENCODING, "Accept-Encoding", 'A', 'g') \
+    X(ACCEPT_LANGUAGE, "Accept-Language", 'A', 'e') \
+    X(ACCEPT_RANGES, "Accept-Ranges", 'A', 's') \
+    X(AGE, "Age", 'A', 'e') \
+    X(ALLOW, "Allow", 'A', 'w') \
+    X(AUTHORIZATION, "Authorization", 'A', 'n') \
+    X(CACHE_CONTROL, "Cache-Control", 'C', 'l') \
+    X(CONNECTION, "Connection", 'C', 'n') \
+    X(CONTENT_DISPOSITION, "Content-Disposition", 'C', 'n') \
+    X(CONTENT_ENCODING, "Content-Encoding", 'C', 'g') \
+    X(CONTENT_LANGUAGE, "Content-Language", 'C', 'e') \
+    X(CONTENT_LENGTH, "Content-Length", 'C', 'h') \
+    X(CONTENT_LOCATION, "Content-Location", 'C', 'n') \
+    X(CONTENT_RANGE, "Content-Range", 'C', 'e') \
+    X(CONTENT_TYPE, "Content-Type", 'C', 'e') \
+    X(COOKIE, "Cookie", 'C', 'e') \
+    X(DATE, "Date", 'D', 'e') \
+    X(ETAG, "ETag", 'E', 'g') \
+    X(EXPECT, "Expect", 'E', 't') \
+    X(EXPIRES, "Expires", 'E', 's') \
+    X(FORWARDED, "Forwarded", 'F', 'd') \
+    X(FROM, "From", 'F', 'm') \
+    X(HOST, "Host", 'H', 't') \
+    X(IF_MATCH, "If-Match", 'I', 'h') \
+    X(IF_MODIFIED_SINCE, "If-Modified-Since", 'I', 'e') \
+    X(IF_NONE_MATCH, "If-None-Match", 'I', 'h') \
+    X(IF_RANGE, "If-Range", 'I', 'e') \
+    X(IF_UNMODIFIED_SINCE, "If-Unmodified-Since", 'I', 'e') \
+    X(KEEP_ALIVE, "Keep-Alive", 'K', 'e') \
+    X(LAST_MODIFIED, "Last-Modified", 'L', 'd') \
+    X(LOCATION, "Location", 'L', 'n') \
+    X(ORIGIN, "Origin", 'O', 'n') \
+    X(PRAGMA, "Pragma", 'P', 'a') \
+    X(RANGE, "Range", 'R', 'e') \
+    X(REFERER, "Referer", 'R', 'r') \
+    X(RETRY_AFTER, "Retry-After", 'R', 'r') \
+    X(SERVER, "Server", 'S', 'r') \
+    X(SET_COOKIE, "Set-Cookie", 'S', 'e') \
+    X(TE, "TE", 'T', 'E') \
+    X(TRAILER, "Trailer", 'T', 'r') \
+    X(TRANSFER_ENCODING, "Transfer-Encoding", 'T', 'g') \
+    X(UPGRADE, "Upgrade", 'U', 'e') \
+    X(USER_AGENT, "User-Agent", 'U', 't') \
+    X(VARY, "Vary", 'V', 'y') \
+    X(VIA, "Via", 'V', 'a') \
+    X(WWW_AUTHENTICATE, "WWW-Authenticate", 'W', 'e') \
+    X(X_FORWARDED_FOR, "X-Forwarded-For", 'X', 'r') \
+    X(X_FORWARDED_PROTO, "X-Forwarded-Proto", 'X', 'o') \
+    X(X_REQUEST_ID, "X-Request-Id", 'X', 'd')
+
+/// case-insensitive for letters, as `& 31` maps 'A' and 'a' alike
+#define HTTP_HEADER_HASH(len, first, last) \
+    (7 * (size_t) (len) + 3 * (size_t) ((first) & 31) + 8 * (size_t) ((last) & 31))
+
+#define HTTP_KNOWN_HEADER_ENUM(id, name, first, last) HTTP_HEADER_##id,
+
+/**
+ * A header field name interned at parse time; unknown names keep only their raw spelling.
+ */
+typedef enum http_header_id {
+    HTTP_HEADER_UNKNOWN = 0,
+    HTTP_KNOWN_HEADERS(HTTP_KNOWN_HEADER_ENUM)
+    HTTP_HEADER_ID_COUNT,
+} http_header_id;
+
+#undef HTTP_KNOWN_HEADER_ENUM
+
+/**
+ * Interns a header field name, ignoring case.
+ *
+ * @return the id of the known header spelled `name[0, len)`, or `HTTP_HEADER_UNKNOWN`
+ */
+http_header_id http_header_lookup(const uint8_t *name, size_t len);
+
+/**
+ * @return the canonical spelling of `id`, or nullptr for `HTTP_HEADER_UNKNOWN`
+ */
+const char *http_header_id_name(http_header_id id);
+
+#endif //TINY_HTTP_HEADERS_H
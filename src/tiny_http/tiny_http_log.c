@@ -0,0 +1,44 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define LOG_LINE_MAX 512
+
+atomic_int http_log_min_level = HTTP_LOG_WARN;
+
+static http_log_sink log_sink;
+static void *log_sink_user_data;
+
+void http_log_configure(const http_log_level min_level, const http_log_sink sink, void *user_data) {
+    log_sink = sink;
+    log_sink_user_data = user_data;
+    http_log_set_level(min_level);
+}
+
+void http_log_set_level(const http_log_level min_level) {
+    atomic_store_explicit(&http_log_min_level, min_level, memory_order_relaxed);
+}
+
+void http_log_write(const http_log_level level, const char *format, ...) {
+    char line[LOG_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len < 0) return;
+    if ((size_t) len >= sizeof(line)) {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+    if (log_sink != nullptr) {
+        log_sink(level, line, (size_t) len, log_sink_user_data);
+        return;
+    }
+    (void) !write(STDERR_FILENO, line, (size_t) len);
+}
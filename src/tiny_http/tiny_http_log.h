@@ -0,0 +1,65 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_LOG_H
+#define TINY_HTTP_LOG_H
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef enum http_log_level {
+    /// a client's malformed request, and other things only worth seeing while debugging
+    HTTP_LOG_DEBUG = 0,
+    HTTP_LOG_INFO = 1,
+    /// the server worked around a failure, e.g. by falling back to a slower path
+    HTTP_LOG_WARN = 2,
+    /// a request or connection was lost to a failure of the server's own
+    HTTP_LOG_ERROR = 3,
+} http_log_level;
+
+/**
+ * Receives every line at or above the configured level, newline included, on whichever thread logged it.
+ */
+typedef void (*http_log_sink)(http_log_level level, const char *line, size_t len, void *user_data);
+
+/**
+ * Sets the lowest level that is logged (`HTTP_LOG_WARN` by default) and where lines go: to `sink`, or
+ * to stderr if it is nullptr.
+ *
+ * Not thread-safe: call it before any server is started, or once every one is stopped.
+ */
+void http_log_configure(http_log_level min_level, http_log_sink sink, void *user_data);
+
+/**
+ * Changes only the lowest level that is logged; unlike `http_log_configure` safe to call at any time.
+ */
+void http_log_set_level(http_log_level min_level);
+
+/// the configured level, read by the logging macros before any formatting is done
+extern atomic_int http_log_min_level;
+
+/**
+ * Log one diagnostic line at the level in the name.
+ *
+ * The line is formatted on the caller's stack and, by default, handed to the kernel with a single
+ * `write(2)`, so unlike `fprintf(stderr, ...)` + `fflush(stderr)` it takes no lock shared between threads
+ * and lines from different worker threads never interleave. A line below the configured level costs one
+ * relaxed load. Define `TINY_HTTP_NO_LOG` to compile every call out.
+ */
+#ifdef TINY_HTTP_NO_LOG
+#define http_log_at(level, ...) ((void) 0)
+#else
+#define http_log_at(level, ...) \
+    ((level) >= atomic_load_explicit(&http_log_min_level, memory_order_relaxed) \
+        ? http_log_write((level), __VA_ARGS__) : (void) 0)
+#endif
+
+#define http_log_debug(...) http_log_at(HTTP_LOG_DEBUG, __VA_ARGS__)
+#define http_log_info(...) http_log_at(HTTP_LOG_INFO, __VA_ARGS__)
+#define http_log_warn(...) http_log_at(HTTP_LOG_WARN, __VA_ARGS__)
+#define http_log_error(...) http_log_at(HTTP_LOG_ERROR, __VA_ARGS__)
+
+__attribute__((format(printf, 2, 3)))
+void http_log_write(http_log_level level, const char *format, ...);
+
+#endif //TINY_HTTP_LOG_H
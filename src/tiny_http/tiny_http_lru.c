@@ -0,0 +1,171 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_lru.h"
+
+#include <stdlib.h>
+
+#define LRU_INITIAL_BUCKETS 64
+
+bool http_lru_init(
+    http_lru *lru,
+    const size_t shards_cnt,
+    const size_t budget,
+    const http_lru_matches matches,
+    const http_lru_free free_entry) {
+    *lru = (http_lru){.matches = matches, .free_entry = free_entry};
+    if (shards_cnt == 0) return true;
+    lru->shards = calloc(shards_cnt, sizeof(http_lru_shard));
+    if (lru->shards == nullptr) return false;
+    for (size_t i = 0; i < shards_cnt; i++) {
+        http_lru_shard *shard = &lru->shards[i];
+        shard->buckets = calloc(LRU_INITIAL_BUCKETS, sizeof(http_lru_entry *));
+        shard->bucket_mask = LRU_INITIAL_BUCKETS - 1;
+        shard->budget = budget / shards_cnt;
+        pthread_mutex_init(&shard->lock, nullptr);
+        lru->shards_cnt = i + 1;
+        if (shard->buckets == nullptr) {
+            http_lru_destroy(lru);
+            return false;
+        }
+    }
+    return true;
+}
+
+void http_lru_destroy(http_lru *lru) {
+    for (size_t i = 0; i < lru->shards_cnt; i++) {
+        http_lru_shard *shard = &lru->shards[i];
+        while (shard->lru_head != nullptr) http_lru_remove(shard, shard->lru_head);
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->buckets);
+    }
+    free(lru->shards);
+    lru->shards = nullptr;
+    lru->shards_cnt = 0;
+}
+
+void http_lru_entry_init(http_lru *lru, http_lru_entry *entry, const uint64_t hash, const size_t size) {
+    *entry = (http_lru_entry){.hash = hash, .size = size, .refs = 1, .lru = lru};
+}
+
+http_lru_shard *http_lru_shard_of(const http_lru *lru, const uint64_t hash) {
+    return lru->shards_cnt > 0 ? &lru->shards[(hash >> 32) % lru->shards_cnt] : nullptr;
+}
+
+static void entry_unref(http_lru_entry *entry) {
+    if (--entry->refs == 0) entry->lru->free_entry(entry);
+}
+
+static void lru_unlink(http_lru_shard *shard, http_lru_entry *entry) {
+    if (entry->lru_prev != nullptr) entry->lru_prev->lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next != nullptr) entry->lru_next->lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = nullptr;
+}
+
+static void lru_push_front(http_lru_shard *shard, http_lru_entry *entry) {
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head != nullptr) shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+    if (shard->lru_tail == nullptr) shard->lru_tail = entry;
+}
+
+/**
+ * Doubles the buckets once there are twice as many entries; keeps the old ones if that fails.
+ */
+static void shard_grow(http_lru_shard *shard) {
+    if (shard->entries_cnt < 2 * (shard->bucket_mask + 1)) return;
+    const size_t bucket_cnt = 2 * (shard->bucket_mask + 1);
+    http_lru_entry **buckets = calloc(bucket_cnt, sizeof(http_lru_entry *));
+    if (buckets == nullptr) return;
+    for (size_t i = 0; i <= shard->bucket_mask; i++) {
+        while (shard->buckets[i] != nullptr) {
+            http_lru_entry *entry = shard->buckets[i];
+            shard->buckets[i] = entry->hash_next;
+            entry->hash_next = buckets[entry->hash & (bucket_cnt - 1)];
+            buckets[entry->hash & (bucket_cnt - 1)] = entry;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_mask = bucket_cnt - 1;
+}
+
+http_lru_entry *http_lru_find(
+    const http_lru *lru,
+    const http_lru_shard *shard,
+    const uint64_t hash,
+    const void *key) {
+    for (http_lru_entry *entry = shard->buckets[hash & shard->bucket_mask];
+         entry != nullptr;
+         entry = entry->hash_next) {
+        if (entry->hash == hash && lru->matches(entry, key)) return entry;
+    }
+    return nullptr;
+}
+
+void http_lru_touch(http_lru_shard *shard, http_lru_entry *entry) {
+    entry->refs++;
+    lru_unlink(shard, entry);
+    lru_push_front(shard, entry);
+}
+
+void http_lru_insert(http_lru_shard *shard, http_lru_entry *entry, const void *key) {
+    http_lru_entry *existing = http_lru_find(entry->lru, shard, entry->hash, key);
+    if (existing != nullptr) http_lru_remove(shard, existing);
+    http_lru_entry **bucket = &shard->buckets[entry->hash & shard->bucket_mask];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(shard, entry);
+    entry->refs++;
+    entry->cached = true;
+    shard->entries_cnt++;
+    shard->used += entry->size;
+    while (shard->used > shard->budget && shard->lru_tail != entry) http_lru_remove(shard, shard->lru_tail);
+    shard_grow(shard);
+}
+
+void http_lru_remove(http_lru_shard *shard, http_lru_entry *entry) {
+    http_lru_entry **link = &shard->buckets[entry->hash & shard->bucket_mask];
+    while (*link != entry) link = &(*link)->hash_next;
+    *link = entry->hash_next;
+    lru_unlink(shard, entry);
+    entry->cached = false;
+    shard->entries_cnt--;
+    shard->used -= entry->size;
+    entry_unref(entry);
+}
+
+http_lru_entry *http_lru_acquire(http_lru *lru, const uint64_t hash, const void *key) {
+    http_lru_shard *shard = http_lru_shard_of(lru, hash);
+    if (shard == nullptr) return nullptr;
+    pthread_mutex_lock(&shard->lock);
+    http_lru_entry *entry = http_lru_find(lru, shard, hash, key);
+    if (entry != nullptr) http_lru_touch(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+    return entry;
+}
+
+bool http_lru_add(http_lru *lru, http_lru_entry *entry, const void *key) {
+    http_lru_shard *shard = http_lru_shard_of(lru, entry->hash);
+    if (shard == nullptr || entry->size > shard->budget) return false;
+    pthread_mutex_lock(&shard->lock);
+    http_lru_insert(shard, entry, key);
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+void http_lru_release(http_lru_entry *entry) {
+    if (entry == nullptr) return;
+    // without shards the entry was never shared
+    http_lru_shard *shard = http_lru_shard_of(entry->lru, entry->hash);
+    if (shard == nullptr) {
+        entry_unref(entry);
+        return;
+    }
+    pthread_mutex_lock(&shard->lock);
+    entry_unref(entry);
+    pthread_mutex_unlock(&shard->lock);
+}
@@ -0,0 +1,129 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_LRU_H
+#define TINY_HTTP_LRU_H
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * An entry of an `http_lru`, embedded as the first member of whatever is cached (a response, a
+ * compressed body, an open file), which is freed once the last reference to it is dropped.
+ */
+typedef struct http_lru_entry {
+    uint64_t hash;
+    /// what the entry is charged against its shard's budget, e.g. its octets
+    size_t size;
+    /// one for the shard while the entry is in it, one per user still holding it
+    size_t refs;
+    /// whether the entry is in its shard: once evicted or replaced it only lives on for those holding it
+    bool cached;
+    struct http_lru *lru;
+    struct http_lru_entry *hash_next;
+    struct http_lru_entry *lru_prev;
+    struct http_lru_entry *lru_next;
+} http_lru_entry;
+
+typedef struct http_lru_shard {
+    pthread_mutex_t lock;
+    http_lru_entry **buckets;
+    size_t bucket_mask;
+    size_t entries_cnt;
+    /// most recently used first
+    http_lru_entry *lru_head;
+    http_lru_entry *lru_tail;
+    size_t used;
+    size_t budget;
+} http_lru_shard;
+
+/**
+ * @return true if `entry` is the one looked up by `key`, whatever that is to the cache
+ */
+typedef bool (*http_lru_matches)(const http_lru_entry *entry, const void *key);
+
+typedef void (*http_lru_free)(http_lru_entry *entry);
+
+/**
+ * A hash table of reference-counted entries split into independently locked shards, each evicting its
+ * least recently used entries once they take more than its share of the budget. What the caches of the
+ * library (responses, compressed bodies, open files) are built on.
+ *
+ * The buckets of a shard are picked by the low bits of an entry's hash, the shard by the high ones.
+ * Functions taking a shard are called with its lock held.
+ */
+typedef struct http_lru {
+    /// nullptr if nothing is kept: entries then only live as long as their creator holds them
+    http_lru_shard *shards;
+    size_t shards_cnt;
+    http_lru_matches matches;
+    http_lru_free free_entry;
+} http_lru;
+
+/**
+ * @param shards_cnt 0 to keep nothing.
+ * @param budget What the entries of all shards may add up to, in the unit of `http_lru_entry::size`.
+ *
+ * @return false on allocation failure
+ */
+bool http_lru_init(http_lru *lru, size_t shards_cnt, size_t budget, http_lru_matches matches, http_lru_free free_entry);
+
+/**
+ * Drops the references of the shards and frees them; no entry may still be held.
+ */
+void http_lru_destroy(http_lru *lru);
+
+/**
+ * Sets `entry` up with a single reference, for its creator.
+ */
+void http_lru_entry_init(http_lru *lru, http_lru_entry *entry, uint64_t hash, size_t size);
+
+/**
+ * @return the shard an entry with `hash` belongs to, nullptr if nothing is kept
+ */
+http_lru_shard *http_lru_shard_of(const http_lru *lru, uint64_t hash);
+
+/**
+ * @return the entry of `shard` looked up by `key`, not referenced, or nullptr
+ */
+http_lru_entry *http_lru_find(const http_lru *lru, const http_lru_shard *shard, uint64_t hash, const void *key);
+
+/**
+ * Takes a reference to `entry` and makes it the most recently used one of `shard`.
+ */
+void http_lru_touch(http_lru_shard *shard, http_lru_entry *entry);
+
+/**
+ * Adds `entry` as the most recently used one, taking a reference for the shard, replacing the entry
+ * looked up by the same `key` and evicting the least recently used ones while the shard is over its
+ * budget.
+ */
+void http_lru_insert(http_lru_shard *shard, http_lru_entry *entry, const void *key);
+
+/**
+ * Takes `entry` out of `shard`, dropping the shard's reference.
+ */
+void http_lru_remove(http_lru_shard *shard, http_lru_entry *entry);
+
+/**
+ * Looks up, references and touches the entry by `key`.
+ *
+ * @return the entry, or nullptr on a miss
+ */
+http_lru_entry *http_lru_acquire(http_lru *lru, uint64_t hash, const void *key);
+
+/**
+ * Inserts `entry`, unless it is larger than its shard's whole budget; the caller's reference stays.
+ *
+ * @return true if it was
+ */
+bool http_lru_add(http_lru *lru, http_lru_entry *entry, const void *key);
+
+/**
+ * Drops a reference to `entry`, freeing it with the last one.
+ */
+void http_lru_release(http_lru_entry *entry);
+
+#endif //TINY_HTTP_LRU_H
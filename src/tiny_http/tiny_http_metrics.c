@@ -0,0 +1,248 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tiny_http_log.h"
+
+#define METRICS_RESPONSE_INITIAL_SIZE (16 * 1024)
+
+// region recording
+
+_Thread_local http_metrics_shard *http_metrics_thread_shard;
+
+/// every thread's shard, newest first; only ever pushed to
+static _Atomic(http_metrics_shard *) shards;
+
+/// stands in for the shard of a thread whose own one cannot be allocated: written to by every such thread
+/// at once, with a plain load and store, so never read
+static http_metrics_shard discarded_shard;
+
+http_metrics_shard *http_metrics_register_thread(void) {
+    http_metrics_shard *shard = calloc(1, sizeof(http_metrics_shard));
+    if (shard == nullptr) {
+        // the thread records nothing from now on, rather than miscount in a shard it shares
+        http_log_error("cannot allocate the metrics of this thread, its metrics are not recorded\n");
+        http_metrics_thread_shard = &discarded_shard;
+        return &discarded_shard;
+    }
+    shard->next = atomic_load_explicit(&shards, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&shards, &shard->next, shard, memory_order_release, memory_order_relaxed)) {
+    }
+    http_metrics_thread_shard = shard;
+    return shard;
+}
+
+uint64_t http_metrics_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+void http_metrics_observe_ns(const http_metric_histogram histogram, const uint64_t ns) {
+    // the bucket whose bound 2^(i + 6) is the first one at or above `ns`
+    size_t bucket = ns <= 64 ? 0 : (size_t) (64 - __builtin_clzll(ns - 1)) - 6;
+    if (bucket > HTTP_METRICS_HISTOGRAM_BUCKETS) bucket = HTTP_METRICS_HISTOGRAM_BUCKETS;
+    http_metrics_shard *shard = http_metrics_local_shard();
+    http_metrics_add(&shard->histograms[histogram].buckets[bucket], 1);
+    http_metrics_add(&shard->histograms[histogram].sum_ns, ns);
+}
+
+// endregion recording
+
+// region reading
+
+static void add_shard(http_metrics_snapshot *snapshot, const http_metrics_shard *shard) {
+    for (size_t i = 0; i < HTTP_METRIC_COUNTER_COUNT; i++) {
+        snapshot->counters[i] += atomic_load_explicit(&shard->counters[i], memory_order_relaxed);
+    }
+    for (size_t i = 0; i < HTTP_METRICS_PARSE_STATUS_SLOTS; i++) {
+        snapshot->parse_errors[i] += atomic_load_explicit(&shard->parse_errors[i], memory_order_relaxed);
+    }
+    for (size_t i = 0; i < HTTP_METRICS_RENDER_STATUS_SLOTS; i++) {
+        snapshot->render_errors[i] += atomic_load_explicit(&shard->render_errors[i], memory_order_relaxed);
+    }
+    for (size_t i = 0; i < 5; i++) {
+        snapshot->responses[i] += atomic_load_explicit(&shard->responses[i], memory_order_relaxed);
+    }
+    for (size_t i = 0; i < HTTP_METRIC_HISTOGRAM_COUNT; i++) {
+        for (size_t bucket = 0; bucket <= HTTP_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+            snapshot->histograms[i].buckets[bucket] +=
+                    atomic_load_explicit(&shard->histograms[i].buckets[bucket], memory_order_relaxed);
+        }
+        snapshot->histograms[i].sum_ns += atomic_load_explicit(&shard->histograms[i].sum_ns, memory_order_relaxed);
+    }
+}
+
+void http_metrics_load(http_metrics_snapshot *out_snapshot) {
+    *out_snapshot = (http_metrics_snapshot){};
+    for (const http_metrics_shard *shard = atomic_load_explicit(&shards, memory_order_acquire);
+         shard != nullptr; shard = shard->next) {
+        add_shard(out_snapshot, shard);
+    }
+}
+
+enum parse_http_request_status http_metrics_parse_status(const size_t slot) {
+    return (enum parse_http_request_status) ((int) slot - 11);
+}
+
+enum render_http_response_status http_metrics_render_status(const size_t slot) {
+    return (enum render_http_response_status) -(int) slot;
+}
+
+static const char *parse_status_name(const enum parse_http_request_status status) {
+    switch (status) {
+        case PARSE_E_REQ_IS_NULL: return "req_is_null";
+        case PARSE_E_MALFORMED_HTTP_HEADER: return "malformed_http_header";
+        case PARSE_E_ALLOC_MEM_FOR_HEADERS: return "alloc_mem_for_headers";
+        case PARSE_E_HTTP_METHOD_NOT_SUPPORTED: return "http_method_not_supported";
+        case PARSE_E_MALFORMED_HTTP_REQUEST_LINE: return "malformed_http_request_line";
+        case PARSE_E_HTTP_VERSION_NOT_SUPPORTED: return "http_version_not_supported";
+        case PARSE_E_BODY_TOO_LARGE: return "body_too_large";
+        case PARSE_E_URL_DECODE: return "url_decode";
+        case PARSE_E_TOO_MANY_HEADERS: return "too_many_headers";
+        case PARSE_E_INCOMPLETE: return "incomplete";
+        case PARSE_E_HEADERS_TOO_LARGE: return "headers_too_large";
+        case PARSE_E_MALFORMED_CHUNKED_BODY: return "malformed_chunked_body";
+        case PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED: return "transfer_encoding_not_supported";
+        default: return nullptr;
+    }
+}
+
+static const char *render_status_name(const enum render_http_response_status status) {
+    switch (status) {
+        case RENDER_E_MEM_ALLOC_FAILED: return "mem_alloc_failed";
+        case RENDER_E_RESPONSE_OBJ_IS_NULL: return "response_obj_is_null";
+        case RENDER_E_OUT_PARAM_ADDR_IS_NULL: return "out_param_addr_is_null";
+        case RENDER_E_HTTP_VERSION_NOT_SUPPORTED: return "http_version_not_supported";
+        case RENDER_E_STATUS_CODE_INVALID: return "status_code_invalid";
+        default: return nullptr;
+    }
+}
+
+// endregion reading
+
+// region exposition
+
+/**
+ * Appends to a buffer that may turn out too small: what does not fit is only counted.
+ */
+typedef struct metrics_text {
+    char *buf;
+    size_t cap;
+    size_t len;
+} metrics_text;
+
+__attribute__((format(printf, 2, 3)))
+static void text_append(metrics_text *text, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(
+        text->len < text->cap ? text->buf + text->len : nullptr,
+        text->len < text->cap ? text->cap - text->len : 0,
+        format, args);
+    va_end(args);
+    if (len > 0) text->len += (size_t) len;
+}
+
+static void text_append_family(metrics_text *text, const char *name, const char *help, const char *type) {
+    text_append(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void render_histogram(metrics_text *text, const char *name, const char *help, const http_metrics_snapshot *snapshot,
+                             const http_metric_histogram histogram) {
+    text_append_family(text, name, help, "histogram");
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket <= HTTP_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+        cumulative += snapshot->histograms[histogram].buckets[bucket];
+        if (bucket == HTTP_METRICS_HISTOGRAM_BUCKETS) {
+            text_append(text, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long) cumulative);
+        } else {
+            text_append(text, "%s_bucket{le=\"%.9g\"} %llu\n",
+                        name, (double) (1ULL << (bucket + 6)) / 1e9, (unsigned long long) cumulative);
+        }
+    }
+    text_append(text, "%s_sum %.9f\n", name, (double) snapshot->histograms[histogram].sum_ns / 1e9);
+    text_append(text, "%s_count %llu\n", name, (unsigned long long) cumulative);
+}
+
+size_t http_metrics_render(const http_metrics_snapshot *snapshot, char *buf, const size_t cap) {
+    metrics_text text = {.buf = buf, .cap = cap};
+    if (cap > 0) buf[0] = '\0';
+
+#define RENDER_COUNTER(id, name, help) \
+    text_append_family(&text, name, help, "counter"); \
+    text_append(&text, name " %llu\n", (unsigned long long) snapshot->counters[HTTP_METRIC_##id]);
+    HTTP_METRICS_COUNTERS(RENDER_COUNTER)
+#undef RENDER_COUNTER
+
+    text_append_family(&text, "tiny_http_responses_total", "Responses sent, by status class", "counter");
+    for (size_t i = 0; i < 5; i++) {
+        text_append(&text, "tiny_http_responses_total{code=\"%zuxx\"} %llu\n",
+                    i + 1, (unsigned long long) snapshot->responses[i]);
+    }
+
+    text_append_family(&text, "tiny_http_parse_errors_total", "Requests rejected by the parser, by status", "counter");
+    for (size_t slot = 0; slot < HTTP_METRICS_PARSE_STATUS_SLOTS; slot++) {
+        const char *status = parse_status_name(http_metrics_parse_status(slot));
+        if (status == nullptr || http_metrics_parse_status(slot) == PARSE_E_INCOMPLETE) continue;
+        text_append(&text, "tiny_http_parse_errors_total{status=\"%s\"} %llu\n",
+                    status, (unsigned long long) snapshot->parse_errors[slot]);
+    }
+
+    text_append_family(&text, "tiny_http_render_errors_total", "Responses that failed to render, by status", "counter");
+    for (size_t slot = 0; slot < HTTP_METRICS_RENDER_STATUS_SLOTS; slot++) {
+        const char *status = render_status_name(http_metrics_render_status(slot));
+        if (status == nullptr) continue;
+        text_append(&text, "tiny_http_render_errors_total{status=\"%s\"} %llu\n",
+                    status, (unsigned long long) snapshot->render_errors[slot]);
+    }
+
+#define RENDER_HISTOGRAM(id, name, help) render_histogram(&text, name, help, snapshot, HTTP_METRIC_##id##_TIME);
+    HTTP_METRICS_HISTOGRAMS(RENDER_HISTOGRAM)
+#undef RENDER_HISTOGRAM
+
+    return text.len;
+}
+
+static http_header metrics_headers[] = {
+    {.name = "Content-Type", .value = "text/plain; version=0.0.4; charset=utf-8"},
+    {.name = "Cache-Control", .value = "no-store"},
+};
+
+void http_metrics_handler(const http_request *request, http_response *response, void *user_data) {
+    (void) user_data;
+    // the text goes in the request's arena: without one (see `parse_http_request`) there is nowhere to put it
+    if (request->arena == nullptr) {
+        response->status_code = 500;
+        return;
+    }
+    http_metrics_snapshot snapshot;
+    http_metrics_load(&snapshot);
+    size_t cap = METRICS_RESPONSE_INITIAL_SIZE;
+    char *body = http_arena_alloc(request->arena, cap);
+    size_t len = body != nullptr ? http_metrics_render(&snapshot, body, cap) : 0;
+    if (body != nullptr && len >= cap) {
+        cap = len + 1;
+        body = http_arena_alloc(request->arena, cap);
+        if (body != nullptr) len = http_metrics_render(&snapshot, body, cap);
+    }
+    if (body == nullptr) {
+        response->status_code = 500;
+        return;
+    }
+    response->status_code = 200;
+    response->headers = metrics_headers;
+    response->headers_cnt = sizeof(metrics_headers) / sizeof(metrics_headers[0]);
+    response->body = (uint8_t *) body;
+    response->body_len = len;
+}
+
+// endregion exposition
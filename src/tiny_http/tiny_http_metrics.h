@@ -0,0 +1,189 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_METRICS_H
+#define TINY_HTTP_METRICS_H
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiny_http_server_lib.h"
+
+/**
+ * The library's counters: X(id, metric name, help text).
+ */
+#define HTTP_METRICS_COUNTERS(X) \
+    X(REQUESTS, "tiny_http_requests_total", "Requests handled, cache hits included") \
+    X(CACHE_HITS, "tiny_http_cache_hits_total", "Requests answered from the response cache") \
+    X(SHED_REQUESTS, "tiny_http_shed_requests_total", "Requests turned away with 503 by admission control") \
+    X(COMPRESSED_RESPONSES, "tiny_http_compressed_responses_total", "Responses sent with a compressed body") \
+    X(COMPRESSION_CACHE_HITS, "tiny_http_compression_cache_hits_total", "Bodies whose compressed variant was already cached") \
+    X(BYTES_IN, "tiny_http_received_bytes_total", "Octets received from clients") \
+    X(BYTES_OUT, "tiny_http_sent_bytes_total", "Octets sent to clients") \
+    X(CONNECTIONS_OPENED, "tiny_http_connections_opened_total", "Connections accepted") \
+    X(CONNECTIONS_CLOSED, "tiny_http_connections_closed_total", "Connections closed") \
+    X(TIMEOUTS, "tiny_http_timeouts_total", "Connections closed for going quiet past one of the server's timeouts")
+
+/**
+ * The library's latency histograms: X(id, metric name, help text).
+ */
+#define HTTP_METRICS_HISTOGRAMS(X) \
+    X(PARSE, "tiny_http_parse_duration_seconds", "Time spent parsing a complete request") \
+    X(HANDLER, "tiny_http_handler_duration_seconds", "Time spent in the request handler") \
+    X(RENDER, "tiny_http_render_duration_seconds", "Time spent rendering a response head")
+
+#define HTTP_METRICS_COUNTER_ID(id, name, help) HTTP_METRIC_##id,
+#define HTTP_METRICS_HISTOGRAM_ID(id, name, help) HTTP_METRIC_##id##_TIME,
+
+typedef enum http_metric_counter {
+    HTTP_METRICS_COUNTERS(HTTP_METRICS_COUNTER_ID)
+    HTTP_METRIC_COUNTER_COUNT,
+} http_metric_counter;
+
+typedef enum http_metric_histogram {
+    HTTP_METRICS_HISTOGRAMS(HTTP_METRICS_HISTOGRAM_ID)
+    HTTP_METRIC_HISTOGRAM_COUNT,
+} http_metric_histogram;
+
+/// bucket `i` of a histogram counts durations of at most 2^(i + 6) ns: 64 ns up to about half a second
+#define HTTP_METRICS_HISTOGRAM_BUCKETS 24
+
+/// `parse_http_request_status` codes run from -11 to 12, `render_http_response_status` ones from -5 to 0
+#define HTTP_METRICS_PARSE_STATUS_SLOTS 24
+#define HTTP_METRICS_RENDER_STATUS_SLOTS 6
+
+/**
+ * One thread's share of every metric: only that thread writes it (a relaxed load and store, no locked
+ * instruction), anyone may read it. Shards are never freed, so the counts of a thread that has exited
+ * still add up.
+ */
+typedef struct http_metrics_shard {
+    atomic_uint_fast64_t counters[HTTP_METRIC_COUNTER_COUNT];
+    atomic_uint_fast64_t parse_errors[HTTP_METRICS_PARSE_STATUS_SLOTS];
+    atomic_uint_fast64_t render_errors[HTTP_METRICS_RENDER_STATUS_SLOTS];
+    /// by status class, 1xx to 5xx
+    atomic_uint_fast64_t responses[5];
+    struct {
+        /// the last bucket is +Inf
+        atomic_uint_fast64_t buckets[HTTP_METRICS_HISTOGRAM_BUCKETS + 1];
+        atomic_uint_fast64_t sum_ns;
+    } histograms[HTTP_METRIC_HISTOGRAM_COUNT];
+    struct http_metrics_shard *next;
+} http_metrics_shard;
+
+/**
+ * Every metric summed up over all threads.
+ */
+typedef struct http_metrics_snapshot {
+    uint64_t counters[HTTP_METRIC_COUNTER_COUNT];
+    uint64_t parse_errors[HTTP_METRICS_PARSE_STATUS_SLOTS];
+    uint64_t render_errors[HTTP_METRICS_RENDER_STATUS_SLOTS];
+    uint64_t responses[5];
+    struct {
+        uint64_t buckets[HTTP_METRICS_HISTOGRAM_BUCKETS + 1];
+        uint64_t sum_ns;
+    } histograms[HTTP_METRIC_HISTOGRAM_COUNT];
+} http_metrics_snapshot;
+
+/**
+ * Sums up every thread's shard; safe to call from any thread at any time. The shards are not read at
+ * the same instant, so counters that go together may be a few events apart.
+ */
+void http_metrics_load(http_metrics_snapshot *out_snapshot);
+
+/**
+ * Renders `snapshot` in the Prometheus text exposition format (version 0.0.4).
+ *
+ * @return the length of the text, which was only written completely if it is less than `cap`
+ * (`snprintf` style)
+ */
+size_t http_metrics_render(const http_metrics_snapshot *snapshot, char *buf, size_t cap);
+
+/**
+ * A request handler answering with `http_metrics_render` of the current metrics, e.g. for `GET /metrics`
+ * (see `http_router_add`). `user_data` is not used. The text is put in the request's arena, so a request
+ * without one is answered with `500`.
+ */
+void http_metrics_handler(const http_request *request, http_response *response, void *user_data);
+
+/**
+ * @return the `parse_http_request_status` counted in `parse_errors[slot]`
+ */
+enum parse_http_request_status http_metrics_parse_status(size_t slot);
+
+/**
+ * @return the `render_http_response_status` counted in `render_errors[slot]`
+ */
+enum render_http_response_status http_metrics_render_status(size_t slot);
+
+// region recording
+// what the library calls on its hot paths; with `TINY_HTTP_NO_METRICS` defined all of it compiles out
+
+/**
+ * @return the calling thread's shard, allocated and registered on its first call; if that fails, one
+ * whose metrics are never read
+ */
+http_metrics_shard *http_metrics_register_thread(void);
+
+extern _Thread_local http_metrics_shard *http_metrics_thread_shard;
+
+static inline http_metrics_shard *http_metrics_local_shard(void) {
+    http_metrics_shard *shard = http_metrics_thread_shard;
+    return __builtin_expect(shard != nullptr, 1) ? shard : http_metrics_register_thread();
+}
+
+static inline void http_metrics_add(atomic_uint_fast64_t *metric, const uint64_t delta) {
+    atomic_store_explicit(metric, atomic_load_explicit(metric, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+/**
+ * @return a monotonic timestamp in nanoseconds, for `http_metrics_observe_since`
+ */
+uint64_t http_metrics_now(void);
+
+void http_metrics_observe_ns(http_metric_histogram histogram, uint64_t ns);
+
+#ifdef TINY_HTTP_NO_METRICS
+
+#define http_metrics_count(counter, delta) ((void) 0)
+#define http_metrics_count_response(status_code) ((void) 0)
+#define http_metrics_count_parse_error(status) ((void) 0)
+#define http_metrics_count_render_error(status) ((void) 0)
+#define http_metrics_start() ((uint64_t) 0)
+#define http_metrics_observe_since(histogram, start) ((void) (start))
+
+#else
+
+static inline void http_metrics_count(const http_metric_counter counter, const uint64_t delta) {
+    http_metrics_add(&http_metrics_local_shard()->counters[counter], delta);
+}
+
+static inline void http_metrics_count_response(const uint16_t status_code) {
+    if (status_code >= 100 && status_code < 600) {
+        http_metrics_add(&http_metrics_local_shard()->responses[status_code / 100 - 1], 1);
+    }
+}
+
+static inline void http_metrics_count_parse_error(const enum parse_http_request_status status) {
+    const int slot = (int) status + 11;
+    if (slot >= 0 && slot < HTTP_METRICS_PARSE_STATUS_SLOTS) {
+        http_metrics_add(&http_metrics_local_shard()->parse_errors[slot], 1);
+    }
+}
+
+static inline void http_metrics_count_render_error(const enum render_http_response_status status) {
+    const int slot = -(int) status;
+    if (slot >= 0 && slot < HTTP_METRICS_RENDER_STATUS_SLOTS) {
+        http_metrics_add(&http_metrics_local_shard()->render_errors[slot], 1);
+    }
+}
+
+#define http_metrics_start() http_metrics_now()
+#define http_metrics_observe_since(histogram, start) http_metrics_observe_ns((histogram), http_metrics_now() - (start))
+
+#endif //TINY_HTTP_NO_METRICS
+
+// endregion recording
+
+#endif //TINY_HTTP_METRICS_H
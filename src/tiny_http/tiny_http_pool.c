@@ -0,0 +1,202 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_pool.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+// region counters
+// only the owner thread writes, so a relaxed load and store is enough and no locked instruction is needed
+
+static void counter_add(atomic_size_t *counter, const size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+static void counter_sub(atomic_size_t *counter, const size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) - delta, memory_order_relaxed);
+}
+
+/**
+ * Counts an object handed out, `reused` if it came off a free list (which then holds one less).
+ */
+static void counters_on_acquire(http_pool_counters *counters, const bool reused) {
+    counter_add(&counters->acquired, 1);
+    if (reused) {
+        counter_add(&counters->reused, 1);
+        counter_sub(&counters->cached, 1);
+    }
+    counter_add(&counters->in_use, 1);
+    const size_t in_use = atomic_load_explicit(&counters->in_use, memory_order_relaxed);
+    if (in_use > atomic_load_explicit(&counters->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&counters->high_water, in_use, memory_order_relaxed);
+    }
+}
+
+/**
+ * Counts an object given back, `cached` if it went onto a free list rather than back to malloc.
+ */
+static void counters_on_release(http_pool_counters *counters, const bool cached) {
+    counter_sub(&counters->in_use, 1);
+    if (cached) counter_add(&counters->cached, 1);
+}
+
+http_pool_stats http_pool_counters_load(const http_pool_counters *counters) {
+    return (http_pool_stats){
+        .acquired = atomic_load_explicit(&counters->acquired, memory_order_relaxed),
+        .reused = atomic_load_explicit(&counters->reused, memory_order_relaxed),
+        .in_use = atomic_load_explicit(&counters->in_use, memory_order_relaxed),
+        .high_water = atomic_load_explicit(&counters->high_water, memory_order_relaxed),
+        .cached = atomic_load_explicit(&counters->cached, memory_order_relaxed),
+    };
+}
+
+void http_pool_stats_add(http_pool_stats *sum, const http_pool_stats *stats) {
+    sum->acquired += stats->acquired;
+    sum->reused += stats->reused;
+    sum->in_use += stats->in_use;
+    sum->high_water += stats->high_water;
+    sum->cached += stats->cached;
+}
+
+// endregion counters
+
+// region slab
+
+struct http_slab_chunk {
+    http_slab_chunk *next;
+    alignas(max_align_t) uint8_t objects[];
+};
+
+/// a free object's first octets link it to the next free one
+typedef struct free_object {
+    struct free_object *next;
+} free_object;
+
+void http_slab_init(http_slab *slab, const size_t object_size, const size_t objects_per_chunk) {
+    const size_t alignment = alignof(max_align_t);
+    const size_t size = object_size < sizeof(free_object) ? sizeof(free_object) : object_size;
+    *slab = (http_slab){
+        .object_size = (size + alignment - 1) & ~(alignment - 1),
+        .objects_per_chunk = objects_per_chunk > 0 ? objects_per_chunk : 1,
+    };
+}
+
+void *http_slab_alloc(http_slab *slab) {
+    const bool reused = slab->free_list != nullptr;
+    if (!reused) {
+        http_slab_chunk *chunk = malloc(sizeof(http_slab_chunk) + slab->object_size * slab->objects_per_chunk);
+        if (chunk == nullptr) return nullptr;
+        chunk->next = slab->chunks;
+        slab->chunks = chunk;
+        // the first object is handed out right away, the rest go onto the free list
+        for (size_t i = slab->objects_per_chunk - 1; i > 0; i--) {
+            free_object *object = (free_object *) (chunk->objects + i * slab->object_size);
+            object->next = slab->free_list;
+            slab->free_list = object;
+        }
+        counter_add(&slab->counters.cached, slab->objects_per_chunk - 1);
+        counters_on_acquire(&slab->counters, false);
+        memset(chunk->objects, 0, slab->object_size);
+        return chunk->objects;
+    }
+    free_object *object = slab->free_list;
+    slab->free_list = object->next;
+    counters_on_acquire(&slab->counters, true);
+    memset(object, 0, slab->object_size);
+    return object;
+}
+
+void http_slab_free(http_slab *slab, void *object) {
+    if (object == nullptr) return;
+    free_object *freed = object;
+    freed->next = slab->free_list;
+    slab->free_list = freed;
+    counters_on_release(&slab->counters, true);
+}
+
+void http_slab_destroy(http_slab *slab) {
+    while (slab->chunks != nullptr) {
+        http_slab_chunk *next = slab->chunks->next;
+        free(slab->chunks);
+        slab->chunks = next;
+    }
+    slab->free_list = nullptr;
+}
+
+// endregion slab
+
+// region buffer pool
+
+void http_buffer_pool_init(http_buffer_pool *pool, const size_t max_cached_bytes) {
+    static const size_t sizes[HTTP_BUFFER_POOL_TIERS] = HTTP_BUFFER_POOL_TIER_SIZES;
+    *pool = (http_buffer_pool){};
+    for (size_t i = 0; i < HTTP_BUFFER_POOL_TIERS; i++) {
+        pool->tiers[i].size = sizes[i];
+        pool->tiers[i].max_cached = max_cached_bytes / sizes[i];
+    }
+}
+
+void *http_buffer_pool_acquire(http_buffer_pool *pool, const size_t min_size, size_t *out_size) {
+    for (size_t i = 0; i < HTTP_BUFFER_POOL_TIERS; i++) {
+        if (min_size > pool->tiers[i].size) continue;
+        free_object *buffer = pool->tiers[i].free_list;
+        const bool reused = buffer != nullptr;
+        if (reused) {
+            pool->tiers[i].free_list = buffer->next;
+        } else {
+            buffer = malloc(pool->tiers[i].size);
+            if (buffer == nullptr) return nullptr;
+        }
+        counters_on_acquire(&pool->tiers[i].counters, reused);
+        *out_size = pool->tiers[i].size;
+        return buffer;
+    }
+    void *buffer = malloc(min_size);
+    if (buffer == nullptr) return nullptr;
+    counters_on_acquire(&pool->oversized, false);
+    *out_size = min_size;
+    return buffer;
+}
+
+void http_buffer_pool_release(http_buffer_pool *pool, void *buffer, const size_t size) {
+    if (buffer == nullptr) return;
+    for (size_t i = 0; i < HTTP_BUFFER_POOL_TIERS; i++) {
+        if (size != pool->tiers[i].size) continue;
+        const bool cache = atomic_load_explicit(&pool->tiers[i].counters.cached, memory_order_relaxed)
+                           < pool->tiers[i].max_cached;
+        if (cache) {
+            free_object *freed = buffer;
+            freed->next = pool->tiers[i].free_list;
+            pool->tiers[i].free_list = freed;
+        } else {
+            free(buffer);
+        }
+        counters_on_release(&pool->tiers[i].counters, cache);
+        return;
+    }
+    free(buffer);
+    counters_on_release(&pool->oversized, false);
+}
+
+void http_buffer_pool_destroy(http_buffer_pool *pool) {
+    for (size_t i = 0; i < HTTP_BUFFER_POOL_TIERS; i++) {
+        while (pool->tiers[i].free_list != nullptr) {
+            free_object *next = ((free_object *) pool->tiers[i].free_list)->next;
+            free(pool->tiers[i].free_list);
+            pool->tiers[i].free_list = next;
+        }
+        atomic_store_explicit(&pool->tiers[i].counters.cached, 0, memory_order_relaxed);
+    }
+}
+
+void http_buffer_pool_stats_load(const http_buffer_pool *pool, http_buffer_pool_stats *out_stats) {
+    for (size_t i = 0; i < HTTP_BUFFER_POOL_TIERS; i++) {
+        out_stats->tiers[i] = http_pool_counters_load(&pool->tiers[i].counters);
+    }
+    out_stats->oversized = http_pool_counters_load(&pool->oversized);
+}
+
+// endregion buffer pool
@@ -0,0 +1,133 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_POOL_H
+#define TINY_HTTP_POOL_H
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A snapshot of how a pool has been doing.
+ */
+typedef struct http_pool_stats {
+    /// allocations served
+    size_t acquired;
+    /// allocations served from the free list, i.e. without malloc
+    size_t reused;
+    /// objects handed out and not given back yet
+    size_t in_use;
+    /// the most objects that were ever in use at once
+    size_t high_water;
+    /// free objects kept for reuse
+    size_t cached;
+} http_pool_stats;
+
+/**
+ * The live counters behind an `http_pool_stats`: only the pool's owner thread writes them, any thread
+ * may read them (see `http_pool_counters_load`).
+ */
+typedef struct http_pool_counters {
+    atomic_size_t acquired;
+    atomic_size_t reused;
+    atomic_size_t in_use;
+    atomic_size_t high_water;
+    atomic_size_t cached;
+} http_pool_counters;
+
+typedef struct http_slab_chunk http_slab_chunk;
+
+/**
+ * Fixed-size objects carved out of malloc'd chunks of `objects_per_chunk` at a time and recycled
+ * through a free list; chunks are only given back to malloc by `http_slab_destroy`.
+ *
+ * Not thread-safe: each thread (e.g. each server worker) keeps a slab of its own.
+ */
+typedef struct http_slab {
+    size_t object_size;
+    size_t objects_per_chunk;
+    void *free_list;
+    http_slab_chunk *chunks;
+    http_pool_counters counters;
+} http_slab;
+
+void http_slab_init(http_slab *slab, size_t object_size, size_t objects_per_chunk);
+
+/**
+ * @return a zeroed object, or nullptr on allocation failure
+ */
+void *http_slab_alloc(http_slab *slab);
+
+void http_slab_free(http_slab *slab, void *object);
+
+/**
+ * Frees every chunk, including objects still in use.
+ */
+void http_slab_destroy(http_slab *slab);
+
+#define HTTP_BUFFER_POOL_TIERS 3
+
+/// the buffer sizes a pool recycles; larger requests are malloc'd and freed as they come
+#define HTTP_BUFFER_POOL_TIER_SIZES {4 * 1024, 16 * 1024, 64 * 1024}
+
+/**
+ * Buffers of a few fixed sizes, recycled through one free list per size.
+ *
+ * Each free list keeps at most `max_cached_bytes` worth of buffers; anything given back beyond that
+ * goes back to malloc, so a burst does not pin its peak memory forever.
+ *
+ * Not thread-safe: each thread (e.g. each server worker) keeps a pool of its own.
+ */
+typedef struct http_buffer_pool {
+    struct {
+        size_t size;
+        void *free_list;
+        size_t max_cached;
+        http_pool_counters counters;
+    } tiers[HTTP_BUFFER_POOL_TIERS];
+    /// the requests too large for any tier
+    http_pool_counters oversized;
+} http_buffer_pool;
+
+typedef struct http_buffer_pool_stats {
+    http_pool_stats tiers[HTTP_BUFFER_POOL_TIERS];
+    http_pool_stats oversized;
+} http_buffer_pool_stats;
+
+/**
+ * @param pool
+ * @param max_cached_bytes How many octets of free buffers each tier may keep.
+ */
+void http_buffer_pool_init(http_buffer_pool *pool, size_t max_cached_bytes);
+
+/**
+ * @param pool
+ * @param min_size The least octets the buffer has to hold.
+ * @param out_size Set to the size of the buffer actually handed out, which has to be passed back to
+ * `http_buffer_pool_release`.
+ *
+ * @return the smallest tier's buffer that holds `min_size` octets, or nullptr on allocation failure
+ */
+void *http_buffer_pool_acquire(http_buffer_pool *pool, size_t min_size, size_t *out_size);
+
+void http_buffer_pool_release(http_buffer_pool *pool, void *buffer, size_t size);
+
+/**
+ * Frees the cached buffers; buffers still in use have to be released before.
+ */
+void http_buffer_pool_destroy(http_buffer_pool *pool);
+
+/**
+ * @return a snapshot of `counters`; safe to call from any thread
+ */
+http_pool_stats http_pool_counters_load(const http_pool_counters *counters);
+
+void http_buffer_pool_stats_load(const http_buffer_pool *pool, http_buffer_pool_stats *out_stats);
+
+/**
+ * Adds `stats` to `sum` (`high_water` adds up too, as the worst case of pools used side by side).
+ */
+void http_pool_stats_add(http_pool_stats *sum, const http_pool_stats *stats);
+
+#endif //TINY_HTTP_POOL_H
@@ -0,0 +1,299 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_range.h"
+#include "tiny_http_arena.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/// hex digits of a `multipart/byteranges` boundary
+#define RANGE_BOUNDARY_LENGTH 16
+/// "bytes " 20 digits "-" 20 digits "/" 20 digits
+#define RANGE_CONTENT_RANGE_MAX_LENGTH (6 + 20 + 1 + 20 + 1 + 20)
+
+// region parsing
+
+static bool is_ows(const char c) {
+    return c == ' ' || c == '\t';
+}
+
+static bool is_digit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Parses the decimal position at `*cursor`, saturating at UINT64_MAX (no file is that large), and
+ * moves the cursor past it.
+ *
+ * @return false if there are no digits
+ */
+static bool parse_position(const char **cursor, uint64_t *out_position) {
+    const char *c = *cursor;
+    if (!is_digit(*c)) return false;
+    uint64_t position = 0;
+    for (; is_digit(*c); c++) {
+        const uint64_t digit = (uint64_t) (*c - '0');
+        position = position > (UINT64_MAX - digit) / 10 ? UINT64_MAX : position * 10 + digit;
+    }
+    *cursor = c;
+    *out_position = position;
+    return true;
+}
+
+/**
+ * Adds `range` to the `*cnt` ranges, none of which overlap or touch each other: merged with every one
+ * it overlaps or touches, in the place of the first of them, or else at the end.
+ */
+static void add_range(http_byte_range *ranges, size_t *cnt, http_byte_range range) {
+    size_t at = SIZE_MAX;
+    size_t kept = 0;
+    for (size_t i = 0; i < *cnt; i++) {
+        const http_byte_range other = ranges[i];
+        if (range.offset <= other.offset + other.len && other.offset <= range.offset + range.len) {
+            const uint64_t end = range.offset + range.len > other.offset + other.len
+                                     ? range.offset + range.len
+                                     : other.offset + other.len;
+            if (other.offset < range.offset) range.offset = other.offset;
+            range.len = end - range.offset;
+            if (at == SIZE_MAX) at = kept++;
+            continue;
+        }
+        ranges[kept++] = other;
+    }
+    if (at == SIZE_MAX) at = kept++;
+    ranges[at] = range;
+    *cnt = kept;
+}
+
+http_range_result http_range_parse(
+    const char *value, const uint64_t size, http_byte_range *out_ranges, const size_t max_ranges, size_t *out_cnt) {
+    *out_cnt = 0;
+    if (strncasecmp(value, "bytes=", 6) != 0) return HTTP_RANGE_FULL;
+    const char *c = value + 6;
+    size_t specs = 0;
+    size_t cnt = 0;
+    while (true) {
+        // a list may have empty elements (RFC 9110 §5.6.1)
+        while (is_ows(*c) || *c == ',') c++;
+        if (*c == '\0') break;
+        if (++specs > max_ranges) return HTTP_RANGE_FULL;
+
+        http_byte_range range = {};
+        bool satisfiable = false;
+        if (*c == '-') {
+            // suffix-range: the last so many octets
+            c++;
+            uint64_t suffix = 0;
+            if (!parse_position(&c, &suffix)) return HTTP_RANGE_FULL;
+            satisfiable = suffix > 0 && size > 0;
+            range.len = suffix < size ? suffix : size;
+            range.offset = size - range.len;
+        } else {
+            uint64_t first = 0;
+            uint64_t last = UINT64_MAX;
+            if (!parse_position(&c, &first) || *c != '-') return HTTP_RANGE_FULL;
+            c++;
+            if (is_digit(*c)) {
+                parse_position(&c, &last);
+                if (last < first) return HTTP_RANGE_FULL;
+            }
+            satisfiable = first < size;
+            if (satisfiable) {
+                if (last > size - 1) last = size - 1;
+                range = (http_byte_range){.offset = first, .len = last - first + 1};
+            }
+        }
+        while (is_ows(*c)) c++;
+        if (*c != ',' && *c != '\0') return HTTP_RANGE_FULL;
+        if (satisfiable) add_range(out_ranges, &cnt, range);
+    }
+    if (specs == 0) return HTTP_RANGE_FULL;
+    if (cnt == 0) return HTTP_RANGE_NOT_SATISFIABLE;
+    *out_cnt = cnt;
+    return HTTP_RANGE_PARTIAL;
+}
+
+bool http_range_if_range_matches(const char *value, const char *etag, const char *last_modified) {
+    while (is_ows(*value)) value++;
+    size_t len = strlen(value);
+    while (len > 0 && is_ows(value[len - 1])) len--;
+    if (len > 0 && (value[0] == '"' || (len > 2 && value[0] == 'W' && value[1] == '/'))) {
+        // an entity-tag, compared strongly: a weak one on either side never matches
+        return etag != nullptr && value[0] == '"' && etag[0] == '"' && strlen(etag) == len
+               && memcmp(value, etag, len) == 0;
+    }
+    return last_modified != nullptr && strlen(last_modified) == len && memcmp(value, last_modified, len) == 0;
+}
+
+// endregion parsing
+
+// region responses
+
+/**
+ * Sets the response's header `name` to `value`, replacing any header of that name, in a copy of its
+ * headers in `arena` (the handler's may be static).
+ *
+ * @return false if the arena is exhausted
+ */
+static bool set_response_header(http_arena *arena, http_response *response, const char *name, const char *value) {
+    http_header *headers = http_arena_alloc(arena, (response->headers_cnt + 1) * sizeof(http_header));
+    if (headers == nullptr) return false;
+    size_t cnt = 0;
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        const http_header *header = &response->headers[i];
+        if (header->name != nullptr && strcasecmp(header->name, name) == 0) continue;
+        headers[cnt++] = *header;
+    }
+    headers[cnt++] = (http_header){.name = (char *) name, .value = (char *) value};
+    response->headers = headers;
+    response->headers_cnt = cnt;
+    return true;
+}
+
+static const char *find_content_type(const http_response *response) {
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        const http_header *header = &response->headers[i];
+        if (header->name != nullptr && strcasecmp(header->name, "Content-Type") == 0) return header->value;
+    }
+    return nullptr;
+}
+
+/**
+ * @return a `Content-Range` value in `arena`, for `range` if it is not nullptr, otherwise for none of
+ * the `size` octets
+ */
+static char *content_range(http_arena *arena, const http_byte_range *range, const uint64_t size) {
+    char *value = http_arena_alloc(arena, RANGE_CONTENT_RANGE_MAX_LENGTH + 1);
+    if (value == nullptr) return nullptr;
+    if (range == nullptr) {
+        snprintf(value, RANGE_CONTENT_RANGE_MAX_LENGTH + 1, "bytes */%" PRIu64, size);
+    } else {
+        snprintf(value, RANGE_CONTENT_RANGE_MAX_LENGTH + 1, "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64,
+                 range->offset, range->offset + range->len - 1, size);
+    }
+    return value;
+}
+
+/**
+ * Fills `out` with a fresh boundary: it only has to be unlikely to turn up in the file, not
+ * unpredictable, so a per-thread xorshift does.
+ */
+static void next_boundary(char out[RANGE_BOUNDARY_LENGTH + 1]) {
+    static _Thread_local uint64_t state;
+    if (state == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        state = ((uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec) ^ (uint64_t) (uintptr_t) &state;
+        if (state == 0) state = 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    snprintf(out, RANGE_BOUNDARY_LENGTH + 1, "%016" PRIx64, state);
+}
+
+/**
+ * Makes the body the `cnt` ranges of the file as a `multipart/byteranges` (RFC 9110 §14.6): each
+ * part's delimiter and header lines are the prefix of an `http_file_part`, the closing delimiter one
+ * with no octets of the file.
+ */
+static bool respond_multipart(
+    http_arena *arena, http_response *response, const http_byte_range *ranges, const size_t cnt, const uint64_t size) {
+    char boundary[RANGE_BOUNDARY_LENGTH + 1];
+    next_boundary(boundary);
+    const char *content_type = find_content_type(response);
+    http_file_part *parts = http_arena_alloc(arena, (cnt + 1) * sizeof(http_file_part));
+    if (parts == nullptr) return false;
+
+    // "\r\n--" boundary "\r\n" ["Content-Type: " type "\r\n"] "Content-Range: " value "\r\n\r\n"
+    const size_t prefix_cap = 4 + RANGE_BOUNDARY_LENGTH + 2
+                              + (content_type != nullptr ? 14 + strlen(content_type) + 2 : 0)
+                              + 15 + RANGE_CONTENT_RANGE_MAX_LENGTH + 4 + 1;
+    size_t body_len = 0;
+    for (size_t i = 0; i < cnt; i++) {
+        char *prefix = http_arena_alloc(arena, prefix_cap);
+        if (prefix == nullptr) return false;
+        // the CRLF before a delimiter belongs to the delimiter, and the first one has none
+        int len = snprintf(prefix, prefix_cap, "%s--%s\r\n", i > 0 ? "\r\n" : "", boundary);
+        if (content_type != nullptr) {
+            len += snprintf(prefix + len, prefix_cap - (size_t) len, "Content-Type: %s\r\n", content_type);
+        }
+        len += snprintf(prefix + len, prefix_cap - (size_t) len,
+                        "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64 "\r\n\r\n",
+                        ranges[i].offset, ranges[i].offset + ranges[i].len - 1, size);
+        parts[i] = (http_file_part){
+            .prefix = {.ptr = (const uint8_t *) prefix, .len = (size_t) len},
+            .offset = response->body_file.offset + (off_t) ranges[i].offset,
+            .len = ranges[i].len,
+        };
+        body_len += (size_t) len + ranges[i].len;
+    }
+    char *closing = http_arena_alloc(arena, 4 + RANGE_BOUNDARY_LENGTH + 4 + 1);
+    if (closing == nullptr) return false;
+    const int closing_len = snprintf(closing, 4 + RANGE_BOUNDARY_LENGTH + 4 + 1, "\r\n--%s--\r\n", boundary);
+    parts[cnt] = (http_file_part){.prefix = {.ptr = (const uint8_t *) closing, .len = (size_t) closing_len}};
+    body_len += (size_t) closing_len;
+
+    // "multipart/byteranges; boundary=" boundary
+    char *multipart_type = http_arena_alloc(arena, 31 + RANGE_BOUNDARY_LENGTH + 1);
+    if (multipart_type == nullptr) return false;
+    snprintf(multipart_type, 31 + RANGE_BOUNDARY_LENGTH + 1, "multipart/byteranges; boundary=%s", boundary);
+    if (!set_response_header(arena, response, "Content-Type", multipart_type)) return false;
+
+    response->body_file.parts = parts;
+    response->body_file.parts_cnt = cnt + 1;
+    response->body_file.len = body_len;
+    return true;
+}
+
+http_range_result http_range_respond(
+    const http_request *request, http_response *response, const char *etag, const char *last_modified) {
+    // a HEAD is answered as the full GET would be; an empty file has no range to give
+    if (request->method != GET || request->arena == nullptr || response->status_code != 200
+        || response->body_file.len == 0 || response->body_file.parts_cnt > 0) {
+        return HTTP_RANGE_FULL;
+    }
+    const http_header *range = http_request_header(request, HTTP_HEADER_RANGE);
+    if (range == nullptr) return HTTP_RANGE_FULL;
+    const http_header *if_range = http_request_header(request, HTTP_HEADER_IF_RANGE);
+    if (if_range != nullptr && !http_range_if_range_matches(if_range->value, etag, last_modified)) {
+        return HTTP_RANGE_FULL;
+    }
+
+    const uint64_t size = response->body_file.len;
+    http_byte_range ranges[HTTP_RANGE_MAX_RANGES];
+    size_t cnt = 0;
+    const http_range_result result = http_range_parse(range->value, size, ranges, HTTP_RANGE_MAX_RANGES, &cnt);
+    if (result == HTTP_RANGE_FULL) return HTTP_RANGE_FULL;
+
+    // the headers are set up before anything else is touched, so running out of arena leaves it whole
+    http_arena *arena = request->arena;
+    if (result == HTTP_RANGE_NOT_SATISFIABLE) {
+        const char *value = content_range(arena, nullptr, size);
+        if (value == nullptr || !set_response_header(arena, response, "Content-Range", value)) return HTTP_RANGE_FULL;
+        // no body, but the file is only released once the response is out: its headers may point into
+        // whatever it keeps alive
+        response->body_file.len = 0;
+        response->body = nullptr;
+        response->body_len = 0;
+        response->status_code = 416;
+        return HTTP_RANGE_NOT_SATISFIABLE;
+    }
+    if (cnt == 1) {
+        const char *value = content_range(arena, &ranges[0], size);
+        if (value == nullptr || !set_response_header(arena, response, "Content-Range", value)) return HTTP_RANGE_FULL;
+        response->body_file.offset += (off_t) ranges[0].offset;
+        response->body_file.len = ranges[0].len;
+    } else if (!respond_multipart(arena, response, ranges, cnt, size)) {
+        return HTTP_RANGE_FULL;
+    }
+    response->status_code = 206;
+    return HTTP_RANGE_PARTIAL;
+}
+
+// endregion responses
@@ -0,0 +1,72 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_RANGE_H
+#define TINY_HTTP_RANGE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiny_http_server_lib.h"
+
+/// a `Range` header asking for more ranges than this is ignored, and the whole representation sent
+#ifndef HTTP_RANGE_MAX_RANGES
+#define HTTP_RANGE_MAX_RANGES 16
+#endif
+
+typedef struct http_byte_range {
+    uint64_t offset;
+    /// never 0
+    uint64_t len;
+} http_byte_range;
+
+typedef enum http_range_result {
+    /// no `Range` header, one that is ignored, or a failed `If-Range`: the whole representation, with 200
+    HTTP_RANGE_FULL = 0,
+    /// some of it, with 206
+    HTTP_RANGE_PARTIAL = 1,
+    /// none of the ranges asked for overlaps the representation, answered with 416
+    HTTP_RANGE_NOT_SATISFIABLE = 2,
+} http_range_result;
+
+/**
+ * Parses a `Range` header value (RFC 9110 §14.1.2) against a representation of `size` octets.
+ *
+ * Only the `bytes` unit is understood; a value in any other unit, with a syntax error, or asking for
+ * more than `max_ranges` ranges is ignored altogether. Ranges past the end are dropped, those reaching
+ * past it cut short, and ranges that overlap or touch are merged into one; otherwise they stay in the
+ * order they were asked for.
+ *
+ * @param out_ranges Receives the satisfiable ranges, `max_ranges` at most.
+ * @param out_cnt Receives how many; 0 unless the result is `HTTP_RANGE_PARTIAL`.
+ */
+http_range_result http_range_parse(
+    const char *value, uint64_t size, http_byte_range *out_ranges, size_t max_ranges, size_t *out_cnt);
+
+/**
+ * Evaluates an `If-Range` header value (RFC 9110 §13.1.5) against the representation's validators,
+ * either of which may be nullptr: an entity-tag matches `etag` by strong comparison (a weak one never
+ * does), a date only if it is exactly `last_modified`.
+ *
+ * @return true if the `Range` header is to be honoured
+ */
+bool http_range_if_range_matches(const char *value, const char *etag, const char *last_modified);
+
+/**
+ * Turns the full 200 response to a `GET` with a file body into the one its `Range` and `If-Range`
+ * headers ask for: a 206 with `Content-Range` for a single range, a 206 `multipart/byteranges` body
+ * for several, each part's header in the request's arena and its octets sent from the file (see
+ * `http_file_part`), or a 416 telling the size in `Content-Range` and with an empty body (the file
+ * still released by the server, once the response is out). The response is left as it is if it does
+ * not qualify, or if the arena is exhausted.
+ *
+ * @param etag The `ETag` of the representation, or nullptr.
+ * @param last_modified The `Last-Modified` of the representation, or nullptr.
+ *
+ * @return what the response became
+ */
+http_range_result http_range_respond(
+    const http_request *request, http_response *response, const char *etag, const char *last_modified);
+
+#endif //TINY_HTTP_RANGE_H
@@ -0,0 +1,485 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_router.h"
+#include "tiny_http_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct http_route {
+    http_method method;
+    http_route_handler handler;
+    void *user_data;
+} http_route;
+
+// region build tree
+
+enum build_node_kind {
+    NODE_STATIC = 0,
+    NODE_PARAM = 1,
+    NODE_WILDCARD = 2,
+};
+
+/**
+ * A node of the radix tree while routes are still being added. A static node's `label` is the path
+ * text it consumes; a capture's is the capture's name.
+ */
+typedef struct build_node {
+    enum build_node_kind kind;
+    char *label;
+    size_t label_len;
+    struct build_node **children;
+    size_t children_cnt;
+    struct build_node *param;
+    struct build_node *wildcard;
+    http_route *routes;
+    size_t routes_cnt;
+} build_node;
+
+static build_node *build_node_create(const enum build_node_kind kind, const char *label, const size_t label_len) {
+    build_node *node = calloc(1, sizeof(build_node));
+    if (node == nullptr) return nullptr;
+    node->kind = kind;
+    node->label = malloc(label_len + 1);
+    if (node->label == nullptr) {
+        free(node);
+        return nullptr;
+    }
+    memcpy(node->label, label, label_len);
+    node->label[label_len] = '\0';
+    node->label_len = label_len;
+    return node;
+}
+
+static void build_node_destroy(build_node *node) {
+    if (node == nullptr) return;
+    for (size_t i = 0; i < node->children_cnt; i++) build_node_destroy(node->children[i]);
+    build_node_destroy(node->param);
+    build_node_destroy(node->wildcard);
+    free(node->children);
+    free(node->routes);
+    free(node->label);
+    free(node);
+}
+
+static size_t common_prefix_len(const char *a, const size_t a_len, const char *b, const size_t b_len) {
+    size_t i = 0;
+    while (i < a_len && i < b_len && a[i] == b[i]) i++;
+    return i;
+}
+
+/**
+ * Splits `node` after `at` octets of its label: `node` keeps the prefix and gets a single child that
+ * takes over the suffix along with everything hanging off `node`.
+ */
+static bool build_node_split(build_node *node, const size_t at) {
+    build_node *suffix = build_node_create(NODE_STATIC, node->label + at, node->label_len - at);
+    build_node **children = malloc(sizeof(build_node *));
+    if (suffix == nullptr || children == nullptr) {
+        build_node_destroy(suffix);
+        free(children);
+        return false;
+    }
+    suffix->children = node->children;
+    suffix->children_cnt = node->children_cnt;
+    suffix->param = node->param;
+    suffix->wildcard = node->wildcard;
+    suffix->routes = node->routes;
+    suffix->routes_cnt = node->routes_cnt;
+    children[0] = suffix;
+    node->children = children;
+    node->children_cnt = 1;
+    node->param = nullptr;
+    node->wildcard = nullptr;
+    node->routes = nullptr;
+    node->routes_cnt = 0;
+    node->label_len = at;
+    node->label[at] = '\0';
+    return true;
+}
+
+/**
+ * @return the node reached after consuming the static `text` below `node`, created as needed
+ */
+static build_node *build_insert_static(build_node *node, const char *text, size_t text_len) {
+    while (text_len > 0) {
+        build_node *next = nullptr;
+        for (size_t i = 0; i < node->children_cnt; i++) {
+            if (node->children[i]->label[0] == text[0]) {
+                next = node->children[i];
+                break;
+            }
+        }
+        if (next == nullptr) {
+            build_node *child = build_node_create(NODE_STATIC, text, text_len);
+            build_node **children = realloc(node->children, (node->children_cnt + 1) * sizeof(build_node *));
+            if (child == nullptr || children == nullptr) {
+                build_node_destroy(child);
+                if (children != nullptr) node->children = children;
+                return nullptr;
+            }
+            children[node->children_cnt++] = child;
+            node->children = children;
+            return child;
+        }
+        const size_t common = common_prefix_len(next->label, next->label_len, text, text_len);
+        if (common < next->label_len && !build_node_split(next, common)) return nullptr;
+        node = next;
+        text += common;
+        text_len -= common;
+    }
+    return node;
+}
+
+/**
+ * @return the `kind` capture child of `node` named `name`, created if there is none yet
+ */
+static build_node *build_insert_capture(
+    build_node *node,
+    const enum build_node_kind kind,
+    const char *name,
+    const size_t name_len,
+    enum http_router_status *status) {
+    build_node **slot = kind == NODE_PARAM ? &node->param : &node->wildcard;
+    if (*slot != nullptr) {
+        if ((*slot)->label_len == name_len && memcmp((*slot)->label, name, name_len) == 0) return *slot;
+        http_log_error("router: capture '%.*s' conflicts with '%s'\n", (int) name_len, name, (*slot)->label);
+        *status = HTTP_ROUTER_E_CONFLICT;
+        return nullptr;
+    }
+    *slot = build_node_create(kind, name, name_len);
+    if (*slot == nullptr) *status = HTTP_ROUTER_E_MEM_ALLOC_FAILED;
+    return *slot;
+}
+
+// endregion build tree
+
+// region compiled tree
+
+/**
+ * A node of the compiled tree. The static children of a node are `nodes[children, children + children_cnt)`,
+ * so the search for the next octet stays within a few neighbouring cache lines.
+ */
+typedef struct router_node {
+    /// offset of the label in `http_router::labels`
+    uint32_t label;
+    uint32_t label_len;
+    uint32_t children;
+    uint32_t children_cnt;
+    /// index of the `:name` child, 0 if there is none (0 is the root, never anyone's child)
+    uint32_t param;
+    /// index of the `*name` child, 0 if there is none
+    uint32_t wildcard;
+    /// `http_router::routes[routes, routes + routes_cnt)` end at this node
+    uint32_t routes;
+    uint32_t routes_cnt;
+} router_node;
+
+struct http_router {
+    build_node *root;
+    bool compiled;
+    router_node *nodes;
+    size_t nodes_cnt;
+    char *labels;
+    size_t labels_len;
+    http_route *routes;
+    size_t routes_cnt;
+};
+
+typedef struct compile_sizes {
+    size_t nodes;
+    size_t labels;
+    size_t routes;
+} compile_sizes;
+
+static void measure_build_tree(const build_node *node, compile_sizes *sizes) {
+    sizes->nodes++;
+    sizes->labels += node->label_len;
+    sizes->routes += node->routes_cnt;
+    for (size_t i = 0; i < node->children_cnt; i++) measure_build_tree(node->children[i], sizes);
+    if (node->param != nullptr) measure_build_tree(node->param, sizes);
+    if (node->wildcard != nullptr) measure_build_tree(node->wildcard, sizes);
+}
+
+static void flatten_node(http_router *router, const build_node *node, const size_t index) {
+    router_node *flat = &router->nodes[index];
+    flat->label = (uint32_t) router->labels_len;
+    flat->label_len = (uint32_t) node->label_len;
+    memcpy(router->labels + router->labels_len, node->label, node->label_len);
+    router->labels_len += node->label_len;
+    flat->routes = (uint32_t) router->routes_cnt;
+    flat->routes_cnt = (uint32_t) node->routes_cnt;
+    if (node->routes_cnt > 0) {
+        memcpy(router->routes + router->routes_cnt, node->routes, node->routes_cnt * sizeof(http_route));
+        router->routes_cnt += node->routes_cnt;
+    }
+
+    // siblings get consecutive slots before any of them is descended into
+    flat->children = (uint32_t) router->nodes_cnt;
+    flat->children_cnt = (uint32_t) node->children_cnt;
+    router->nodes_cnt += node->children_cnt;
+    flat->param = node->param != nullptr ? (uint32_t) router->nodes_cnt++ : 0;
+    flat->wildcard = node->wildcard != nullptr ? (uint32_t) router->nodes_cnt++ : 0;
+    for (size_t i = 0; i < node->children_cnt; i++) flatten_node(router, node->children[i], flat->children + i);
+    if (node->param != nullptr) flatten_node(router, node->param, flat->param);
+    if (node->wildcard != nullptr) flatten_node(router, node->wildcard, flat->wildcard);
+}
+
+// endregion compiled tree
+
+http_router *http_router_create(void) {
+    http_router *router = calloc(1, sizeof(http_router));
+    if (router == nullptr) return nullptr;
+    router->root = build_node_create(NODE_STATIC, "", 0);
+    if (router->root == nullptr) {
+        free(router);
+        return nullptr;
+    }
+    return router;
+}
+
+void http_router_destroy(http_router *router) {
+    if (router == nullptr) return;
+    build_node_destroy(router->root);
+    free(router->nodes);
+    free(router->labels);
+    free(router->routes);
+    free(router);
+}
+
+enum http_router_status http_router_add(
+    http_router *router,
+    const http_method method,
+    const char *pattern,
+    const http_route_handler handler,
+    void *user_data) {
+    if (pattern == nullptr || pattern[0] != '/' || handler == nullptr || http_method_name(method) == nullptr) {
+        http_log_error("router: malformed route\n");
+        return HTTP_ROUTER_E_MALFORMED_PATTERN;
+    }
+    enum http_router_status status = HTTP_ROUTER_OK;
+    build_node *node = router->root;
+    size_t params_cnt = 0;
+    size_t at = 0;
+    while (pattern[at] != '\0' && node != nullptr) {
+        // static text up to a segment that starts with ':' or '*'
+        size_t end = at;
+        while (pattern[end] != '\0' && !(end > 0 && pattern[end - 1] == '/' && (pattern[end] == ':' || pattern[end] == '*'))) {
+            end++;
+        }
+        if (end > at) {
+            node = build_insert_static(node, pattern + at, end - at);
+            if (node == nullptr) return HTTP_ROUTER_E_MEM_ALLOC_FAILED;
+            at = end;
+            continue;
+        }
+        const enum build_node_kind kind = pattern[at] == ':' ? NODE_PARAM : NODE_WILDCARD;
+        const size_t name_start = at + 1;
+        const size_t name_len = strcspn(pattern + name_start, "/");
+        if (name_len == 0 || (kind == NODE_WILDCARD && pattern[name_start + name_len] != '\0')) {
+            http_log_error("router: malformed pattern %s\n", pattern);
+            return HTTP_ROUTER_E_MALFORMED_PATTERN;
+        }
+        if (++params_cnt > HTTP_ROUTER_MAX_PARAMS) {
+            http_log_error("router: more than %d captures in %s\n", HTTP_ROUTER_MAX_PARAMS, pattern);
+            return HTTP_ROUTER_E_TOO_MANY_PARAMS;
+        }
+        node = build_insert_capture(node, kind, pattern + name_start, name_len, &status);
+        at = name_start + name_len;
+    }
+    if (node == nullptr) return status;
+
+    for (size_t i = 0; i < node->routes_cnt; i++) {
+        if (node->routes[i].method == method) {
+            http_log_error("router: route %s added twice\n", pattern);
+            return HTTP_ROUTER_E_CONFLICT;
+        }
+    }
+    http_route *routes = realloc(node->routes, (node->routes_cnt + 1) * sizeof(http_route));
+    if (routes == nullptr) return HTTP_ROUTER_E_MEM_ALLOC_FAILED;
+    routes[node->routes_cnt++] = (http_route){.method = method, .handler = handler, .user_data = user_data};
+    node->routes = routes;
+    router->compiled = false;
+    return HTTP_ROUTER_OK;
+}
+
+enum http_router_status http_router_compile(http_router *router) {
+    compile_sizes sizes = {};
+    measure_build_tree(router->root, &sizes);
+    router_node *nodes = calloc(sizes.nodes, sizeof(router_node));
+    char *labels = malloc(sizes.labels + 1);
+    http_route *routes = malloc((sizes.routes + 1) * sizeof(http_route));
+    if (nodes == nullptr || labels == nullptr || routes == nullptr) {
+        free(nodes);
+        free(labels);
+        free(routes);
+        return HTTP_ROUTER_E_MEM_ALLOC_FAILED;
+    }
+    free(router->nodes);
+    free(router->labels);
+    free(router->routes);
+    router->nodes = nodes;
+    router->labels = labels;
+    router->routes = routes;
+    router->nodes_cnt = 1;
+    router->labels_len = 0;
+    router->routes_cnt = 0;
+    flatten_node(router, router->root, 0);
+    router->compiled = true;
+    return HTTP_ROUTER_OK;
+}
+
+// region lookup
+
+/**
+ * Matches `path[at, len)` below `index`, whose own label has been consumed already.
+ *
+ * @return the index of the node the path ends at with at least one route, or 0 if there is none
+ */
+static size_t match_below(
+    const http_router *router,
+    const size_t index,
+    const char *path,
+    const size_t at,
+    const size_t len,
+    http_route_match *match) {
+    const router_node *node = &router->nodes[index];
+    if (at == len && node->routes_cnt > 0) return index;
+    if (at < len) {
+        for (uint32_t i = 0; i < node->children_cnt; i++) {
+            const router_node *child = &router->nodes[node->children + i];
+            const char *label = router->labels + child->label;
+            if (label[0] != path[at]) continue;
+            // siblings never share a first octet, so this is the only candidate
+            if (child->label_len <= len - at && memcmp(label, path + at, child->label_len) == 0) {
+                const size_t found = match_below(router, node->children + i, path, at + child->label_len, len, match);
+                if (found != 0) return found;
+            }
+            break;
+        }
+        if (node->param != 0 && path[at] != '/') {
+            const char *slash = memchr(path + at, '/', len - at);
+            const size_t end = slash != nullptr ? (size_t) (slash - path) : len;
+            const router_node *param = &router->nodes[node->param];
+            match->params[match->params_cnt++] = (http_route_param){
+                .name = {.ptr = (const uint8_t *) router->labels + param->label, .len = param->label_len},
+                .value = {.ptr = (const uint8_t *) path + at, .len = end - at},
+            };
+            const size_t found = match_below(router, node->param, path, end, len, match);
+            if (found != 0) return found;
+            match->params_cnt--;
+        }
+    }
+    if (node->wildcard != 0) {
+        const router_node *wildcard = &router->nodes[node->wildcard];
+        match->params[match->params_cnt++] = (http_route_param){
+            .name = {.ptr = (const uint8_t *) router->labels + wildcard->label, .len = wildcard->label_len},
+            .value = {.ptr = (const uint8_t *) path + at, .len = len - at},
+        };
+        return node->wildcard;
+    }
+    return 0;
+}
+
+enum http_route_result http_router_match(
+    const http_router *router,
+    const http_method method,
+    const char *path,
+    size_t path_len,
+    http_route_match *out_match) {
+    *out_match = (http_route_match){};
+    if (!router->compiled || path_len == 0) return HTTP_ROUTE_NOT_FOUND;
+    const char *query = memchr(path, '?', path_len);
+    if (query != nullptr) path_len = (size_t) (query - path);
+
+    const size_t found = match_below(router, 0, path, 0, path_len, out_match);
+    if (found == 0) {
+        out_match->params_cnt = 0;
+        return HTTP_ROUTE_NOT_FOUND;
+    }
+    const router_node *node = &router->nodes[found];
+    const http_route *fallback = nullptr;
+    for (uint32_t i = 0; i < node->routes_cnt; i++) {
+        const http_route *route = &router->routes[node->routes + i];
+        out_match->allowed_methods |= 1u << route->method;
+        if (route->method == method) {
+            out_match->handler = route->handler;
+            out_match->user_data = route->user_data;
+        } else if (method == HEAD && route->method == GET) {
+            fallback = route;
+        }
+    }
+    if (out_match->handler == nullptr && fallback != nullptr) {
+        out_match->handler = fallback->handler;
+        out_match->user_data = fallback->user_data;
+    }
+    if (out_match->allowed_methods & 1u << GET) out_match->allowed_methods |= 1u << HEAD;
+    return out_match->handler != nullptr ? HTTP_ROUTE_FOUND : HTTP_ROUTE_METHOD_NOT_ALLOWED;
+}
+
+const http_slice *http_route_param_value(const http_route_match *match, const char *name) {
+    for (size_t i = 0; i < match->params_cnt; i++) {
+        if (http_slice_eq_cstr(match->params[i].name, name)) return &match->params[i].value;
+    }
+    return nullptr;
+}
+
+// endregion lookup
+
+// region handler
+
+/**
+ * @return the `Allow` field value listing `allowed_methods`, allocated from `arena`, or nullptr
+ */
+static char *render_allow(http_arena *arena, const uint32_t allowed_methods) {
+    if (arena == nullptr) return nullptr;
+    size_t len = 0;
+    for (size_t m = 0; m < HTTP_METHOD_COUNT; m++) {
+        if (http_method_name(m) != nullptr && (allowed_methods & 1u << m)) len += strlen(http_method_name(m)) + 2;
+    }
+    char *allow = http_arena_alloc(arena, len + 1);
+    if (allow == nullptr) return nullptr;
+    char *out = allow;
+    for (size_t m = 0; m < HTTP_METHOD_COUNT; m++) {
+        const char *name = http_method_name(m);
+        if (name == nullptr || !(allowed_methods & 1u << m)) continue;
+        if (out != allow) {
+            memcpy(out, ", ", 2);
+            out += 2;
+        }
+        const size_t name_len = strlen(name);
+        memcpy(out, name, name_len);
+        out += name_len;
+    }
+    *out = '\0';
+    return allow;
+}
+
+void http_router_handler(const http_request *request, http_response *response, void *user_data) {
+    const http_router *router = user_data;
+    http_route_match match;
+    const enum http_route_result result = http_router_match(
+        router, request->method, request->path, request->path != nullptr ? strlen(request->path) : 0, &match);
+    if (result == HTTP_ROUTE_FOUND) {
+        match.handler(request, &match, response, match.user_data);
+        return;
+    }
+    if (result == HTTP_ROUTE_NOT_FOUND) {
+        response->status_code = 404;
+        return;
+    }
+    // a path no `OPTIONS` route answers still tells what it allows
+    const bool options = request->method == OPTIONS;
+    response->status_code = options ? 204 : 405;
+    char *allow = render_allow(request->arena, match.allowed_methods | (options ? 1u << OPTIONS : 0));
+    http_header *headers = allow != nullptr ? http_arena_alloc(request->arena, sizeof(http_header)) : nullptr;
+    if (headers != nullptr) {
+        headers[0] = (http_header){.name = "Allow", .value = allow};
+        response->headers = headers;
+        response->headers_cnt = 1;
+    }
+}
+
+// endregion handler
@@ -0,0 +1,128 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_ROUTER_H
+#define TINY_HTTP_ROUTER_H
+#include <stddef.h>
+
+#include "tiny_http_server_lib.h"
+
+/**
+ * Dispatches requests by method and path.
+ *
+ * A pattern is a path made of `/` separated segments, each of which is either static text, a `:name`
+ * capture matching one non-empty segment, or (last segment only) a `*name` wildcard matching the rest
+ * of the path, slashes and all, possibly nothing. Routes are added to a build tree and then compiled
+ * into a radix tree flattened into one node array, siblings next to each other, so a lookup walks the
+ * path once, octet by octet, however many routes there are. Static segments win over a `:name` at the
+ * same place and a `:name` over a `*name`; only when the static branch dead-ends further down does the
+ * lookup come back to try the capture.
+ */
+typedef struct http_router http_router;
+
+#ifndef HTTP_ROUTER_MAX_PARAMS
+#define HTTP_ROUTER_MAX_PARAMS 8
+#endif
+
+typedef struct http_route_param {
+    /// borrowed from the router
+    http_slice name;
+    /// borrowed from the matched path
+    http_slice value;
+} http_route_param;
+
+typedef struct http_route_match http_route_match;
+
+/**
+ * Like an `http_request_handler`, with the captures of the route that matched.
+ */
+typedef void (*http_route_handler)(
+    const http_request *request,
+    const http_route_match *match,
+    http_response *response,
+    void *user_data);
+
+struct http_route_match {
+    http_route_param params[HTTP_ROUTER_MAX_PARAMS];
+    size_t params_cnt;
+    /// `1 << method` for every method the matched path has a route for
+    uint32_t allowed_methods;
+    /// the route's handler and user data, if one was found
+    http_route_handler handler;
+    void *user_data;
+};
+
+enum http_router_status {
+    HTTP_ROUTER_OK = 0,
+    HTTP_ROUTER_E_MEM_ALLOC_FAILED = -1,
+    HTTP_ROUTER_E_MALFORMED_PATTERN = -2,
+    /// the same method and pattern, or a capture named differently at the same place, was added before
+    HTTP_ROUTER_E_CONFLICT = -3,
+    HTTP_ROUTER_E_TOO_MANY_PARAMS = -4,
+};
+
+enum http_route_result {
+    HTTP_ROUTE_FOUND = 0,
+    HTTP_ROUTE_NOT_FOUND = 1,
+    /// the path matched, but not for this method; see `http_route_match::allowed_methods`
+    HTTP_ROUTE_METHOD_NOT_ALLOWED = 2,
+};
+
+/**
+ * @return an empty router, or nullptr on allocation failure
+ */
+http_router *http_router_create(void);
+
+void http_router_destroy(http_router *router);
+
+/**
+ * Adds a route to the build tree; it takes effect with the next `http_router_compile`.
+ *
+ * @param router
+ * @param method The method the route answers; a `GET` route answers `HEAD` too unless `HEAD` has a route of its own.
+ * @param pattern The path pattern, starting with '/', e.g. "/users/:id/posts".
+ * @param handler Called with the captures when the route matches.
+ * @param user_data Passed as is to `handler`.
+ */
+enum http_router_status http_router_add(
+    http_router *router,
+    http_method method,
+    const char *pattern,
+    http_route_handler handler,
+    void *user_data);
+
+/**
+ * Flattens the routes added so far into the lookup array. Not thread-safe: compile before serving.
+ */
+enum http_router_status http_router_compile(http_router *router);
+
+/**
+ * Finds the route for `method` and `path[0, path_len)` (any query string is ignored) without allocating.
+ *
+ * @param router A compiled router; one that was never compiled finds nothing.
+ * @param method
+ * @param path The decoded request path; the captured values point into it.
+ * @param path_len
+ * @param out_match Receives the route and its captures.
+ */
+enum http_route_result http_router_match(
+    const http_router *router,
+    http_method method,
+    const char *path,
+    size_t path_len,
+    http_route_match *out_match);
+
+/**
+ * @return the value captured by `:name` or `*name`, or nullptr if the route has no such capture
+ */
+const http_slice *http_route_param_value(const http_route_match *match, const char *name);
+
+/**
+ * An `http_request_handler` dispatching to the matching route of a compiled `http_router` passed as
+ * `user_data`; answers 404 if no route matches the path and 405 (with `Allow`) if none matches the method,
+ * but 204 (with `Allow`) to an `OPTIONS` request no route of the path answers.
+ */
+void http_router_handler(const http_request *request, http_response *response, void *user_data);
+
+#endif //TINY_HTTP_ROUTER_H
@@ -0,0 +1,285 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_scan.h"
+
+#include <string.h>
+
+#if !defined(TINY_HTTP_PORTABLE_SCAN) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TINY_HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// region class tables
+
+/**
+ * Per-class lookup tables.
+ *
+ * `member` is the plain 256 entry table. The SIMD kernels classify 16/32 octets at once with two
+ * shuffles instead: `lo[o & 0xf]` has bit `h` set iff octet `(h << 4) | (o & 0xf)` is a member, and
+ * `hi[o >> 4]` is `1 << (o >> 4)` for the 7-bit half, so `lo[o & 0xf] & hi[o >> 4]` is non-zero exactly
+ * for the 7-bit members; octets >= 0x80 are members iff `allow_high`.
+ */
+typedef struct scan_class_tables {
+    bool member[256];
+    uint8_t lo[16];
+    uint8_t hi[16];
+    bool allow_high;
+} scan_class_tables;
+
+static scan_class_tables class_tables[3];
+
+static bool is_tchar(const uint8_t octet) {
+    if ((octet >= '0' && octet <= '9') || (octet >= 'A' && octet <= 'Z') || (octet >= 'a' && octet <= 'z')) {
+        return true;
+    }
+    return octet != '\0' && strchr("!#$%&'*+-.^_`|~", octet) != nullptr;
+}
+
+static bool is_in_class(const http_scan_class cls, const uint8_t octet) {
+    switch (cls) {
+        case HTTP_SCAN_TCHAR:
+            return is_tchar(octet);
+        case HTTP_SCAN_FIELD_CONTENT:
+            return octet == '\t' || (octet >= 0x20 && octet != 0x7f);
+        case HTTP_SCAN_REQUEST_TARGET:
+            return octet > 0x20 && octet != 0x7f;
+        default:
+            return false;
+    }
+}
+
+static void build_class_tables(void) {
+    for (int cls = 0; cls < 3; cls++) {
+        scan_class_tables *tables = &class_tables[cls];
+        memset(tables, 0, sizeof(*tables));
+        for (int octet = 0; octet < 256; octet++) {
+            tables->member[octet] = is_in_class(cls, (uint8_t) octet);
+            if (octet < 0x80 && tables->member[octet]) {
+                tables->lo[octet & 0x0f] |= (uint8_t) (1u << (octet >> 4));
+            }
+        }
+        for (int nibble = 0; nibble < 8; nibble++) {
+            tables->hi[nibble] = (uint8_t) (1u << nibble);
+        }
+        tables->allow_high = tables->member[0x80];
+    }
+}
+
+// endregion class tables
+
+// region portable kernels
+
+static size_t span_scalar(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+    const bool *member = class_tables[cls].member;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        if (!member[buf[i]]) return i;
+        if (!member[buf[i + 1]]) return i + 1;
+        if (!member[buf[i + 2]]) return i + 2;
+        if (!member[buf[i + 3]]) return i + 3;
+    }
+    for (; i < len; i++) {
+        if (!member[buf[i]]) return i;
+    }
+    return len;
+}
+
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+// high bit set in (at least) the lowest octet of `x` that is below `n` (n <= 128) / zero
+#define SWAR_HAS_LESS(x, n) (((x) - SWAR_ONES * (n)) & ~(x) & SWAR_HIGHS)
+#define SWAR_HAS_ZERO(x) SWAR_HAS_LESS(x, 1)
+
+static uint64_t swar_load(const uint8_t *buf) {
+    uint64_t word;
+    memcpy(&word, buf, sizeof(word));
+    return word;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_FIRST_OCTET(mask) ((size_t) __builtin_ctzll(mask) / 8)
+#endif
+
+/**
+ * Field content and request-targets are ranges of octets (bar HTAB / DEL), so 8 octets at a time
+ * can be accepted with the `SWAR_HAS_LESS` trick; a flagged octet is then re-checked with the table.
+ * tchar is too scattered for that and header names are short, so it stays on the table.
+ */
+static size_t span_swar(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+#ifdef SWAR_FIRST_OCTET
+    if (cls == HTTP_SCAN_TCHAR) return span_scalar(buf, len, cls);
+    const uint64_t below = cls == HTTP_SCAN_FIELD_CONTENT ? 0x20 : 0x21;
+    size_t i = 0;
+    while (i + 8 <= len) {
+        const uint64_t word = swar_load(buf + i);
+        const uint64_t flagged = SWAR_HAS_LESS(word, below) | SWAR_HAS_ZERO(word ^ (SWAR_ONES * 0x7f));
+        if (flagged == 0) {
+            i += 8;
+            continue;
+        }
+        i += SWAR_FIRST_OCTET(flagged);
+        if (!class_tables[cls].member[buf[i]]) return i;
+        i++;
+    }
+    return i + span_scalar(buf + i, len - i, cls);
+#else
+    return span_scalar(buf, len, cls);
+#endif
+}
+
+static size_t find_octet_swar(const uint8_t *buf, const size_t len, const uint8_t octet) {
+    const uint8_t *found = memchr(buf, octet, len);
+    return found == nullptr ? len : (size_t) (found - buf);
+}
+
+// endregion portable kernels
+
+// region x86 kernels
+#ifdef TINY_HTTP_SCAN_X86
+
+__attribute__((target("sse4.2")))
+static size_t span_sse42(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+    const scan_class_tables *tables = &class_tables[cls];
+    const __m128i lo_table = _mm_loadu_si128((const __m128i *) tables->lo);
+    const __m128i hi_table = _mm_loadu_si128((const __m128i *) tables->hi);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const uint32_t high_members = tables->allow_high ? 0xffffu : 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i octets = _mm_loadu_si128((const __m128i *) (buf + i));
+        const __m128i lo = _mm_shuffle_epi8(lo_table, _mm_and_si128(octets, nibble_mask));
+        const __m128i hi = _mm_shuffle_epi8(hi_table, _mm_and_si128(_mm_srli_epi16(octets, 4), nibble_mask));
+        const __m128i not_member = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        const uint32_t stop = (uint32_t) _mm_movemask_epi8(not_member)
+                              & ~((uint32_t) _mm_movemask_epi8(octets) & high_members);
+        if (stop != 0) return i + (size_t) __builtin_ctz(stop);
+    }
+    return i + span_scalar(buf + i, len - i, cls);
+}
+
+__attribute__((target("sse4.2")))
+static size_t find_octet_sse42(const uint8_t *buf, const size_t len, const uint8_t octet) {
+    const __m128i needle = _mm_set1_epi8((char) octet);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i octets = _mm_loadu_si128((const __m128i *) (buf + i));
+        const uint32_t hits = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(octets, needle));
+        if (hits != 0) return i + (size_t) __builtin_ctz(hits);
+    }
+    return i + find_octet_swar(buf + i, len - i, octet);
+}
+
+__attribute__((target("avx2")))
+static size_t span_avx2(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+    const scan_class_tables *tables = &class_tables[cls];
+    const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) tables->lo));
+    const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) tables->hi));
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const uint32_t high_members = tables->allow_high ? 0xffffffffu : 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i octets = _mm256_loadu_si256((const __m256i *) (buf + i));
+        const __m256i lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(octets, nibble_mask));
+        const __m256i hi = _mm256_shuffle_epi8(
+            hi_table, _mm256_and_si256(_mm256_srli_epi16(octets, 4), nibble_mask));
+        const __m256i not_member = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+        const uint32_t stop = (uint32_t) _mm256_movemask_epi8(not_member)
+                              & ~((uint32_t) _mm256_movemask_epi8(octets) & high_members);
+        if (stop != 0) return i + (size_t) __builtin_ctz(stop);
+    }
+    return i + span_sse42(buf + i, len - i, cls);
+}
+
+__attribute__((target("avx2")))
+static size_t find_octet_avx2(const uint8_t *buf, const size_t len, const uint8_t octet) {
+    const __m256i needle = _mm256_set1_epi8((char) octet);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i octets = _mm256_loadu_si256((const __m256i *) (buf + i));
+        const uint32_t hits = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(octets, needle));
+        if (hits != 0) return i + (size_t) __builtin_ctz(hits);
+    }
+    return i + find_octet_sse42(buf + i, len - i, octet);
+}
+
+#endif
+// endregion x86 kernels
+
+// region dispatch
+
+typedef size_t (*span_fn)(const uint8_t *, size_t, http_scan_class);
+typedef size_t (*find_octet_fn)(const uint8_t *, size_t, uint8_t);
+
+static http_scan_kernel best_kernel = HTTP_SCAN_KERNEL_SWAR;
+static http_scan_kernel active_kernel = HTTP_SCAN_KERNEL_SWAR;
+static span_fn span_impl = span_swar;
+static find_octet_fn find_octet_impl = find_octet_swar;
+
+bool http_scan_select_kernel(const http_scan_kernel kernel) {
+    if (kernel > best_kernel) return false;
+    switch (kernel) {
+#ifdef TINY_HTTP_SCAN_X86
+        case HTTP_SCAN_KERNEL_AVX2:
+            span_impl = span_avx2;
+            find_octet_impl = find_octet_avx2;
+            break;
+        case HTTP_SCAN_KERNEL_SSE42:
+            span_impl = span_sse42;
+            find_octet_impl = find_octet_sse42;
+            break;
+#endif
+        case HTTP_SCAN_KERNEL_SWAR:
+            span_impl = span_swar;
+            find_octet_impl = find_octet_swar;
+            break;
+        default:
+            return false;
+    }
+    active_kernel = kernel;
+    return true;
+}
+
+http_scan_kernel http_scan_active_kernel(void) {
+    return active_kernel;
+}
+
+/**
+ * Builds the tables and picks the widest kernel once, before `main`, so that the hot path is a plain
+ * indirect call with no "initialised yet?" check and no shared state written after start-up.
+ */
+__attribute__((constructor))
+static void http_scan_init(void) {
+    build_class_tables();
+#ifdef TINY_HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        best_kernel = HTTP_SCAN_KERNEL_AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        best_kernel = HTTP_SCAN_KERNEL_SSE42;
+    }
+#endif
+    http_scan_select_kernel(best_kernel);
+}
+
+// endregion dispatch
+
+size_t http_scan_span(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+    return span_impl(buf, len, cls);
+}
+
+size_t http_scan_find_octet(const uint8_t *buf, const size_t len, const uint8_t octet) {
+    return find_octet_impl(buf, len, octet);
+}
+
+size_t http_scan_find_crlf(const uint8_t *buf, const size_t len) {
+    size_t from = 0;
+    while (from < len) {
+        const size_t cr = from + find_octet_impl(buf + from, len - from, '\r');
+        if (cr + 1 >= len) return len;
+        if (buf[cr + 1] == '\n') return cr;
+        from = cr + 1;
+    }
+    return len;
+}
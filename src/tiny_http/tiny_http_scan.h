@@ -0,0 +1,57 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_SCAN_H
+#define TINY_HTTP_SCAN_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Octet classes of the HTTP grammar the parser needs to skip over.
+ */
+typedef enum http_scan_class {
+    /// tchar (RFC 9110 §5.6.2): method and header field names
+    HTTP_SCAN_TCHAR = 0,
+    /// VCHAR / obs-text / SP / HTAB (RFC 9110 §5.5): header field values
+    HTTP_SCAN_FIELD_CONTENT = 1,
+    /// VCHAR / obs-text: the request-target, UTF-8 included
+    HTTP_SCAN_REQUEST_TARGET = 2,
+} http_scan_class;
+
+typedef enum http_scan_kernel {
+    HTTP_SCAN_KERNEL_SWAR = 0,
+    HTTP_SCAN_KERNEL_SSE42 = 1,
+    HTTP_SCAN_KERNEL_AVX2 = 2,
+} http_scan_kernel;
+
+/**
+ * @return the length of the longest prefix of `buf[0, len)` whose octets all belong to `cls`, i.e. the
+ * index of the first delimiter (or invalid octet), or `len` if there is none
+ */
+size_t http_scan_span(const uint8_t *buf, size_t len, http_scan_class cls);
+
+/**
+ * @return the index of the first `octet` in `buf[0, len)` or `len` if there is none
+ */
+size_t http_scan_find_octet(const uint8_t *buf, size_t len, uint8_t octet);
+
+/**
+ * @return the index of the first "\r\n" in `buf[0, len)` or `len` if there is none
+ */
+size_t http_scan_find_crlf(const uint8_t *buf, size_t len);
+
+/**
+ * @return the kernel picked for this CPU at start-up (the widest one it supports)
+ */
+http_scan_kernel http_scan_active_kernel(void);
+
+/**
+ * Switches every scan to `kernel`; meant for tests and benchmarks.
+ *
+ * @return false (and changes nothing) if the CPU or the build does not support `kernel`
+ */
+bool http_scan_select_kernel(http_scan_kernel kernel);
+
+#endif //TINY_HTTP_SCAN_H
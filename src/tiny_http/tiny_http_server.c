@@ -0,0 +1,1603 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_server.h"
+#include "tiny_http_cache.h"
+#include "tiny_http_chunked.h"
+#include "tiny_http_compress.h"
+#include "tiny_http_log.h"
+#include "tiny_http_metrics.h"
+#include "tiny_http_stream_parser.h"
+#include "tiny_http_timer.h"
+#include "tiny_http_uring.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define SERVER_MAX_EVENTS 256
+#define SERVER_CONNECTIONS_PER_SLAB_CHUNK 64
+#define SERVER_DEFAULT_POOL_MAX_CACHED_BYTES (4 * 1024 * 1024)
+#define CONNECTION_INITIAL_BUFFER_SIZE 4096
+#define CONNECTION_ARENA_SIZE (16 * 1024)
+#define CONNECTION_STREAM_BUFFER_SIZE (16 * 1024)
+#define URING_QUEUE_ENTRIES 256
+#define URING_COMPLETION_ENTRIES 4096
+#define URING_RECV_BUFFER_GROUP 0
+#define URING_RECV_BUFFERS 512
+#define URING_RECV_BUFFER_SIZE 4096
+#define SERVER_DEFAULT_IDLE_TIMEOUT_MS 60000
+#define SERVER_DEFAULT_HEADER_TIMEOUT_MS 30000
+#define SERVER_DEFAULT_BODY_TIMEOUT_MS 30000
+#define SERVER_DEFAULT_WRITE_TIMEOUT_MS 60000
+
+typedef enum connection_state {
+    CONNECTION_READING = 0,
+    CONNECTION_WRITING = 1,
+} connection_state;
+
+/**
+ * What a connection is waiting on, each with a timeout of its own (see `http_server_settings`).
+ */
+typedef enum connection_phase {
+    /// for the first octet of a request
+    CONNECTION_PHASE_IDLE = 0,
+    /// for the rest of a request head
+    CONNECTION_PHASE_HEAD = 1,
+    /// for more of a request body
+    CONNECTION_PHASE_BODY = 2,
+    /// for the client to take more of a response
+    CONNECTION_PHASE_WRITE = 3,
+    CONNECTION_PHASE_COUNT = 4,
+} connection_phase;
+
+typedef enum event_source_kind {
+    EVENT_SOURCE_LISTENER = 0,
+    EVENT_SOURCE_WAKEUP = 1,
+    EVENT_SOURCE_CONNECTION = 2,
+} event_source_kind;
+
+/**
+ * Every epoll registration points at one of these (as the first member of the registered object),
+ * so the loop can tell what became ready without a lookup.
+ */
+typedef struct event_source {
+    event_source_kind kind;
+    int fd;
+} event_source;
+
+typedef struct http_connection {
+    event_source source;
+    connection_state state;
+    struct http_connection *prev;
+    struct http_connection *next;
+
+    /// `read_buf[read_start, parsed_len)` is the request being parsed, anything after it was pipelined behind it;
+    /// like every buffer of the connection it comes from the worker's pool and goes back there while idle
+    uint8_t *read_buf;
+    size_t read_start;
+    size_t read_len;
+    size_t read_capacity;
+    size_t parsed_len;
+    http_stream_parser parser;
+    /// the body received so far, decoded, is `read_buf[read_start + body_offset, + body_len)`: a chunked
+    /// body is decoded in place, over its own framing, so the handler gets it without a copy
+    size_t body_offset;
+    size_t body_len;
+
+    /// over a pooled block of `arena_block_size` octets, if `arena.block` is set
+    http_arena arena;
+    size_t arena_block_size;
+    bool keep_alive;
+    /// version, head, `Date`, framing and body of a cached response; just head and body of a rendered one
+    struct iovec write_iov[5];
+    size_t write_iov_cnt;
+    size_t write_iov_idx;
+
+    /// set while a streamed body is being produced, once the head has been written
+    http_body_producer producer;
+    void *producer_state;
+    http_response_writer writer;
+    /// acquired on the first streamed response and kept until the connection idles
+    uint8_t *stream_buf;
+    size_t stream_buf_size;
+
+    /// sent once `write_iov` has been written, `file.len` octets to go; a body in parts has the current
+    /// part's range in `offset` and `len`, and `parts` are the ones still to come
+    http_file_body file;
+    /// the cache entry `write_iov` points into, referenced until the connection moves on
+    http_cached_response *cached;
+    /// the compressed variant the body of `write_iov` points into, referenced until the connection moves on
+    http_compressed_variant *compressed;
+
+    /// armed on the worker's wheel for as long as the connection is open, see `connection_update_timer`
+    http_timer timer;
+    connection_phase phase;
+    /// octets were received, or sent, since the timer was last looked at
+    bool received;
+    bool sent;
+    /// the request counts as in flight with the worker's admission control
+    bool admitted;
+
+#ifdef TINY_HTTP_IO_URING
+    /// what `write_iov` is sent with; the kernel reads it once the send is under way
+    struct msghdr write_msg;
+    /// operations submitted for this connection whose last completion has not arrived yet
+    size_t uring_ops;
+    /// a send, or a poll for the socket to take more, is in flight
+    bool uring_writing;
+    /// shut down, waiting for `uring_ops` to drain before it is closed
+    bool uring_closing;
+#endif
+} http_connection;
+
+/**
+ * One event loop, owning its own `SO_REUSEPORT` listener, epoll instance and connections; the kernel
+ * spreads incoming connections across the workers' listeners, so workers never share mutable state.
+ */
+typedef struct http_server_worker {
+    const struct http_server *server;
+    size_t index;
+    pthread_t thread;
+    bool thread_started;
+    event_source listener;
+    event_source wakeup;
+    int epoll_fd;
+    http_connection *connections;
+    /// `http_connection` objects
+    http_slab connection_slab;
+    /// every buffer of every connection of this worker; only ever touched by the worker's own thread
+    http_buffer_pool buffers;
+    /// the engine the worker's loop runs, epoll if the io_uring one cannot be set up
+    http_io_engine io_engine;
+    /// every open connection's timer
+    http_timer_wheel timers;
+    /// `http_timer_clock_ms` as of the loop's last wake-up, which timers are armed from
+    uint64_t now_ms;
+    /// only set up if the server sheds load
+    http_admission admission;
+    /// `http_admission_clock_ns` as of the loop's last wake-up
+    uint64_t wake_ns;
+    /// what the I/O found by the last wake-up has been pending since, at the least: the wake-up itself if
+    /// the loop had to wait for it, the one before if it piled up while the loop was busy
+    uint64_t events_since_ns;
+    /// what every request handled until the next wake-up has been queueing since, at the least: as
+    /// `events_since_ns`, but a request on a connection accepted by the iteration before came with the
+    /// connection, so the lag of that iteration carries over
+    uint64_t queued_ns;
+    /// the loop's current iteration opened connections
+    bool accepted;
+#ifdef TINY_HTTP_IO_URING
+    /// set up by the worker's own thread when its loop starts
+    http_uring ring;
+    /// operations submitted to `ring` whose last completion has not arrived yet
+    size_t uring_in_flight;
+    bool uring_stopping;
+    /// what `wakeup` is read into
+    uint64_t wakeup_value;
+#endif
+} http_server_worker;
+
+struct http_server {
+    const http_server_settings *settings;
+    http_request_handler handler;
+    void *user_data;
+    uint16_t port;
+    size_t head_capacity;
+    /// milliseconds, by `connection_phase`
+    uint32_t timeouts[CONNECTION_PHASE_COUNT];
+    /// what a shed request is answered with, `Retry-After` and all
+    char response_503[128];
+    size_t response_503_len;
+    http_io_engine io_engine;
+    http_server_worker *workers;
+    size_t worker_count;
+};
+
+// region canned responses
+
+// after any of these the connection is closed: whatever the client pipelined behind the bad request is lost
+
+static const char response_400[] = "HTTP/1.0 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_408[] = "HTTP/1.0 408 Request Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_413[] = "HTTP/1.0 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_431[] = "HTTP/1.0 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_500[] = "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_501[] = "HTTP/1.0 501 Not Implemented\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char response_505[] = "HTTP/1.0 505 HTTP Version Not Supported\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+static const char *response_for_parse_error(
+    const enum parse_http_request_status status, uint16_t *out_status_code, size_t *out_len) {
+    const char *response;
+    switch (status) {
+        case PARSE_E_BODY_TOO_LARGE:
+            response = response_413;
+            *out_status_code = 413;
+            *out_len = sizeof(response_413) - 1;
+            break;
+        case PARSE_E_HEADERS_TOO_LARGE:
+        case PARSE_E_TOO_MANY_HEADERS:
+            response = response_431;
+            *out_status_code = 431;
+            *out_len = sizeof(response_431) - 1;
+            break;
+        case PARSE_E_HTTP_METHOD_NOT_SUPPORTED:
+        case PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED:
+            response = response_501;
+            *out_status_code = 501;
+            *out_len = sizeof(response_501) - 1;
+            break;
+        case PARSE_E_HTTP_VERSION_NOT_SUPPORTED:
+            response = response_505;
+            *out_status_code = 505;
+            *out_len = sizeof(response_505) - 1;
+            break;
+        default:
+            response = response_400;
+            *out_status_code = 400;
+            *out_len = sizeof(response_400) - 1;
+            break;
+    }
+    return response;
+}
+
+// endregion canned responses
+
+// region connections
+
+static void connection_release_file(http_connection *connection) {
+    if (connection->file.release != nullptr) connection->file.release(connection->file.release_state);
+    connection->file = (http_file_body){};
+}
+
+static void connection_release_cached(http_connection *connection) {
+    http_cached_response_release(connection->cached);
+    connection->cached = nullptr;
+}
+
+static void connection_release_compressed(http_connection *connection) {
+    http_compressed_variant_release(connection->compressed);
+    connection->compressed = nullptr;
+}
+
+/**
+ * Gives every buffer back to the worker's pool while the connection has nothing in flight: between
+ * requests an idle keep-alive connection holds no memory beyond its slab object.
+ */
+static void connection_release_buffers(http_server_worker *worker, http_connection *connection) {
+    http_buffer_pool_release(&worker->buffers, connection->read_buf, connection->read_capacity);
+    connection->read_buf = nullptr;
+    connection->read_capacity = 0;
+    http_stream_parser_release_head(&connection->parser);
+    if (connection->arena.block != nullptr) {
+        http_arena_destroy(&connection->arena);
+        http_buffer_pool_release(&worker->buffers, connection->arena.block, connection->arena_block_size);
+        http_arena_init(&connection->arena, nullptr, 0);
+        connection->arena_block_size = 0;
+    }
+    http_buffer_pool_release(&worker->buffers, connection->stream_buf, connection->stream_buf_size);
+    connection->stream_buf = nullptr;
+    connection->stream_buf_size = 0;
+}
+
+/**
+ * Ends the request's time in flight, if it was admitted.
+ */
+static void connection_release_admission(http_server_worker *worker, http_connection *connection) {
+    if (!connection->admitted) return;
+    connection->admitted = false;
+    http_admission_complete(&worker->admission);
+}
+
+static void connection_close(http_server_worker *worker, http_connection *connection) {
+    if (connection->prev != nullptr) connection->prev->next = connection->next;
+    else worker->connections = connection->next;
+    if (connection->next != nullptr) connection->next->prev = connection->prev;
+
+    close(connection->source.fd); // also drops it from the epoll set
+    http_timer_disarm(&worker->timers, &connection->timer);
+    connection_release_admission(worker, connection);
+    http_metrics_count(HTTP_METRIC_CONNECTIONS_CLOSED, 1);
+    connection_release_file(connection);
+    connection_release_cached(connection);
+    connection_release_compressed(connection);
+    http_stream_parser_destroy(&connection->parser);
+    connection_release_buffers(worker, connection);
+    http_slab_free(&worker->connection_slab, connection);
+}
+
+static http_connection *connection_open(http_server_worker *worker, const int fd) {
+    http_connection *connection = http_slab_alloc(&worker->connection_slab);
+    if (connection == nullptr) return nullptr;
+    connection->source = (event_source){.kind = EVENT_SOURCE_CONNECTION, .fd = fd};
+    http_arena_init(&connection->arena, nullptr, 0);
+    http_stream_parser_init_pooled(
+        &connection->parser, worker->server->settings, worker->server->head_capacity, &worker->buffers);
+    worker->accepted = true;
+
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = &connection->source,
+    };
+    if (worker->io_engine == HTTP_IO_ENGINE_EPOLL && epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        http_slab_free(&worker->connection_slab, connection);
+        return nullptr;
+    }
+
+    connection->next = worker->connections;
+    if (worker->connections != nullptr) worker->connections->prev = connection;
+    worker->connections = connection;
+    connection->phase = CONNECTION_PHASE_IDLE;
+    http_timer_arm(
+        &worker->timers, &connection->timer, worker->now_ms + worker->server->timeouts[CONNECTION_PHASE_IDLE]);
+    http_metrics_count(HTTP_METRIC_CONNECTIONS_OPENED, 1);
+    return connection;
+}
+
+/**
+ * Backs the connection's arena with a pooled block, unless it already has one.
+ *
+ * @return false if the block cannot be acquired
+ */
+static bool connection_ready_arena(http_server_worker *worker, http_connection *connection) {
+    if (connection->arena.block != nullptr) return true;
+    void *block = http_buffer_pool_acquire(&worker->buffers, CONNECTION_ARENA_SIZE, &connection->arena_block_size);
+    if (block == nullptr) return false;
+    http_arena_init(&connection->arena, block, connection->arena_block_size);
+    return true;
+}
+
+/**
+ * Starts writing a canned response, after which the connection is closed.
+ */
+static void connection_start_writing(
+    http_connection *connection, const uint16_t status_code, const void *octets, const size_t len) {
+    http_metrics_count_response(status_code);
+    connection_release_file(connection);
+    connection_release_cached(connection);
+    connection_release_compressed(connection);
+    connection->state = CONNECTION_WRITING;
+    connection->keep_alive = false;
+    connection->write_iov[0] = (struct iovec){.iov_base = (void *) octets, .iov_len = len};
+    connection->write_iov_cnt = 1;
+    connection->write_iov_idx = 0;
+}
+
+/**
+ * Moves on to the next part of a file body sent in parts, once the current one has been sent: its
+ * prefix goes in `write_iov`, its range of the file in `file`.
+ *
+ * @return false if there is no next part, or the current one is not done yet
+ */
+static bool connection_next_file_part(http_connection *connection) {
+    if (connection->file.parts_cnt == 0 || connection->file.len > 0) return false;
+    const http_file_part *part = connection->file.parts;
+    connection->write_iov[0] = (struct iovec){.iov_base = (void *) part->prefix.ptr, .iov_len = part->prefix.len};
+    connection->write_iov_cnt = 1;
+    connection->write_iov_idx = 0;
+    connection->file.offset = part->offset;
+    connection->file.len = part->len;
+    connection->file.parts++;
+    connection->file.parts_cnt--;
+    return true;
+}
+
+/**
+ * Asks the handler's body producer for the next piece of a streamed body, or starts on the next part
+ * of a file body.
+ *
+ * @return false once the whole body has been produced and there is nothing more to write
+ */
+static bool connection_produce(http_connection *connection) {
+    if (connection->file.parts_cnt > 0) return connection_next_file_part(connection);
+    if (connection->producer == nullptr) return false;
+    http_response_writer *writer = &connection->writer;
+    http_response_writer_clear(writer);
+    const bool more = connection->producer(writer, connection->producer_state);
+    if (!more || writer->len == 0) {
+        if (more) {
+            // it would only be called again straight away: end the body (and the connection) instead
+            http_log_warn("body producer made no progress, ending the response\n");
+            connection->keep_alive = false;
+        }
+        http_response_writer_end(writer);
+        connection->producer = nullptr;
+    }
+    if (writer->len == 0) return false;
+    connection->write_iov[0] = (struct iovec){.iov_base = writer->buf, .iov_len = writer->len};
+    connection->write_iov_cnt = 1;
+    connection->write_iov_idx = 0;
+    return true;
+}
+
+/**
+ * Sends what is left of a file body, or of its current part.
+ *
+ * @retval 1 the whole file, or part, has been sent (or there is none)
+ * @retval 0 the socket cannot take any more right now
+ * @retval -1 the connection has to be closed
+ */
+static int connection_send_file(http_connection *connection) {
+    while (connection->file.len > 0) {
+        const ssize_t sent = sendfile(
+            connection->source.fd, connection->file.fd, &connection->file.offset, connection->file.len);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            http_log_warn("sendfile failed: %s\n", strerror(errno));
+            return -1;
+        }
+        if (sent == 0) {
+            // the file shrank since its size was announced in `Content-Length`
+            http_log_warn("file body ended %zu octets early\n", connection->file.len);
+            return -1;
+        }
+        connection->file.len -= (size_t) sent;
+        connection->sent = true;
+        http_metrics_count(HTTP_METRIC_BYTES_OUT, (uint64_t) sent);
+    }
+    if (connection->file.parts_cnt == 0) connection_release_file(connection);
+    return 1;
+}
+
+/**
+ * Skips the `written` octets of `write_iov` the socket has taken.
+ */
+static void connection_advance_iov(http_connection *connection, size_t written) {
+    while (written > 0) {
+        struct iovec *iov = &connection->write_iov[connection->write_iov_idx];
+        if (written < iov->iov_len) {
+            iov->iov_base = (uint8_t *) iov->iov_base + written;
+            iov->iov_len -= written;
+            written = 0;
+        } else {
+            written -= iov->iov_len;
+            connection->write_iov_idx++;
+        }
+    }
+}
+
+/**
+ * @retval 1 the whole response has been written
+ * @retval 0 the socket cannot take any more right now
+ * @retval -1 the connection has to be closed
+ */
+static int connection_write(http_connection *connection) {
+    // a file body in parts alternates between the prefix of a part and its range of the file
+    do {
+        while (connection->write_iov_idx < connection->write_iov_cnt || connection_produce(connection)) {
+            // with a file body to follow, let the head wait for the file's first octets to fill the segment
+            struct msghdr message = {
+                .msg_iov = connection->write_iov + connection->write_iov_idx,
+                .msg_iovlen = connection->write_iov_cnt - connection->write_iov_idx,
+            };
+            const ssize_t written = sendmsg(
+                connection->source.fd, &message, MSG_NOSIGNAL | (connection->file.len > 0 ? MSG_MORE : 0));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            connection->sent = true;
+            http_metrics_count(HTTP_METRIC_BYTES_OUT, (uint64_t) written);
+            connection_advance_iov(connection, (size_t) written);
+        }
+        const int sent = connection_send_file(connection);
+        if (sent <= 0) return sent;
+    } while (connection->file.parts_cnt > 0);
+    return 1;
+}
+
+/**
+ * @return the index of the header named `name` (case-insensitively), or -1 if there is none
+ */
+static ssize_t find_response_header(const http_response *response, const char *name) {
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        if (response->headers[i].name != nullptr && strcasecmp(response->headers[i].name, name) == 0) {
+            return (ssize_t) i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Adds `extra` after the header fragments `response` already has, in a new array allocated in `arena`.
+ *
+ * @return false if the arena ran out of memory
+ */
+static bool append_header_fragments(
+    http_arena *arena,
+    http_response *response,
+    const http_header_fragment *extra,
+    const size_t extra_cnt) {
+    if (extra_cnt == 0) return true;
+    const size_t fragments_cnt = response->header_fragments_cnt + extra_cnt;
+    http_header_fragment *fragments = http_arena_alloc(arena, fragments_cnt * sizeof(http_header_fragment));
+    if (fragments == nullptr) return false;
+    if (response->header_fragments_cnt > 0) {
+        memcpy(fragments, response->header_fragments, response->header_fragments_cnt * sizeof(http_header_fragment));
+    }
+    memcpy(fragments + response->header_fragments_cnt, extra, extra_cnt * sizeof(http_header_fragment));
+    response->header_fragments = fragments;
+    response->header_fragments_cnt = fragments_cnt;
+    return true;
+}
+
+/**
+ * Adds the header lines the server puts on every response it renders: `http_server_settings::header_fragments`.
+ * `Date` is added apart, once the response has been stored in the cache, which must not keep it.
+ *
+ * @return false if the arena ran out of memory
+ */
+static bool add_server_headers(http_arena *arena, const http_server_settings *settings, http_response *response) {
+    return append_header_fragments(arena, response, settings->header_fragments, settings->header_fragments_cnt);
+}
+
+/**
+ * Adds the framing headers the handler left out: `Content-Length` (so the client can tell where the
+ * body ends without the connection closing) or, for a streamed body, `Transfer-Encoding: chunked`,
+ * and `Connection` whenever the version's default does not already say what is going to happen to
+ * the connection. They are added as header fragments, allocated in `arena`.
+ *
+ * @return false if the arena ran out of memory
+ */
+static bool add_framing_headers(http_arena *arena, http_response *response, bool *keep_alive, bool *chunked) {
+    const ssize_t connection_idx = find_response_header(response, "Connection");
+    if (connection_idx >= 0 && strcasecmp(response->headers[connection_idx].value, "close") == 0) {
+        *keep_alive = false;
+    }
+    const bool has_content_length = find_response_header(response, "Content-Length") >= 0;
+    // a streamed body of unknown length is chunked, or (HTTP/1.0) ends when the connection does
+    *chunked = response->body_producer != nullptr && !has_content_length && response->version == HTTP_1_1;
+    if (response->body_producer != nullptr && !has_content_length && !*chunked) *keep_alive = false;
+    const bool add_content_length = !has_content_length && response->body_producer == nullptr;
+    const bool add_connection = connection_idx < 0 && (response->version == HTTP_1_1) != *keep_alive;
+
+    http_header_fragment framing[3];
+    size_t framing_cnt = 0;
+    if (*chunked) {
+        framing[framing_cnt++] = HTTP_HEADER_FRAGMENT("Transfer-Encoding", "chunked");
+    }
+    if (add_content_length) {
+        // "Content-Length: " 20 digits at most "\r\n"
+        char *line = http_arena_alloc(arena, 16 + 20 + 2 + 1);
+        if (line == nullptr) return false;
+        const size_t body_len = response->body_file.len > 0
+                                    ? response->body_file.len
+                                    : response->body != nullptr ? response->body_len : 0;
+        const int line_len = snprintf(line, 16 + 20 + 2 + 1, "Content-Length: %zu\r\n", body_len);
+        framing[framing_cnt++] = (http_header_fragment){.octets = line, .len = (size_t) line_len};
+    }
+    if (add_connection) {
+        framing[framing_cnt++] = *keep_alive
+                                     ? HTTP_HEADER_FRAGMENT("Connection", "keep-alive")
+                                     : HTTP_HEADER_FRAGMENT("Connection", "close");
+    }
+    return append_header_fragments(arena, response, framing, framing_cnt);
+}
+
+/**
+ * Starts writing the cached response to `request`, if there is one.
+ *
+ * @return false on a miss
+ */
+static bool connection_write_cached(
+    http_response_cache *cache,
+    const http_server_settings *settings,
+    http_connection *connection,
+    const http_request *request) {
+    const enum http_cache_lookup_result cached = http_response_cache_lookup(cache, request, &connection->cached);
+    if (cached == HTTP_CACHE_MISS) return false;
+    // the date of this second, copied: the thread's own line changes under a write still going on in the next
+    http_header_fragment date = {};
+    if (settings->send_date) {
+        const http_header_fragment now = http_date_header();
+        char *octets = http_arena_alloc(&connection->arena, now.len);
+        if (octets != nullptr) {
+            date = (http_header_fragment){.octets = memcpy(octets, now.octets, now.len), .len = now.len};
+        }
+    }
+    http_metrics_count_response(cached == HTTP_CACHE_NOT_MODIFIED ? 304 : 200);
+    connection->state = CONNECTION_WRITING;
+    connection->keep_alive = http_request_keep_alive(request);
+    connection->write_iov_cnt = http_cached_response_iov(
+        connection->cached, request->version, connection->keep_alive,
+        cached == HTTP_CACHE_NOT_MODIFIED, request->method == HEAD, date.len > 0 ? &date : nullptr,
+        connection->write_iov);
+    connection->write_iov_idx = 0;
+    return true;
+}
+
+static void connection_dispatch(http_server_worker *worker, http_connection *connection) {
+    if (!connection_ready_arena(worker, connection)) {
+        connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+        return;
+    }
+    // the stream parser has parsed the head already: the request borrows it, and the body from `read_buf`
+    const uint64_t parse_start = http_metrics_start();
+    http_request *request = nullptr;
+    const enum parse_http_request_status status = http_request_from_view(
+        &connection->arena,
+        connection->parser.head,
+        &connection->parser.request,
+        connection->body_len > 0 ? connection->read_buf + connection->read_start + connection->body_offset : nullptr,
+        connection->body_len,
+        &request);
+    http_metrics_observe_since(HTTP_METRIC_PARSE_TIME, parse_start);
+    if (status == PARSE_E_ALLOC_MEM_FOR_HEADERS) {
+        connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+        return;
+    }
+    if (status != PARSE_OK) {
+        uint16_t status_code = 0;
+        size_t len = 0;
+        const char *response = response_for_parse_error(status, &status_code, &len);
+        connection_start_writing(connection, status_code, response, len);
+        return;
+    }
+
+    http_metrics_count(HTTP_METRIC_REQUESTS, 1);
+
+    http_response_cache *cache = worker->server->settings->response_cache;
+    if (cache != nullptr && connection_write_cached(cache, worker->server->settings, connection, request)) {
+        http_metrics_count(HTTP_METRIC_CACHE_HITS, 1);
+        return;
+    }
+
+    http_response response = {.version = request->version};
+    const uint64_t handler_start = http_metrics_start();
+    worker->server->handler(request, &response, worker->server->user_data);
+    http_metrics_observe_since(HTTP_METRIC_HANDLER_TIME, handler_start);
+    if (!add_server_headers(&connection->arena, worker->server->settings, &response)) {
+        connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+        return;
+    }
+    http_compressor *compressor = worker->server->settings->compressor;
+    if (compressor != nullptr && !http_compress_response(compressor, request, &response, &connection->compressed)) {
+        connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+        return;
+    }
+    // a stored response goes out as the cache renders it, so the first client sees the same `ETag` as the rest
+    if (cache != nullptr && http_response_cache_store(cache, request, &response)
+        && connection_write_cached(cache, worker->server->settings, connection, request)) {
+        return;
+    }
+    if (worker->server->settings->send_date) {
+        const http_header_fragment date = http_date_header();
+        if (!append_header_fragments(&connection->arena, &response, &date, 1)) {
+            connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+            return;
+        }
+    }
+
+    bool keep_alive = http_request_keep_alive(request);
+    bool chunked = false;
+    connection->file = response.body_file;
+    // `len` is that of the whole body: the first part starts once the head has been written
+    if (connection->file.parts_cnt > 0) connection->file.len = 0;
+    if (response.body_file.len > 0) {
+        response.body = nullptr;
+        response.body_len = 0;
+        response.body_producer = nullptr;
+    } else if (response.body_producer != nullptr) {
+        response.body = nullptr;
+        response.body_len = 0;
+        if (connection->stream_buf == nullptr) {
+            connection->stream_buf = http_buffer_pool_acquire(
+                &worker->buffers, CONNECTION_STREAM_BUFFER_SIZE, &connection->stream_buf_size);
+        }
+        if (connection->stream_buf == nullptr) {
+            connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+            return;
+        }
+    }
+    size_t iov_cnt = 0;
+    const uint64_t render_start = http_metrics_start();
+    if (!add_framing_headers(&connection->arena, &response, &keep_alive, &chunked)
+        || render_http_response_iov(worker->server->settings, &connection->arena, &response, connection->write_iov, &iov_cnt)
+        != RENDER_OK) {
+        connection_start_writing(connection, 500, response_500, sizeof(response_500) - 1);
+        return;
+    }
+    http_metrics_observe_since(HTTP_METRIC_RENDER_TIME, render_start);
+    http_metrics_count_response(response.status_code);
+    connection->state = CONNECTION_WRITING;
+    connection->keep_alive = keep_alive;
+    // HEAD: the same head as the GET would get, but never the body
+    connection->write_iov_cnt = request->method == HEAD ? 1 : iov_cnt;
+    connection->write_iov_idx = 0;
+    if (request->method == HEAD) connection_release_file(connection);
+    if (response.body_producer != nullptr && request->method != HEAD) {
+        connection->producer = response.body_producer;
+        connection->producer_state = response.body_producer_state;
+        http_response_writer_init(&connection->writer, connection->stream_buf, connection->stream_buf_size, chunked);
+    }
+}
+
+/**
+ * Has the worker's admission control decide on a request whose head has just arrived: a shed one is
+ * answered right away, before any of its body is read.
+ */
+static void connection_admit(http_server_worker *worker, http_connection *connection) {
+    if (worker->server->settings->admission == nullptr) return;
+    const http_admission_verdict verdict = http_admission_admit(
+        &worker->admission, http_admission_clock_ns(), worker->queued_ns);
+    if (verdict == HTTP_ADMISSION_ADMIT) {
+        connection->admitted = true;
+        return;
+    }
+    http_metrics_count(HTTP_METRIC_SHED_REQUESTS, 1);
+    connection_start_writing(connection, 503, worker->server->response_503, worker->server->response_503_len);
+}
+
+/**
+ * Feeds the octets not parsed yet, `read_buf[parsed_len, read_len)`, to the request parser.
+ */
+static void connection_parse(http_server_worker *worker, http_connection *connection) {
+    while (connection->state == CONNECTION_READING && connection->parsed_len < connection->read_len) {
+        size_t consumed = 0;
+        http_slice body_chunk = {};
+        const enum http_stream_parse_result result = http_stream_parser_feed(
+            &connection->parser,
+            connection->read_buf + connection->parsed_len,
+            connection->read_len - connection->parsed_len,
+            &consumed,
+            &body_chunk);
+        connection->parsed_len += consumed;
+        if (result == HTTP_STREAM_MALFORMED) {
+            uint16_t status_code = 0;
+            size_t len = 0;
+            const char *response = response_for_parse_error(connection->parser.error, &status_code, &len);
+            connection_start_writing(connection, status_code, response, len);
+        } else if (result == HTTP_STREAM_HEADERS_COMPLETE) {
+            connection->body_offset = connection->parsed_len - connection->read_start;
+            connection->body_len = 0;
+            connection_admit(worker, connection);
+        } else if (result == HTTP_STREAM_BODY_CHUNK) {
+            // a `Content-Length` body is where it arrived already, chunk data moves down over the framing before it
+            uint8_t *body_end =
+                    connection->read_buf + connection->read_start + connection->body_offset + connection->body_len;
+            if (body_chunk.ptr != body_end) memmove(body_end, body_chunk.ptr, body_chunk.len);
+            connection->body_len += body_chunk.len;
+        } else if (result == HTTP_STREAM_MESSAGE_COMPLETE) {
+            connection_dispatch(worker, connection);
+        }
+    }
+    if (connection->state == CONNECTION_READING
+        && connection->parser.state == HTTP_STREAM_STATE_BODY
+        && !connection->parser.chunked
+        && connection->parser.body_remaining == 0) {
+        // a request without a body completes without any further octets
+        size_t consumed = 0;
+        http_slice body_chunk = {};
+        if (http_stream_parser_feed(&connection->parser, nullptr, 0, &consumed, &body_chunk)
+            == HTTP_STREAM_MESSAGE_COMPLETE) {
+            connection_dispatch(worker, connection);
+        }
+    }
+}
+
+/**
+ * Makes room for more octets at the end of `read_buf`: by dropping the requests already answered if
+ * that frees any, by moving to a larger pooled buffer otherwise.
+ *
+ * @return false if the buffer is as large as a request may be, or cannot be acquired
+ */
+static bool connection_reserve_read(http_server_worker *worker, http_connection *connection) {
+    if (connection->read_len == connection->read_capacity && connection->read_start > 0) {
+        connection->read_len -= connection->read_start;
+        connection->parsed_len -= connection->read_start;
+        memmove(connection->read_buf, connection->read_buf + connection->read_start, connection->read_len);
+        connection->read_start = 0;
+    }
+    if (connection->read_len < connection->read_capacity) return true;
+    const size_t limit = worker->server->head_capacity + worker->server->settings->max_body_length;
+    if (connection->read_capacity >= limit) return false;
+    size_t wanted = connection->read_capacity > 0 ? connection->read_capacity * 2 : CONNECTION_INITIAL_BUFFER_SIZE;
+    if (wanted > limit) wanted = limit;
+    size_t new_capacity = 0;
+    uint8_t *new_buf = http_buffer_pool_acquire(&worker->buffers, wanted, &new_capacity);
+    if (new_buf == nullptr) return false;
+    if (connection->read_len > 0) memcpy(new_buf, connection->read_buf, connection->read_len);
+    http_buffer_pool_release(&worker->buffers, connection->read_buf, connection->read_capacity);
+    connection->read_buf = new_buf;
+    connection->read_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * Reads from the socket until a whole request has arrived and its response is ready to be written.
+ *
+ * @retval 1 a response is ready to be written
+ * @retval 0 the socket has nothing more to read right now
+ * @retval -1 the connection has to be closed
+ */
+static int connection_read(http_server_worker *worker, http_connection *connection) {
+    while (connection->state == CONNECTION_READING) {
+        if (!connection_reserve_read(worker, connection)) return -1;
+        const ssize_t received = recv(
+            connection->source.fd,
+            connection->read_buf + connection->read_len,
+            connection->read_capacity - connection->read_len,
+            0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+            // nothing buffered, nothing in flight: wait for the next request without holding any buffer
+            if (connection->read_len == 0) connection_release_buffers(worker, connection);
+            return 0;
+        }
+        if (received == 0) return -1;
+        connection->received = true;
+        http_metrics_count(HTTP_METRIC_BYTES_IN, (uint64_t) received);
+        connection->read_len += (size_t) received;
+        connection_parse(worker, connection);
+    }
+    return 1;
+}
+
+/**
+ * Gets a persistent connection ready for its next request, which may already be (partly) buffered
+ * if the client pipelined it: the parser picks it up right where the previous request ended.
+ */
+static void connection_next_request(http_server_worker *worker, http_connection *connection) {
+    connection_release_admission(worker, connection);
+    connection_release_cached(connection);
+    connection_release_compressed(connection);
+    http_arena_reset(&connection->arena);
+    http_stream_parser_reset(&connection->parser);
+    connection->state = CONNECTION_READING;
+    connection->write_iov_cnt = 0;
+    connection->write_iov_idx = 0;
+    connection->producer = nullptr;
+    connection->read_start = connection->parsed_len;
+    if (connection->read_start == connection->read_len) {
+        connection->read_start = connection->parsed_len = connection->read_len = 0;
+    }
+    connection_parse(worker, connection);
+}
+
+/**
+ * Drives the connection as far as the socket allows: reading requests, writing their responses and,
+ * for persistent connections, moving on to the next request.
+ *
+ * @return false if the connection has to be closed
+ */
+static bool connection_on_ready(http_server_worker *worker, http_connection *connection) {
+    while (true) {
+        if (connection->state == CONNECTION_READING) {
+            const int read = connection_read(worker, connection);
+            if (read <= 0) return read == 0;
+        }
+        const int written = connection_write(connection);
+        if (written <= 0) return written == 0;
+        if (!connection->keep_alive) return false;
+        connection_next_request(worker, connection);
+    }
+}
+
+/**
+ * Re-arms the connection's timer for what it waits on now, once it has done all it could: afresh when
+ * that changes, and whenever octets moved while a body is read or a response written, which only time
+ * out when stalled. A head has to arrive whole within its timeout however it trickles in.
+ */
+static void connection_update_timer(http_server_worker *worker, http_connection *connection) {
+    connection_phase phase;
+    bool progressed = false;
+    if (connection->state == CONNECTION_WRITING) {
+        phase = CONNECTION_PHASE_WRITE;
+        progressed = connection->sent;
+    } else if (connection->parser.state != HTTP_STREAM_STATE_HEAD) {
+        phase = CONNECTION_PHASE_BODY;
+        progressed = connection->received;
+    } else {
+        phase = connection->read_len > connection->read_start ? CONNECTION_PHASE_HEAD : CONNECTION_PHASE_IDLE;
+    }
+    connection->received = false;
+    connection->sent = false;
+    if (phase == connection->phase && !progressed && http_timer_armed(&connection->timer)) return;
+    connection->phase = phase;
+    http_timer_arm(&worker->timers, &connection->timer, worker->now_ms + worker->server->timeouts[phase]);
+}
+
+/**
+ * @return the connection whose `timer` this is
+ */
+static http_connection *connection_of_timer(http_timer *timer) {
+    return (http_connection *) ((uint8_t *) timer - offsetof(http_connection, timer));
+}
+
+/**
+ * Tells a client that did not get its request across in time so, if the socket takes it straight
+ * away: one this slow is not waited for any further. The connection is to be closed next.
+ */
+static void connection_time_out(const http_connection *connection) {
+    http_metrics_count(HTTP_METRIC_TIMEOUTS, 1);
+    if (connection->phase != CONNECTION_PHASE_HEAD && connection->phase != CONNECTION_PHASE_BODY) return;
+    http_metrics_count_response(408);
+    if (send(connection->source.fd, response_408, sizeof(response_408) - 1, MSG_DONTWAIT | MSG_NOSIGNAL) > 0) {
+        http_metrics_count(HTTP_METRIC_BYTES_OUT, sizeof(response_408) - 1);
+    }
+}
+
+static void connection_on_timeout(http_timer *timer, void *worker) {
+    http_connection *connection = connection_of_timer(timer);
+    connection_time_out(connection);
+    connection_close(worker, connection);
+}
+
+// endregion connections
+
+static void worker_accept(http_server_worker *worker) {
+    while (true) {
+        const int fd = accept4(worker->listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                http_log_error("accept failed: %s\n", strerror(errno));
+            }
+            return;
+        }
+        if (connection_open(worker, fd) == nullptr) {
+            http_log_error("cannot allocate a new connection\n");
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Binds `worker`'s listener to `addr` (whose port is filled in with the actual port on return).
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int worker_open(http_server_worker *worker, struct sockaddr_in *addr) {
+    worker->listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    worker->wakeup.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    const int on = 1;
+    socklen_t addr_len = sizeof(*addr);
+    struct epoll_event listener_event = {.events = EPOLLIN | EPOLLET, .data.ptr = &worker->listener};
+    struct epoll_event wakeup_event = {.events = EPOLLIN, .data.ptr = &worker->wakeup};
+    if (worker->listener.fd < 0 || worker->wakeup.fd < 0 || worker->epoll_fd < 0
+        || setsockopt(worker->listener.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+        || setsockopt(worker->listener.fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0
+        || bind(worker->listener.fd, (struct sockaddr *) addr, sizeof(*addr)) != 0
+        || listen(worker->listener.fd, SOMAXCONN) != 0
+        || getsockname(worker->listener.fd, (struct sockaddr *) addr, &addr_len) != 0
+        || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listener.fd, &listener_event) != 0
+        || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wakeup.fd, &wakeup_event) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void worker_close(http_server_worker *worker) {
+    while (worker->connections != nullptr) {
+        connection_close(worker, worker->connections);
+    }
+    if (worker->listener.fd >= 0) close(worker->listener.fd);
+    if (worker->wakeup.fd >= 0) close(worker->wakeup.fd);
+    if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+    http_buffer_pool_destroy(&worker->buffers);
+    http_slab_destroy(&worker->connection_slab);
+}
+
+/**
+ * Reads the clocks once the loop's wait is over; `waited` is false if the wait returned right away, with
+ * I/O that had piled up while the loop was busy with its last iteration.
+ */
+static void worker_wake(http_server_worker *worker, const bool waited) {
+    worker->now_ms = http_timer_clock_ms();
+    if (worker->server->settings->admission == nullptr) return;
+    const uint64_t now_ns = http_admission_clock_ns();
+    const uint64_t events_since_ns = waited ? now_ns : worker->wake_ns;
+    worker->queued_ns = !waited && worker->accepted ? worker->events_since_ns : events_since_ns;
+    worker->events_since_ns = events_since_ns;
+    worker->wake_ns = now_ns;
+    worker->accepted = false;
+}
+
+/**
+ * @return whether the loop should check for I/O that piled up meanwhile before waiting: only worth a
+ * system call if its last iteration had anything to do, and only telling with admission control
+ */
+static bool worker_should_poll(const http_server_worker *worker, const bool busy) {
+    return busy && worker->server->settings->admission != nullptr;
+}
+
+/**
+ * @return how long the worker's loop may wait for I/O before its next timer is due, -1 for as long as it takes
+ */
+static int worker_wait_timeout(const http_server_worker *worker) {
+    if (worker->timers.armed == 0) return -1;
+    return (int) http_timer_wheel_next(&worker->timers, INT_MAX);
+}
+
+/**
+ * Pins the calling thread to the `index`-th CPU (wrapping around) of the ones it is allowed to run on.
+ */
+static void pin_to_cpu(const size_t index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    const int allowed_cnt = CPU_COUNT(&allowed);
+    if (allowed_cnt <= 0) return;
+    int nth = (int) (index % (size_t) allowed_cnt);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        if (nth-- > 0) continue;
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(cpu, &pinned);
+        const int err = pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+        if (err != 0) {
+            http_log_warn("cannot pin worker %zu to cpu %d: %s\n", index, cpu, strerror(err));
+        }
+        return;
+    }
+}
+
+// region io_uring engine
+
+#ifdef TINY_HTTP_IO_URING
+
+/**
+ * What a completion completes; the user data of every submission is the connection it is for (nullptr
+ * for the listener and the wakeup) with the operation in its low bits, which slab objects always leave clear.
+ */
+typedef enum uring_op {
+    URING_OP_ACCEPT = 1,
+    URING_OP_WAKEUP = 2,
+    URING_OP_RECV = 3,
+    URING_OP_SEND = 4,
+    URING_OP_POLL = 5,
+    URING_OP_CANCEL = 6,
+} uring_op;
+
+#define URING_OP_MASK 7
+
+static uint64_t uring_user_data(const http_connection *connection, const uring_op op) {
+    return (uint64_t) (uintptr_t) connection | op;
+}
+
+/**
+ * @return an entry for an operation on `connection` (nullptr for one of the worker's own), counted as
+ * in flight until its last completion arrives, or nullptr if the submission queue is stuck
+ */
+static struct io_uring_sqe *uring_submission(http_server_worker *worker, http_connection *connection) {
+    struct io_uring_sqe *sqe = http_uring_get_sqe(&worker->ring);
+    if (sqe == nullptr) return nullptr;
+    worker->uring_in_flight++;
+    if (connection != nullptr) connection->uring_ops++;
+    return sqe;
+}
+
+static bool uring_arm_accept(http_server_worker *worker) {
+    struct io_uring_sqe *sqe = uring_submission(worker, nullptr);
+    if (sqe == nullptr) return false;
+    http_uring_prep_accept_multishot(
+        sqe, worker->listener.fd, SOCK_NONBLOCK | SOCK_CLOEXEC, uring_user_data(nullptr, URING_OP_ACCEPT));
+    return true;
+}
+
+static bool uring_arm_wakeup(http_server_worker *worker) {
+    struct io_uring_sqe *sqe = uring_submission(worker, nullptr);
+    if (sqe == nullptr) return false;
+    http_uring_prep_read(
+        sqe, worker->wakeup.fd, &worker->wakeup_value, sizeof(worker->wakeup_value),
+        uring_user_data(nullptr, URING_OP_WAKEUP));
+    return true;
+}
+
+static bool uring_arm_recv(http_server_worker *worker, http_connection *connection) {
+    struct io_uring_sqe *sqe = uring_submission(worker, connection);
+    if (sqe == nullptr) return false;
+    http_uring_prep_recv_multishot(
+        sqe, &worker->ring, connection->source.fd, uring_user_data(connection, URING_OP_RECV));
+    return true;
+}
+
+/**
+ * Sends what is left of `write_iov`, head and body in the one operation.
+ */
+static bool uring_send(http_server_worker *worker, http_connection *connection) {
+    struct io_uring_sqe *sqe = uring_submission(worker, connection);
+    if (sqe == nullptr) return false;
+    connection->write_msg = (struct msghdr){
+        .msg_iov = connection->write_iov + connection->write_iov_idx,
+        .msg_iovlen = connection->write_iov_cnt - connection->write_iov_idx,
+    };
+    // with a file body to follow, let the head wait for the file's first octets to fill the segment
+    http_uring_prep_sendmsg(
+        sqe, connection->source.fd, &connection->write_msg,
+        MSG_NOSIGNAL | (connection->file.len > 0 ? MSG_MORE : 0), uring_user_data(connection, URING_OP_SEND));
+    connection->uring_writing = true;
+    return true;
+}
+
+/**
+ * Waits for the socket to take more of a file body, which goes out with `sendfile` as on epoll.
+ */
+static bool uring_poll_writable(http_server_worker *worker, http_connection *connection) {
+    struct io_uring_sqe *sqe = uring_submission(worker, connection);
+    if (sqe == nullptr) return false;
+    http_uring_prep_poll(sqe, connection->source.fd, POLLOUT, uring_user_data(connection, URING_OP_POLL));
+    connection->uring_writing = true;
+    return true;
+}
+
+/**
+ * Closes the connection once nothing is in flight for it any more: until then it is shut down, which
+ * ends whatever is still in flight.
+ */
+static void uring_connection_close(http_server_worker *worker, http_connection *connection) {
+    if (connection->uring_ops == 0) {
+        connection_close(worker, connection);
+        return;
+    }
+    if (connection->uring_closing) return;
+    connection->uring_closing = true;
+    http_timer_disarm(&worker->timers, &connection->timer);
+    shutdown(connection->source.fd, SHUT_RDWR);
+}
+
+/**
+ * Drives the connection as far as it goes without waiting: writing the response that is ready and, for
+ * persistent connections, moving on to the next request, which may have been pipelined already.
+ */
+static void uring_connection_advance(http_server_worker *worker, http_connection *connection) {
+    while (!connection->uring_writing) {
+        if (connection->state == CONNECTION_READING) {
+            // nothing buffered, nothing in flight: wait for the next request without holding any buffer
+            if (connection->read_len == 0) connection_release_buffers(worker, connection);
+            break;
+        }
+        if (connection->write_iov_idx < connection->write_iov_cnt || connection_produce(connection)) {
+            if (!uring_send(worker, connection)) {
+                uring_connection_close(worker, connection);
+                return;
+            }
+            break;
+        }
+        const int sent = connection_send_file(connection);
+        if (sent == 0) {
+            if (!uring_poll_writable(worker, connection)) {
+                uring_connection_close(worker, connection);
+                return;
+            }
+            break;
+        }
+        if (sent < 0) {
+            uring_connection_close(worker, connection);
+            return;
+        }
+        // on to the next part of the file body
+        if (connection->file.parts_cnt > 0) continue;
+        if (!connection->keep_alive) {
+            uring_connection_close(worker, connection);
+            return;
+        }
+        connection_next_request(worker, connection);
+    }
+    connection_update_timer(worker, connection);
+}
+
+static void uring_on_accept(http_server_worker *worker, const struct io_uring_cqe *cqe) {
+    if (cqe->res < 0) {
+        if (cqe->res != -ECANCELED) http_log_error("accept failed: %s\n", strerror(-cqe->res));
+    } else if (worker->uring_stopping) {
+        close(cqe->res);
+    } else {
+        http_connection *connection = connection_open(worker, cqe->res);
+        if (connection == nullptr) {
+            http_log_error("cannot allocate a new connection\n");
+            close(cqe->res);
+        } else if (!uring_arm_recv(worker, connection)) {
+            connection_close(worker, connection);
+        }
+    }
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0 && !worker->uring_stopping && !uring_arm_accept(worker)) {
+        http_log_error("cannot accept any more connections on worker %zu\n", worker->index);
+    }
+}
+
+/**
+ * Appends `len` received octets to `read_buf`, which grows as it does for epoll.
+ *
+ * @return false if the request grew too large
+ */
+static bool uring_append_received(
+    http_server_worker *worker, http_connection *connection, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (!connection_reserve_read(worker, connection)) return false;
+        const size_t room = connection->read_capacity - connection->read_len;
+        const size_t copied = len < room ? len : room;
+        memcpy(connection->read_buf + connection->read_len, data, copied);
+        connection->read_len += copied;
+        data += copied;
+        len -= copied;
+    }
+    return true;
+}
+
+static void uring_on_recv(http_server_worker *worker, http_connection *connection, const struct io_uring_cqe *cqe) {
+    bool appended = true;
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        if (cqe->res > 0 && !connection->uring_closing) {
+            connection->received = true;
+            http_metrics_count(HTTP_METRIC_BYTES_IN, (uint64_t) cqe->res);
+            appended = uring_append_received(worker, connection, http_uring_buffer(&worker->ring, cqe), (size_t) cqe->res);
+        }
+        http_uring_recycle_buffer(&worker->ring, cqe);
+    }
+    if (connection->uring_closing) {
+        if (connection->uring_ops == 0) connection_close(worker, connection);
+        return;
+    }
+    if (cqe->res == 0) {
+        // the client is done sending: finish the response under way, if any, then close
+        connection->keep_alive = false;
+        if (connection->state == CONNECTION_READING) uring_connection_close(worker, connection);
+        else uring_connection_advance(worker, connection);
+        return;
+    }
+    // out of buffers (all of them waiting in this batch of completions, which gives them back): re-arm
+    if ((cqe->res < 0 && cqe->res != -ENOBUFS) || !appended) {
+        uring_connection_close(worker, connection);
+        return;
+    }
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0 && !uring_arm_recv(worker, connection)) {
+        uring_connection_close(worker, connection);
+        return;
+    }
+    // while a response is being written, what the client pipelined waits in `read_buf` for its turn
+    if (connection->state == CONNECTION_READING) connection_parse(worker, connection);
+    uring_connection_advance(worker, connection);
+}
+
+/**
+ * A send or a poll for the socket to take more has completed.
+ */
+static void uring_on_written(
+    http_server_worker *worker, http_connection *connection, const struct io_uring_cqe *cqe, const uring_op op) {
+    connection->uring_writing = false;
+    if (connection->uring_closing) {
+        if (connection->uring_ops == 0) connection_close(worker, connection);
+        return;
+    }
+    if (cqe->res < 0) {
+        uring_connection_close(worker, connection);
+        return;
+    }
+    if (op == URING_OP_SEND) {
+        if (cqe->res > 0) connection->sent = true;
+        http_metrics_count(HTTP_METRIC_BYTES_OUT, (uint64_t) cqe->res);
+        connection_advance_iov(connection, (size_t) cqe->res);
+    }
+    uring_connection_advance(worker, connection);
+}
+
+static void uring_on_timeout(http_timer *timer, void *worker) {
+    http_connection *connection = connection_of_timer(timer);
+    connection_time_out(connection);
+    uring_connection_close(worker, connection);
+}
+
+/**
+ * Stops accepting and closes every connection; the loop goes on until their completions have drained.
+ */
+static void uring_stop(http_server_worker *worker) {
+    worker->uring_stopping = true;
+    struct io_uring_sqe *sqe = uring_submission(worker, nullptr);
+    if (sqe != nullptr) {
+        http_uring_prep_cancel(sqe, uring_user_data(nullptr, URING_OP_ACCEPT), uring_user_data(nullptr, URING_OP_CANCEL));
+    }
+    http_connection *connection = worker->connections;
+    while (connection != nullptr) {
+        http_connection *next = connection->next;
+        uring_connection_close(worker, connection);
+        connection = next;
+    }
+}
+
+/**
+ * @return false once the server has been asked to stop
+ */
+static bool uring_on_completion(http_server_worker *worker, const struct io_uring_cqe *cqe) {
+    const uring_op op = (uring_op) (cqe->user_data & URING_OP_MASK);
+    http_connection *connection = (http_connection *) (uintptr_t) (cqe->user_data & ~(uint64_t) URING_OP_MASK);
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+        worker->uring_in_flight--;
+        if (connection != nullptr) connection->uring_ops--;
+    }
+    switch (op) {
+        case URING_OP_ACCEPT:
+            uring_on_accept(worker, cqe);
+            break;
+        case URING_OP_WAKEUP:
+            return false;
+        case URING_OP_RECV:
+            uring_on_recv(worker, connection, cqe);
+            break;
+        case URING_OP_SEND:
+        case URING_OP_POLL:
+            uring_on_written(worker, connection, cqe, op);
+            break;
+        case URING_OP_CANCEL:
+            break;
+    }
+    return true;
+}
+
+/**
+ * The io_uring counterpart of `worker_run_epoll`: every operation the completions of one iteration
+ * call for is submitted with the next iteration's wait, in a single system call.
+ */
+static int worker_run_uring(http_server_worker *worker) {
+    if (!uring_arm_accept(worker) || !uring_arm_wakeup(worker)) {
+        http_log_error("cannot arm the listener of worker %zu\n", worker->index);
+        return -1;
+    }
+    struct io_uring_cqe completions[SERVER_MAX_EVENTS];
+    size_t reaped = 0;
+    while (!worker->uring_stopping || worker->uring_in_flight > 0) {
+        const bool polled = worker_should_poll(worker, reaped > 0);
+        int entered = polled ? http_uring_submit_and_wait(&worker->ring, 0) : 0;
+        const bool waited = !polled || !http_uring_ready(&worker->ring);
+        if (entered == 0 && waited) entered = http_uring_submit_and_wait(&worker->ring, worker_wait_timeout(worker));
+        if (entered != 0) {
+            http_log_error("io_uring_enter failed: %s\n", strerror(errno));
+            return -1;
+        }
+        worker_wake(worker, waited);
+        reaped = http_uring_reap(&worker->ring, completions, SERVER_MAX_EVENTS);
+        for (size_t i = 0; i < reaped; i++) {
+            if (!uring_on_completion(worker, &completions[i])) uring_stop(worker);
+        }
+        http_timer_wheel_advance(&worker->timers, worker->now_ms, uring_on_timeout, worker);
+    }
+    return 0;
+}
+
+/**
+ * Sets up the worker's ring and its receive buffers, on the thread that is going to run it.
+ *
+ * @return 0 on success, -1 with `errno` set on failure
+ */
+static int uring_open(http_server_worker *worker) {
+    if (http_uring_init(&worker->ring, URING_QUEUE_ENTRIES, URING_COMPLETION_ENTRIES) != 0) return -1;
+    if (http_uring_setup_buffers(&worker->ring, URING_RECV_BUFFER_GROUP, URING_RECV_BUFFERS, URING_RECV_BUFFER_SIZE)
+        != 0) {
+        const int err = errno;
+        http_uring_destroy(&worker->ring);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+#endif //TINY_HTTP_IO_URING
+
+// endregion io_uring engine
+
+static int worker_run_epoll(http_server_worker *worker) {
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int ready = 0;
+    while (true) {
+        const bool polled = worker_should_poll(worker, ready > 0);
+        if (polled) ready = epoll_wait(worker->epoll_fd, events, SERVER_MAX_EVENTS, 0);
+        const bool waited = !polled || ready == 0;
+        if (waited) ready = epoll_wait(worker->epoll_fd, events, SERVER_MAX_EVENTS, worker_wait_timeout(worker));
+        worker_wake(worker, waited);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            http_log_error("epoll_wait failed: %s\n", strerror(errno));
+            return -1;
+        }
+        for (int i = 0; i < ready; i++) {
+            event_source *source = events[i].data.ptr;
+            switch (source->kind) {
+                case EVENT_SOURCE_WAKEUP:
+                    return 0;
+                case EVENT_SOURCE_LISTENER:
+                    worker_accept(worker);
+                    break;
+                case EVENT_SOURCE_CONNECTION: {
+                    http_connection *connection = (http_connection *) source;
+                    const bool keep_open = (events[i].events & (EPOLLERR | EPOLLHUP)) == 0
+                                           && connection_on_ready(worker, connection);
+                    if (keep_open) connection_update_timer(worker, connection);
+                    else connection_close(worker, connection);
+                    break;
+                }
+            }
+        }
+        // only once every ready connection has been handled: expiring one closes it
+        http_timer_wheel_advance(&worker->timers, worker->now_ms, connection_on_timeout, worker);
+    }
+}
+
+static int worker_run(http_server_worker *worker) {
+    if (worker->server->settings->pin_workers) pin_to_cpu(worker->index);
+    worker_wake(worker, true);
+    http_timer_wheel_init(&worker->timers, worker->now_ms);
+#ifdef TINY_HTTP_IO_URING
+    if (worker->io_engine == HTTP_IO_ENGINE_IO_URING) {
+        if (uring_open(worker) == 0) {
+            const int result = worker_run_uring(worker);
+            http_uring_destroy(&worker->ring);
+            return result;
+        }
+        // the listener and the wakeup are registered with epoll all along, so it can take over
+        http_log_warn("cannot set up io_uring for worker %zu, falling back to epoll: %s\n",
+                       worker->index, strerror(errno));
+        worker->io_engine = HTTP_IO_ENGINE_EPOLL;
+    }
+#endif
+    return worker_run_epoll(worker);
+}
+
+static void *worker_thread_main(void *worker) {
+    return (void *) (intptr_t) worker_run(worker);
+}
+
+http_server *http_server_create(
+    const http_server_settings *settings,
+    const char *host,
+    const uint16_t port,
+    const http_request_handler handler,
+    void *user_data) {
+    http_server *server = calloc(1, sizeof(http_server));
+    if (server == nullptr) return nullptr;
+    const size_t worker_count = settings->worker_count > 0 ? settings->worker_count : 1;
+    *server = (http_server){
+        .settings = settings,
+        .handler = handler,
+        .user_data = user_data,
+        // request line + every header at its longest
+        .head_capacity = settings->max_url_length + 32
+                         + HTTP_REQUEST_VIEW_MAX_HEADERS
+                         * (settings->max_header_name_length + settings->max_header_value_length + 4),
+        .timeouts = {
+            [CONNECTION_PHASE_IDLE] = settings->idle_timeout_ms > 0 ? settings->idle_timeout_ms : SERVER_DEFAULT_IDLE_TIMEOUT_MS,
+            [CONNECTION_PHASE_HEAD] = settings->header_timeout_ms > 0 ? settings->header_timeout_ms : SERVER_DEFAULT_HEADER_TIMEOUT_MS,
+            [CONNECTION_PHASE_BODY] = settings->body_timeout_ms > 0 ? settings->body_timeout_ms : SERVER_DEFAULT_BODY_TIMEOUT_MS,
+            [CONNECTION_PHASE_WRITE] = settings->write_timeout_ms > 0 ? settings->write_timeout_ms : SERVER_DEFAULT_WRITE_TIMEOUT_MS,
+        },
+        .io_engine = settings->io_engine,
+        .workers = calloc(worker_count, sizeof(http_server_worker)),
+        .worker_count = worker_count,
+    };
+    if (server->workers == nullptr) {
+        free(server);
+        return nullptr;
+    }
+    if (settings->admission != nullptr) {
+        const uint32_t retry_after_s = settings->admission->retry_after_s > 0 ? settings->admission->retry_after_s : 1;
+        server->response_503_len = (size_t) snprintf(
+            server->response_503, sizeof(server->response_503),
+            "HTTP/1.0 503 Service Unavailable\r\nRetry-After: %u\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+            retry_after_s);
+    }
+    if (server->io_engine == HTTP_IO_ENGINE_IO_URING && !http_uring_supported()) {
+        http_log_warn("io_uring is not supported here, falling back to epoll\n");
+        server->io_engine = HTTP_IO_ENGINE_EPOLL;
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        server->workers[i] = (http_server_worker){
+            .server = server,
+            .index = i,
+            .listener = {.kind = EVENT_SOURCE_LISTENER, .fd = -1},
+            .wakeup = {.kind = EVENT_SOURCE_WAKEUP, .fd = -1},
+            .epoll_fd = -1,
+            .io_engine = server->io_engine,
+        };
+        if (settings->admission != nullptr) {
+            http_admission_init(&server->workers[i].admission, settings->admission, http_admission_clock_ns());
+        }
+        http_slab_init(&server->workers[i].connection_slab, sizeof(http_connection), SERVER_CONNECTIONS_PER_SLAB_CHUNK);
+        http_buffer_pool_init(
+            &server->workers[i].buffers,
+            settings->pool_max_cached_bytes > 0 ? settings->pool_max_cached_bytes : SERVER_DEFAULT_POOL_MAX_CACHED_BYTES);
+    }
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        http_log_error("invalid IPv4 address: %s\n", host);
+        http_server_destroy(server);
+        return nullptr;
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        // after the first bind `addr` carries the actual port, so port 0 still gives one shared port
+        if (worker_open(&server->workers[i], &addr) != 0) {
+            http_log_error("cannot set up the server on %s:%d: %s\n", host, port, strerror(errno));
+            http_server_destroy(server);
+            return nullptr;
+        }
+    }
+    server->port = ntohs(addr.sin_port);
+    return server;
+}
+
+uint16_t http_server_port(const http_server *server) {
+    return server->port;
+}
+
+http_io_engine http_server_io_engine(const http_server *server) {
+    return server->io_engine;
+}
+
+void http_server_pool_stats_load(const http_server *server, http_server_pool_stats *out_stats) {
+    *out_stats = (http_server_pool_stats){};
+    for (size_t i = 0; i < server->worker_count; i++) {
+        const http_pool_stats connections = http_pool_counters_load(&server->workers[i].connection_slab.counters);
+        http_pool_stats_add(&out_stats->connections, &connections);
+        http_buffer_pool_stats buffers;
+        http_buffer_pool_stats_load(&server->workers[i].buffers, &buffers);
+        for (size_t tier = 0; tier < HTTP_BUFFER_POOL_TIERS; tier++) {
+            http_pool_stats_add(&out_stats->buffers.tiers[tier], &buffers.tiers[tier]);
+        }
+        http_pool_stats_add(&out_stats->buffers.oversized, &buffers.oversized);
+    }
+}
+
+void http_server_admission_stats_load(const http_server *server, http_admission_stats *out_stats) {
+    *out_stats = (http_admission_stats){};
+    if (server->settings->admission == nullptr) return;
+    for (size_t i = 0; i < server->worker_count; i++) {
+        http_admission_stats_add(&server->workers[i].admission, out_stats);
+    }
+}
+
+int http_server_run(http_server *server) {
+    for (size_t i = 1; i < server->worker_count; i++) {
+        http_server_worker *worker = &server->workers[i];
+        const int err = pthread_create(&worker->thread, nullptr, worker_thread_main, worker);
+        if (err != 0) {
+            http_log_error("cannot start worker %zu: %s\n", i, strerror(err));
+            http_server_stop(server);
+            break;
+        }
+        worker->thread_started = true;
+    }
+    int result = worker_run(&server->workers[0]);
+    for (size_t i = 1; i < server->worker_count; i++) {
+        http_server_worker *worker = &server->workers[i];
+        if (!worker->thread_started) continue;
+        void *worker_result = nullptr;
+        pthread_join(worker->thread, &worker_result);
+        worker->thread_started = false;
+        if ((intptr_t) worker_result != 0) result = -1;
+    }
+    return result;
+}
+
+void http_server_stop(http_server *server) {
+    const uint64_t one = 1;
+    for (size_t i = 0; i < server->worker_count; i++) {
+        while (write(server->workers[i].wakeup.fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void http_server_destroy(http_server *server) {
+    if (server == nullptr) return;
+    for (size_t i = 0; i < server->worker_count; i++) {
+        worker_close(&server->workers[i]);
+    }
+    free(server->workers);
+    free(server);
+}
@@ -0,0 +1,101 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_SERVER_H
+#define TINY_HTTP_SERVER_H
+#include <stdint.h>
+
+#include "tiny_http_admission.h"
+#include "tiny_http_pool.h"
+#include "tiny_http_server_lib.h"
+
+/**
+ * Called once per request with the parsed request; fills in `response`.
+ *
+ * `response` starts zeroed apart from `version`. Anything the response points to (reason phrase,
+ * headers, body) must stay alive until the response has been written: either static data or memory
+ * taken from `request->arena`, which lives until the connection moves on to its next request.
+ * `request->body` is borrowed from the connection's receive buffer, which may move once the handler
+ * returns: a response sending any of it back has to copy it into the arena.
+ *
+ * To stream a body instead (e.g. one generated on the fly), set `response->body_producer`: once the
+ * head has been sent it is called again and again, whenever the socket can take more, until it
+ * returns false. Unless the handler sets `Content-Length` itself the body goes out chunked (HTTP/1.1)
+ * or delimited by closing the connection (HTTP/1.0). A chunked request body arrives already decoded.
+ */
+typedef void (*http_request_handler)(const http_request *request, http_response *response, void *user_data);
+
+typedef struct http_server http_server;
+
+/**
+ * Creates `settings->worker_count` event loops, each with its own epoll instance (or io_uring, see
+ * `http_server_settings::io_engine`) and non-blocking `SO_REUSEPORT` listening socket bound to `host`:`port`.
+ *
+ * @param settings Limits applied to every request; must outlive the server.
+ * @param host IPv4 address to bind to, e.g. "127.0.0.1" or "0.0.0.0".
+ * @param port Port to bind to, 0 to let the kernel pick one (see `http_server_port`).
+ * @param handler The request handler.
+ * @param user_data Passed as is to `handler`.
+ *
+ * @return the server, or nullptr if the socket cannot be set up
+ */
+http_server *http_server_create(
+    const http_server_settings *settings,
+    const char *host,
+    uint16_t port,
+    http_request_handler handler,
+    void *user_data);
+
+/**
+ * @return the port the server is actually listening on
+ */
+uint16_t http_server_port(const http_server *server);
+
+/**
+ * @return the I/O engine the workers run: `http_server_settings::io_engine`, unless that is io_uring and
+ * the kernel (or the build) does not support it
+ */
+http_io_engine http_server_io_engine(const http_server *server);
+
+/**
+ * How the workers' pools are doing, summed up over all workers.
+ */
+typedef struct http_server_pool_stats {
+    /// connection objects
+    http_pool_stats connections;
+    /// read buffers, request heads, arenas and streaming buffers, by size
+    http_buffer_pool_stats buffers;
+} http_server_pool_stats;
+
+/**
+ * Safe to call from any thread while the server runs; the counters of different workers are not
+ * read at the same instant.
+ */
+void http_server_pool_stats_load(const http_server *server, http_server_pool_stats *out_stats);
+
+/**
+ * How admission control (see `http_server_settings::admission`) has been doing, summed up over all
+ * workers; all zero without it. Safe to call from any thread while the server runs.
+ */
+void http_server_admission_stats_load(const http_server *server, http_admission_stats *out_stats);
+
+/**
+ * Serves requests until `http_server_stop` is called: worker 0 runs on the calling thread, every other
+ * worker on a thread of its own. The handler is called concurrently from all of them.
+ *
+ * @return 0 once stopped, -1 if the event loop failed
+ */
+int http_server_run(http_server *server);
+
+/**
+ * Asks `http_server_run` to return; safe to call from any thread or from a handler.
+ */
+void http_server_stop(http_server *server);
+
+/**
+ * Closes the listener and every open connection and frees the server; `http_server_run` must have returned.
+ */
+void http_server_destroy(http_server *server);
+
+#endif //TINY_HTTP_SERVER_H
@@ -3,24 +3,162 @@
 //
 
 #include "tiny_http_server_lib.h"
-#include "tiny_url_decoder_lib.h"
+#include "tiny_http_chunked.h"
+#include "tiny_http_log.h"
+#include "tiny_http_metrics.h"
+#include "tiny_http_scan.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
-enum parse_http_request_status {
-    PARSE_OK = 0,
-    PARSE_E_REQ_IS_NULL = -11,
-    PARSE_E_MALFORMED_HTTP_HEADER = 1,
-    PARSE_E_ALLOC_MEM_FOR_HEADERS = 2,
-    PARSE_E_HTTP_METHOD_NOT_SUPPORTED = 3,
-    PARSE_E_MALFORMED_HTTP_REQUEST_LINE = 4,
-    PARSE_E_HTTP_VERSION_NOT_SUPPORTED = 5,
-    PARSE_E_BODY_TOO_LARGE = 6,
-    PARSE_E_URL_DECODE = 7,
+// region memory
+// every allocation of the parse/render path goes through these so that it can come from an arena instead
+
+static void *http_mem_calloc(http_arena *arena, const size_t size) {
+    if (arena == nullptr) return calloc(1, size);
+    void *ptr = http_arena_alloc(arena, size);
+    if (ptr != nullptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+static void *http_mem_realloc(http_arena *arena, void *ptr, const size_t old_size, const size_t new_size) {
+    if (arena == nullptr) return realloc(ptr, new_size);
+    return http_arena_realloc(arena, ptr, old_size, new_size);
+}
+
+/**
+ * @return a nul-terminated copy of exactly `len` octets of `src`
+ */
+static char *http_mem_dup(http_arena *arena, const void *src, const size_t len) {
+    char *dup = arena == nullptr ? malloc(len + 1) : http_arena_alloc(arena, len + 1);
+    if (dup == nullptr) return nullptr;
+    memcpy(dup, src, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+static void http_mem_free(http_arena *arena, void *ptr) {
+    if (arena == nullptr) free(ptr);
+}
+
+// endregion memory
+
+// region methods
+
+/// "CONNECT" and "OPTIONS"
+#define METHOD_MAX_LENGTH 7
+/// maps the key of every method to a slot of its own, see `METHOD_SLOT`
+#define METHOD_HASH_MULTIPLIER 0x35bf992dc9e9c617ULL
+/// the slot of `method_table` for a token whose octets, read as a little-endian integer, are `key`
+#define METHOD_SLOT(key) ((size_t) (((uint64_t) (key) * METHOD_HASH_MULTIPLIER) >> 60))
+
+typedef struct method_entry {
+    uint64_t key;
+    size_t len;
+    http_method method;
+} method_entry;
+
+#define METHOD_ENTRY(key, len, method) [METHOD_SLOT(key)] = {key, len, method}
+
+static const method_entry method_table[16] = {
+    METHOD_ENTRY(0x544547ULL, 3, GET), // "GET"
+    METHOD_ENTRY(0x44414548ULL, 4, HEAD), // "HEAD"
+    METHOD_ENTRY(0x54534f50ULL, 4, POST), // "POST"
+    METHOD_ENTRY(0x545550ULL, 3, PUT), // "PUT"
+    METHOD_ENTRY(0x4554454c4544ULL, 6, DELETE), // "DELETE"
+    METHOD_ENTRY(0x5443454e4e4f43ULL, 7, CONNECT), // "CONNECT"
+    METHOD_ENTRY(0x534e4f4954504fULL, 7, OPTIONS), // "OPTIONS"
+    METHOD_ENTRY(0x4543415254ULL, 5, TRACE), // "TRACE"
+    METHOD_ENTRY(0x4843544150ULL, 5, PATCH), // "PATCH"
 };
 
+static const char *const method_names[HTTP_METHOD_COUNT] = {
+    [GET] = "GET",
+    [HEAD] = "HEAD",
+    [POST] = "POST",
+    [PUT] = "PUT",
+    [DELETE] = "DELETE",
+    [CONNECT] = "CONNECT",
+    [OPTIONS] = "OPTIONS",
+    [TRACE] = "TRACE",
+    [PATCH] = "PATCH",
+};
+
+static uint64_t load_le64(const uint8_t *octets) {
+    uint64_t word;
+    memcpy(&word, octets, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+static http_method method_from_key(const uint64_t key, const size_t len) {
+    const method_entry *entry = &method_table[METHOD_SLOT(key)];
+    return (entry->key == key) & (entry->len == len) ? entry->method : HTTP_METHOD_UNKNOWN;
+}
+
+/**
+ * `http_method_lookup` of the `token_len` octets at the start of a packet, loading the first 8 octets
+ * in one go when the packet has that many.
+ */
+static http_method method_from_packet(const uint8_t *packet, const size_t packet_len, const size_t token_len) {
+    if (token_len == 0 || token_len > METHOD_MAX_LENGTH) return HTTP_METHOD_UNKNOWN;
+    if (packet_len < sizeof(uint64_t)) return http_method_lookup(packet, token_len);
+    // only the token's octets, the space after it and what follows masked off
+    return method_from_key(load_le64(packet) & ((1ULL << token_len * 8) - 1), token_len);
+}
+
+http_method http_method_lookup(const uint8_t *token, const size_t token_len) {
+    if (token == nullptr || token_len == 0 || token_len > METHOD_MAX_LENGTH) return HTTP_METHOD_UNKNOWN;
+    uint8_t octets[sizeof(uint64_t)] = {};
+    memcpy(octets, token, token_len);
+    return method_from_key(load_le64(octets), token_len);
+}
+
+const char *http_method_name(const http_method method) {
+    return (unsigned) method < HTTP_METHOD_COUNT ? method_names[method] : nullptr;
+}
+
+// endregion methods
+
+/**
+ * @return the index of the first `octet` in `http_packet[from, to)` or `to` if there is none
+ */
+static size_t scan_for_octet(
+    const uint8_t *const http_packet,
+    const size_t from,
+    const size_t to,
+    const uint8_t octet) {
+    return from + http_scan_find_octet(http_packet + from, to - from, octet);
+}
+
+/**
+ * @return the index of the first "\r\n" in `http_packet[from, to)` or `to` if there is none
+ */
+static size_t scan_for_crlf(
+    const uint8_t *const http_packet,
+    const size_t from,
+    const size_t to) {
+    return from + http_scan_find_crlf(http_packet + from, to - from);
+}
+
+/**
+ * @return the index of the first octet in `http_packet[from, to)` outside of `cls`, or `to` if there is none
+ */
+static size_t scan_span(
+    const uint8_t *const http_packet,
+    const size_t from,
+    const size_t to,
+    const http_scan_class cls) {
+    return from + http_scan_span(http_packet + from, to - from, cls);
+}
+
+static size_t min_size(const size_t a, const size_t b) {
+    return a < b ? a : b;
+}
 
 /**
  * Frees the memory allocated for the given HTTP request and its components.
@@ -29,8 +167,11 @@ enum parse_http_request_status {
  */
 void destroy_http_request(http_request *http_request) {
     if (http_request == nullptr) {
-        fprintf(stderr, "http_request is already null\n");
-        fflush(stderr);
+        http_log_error("http_request is already null\n");
+        return;
+    }
+    if (http_request->arena != nullptr) {
+        // owned by the arena, released by `http_arena_reset`
         return;
     }
     if (http_request->body != nullptr) {
@@ -42,9 +183,12 @@ void destroy_http_request(http_request *http_request) {
     if (http_request->headers != nullptr) {
         // ReSharper disable once CppDFANullDereference
         for (size_t i = 0; i < http_request->headers_cnt; i++) {
+            free(http_request->headers[i]->name);
+            free(http_request->headers[i]->value);
             free(http_request->headers[i]);
             http_request->headers[i] = nullptr;
         }
+        free(http_request->headers);
         http_request->headers = nullptr;
         http_request->headers_cnt = 0;
     }
@@ -54,137 +198,328 @@ void destroy_http_request(http_request *http_request) {
     free(http_request);
 }
 
-enum render_http_response_status render_http_response(
-    const http_server_settings *const settings,
+#define RENDER_MAX_REASON_PHRASE_LENGTH 128
+#define RENDER_MAX_HEADER_PART_LENGTH 2000
+
+static enum render_http_response_status validate_http_response(
     const http_response *http_response,
-    uint8_t **out_response_octets,
-    size_t *out_response_len) {
+    const size_t *out_response_len) {
     if (http_response == nullptr) {
-        fprintf(stderr, "http_response is already null\n");
-        fflush(stderr);
-        *out_response_len = 0;
+        http_log_error("http_response is already null\n");
         return RENDER_E_RESPONSE_OBJ_IS_NULL;
     }
     if (out_response_len == nullptr) {
-        fprintf(stderr, "out_response_len is null\n");
-        fflush(stderr);
+        http_log_error("out_response_len is null\n");
         return RENDER_E_OUT_PARAM_ADDR_IS_NULL;
     }
-    *out_response_octets = calloc(
-        // TODO: have a way to predict the size more accurately to avoid over or under allocation
-        http_response->body_len +
-        http_response->headers_cnt * (settings->max_header_name_length + settings->max_header_value_length) +
-        32,
-        sizeof(uint8_t));
-    if (*out_response_octets == nullptr) {
-        fprintf(stderr, "cannot alloc mem for out_response_octets\n");
-        fflush(stderr);
-        *out_response_len = 0;
-        return RENDER_E_MEM_ALLOC_FAILED;
+    if (http_response->version != HTTP_1_0 && http_response->version != HTTP_1_1) {
+        http_log_error("unsupported HTTP version\n");
+        return RENDER_E_HTTP_VERSION_NOT_SUPPORTED;
+    }
+    if (http_response->status_code < 100 || http_response->status_code > 999) {
+        http_log_error("status code %d is not 3 digits\n", http_response->status_code);
+        return RENDER_E_STATUS_CODE_INVALID;
+    }
+    return RENDER_OK;
+}
+
+/**
+ * @return true if the head has any header lines, and so ends with a blank line
+ */
+static bool has_headers(const http_response *http_response) {
+    return (http_response->headers != nullptr && http_response->headers_cnt > 0) || http_response->header_fragments_cnt > 0;
+}
+
+/**
+ * @return the pre-built status line of `http_response`, or nullptr if it has to be rendered piece by piece
+ */
+static const char *prebuilt_status_line(const http_response *http_response, size_t *out_len) {
+    if (http_response->reason_phrase != nullptr) return nullptr;
+    return http_status_line(http_response->version == HTTP_1_1, http_response->status_code, out_len);
+}
+
+/**
+ * @return the exact number of octets of the status line and headers (including the blank line, if any)
+ */
+static size_t measure_http_response_head(const http_response *http_response) {
+    size_t head_len = 0;
+    if (prebuilt_status_line(http_response, &head_len) == nullptr) {
+        // "HTTP/x.y" SP 3DIGIT SP <reason phrase> CRLF
+        head_len = 5 + 3 + 1 + 3 + 1 + 2;
+        if (http_response->reason_phrase != nullptr) {
+            head_len += strnlen((const char *) http_response->reason_phrase, RENDER_MAX_REASON_PHRASE_LENGTH);
+        }
+    }
+    for (size_t i = 0; i < http_response->header_fragments_cnt; i++) {
+        head_len += http_response->header_fragments[i].len;
+    }
+    if (http_response->headers != nullptr) {
+        for (size_t i = 0; i < http_response->headers_cnt; i++) {
+            // <header name>: <header value> CRLF
+            head_len += strnlen(http_response->headers[i].name, RENDER_MAX_HEADER_PART_LENGTH) + 2
+                    + strnlen(http_response->headers[i].value, RENDER_MAX_HEADER_PART_LENGTH) + 2;
+        }
     }
+    if (has_headers(http_response)) head_len += 2;
+    return head_len;
+}
 
-    size_t octets_written = 0;
+static uint8_t *render_octets(uint8_t *out, const void *octets, const size_t len) {
+    memcpy(out, octets, len);
+    return out + len;
+}
 
+/**
+ * Writes exactly `measure_http_response_head(http_response)` octets to `out`.
+ */
+static void render_http_response_head_into(const http_response *http_response, uint8_t *out) {
     // region status line
     // Status-Line:
     // "HTTP/" 1*DIGIT "." 1*DIGIT SP 3DIGIT SP *<TEXT, excluding CR, LF>
     // "HTTP/<http_version><SP><http response status><SP><reason phrase><CR><LF>"
-
-    // region "HTTP/x.y" part
-    strcpy((char *) *out_response_octets, "HTTP/"); // "HTTP/"
-    octets_written += 5;
-    if (http_response->version == HTTP_1_0) {
-        strcpy((char *) *out_response_octets + octets_written, "1.0");
-        octets_written += 3;
+    size_t status_line_len = 0;
+    const char *status_line = prebuilt_status_line(http_response, &status_line_len);
+    if (status_line != nullptr) {
+        out = render_octets(out, status_line, status_line_len);
     } else {
-        fprintf(stderr, "unsupported HTTP version\n");
-        fflush(stderr);
-        *out_response_len = 0;
-        free(*out_response_octets);
-        *out_response_octets = nullptr;
-        return RENDER_E_HTTP_VERSION_NOT_SUPPORTED;
+        out = render_octets(out, http_response->version == HTTP_1_1 ? "HTTP/1.1 " : "HTTP/1.0 ", 9);
+        *out++ = (uint8_t) ('0' + http_response->status_code / 100);
+        *out++ = (uint8_t) ('0' + http_response->status_code / 10 % 10);
+        *out++ = (uint8_t) ('0' + http_response->status_code % 10);
+        *out++ = ' ';
+        if (http_response->reason_phrase != nullptr) {
+            out = render_octets(
+                out,
+                http_response->reason_phrase,
+                strnlen((const char *) http_response->reason_phrase, RENDER_MAX_REASON_PHRASE_LENGTH));
+        }
+        out = render_octets(out, "\r\n", 2);
     }
-    // endregion "HTTP/x.y" part
-    strcpy((char *) *out_response_octets + octets_written, " ");
-    octets_written += 1;
-    // region http status
-    snprintf((char *) *out_response_octets + octets_written, 5, "%d ", http_response->status_code);
-    octets_written += 4;
-    // endregion http status
-    // region reason phrase
-    const size_t reason_phrase_len = strnlen((char *) http_response->reason_phrase, 128);
-    strncpy((char *) *out_response_octets + octets_written,
-            (const char *) http_response->reason_phrase,
-            reason_phrase_len);
-    octets_written += reason_phrase_len;
-    // endregion reason phrase
-    strncpy((char *) *out_response_octets + octets_written, "\r\n", 2);
-    octets_written += 2;
     // endregion status line
 
     // region headers
     // <header name>: <header value><CR><LF>
-    if (http_response->headers != nullptr && http_response->headers_cnt > 0) {
+    if (http_response->headers != nullptr) {
         for (size_t i = 0; i < http_response->headers_cnt; i++) {
-            const size_t header_name_len = strnlen(http_response->headers[i].name, 2000);
-            strncpy(
-                (char *) *out_response_octets + octets_written,
-                http_response->headers[i].name,
-                header_name_len);
-            octets_written += header_name_len;
-            strcpy((char *) *out_response_octets + octets_written, ": ");
-            octets_written += 2;
-
-            const size_t header_value_len = strnlen(http_response->headers[i].value, 2000);
-            strncpy(
-                (char *) *out_response_octets + octets_written,
-                http_response->headers[i].value,
-                header_value_len);
-            octets_written += header_value_len;
-            strcpy((char *) *out_response_octets + octets_written, "\r\n");
-            octets_written += 2;
-        }
-
-        strncpy((char *) *out_response_octets + octets_written, "\r\n", 2);
-        octets_written += 2;
+            const http_header *header = &http_response->headers[i];
+            out = render_octets(out, header->name, strnlen(header->name, RENDER_MAX_HEADER_PART_LENGTH));
+            out = render_octets(out, ": ", 2);
+            out = render_octets(out, header->value, strnlen(header->value, RENDER_MAX_HEADER_PART_LENGTH));
+            out = render_octets(out, "\r\n", 2);
+        }
+    }
+    for (size_t i = 0; i < http_response->header_fragments_cnt; i++) {
+        out = render_octets(out, http_response->header_fragments[i].octets, http_response->header_fragments[i].len);
     }
+    if (has_headers(http_response)) render_octets(out, "\r\n", 2);
     // endregion headers
+}
 
+static enum render_http_response_status render_http_response_with(
+    http_arena *arena,
+    const http_response *http_response,
+    uint8_t **out_response_octets,
+    size_t *out_response_len) {
+    const enum render_http_response_status status = validate_http_response(http_response, out_response_len);
+    if (status != RENDER_OK) {
+        http_metrics_count_render_error(status);
+        if (out_response_len != nullptr) *out_response_len = 0;
+        return status;
+    }
+
+    const size_t head_len = measure_http_response_head(http_response);
+    const size_t body_len = http_response->body != nullptr ? http_response->body_len : 0;
+    // sized exactly; the one extra octet keeps the output nul-terminated for callers treating it as a string
+    *out_response_octets = arena == nullptr
+                               ? malloc(head_len + body_len + 1)
+                               : http_arena_alloc(arena, head_len + body_len + 1);
+    if (*out_response_octets == nullptr) {
+        http_log_error("cannot alloc mem for out_response_octets\n");
+        http_metrics_count_render_error(RENDER_E_MEM_ALLOC_FAILED);
+        *out_response_len = 0;
+        return RENDER_E_MEM_ALLOC_FAILED;
+    }
+
+    render_http_response_head_into(http_response, *out_response_octets);
     // region body
-    // <body octets><CR><LF>
-    if (http_response->body != nullptr && http_response->body_len > 0) {
-        strncpy((char *) *out_response_octets + octets_written, (const char *) http_response->body,
-                http_response->body_len);
-        octets_written += http_response->body_len;
+    // <body octets>
+    if (body_len > 0) {
+        memcpy(*out_response_octets + head_len, http_response->body, body_len);
     }
     // endregion body
+    (*out_response_octets)[head_len + body_len] = '\0';
+
+    *out_response_len = head_len + body_len;
+    return RENDER_OK;
+}
+
+enum render_http_response_status render_http_response(
+    const http_server_settings *const settings,
+    const http_response *http_response,
+    uint8_t **out_response_octets,
+    size_t *out_response_len) {
+    // responses are measured exactly, so the limits of `settings` no longer play a part; it stays for the
+    // symmetry with `parse_http_request` and the callers already passing it
+    (void) settings;
+    return render_http_response_with(nullptr, http_response, out_response_octets, out_response_len);
+}
+
+enum render_http_response_status render_http_response_in_arena(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const http_response *http_response,
+    uint8_t **out_response_octets,
+    size_t *out_response_len) {
+    (void) settings; // see `render_http_response`
+    return render_http_response_with(arena, http_response, out_response_octets, out_response_len);
+}
+
+enum render_http_response_status render_http_response_iov(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const http_response *http_response,
+    struct iovec out_iov[static 2],
+    size_t *out_iov_cnt) {
+    (void) settings; // see `render_http_response`
+    size_t head_len = 0;
+    const enum render_http_response_status status = validate_http_response(http_response, &head_len);
+    if (status != RENDER_OK) {
+        http_metrics_count_render_error(status);
+        *out_iov_cnt = 0;
+        return status;
+    }
+
+    head_len = measure_http_response_head(http_response);
+    uint8_t *head = arena == nullptr ? malloc(head_len) : http_arena_alloc(arena, head_len);
+    if (head == nullptr) {
+        http_log_error("cannot alloc mem for the response head\n");
+        http_metrics_count_render_error(RENDER_E_MEM_ALLOC_FAILED);
+        *out_iov_cnt = 0;
+        return RENDER_E_MEM_ALLOC_FAILED;
+    }
+    render_http_response_head_into(http_response, head);
 
-    *out_response_len = octets_written;
+    out_iov[0] = (struct iovec){.iov_base = head, .iov_len = head_len};
+    *out_iov_cnt = 1;
+    if (http_response->body != nullptr && http_response->body_len > 0) {
+        out_iov[1] = (struct iovec){.iov_base = http_response->body, .iov_len = http_response->body_len};
+        *out_iov_cnt = 2;
+    }
     return RENDER_OK;
 }
 
+// region chunked bodies
+
+/**
+ * @return `PARSE_OK` if the `Transfer-Encoding` field value is a lone `chunked`, the only coding supported
+ */
+static enum parse_http_request_status check_transfer_encoding(const uint8_t *value, size_t value_len) {
+    while (value_len > 0 && (*value == ' ' || *value == '\t')) {
+        value++;
+        value_len--;
+    }
+    while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t')) value_len--;
+    if (value_len == 7 && strncasecmp((const char *) value, "chunked", 7) == 0) return PARSE_OK;
+    http_log_debug("unsupported transfer coding\n");
+    return PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED;
+}
+
 /**
+ * Decodes the chunked body at the start of `encoded` in one go.
  *
- * @param settings
- * @param headers http_headers from which we've to get the Content-Length
- * @param num_headers number of headers
- * @return the value of `Content-Length` header or error (negative)
- * @retval > 0 is the actual value
- * @retval -1 headers is NULL
- * @retval -2 the `Content-Length` header is not found
+ * @param max_body_len
+ * @param encoded
+ * @param encoded_len
+ * @param out Receives the decoded body (never longer than `encoded_len`), nullptr to only find its end.
+ * @param out_body_len Set to the length of the decoded body.
+ * @param out_encoded_len Set to the octets of `encoded` the body took up, framing included.
  */
-ssize_t get_body_size_from_header(
-    const http_server_settings *const settings,
-    const http_header *const *const headers,
-    const size_t num_headers) {
-    if (headers == nullptr) return -1;
-    for (size_t i = 0; i < num_headers; i++) {
-        if (headers[i] == nullptr) continue;
-        if (strncmp(headers[i]->name, "Content-Length", settings->max_header_name_length) == 0) {
-            return strtol(headers[i]->value, nullptr, 10);
+static enum parse_http_request_status decode_chunked_body(
+    const size_t max_body_len,
+    const uint8_t *const encoded,
+    const size_t encoded_len,
+    uint8_t *const out,
+    size_t *const out_body_len,
+    size_t *const out_encoded_len) {
+    http_chunked_decoder decoder;
+    http_chunked_decoder_init(&decoder, max_body_len);
+    size_t at = 0;
+    *out_body_len = 0;
+    while (true) {
+        size_t consumed = 0;
+        http_slice data = {};
+        const enum http_chunked_decode_result result =
+                http_chunked_decoder_feed(&decoder, encoded + at, encoded_len - at, &consumed, &data);
+        at += consumed;
+        switch (result) {
+            case HTTP_CHUNKED_DATA:
+                if (out != nullptr) memcpy(out + *out_body_len, data.ptr, data.len);
+                *out_body_len += data.len;
+                break;
+            case HTTP_CHUNKED_COMPLETE:
+                *out_encoded_len = at;
+                return PARSE_OK;
+            case HTTP_CHUNKED_NEED_MORE:
+                return PARSE_E_INCOMPLETE;
+            case HTTP_CHUNKED_TOO_LARGE:
+                return PARSE_E_BODY_TOO_LARGE;
+            case HTTP_CHUNKED_MALFORMED:
+            default:
+                return PARSE_E_MALFORMED_CHUNKED_BODY;
+        }
+    }
+}
+
+// endregion chunked bodies
+
+/**
+ * @return the length a `Content-Length` field value gives, or -1 if it is not one: digits only, no sign
+ * or other octets around them, and not so many that the length could overflow
+ */
+static ssize_t parse_content_length(const http_slice value) {
+    if (value.len == 0 || value.len > 18) return -1;
+    ssize_t content_length = 0;
+    for (size_t j = 0; j < value.len; j++) {
+        if (value.ptr[j] < '0' || value.ptr[j] > '9') return -1;
+        content_length = content_length * 10 + (value.ptr[j] - '0');
+    }
+    return content_length;
+}
+
+/**
+ *
+ * @param request the http_request from which we've to get the Content-Length
+ * @param out_present Set to whether there is a `Content-Length` header at all.
+ * @param out_len Set to its value, if there is one.
+ * @return `PARSE_OK`, or `PARSE_E_MALFORMED_HTTP_HEADER` if a value is not a length or several `Content-Length`
+ * headers disagree
+ */
+static enum parse_http_request_status get_body_size_from_header(
+    const http_request *const request,
+    bool *const out_present,
+    size_t *const out_len) {
+    *out_present = false;
+    *out_len = 0;
+    const size_t first = request->known_headers[HTTP_HEADER_CONTENT_LENGTH];
+    if (first == 0) return PARSE_OK;
+    const char *value = request->headers[first - 1]->value;
+    const ssize_t content_length =
+            parse_content_length((http_slice){.ptr = (const uint8_t *) value, .len = strlen(value)});
+    if (content_length < 0) {
+        http_log_debug("malformed Content-Length header\n");
+        return PARSE_E_MALFORMED_HTTP_HEADER;
+    }
+    // every `Content-Length` header counts: differing ones leave the body's length unknown (RFC 9112 §6.3)
+    for (size_t i = first; i < request->headers_cnt; i++) {
+        if (request->headers[i] == nullptr || request->headers[i]->id != HTTP_HEADER_CONTENT_LENGTH) continue;
+        if (strcmp(request->headers[i]->value, value) != 0) {
+            http_log_debug("conflicting Content-Length headers given\n");
+            return PARSE_E_MALFORMED_HTTP_HEADER;
         }
     }
-    return -2;
+    *out_present = true;
+    *out_len = (size_t) content_length;
+    return PARSE_OK;
 }
 
 /**
@@ -203,31 +538,60 @@ enum parse_http_request_status parse_http_request_body(
     http_request *request,
     const size_t *ptr) {
     if (request == nullptr) {
-        fprintf(stderr, "Error: null request\n");
-        fflush(stderr);
+        http_log_error("Error: null request\n");
         return PARSE_E_REQ_IS_NULL;
     }
+    bool chunked = false;
+    // every `Transfer-Encoding` header counts, not only the first one the index points at
+    const size_t first_transfer_encoding = request->known_headers[HTTP_HEADER_TRANSFER_ENCODING];
+    for (size_t i = first_transfer_encoding > 0 ? first_transfer_encoding - 1 : request->headers_cnt;
+         i < request->headers_cnt; i++) {
+        if (request->headers[i] == nullptr || request->headers[i]->id != HTTP_HEADER_TRANSFER_ENCODING) continue;
+        const char *value = request->headers[i]->value;
+        const enum parse_http_request_status status = check_transfer_encoding((const uint8_t *) value, strlen(value));
+        if (status != PARSE_OK) return status;
+        chunked = true;
+    }
+    bool has_content_length = false;
+    size_t content_length = 0;
+    const enum parse_http_request_status content_length_status =
+            get_body_size_from_header(request, &has_content_length, &content_length);
+    if (content_length_status != PARSE_OK) return content_length_status;
+    if (chunked) {
+        if (has_content_length) {
+            http_log_debug("both Content-Length and Transfer-Encoding given\n");
+            return PARSE_E_MALFORMED_HTTP_HEADER;
+        }
+        // the decoded body is never longer than what is left of the packet
+        const size_t available = http_packet_len - *ptr;
+        request->body = http_mem_calloc(request->arena, available + 1);
+        if (request->body == nullptr) {
+            http_log_error("cannot allocate memory for body\n");
+            return PARSE_E_ALLOC_MEM_FOR_HEADERS;
+        }
+        size_t encoded_len = 0;
+        return decode_chunked_body(
+            settings->max_body_length, http_packet + *ptr, available, request->body, &request->body_len, &encoded_len);
+    }
     if (*ptr < http_packet_len) {
-        const ssize_t body_len_from_header = request != nullptr && request->headers != nullptr
-                                                 ? get_body_size_from_header(
-                                                     settings,
-                                                     // ReSharper disable once CppRedundantCastExpression
-                                                     // ReSharper disable once CppDFANullDereference
-                                                     (const http_header *const *const) request->headers,
-                                                     request->headers_cnt)
-                                                 : -42;
-        if (body_len_from_header >= 0) {
-            request->body_len = body_len_from_header;
+        if (has_content_length) {
+            request->body_len = content_length;
         } else {
             // ReSharper disable once CppDFANullDereference
             request->body_len = http_packet_len - *ptr;
         }
         if (request->body_len > settings->max_body_length) {
-            fprintf(stderr, "Error: body length too large\n");
-            fflush(stderr);
+            http_log_debug("Error: body length too large\n");
             return PARSE_E_BODY_TOO_LARGE;
         }
-        request->body = (uint8_t *) strndup((char *) http_packet + *ptr, request->body_len);
+        // never read past the packet even if `Content-Length` promises more than was received
+        const size_t available = http_packet_len - *ptr;
+        request->body = http_mem_calloc(request->arena, request->body_len + 1);
+        if (request->body == nullptr) {
+            http_log_error("cannot allocate memory for body\n");
+            return PARSE_E_ALLOC_MEM_FOR_HEADERS;
+        }
+        memcpy(request->body, http_packet + *ptr, request->body_len < available ? request->body_len : available);
     }
     return PARSE_OK;
 }
@@ -246,23 +610,33 @@ enum parse_http_request_status parse_http_request_headers(
             // is end-of-headers
             break;
         }
-        http_header *header = calloc(1, sizeof(http_header));
-        const size_t header_name_start_ptr = *ptr;
-        size_t header_name_len = 0;
-        for (int iter_cnt = 0;
-             *ptr < http_packet_len && iter_cnt < settings->max_header_name_length;
-             (*ptr)++, iter_cnt++) {
-            if (http_packet[(*ptr)] == ' ') {
-                header_name_len = *ptr - header_name_start_ptr;
-                break;
-            }
+        http_header *header = http_mem_calloc(request->arena, sizeof(http_header));
+        if (header == nullptr) {
+            http_log_error("cannot allocate memory for new header\n");
+            return PARSE_E_ALLOC_MEM_FOR_HEADERS;
         }
+        const size_t header_name_start_ptr = *ptr;
+        *ptr = scan_for_octet(
+            http_packet,
+            *ptr,
+            min_size(http_packet_len, header_name_start_ptr + settings->max_header_name_length),
+            ' ');
+        const size_t header_name_len = *ptr < http_packet_len && http_packet[*ptr] == ' '
+                                           ? *ptr - header_name_start_ptr
+                                           : 0;
         if (header_name_len == 0) {
-            fprintf(stderr, "malformed header\n");
-            fflush(stderr);
+            http_log_debug("malformed header\n");
+            http_mem_free(request->arena, header);
             return PARSE_E_MALFORMED_HTTP_HEADER;
         }
-        header->name = strndup((char *) http_packet + *ptr - header_name_len, header_name_len - 1);
+        if (i == UINT16_MAX) {
+            // past what `known_headers` can index
+            http_log_debug("too many headers\n");
+            http_mem_free(request->arena, header);
+            return PARSE_E_TOO_MANY_HEADERS;
+        }
+        header->name = http_mem_dup(request->arena, http_packet + *ptr - header_name_len, header_name_len - 1);
+        header->id = http_header_lookup(http_packet + *ptr - header_name_len, header_name_len - 1);
 
         for (; *ptr < http_packet_len; (*ptr)++) {
             if (http_packet[(*ptr)] != ' ') {
@@ -270,36 +644,36 @@ enum parse_http_request_status parse_http_request_headers(
             }
         }
         const size_t header_value_start = *ptr;
-        size_t header_value_len = 0;
-        for (int iter_cnt = 0;
-             *ptr < http_packet_len && iter_cnt < settings->max_header_value_length;
-             (*ptr)++, iter_cnt++) {
-            if (http_packet[(*ptr)] == '\r' && http_packet[*ptr + 1] == '\n') {
-                header_value_len = *ptr - header_value_start;
-                break;
-            }
+        // the "\r" may be the last octet of the window, its "\n" one past it
+        const size_t header_value_end = min_size(
+            http_packet_len, header_value_start + settings->max_header_value_length + 1);
+        *ptr = scan_for_crlf(http_packet, header_value_start, header_value_end);
+        const size_t header_value_len = *ptr < header_value_end ? *ptr - header_value_start : 0;
+        if (*ptr == header_value_end) {
+            *ptr = min_size(http_packet_len, header_value_start + settings->max_header_value_length);
         }
-        header->value = strndup((char *) http_packet + *ptr - header_value_len, header_value_len);
-        if (request->headers == nullptr) {
-            // ReSharper disable once CppDFANullDereference
-            request->headers = calloc(1, sizeof(http_header *));
-            if (request->headers == nullptr) {
-                fprintf(stderr, "cannot allocate memory for new headers\n");
-                fflush(stderr);
-                return PARSE_E_ALLOC_MEM_FOR_HEADERS;
-            }
-        } else {
-            http_header **new_headers = realloc(request->headers, sizeof(http_header *) * (i + 1));
-            if (new_headers == nullptr) {
-                fprintf(stderr, "cannot allocate memory for new headers\n");
-                fflush(stderr);
-                return PARSE_E_ALLOC_MEM_FOR_HEADERS;
-            }
+        header->value = http_mem_dup(request->arena, http_packet + *ptr - header_value_len, header_value_len);
+        http_header **new_headers = http_mem_realloc(
+            request->arena,
+            request->headers,
+            sizeof(http_header *) * i,
+            sizeof(http_header *) * (i + 1));
+        if (new_headers != nullptr) {
             // ReSharper disable once CppDFANullDereference
             request->headers = new_headers;
         }
+        if (header->name == nullptr || header->value == nullptr || new_headers == nullptr) {
+            http_log_error("cannot allocate memory for new headers\n");
+            http_mem_free(request->arena, header->name);
+            http_mem_free(request->arena, header->value);
+            http_mem_free(request->arena, header);
+            return PARSE_E_ALLOC_MEM_FOR_HEADERS;
+        }
         request->headers[i] = header;
         request->headers_cnt = i + 1;
+        if (header->id != HTTP_HEADER_UNKNOWN && request->known_headers[header->id] == 0) {
+            request->known_headers[header->id] = (uint16_t) (i + 1);
+        }
         *ptr += 2;
     }
     *ptr += 2;
@@ -313,84 +687,53 @@ enum parse_http_request_status parse_http_request_line_from_packet(
     http_request *request,
     size_t *ptr) {
     if (request == nullptr) return PARSE_E_REQ_IS_NULL;
-    size_t start_uri = 0;
-    if (strncmp((char *) http_packet, "GET", 3) == 0) {
-        *ptr += 4; // "GET " - 4
-        start_uri = 4;
-        // ReSharper disable once CppDFANullDereference
-        request->method = GET;
-    } else if (strncmp((char *) http_packet, "POST", 4) == 0) {
-        *ptr += 5; // "POST" - 5
-        start_uri = 5;
-        // ReSharper disable once CppDFANullDereference
-        request->method = POST;
-    } else if (strncmp((char *) http_packet, "HEAD", 4) == 0) {
-        *ptr += 5; // "HEAD" - 5
-        start_uri = 5;
-        // ReSharper disable once CppDFANullDereference
-        request->method = HEAD;
-    } else {
-        fprintf(stderr, "right now, only HTTP GET and POST verbs are supported\n");
-        fflush(stderr);
+    // <method> SP: a token that ends anywhere but in a space is malformed, a well-formed one nobody knows is not implemented
+    const size_t method_end = scan_span(http_packet, 0, http_packet_len, HTTP_SCAN_TCHAR);
+    if (method_end == 0 || method_end == http_packet_len || http_packet[method_end] != ' ') {
+        http_log_debug("malformed request line: not able to find method\n");
+        return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    // ReSharper disable once CppDFANullDereference
+    request->method = method_from_packet(http_packet, http_packet_len, method_end);
+    if (request->method == HTTP_METHOD_UNKNOWN) {
+        http_log_debug("unknown method %.*s\n", (int) method_end, (const char *) http_packet);
         return PARSE_E_HTTP_METHOD_NOT_SUPPORTED;
     }
+    *ptr += method_end + 1;
+    const size_t start_uri = method_end + 1;
 #ifdef DEBUG
     printf("request method: %d", request->method);
 #endif
 
-    for (int iter_cnt = 0;
-        *ptr < http_packet_len && iter_cnt < settings->max_url_length;
-        (*ptr)++, iter_cnt++) {
-        if (http_packet[(*ptr)] == ' ') {
-            if (*ptr - start_uri <= 0) {
-                fprintf(stderr, "malformed request line: not able to find path\n");
-                fflush(stderr);
-                return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
-            }
-            if (*ptr - start_uri == 1) {
-                if (http_packet[*ptr - 1] == '/') {
-                    request->path = strdup("/");
-                    (*ptr)++;
-                    break;
-                }
-            }
-            char *raw_path = strndup((char *) &http_packet[start_uri], *ptr - start_uri);
-            char *tok_state = calloc(*ptr - start_uri + 1, sizeof(char *));
-            request->path = calloc(*ptr - start_uri + 1, sizeof(char));
-            size_t path_len = 0;
-            char *token = strtok_r(raw_path, "/", &tok_state);
-            while (token != nullptr) {
-                uint8_t *url_decoded = nullptr;
-                size_t url_decoded_len = 0;
-                const enum url_decode_result res = url_decode(
-                    (const uint8_t *) token,
-                    strlen(token),
-                    &url_decoded,
-                    &url_decoded_len);
-                if (res != URL_DEC_OK) {
-                    fprintf(stderr, "cannot decode URL: %s\n", token);
-                    fflush(stderr);
-                    if (url_decoded != nullptr) free(url_decoded);
-                    free(token);
-                    free(tok_state);
-                    free(raw_path);
-                    return PARSE_E_URL_DECODE;
-                }
-                *(request->path + path_len) = '/';
-                path_len++;
-                strncpy(request->path + path_len, (char *) url_decoded, url_decoded_len);
-                path_len += url_decoded_len;
-                free(url_decoded);
-                url_decoded = nullptr;
-                url_decoded_len = 0;
-                token = strtok_r(nullptr, "/", &tok_state);
-            }
-            free(token);
-            free(tok_state);
-            free(raw_path);
-            (*ptr)++;
-            break;
+    const size_t path_window_end = min_size(http_packet_len, *ptr + settings->max_url_length);
+    *ptr = scan_for_octet(http_packet, *ptr, path_window_end, ' ');
+    if (*ptr < path_window_end) {
+        if (*ptr - start_uri <= 0) {
+            http_log_debug("malformed request line: not able to find path\n");
+            return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+        }
+        const uint8_t *target = &http_packet[start_uri];
+        const size_t target_len = *ptr - start_uri;
+        const uint8_t *query = memchr(target, '?', target_len);
+        const size_t raw_path_len = query != nullptr ? (size_t) (query - target) : target_len;
+        const size_t query_len = query != nullptr ? target_len - raw_path_len - 1 : 0;
+        // a single allocation: the normalized path, then the raw query, each nul-terminated
+        request->path = http_mem_calloc(request->arena, raw_path_len + 2 + query_len + 1);
+        if (request->path == nullptr) {
+            http_log_error("cannot allocate memory for path\n");
+            return PARSE_E_ALLOC_MEM_FOR_HEADERS;
+        }
+        const ssize_t path_len = http_path_normalize(target, raw_path_len, request->path);
+        if (path_len < 0) {
+            http_log_debug("cannot decode URL: %.*s\n", (int) raw_path_len, (const char *) target);
+            return PARSE_E_URL_DECODE;
         }
+        if (query != nullptr) {
+            char *query_copy = request->path + path_len + 1;
+            memcpy(query_copy, query + 1, query_len);
+            request->query = (http_slice){.ptr = (const uint8_t *) query_copy, .len = query_len};
+        }
+        (*ptr)++;
     }
 #ifdef DEBUG
     printf("request url: '%s'", request->url);
@@ -402,8 +745,7 @@ enum parse_http_request_status parse_http_request_line_from_packet(
     if (strncmp((char *) http_packet + *ptr, "HTTP", 4) == 0) {
         *ptr += 5; // 'HTTP/' - 5
     } else {
-        fprintf(stderr, "illegal http packet\n");
-        fflush(stderr);
+        http_log_debug("illegal http packet\n");
         return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
     }
     if (strncmp((char *) http_packet + *ptr, "1.0", 3) == 0) {
@@ -412,9 +754,11 @@ enum parse_http_request_status parse_http_request_line_from_packet(
 #ifdef DEBUG
         printf("http version: %d", request->version);
 #endif
+    } else if (strncmp((char *) http_packet + *ptr, "1.1", 3) == 0) {
+        request->version = HTTP_1_1;
+        *ptr += 3;
     } else {
-        fprintf(stderr, "right now, only HTTP 1.0 is supported\n");
-        fflush(stderr);
+        http_log_debug("right now, only HTTP 1.0 and 1.1 are supported\n");
         return PARSE_E_HTTP_VERSION_NOT_SUPPORTED;
     }
 
@@ -426,35 +770,29 @@ enum parse_http_request_status parse_http_request_line_from_packet(
 }
 
 
-/**
- * Parses an HTTP request from the given http packet in octets.
- *
- * @param settings
- * @param http_packet A pointer to the HTTP packet to parse.
- * @param http_packet_len The length of the HTTP packet.
- *
- * @return A pointer to the parsed HTTP request, or nullptr if parsing fails.
- */
-http_request *parse_http_request(
+static http_request *parse_http_request_with(
     const http_server_settings *const settings,
+    http_arena *arena,
     const uint8_t *const http_packet,
     const size_t http_packet_len) {
     if (http_packet != nullptr && http_packet_len <= 5) {
-        fprintf(stderr, "cannot parse http request as it appears empty\n");
-        fflush(stderr);
+        http_log_debug("cannot parse http request as it appears empty\n");
+        http_metrics_count_parse_error(PARSE_E_MALFORMED_HTTP_REQUEST_LINE);
         return nullptr;
     }
-    http_request *request = calloc(1, sizeof(http_request));
+    http_request *request = http_mem_calloc(arena, sizeof(http_request));
     if (request == nullptr) {
-        fprintf(stderr, "cannot allocate memory for new http request\n");
-        fflush(stderr);
+        http_log_error("cannot allocate memory for new http request\n");
+        http_metrics_count_parse_error(PARSE_E_ALLOC_MEM_FOR_HEADERS);
         return nullptr;
     }
+    request->arena = arena;
     size_t ptr = 0;
 
     const enum parse_http_request_status request_line_parse_status =
             parse_http_request_line_from_packet(settings, http_packet, http_packet_len, request, &ptr);
     if (request_line_parse_status != PARSE_OK) {
+        http_metrics_count_parse_error(request_line_parse_status);
         destroy_http_request(request);
         return nullptr;
     }
@@ -462,6 +800,7 @@ http_request *parse_http_request(
     const enum parse_http_request_status headers_parse_status =
             parse_http_request_headers(settings, http_packet, http_packet_len, request, &ptr);
     if (headers_parse_status != PARSE_OK) {
+        http_metrics_count_parse_error(headers_parse_status);
         destroy_http_request(request);
         return nullptr;
     }
@@ -469,9 +808,580 @@ http_request *parse_http_request(
     const enum parse_http_request_status body_parse_status =
             parse_http_request_body(settings, http_packet, http_packet_len, request, &ptr);
     if (body_parse_status != PARSE_OK) {
+        http_metrics_count_parse_error(body_parse_status);
         destroy_http_request(request);
         return nullptr;
     }
 
     return request;
 }
+
+/**
+ * Parses an HTTP request from the given http packet in octets.
+ *
+ * @param settings
+ * @param http_packet A pointer to the HTTP packet to parse.
+ * @param http_packet_len The length of the HTTP packet.
+ *
+ * @return A pointer to the parsed HTTP request, or nullptr if parsing fails.
+ */
+http_request *parse_http_request(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len) {
+    return parse_http_request_with(settings, nullptr, http_packet, http_packet_len);
+}
+
+http_request *parse_http_request_in_arena(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len) {
+    return parse_http_request_with(settings, arena, http_packet, http_packet_len);
+}
+
+// region request targets
+
+/**
+ * @return the value of the hex digit `octet` or -1 if it is not one
+ */
+static int hex_digit_value(const uint8_t octet) {
+    if (octet >= '0' && octet <= '9') return octet - '0';
+    if (octet >= 'a' && octet <= 'f') return octet - 'a' + 10;
+    if (octet >= 'A' && octet <= 'F') return octet - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @return the octet `%XY` at `octets[at]` stands for, or -1 if it is no complete escape
+ */
+static int percent_decoded(const uint8_t *octets, const size_t len, const size_t at) {
+    if (at + 2 >= len) return -1;
+    const int hi = hex_digit_value(octets[at + 1]);
+    const int lo = hex_digit_value(octets[at + 2]);
+    return hi < 0 || lo < 0 ? -1 : hi << 4 | lo;
+}
+
+ssize_t http_path_normalize(const uint8_t *raw, const size_t raw_len, char *out) {
+    size_t len = 0;
+    size_t i = 0;
+    while (i < raw_len) {
+        if (raw[i] == '/') {
+            // empty segments ("//") collapse, every segment opens with a '/' of its own
+            i++;
+            continue;
+        }
+        const size_t segment_start = len;
+        out[len++] = '/';
+        for (; i < raw_len && raw[i] != '/'; i++) {
+            int octet = raw[i];
+            if (octet == '%') {
+                octet = percent_decoded(raw, raw_len, i);
+                // a nul would cut the path short for anyone treating it as a string
+                if (octet <= 0) return -1;
+                i += 2;
+            }
+            out[len++] = (char) octet;
+        }
+        // dot segments are recognised decoded, so "%2e%2E" cannot step up unnoticed
+        const size_t segment_len = len - segment_start - 1;
+        const char *segment = out + segment_start + 1;
+        if (segment_len == 1 && segment[0] == '.') {
+            len = segment_start;
+        } else if (segment_len == 2 && segment[0] == '.' && segment[1] == '.') {
+            len = segment_start;
+            while (len > 0 && out[len - 1] != '/') len--;
+            if (len > 0) len--;
+        }
+    }
+    if (len == 0) out[len++] = '/';
+    out[len] = '\0';
+    return (ssize_t) len;
+}
+
+bool http_query_next(http_slice *query, http_slice *out_key, http_slice *out_value) {
+    while (query->len > 0) {
+        const uint8_t *pair = query->ptr;
+        const uint8_t *separator = memchr(pair, '&', query->len);
+        const size_t pair_len = separator != nullptr ? (size_t) (separator - pair) : query->len;
+        const size_t consumed = pair_len + (separator != nullptr ? 1 : 0);
+        query->ptr += consumed;
+        query->len -= consumed;
+        if (pair_len == 0) continue;
+        const uint8_t *equals = memchr(pair, '=', pair_len);
+        const size_t key_len = equals != nullptr ? (size_t) (equals - pair) : pair_len;
+        *out_key = (http_slice){.ptr = pair, .len = key_len};
+        *out_value = equals != nullptr
+                         ? (http_slice){.ptr = equals + 1, .len = pair_len - key_len - 1}
+                         : (http_slice){.ptr = pair + pair_len, .len = 0};
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @return the octet at `raw[*at]` decoded as in a query ('+' is a space), advancing `*at` past an
+ * escape, or -1 if it is a malformed one
+ */
+static int query_octet(const http_slice raw, size_t *at) {
+    const uint8_t octet = raw.ptr[*at];
+    if (octet == '+') return ' ';
+    if (octet != '%') return octet;
+    const int decoded = percent_decoded(raw.ptr, raw.len, *at);
+    if (decoded >= 0) *at += 2;
+    return decoded;
+}
+
+ssize_t http_query_decode(const http_slice raw, char *out, const size_t cap) {
+    if (cap == 0) return -1;
+    size_t len = 0;
+    for (size_t i = 0; i < raw.len; i++) {
+        const int octet = query_octet(raw, &i);
+        if (octet < 0 || len + 1 >= cap) return -1;
+        out[len++] = (char) octet;
+    }
+    out[len] = '\0';
+    return (ssize_t) len;
+}
+
+/**
+ * @return true if `key` decodes to exactly `name`, compared without decoding it anywhere
+ */
+static bool query_key_is(const http_slice key, const char *name) {
+    size_t matched = 0;
+    for (size_t i = 0; i < key.len; i++) {
+        const int octet = query_octet(key, &i);
+        if (octet < 0 || name[matched] == '\0' || (uint8_t) name[matched] != octet) return false;
+        matched++;
+    }
+    return name[matched] == '\0';
+}
+
+ssize_t http_query_param(http_slice query, const char *name, char *out, const size_t cap) {
+    http_slice key;
+    http_slice value;
+    while (http_query_next(&query, &key, &value)) {
+        if (query_key_is(key, name)) return http_query_decode(value, out, cap);
+    }
+    return -1;
+}
+
+// endregion request targets
+
+// region header lookup
+
+const http_header *http_request_header(const http_request *const request, const http_header_id id) {
+    if (id <= HTTP_HEADER_UNKNOWN || id >= HTTP_HEADER_ID_COUNT || request->known_headers[id] == 0) return nullptr;
+    return request->headers[request->known_headers[id] - 1];
+}
+
+const http_header *http_request_find_header(const http_request *const request, const char *name) {
+    const size_t name_len = strlen(name);
+    const http_header_id id = http_header_lookup((const uint8_t *) name, name_len);
+    if (id != HTTP_HEADER_UNKNOWN) return http_request_header(request, id);
+    for (size_t i = 0; i < request->headers_cnt; i++) {
+        if (request->headers[i] != nullptr && strcasecmp(request->headers[i]->name, name) == 0) {
+            return request->headers[i];
+        }
+    }
+    return nullptr;
+}
+
+const http_header_view *http_request_view_header(const http_request_view *const request, const http_header_id id) {
+    if (id <= HTTP_HEADER_UNKNOWN || id >= HTTP_HEADER_ID_COUNT || request->known_headers[id] == 0) return nullptr;
+    return &request->headers[request->known_headers[id] - 1];
+}
+
+const http_header_view *http_request_view_find_header(const http_request_view *const request, const char *name) {
+    const size_t name_len = strlen(name);
+    const http_header_id id = http_header_lookup((const uint8_t *) name, name_len);
+    if (id != HTTP_HEADER_UNKNOWN) return http_request_view_header(request, id);
+    for (size_t i = 0; i < request->headers_cnt; i++) {
+        const http_slice header_name = request->headers[i].name;
+        if (header_name.len == name_len && strncasecmp((const char *) header_name.ptr, name, name_len) == 0) {
+            return &request->headers[i];
+        }
+    }
+    return nullptr;
+}
+
+// endregion header lookup
+
+// region zero-copy (borrowed view) parsing
+
+bool http_slice_eq_cstr(const http_slice slice, const char *str) {
+    if (str == nullptr) return slice.ptr == nullptr;
+    const size_t str_len = strlen(str);
+    return slice.len == str_len && (str_len == 0 || memcmp(slice.ptr, str, str_len) == 0);
+}
+
+static enum parse_http_request_status parse_http_request_line_view(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const request,
+    size_t *ptr) {
+    // <method> SP <request-target> SP "HTTP/" DIGIT "." DIGIT CRLF
+    const size_t method_end = scan_span(http_packet, 0, http_packet_len, HTTP_SCAN_TCHAR);
+    if (method_end == http_packet_len) return PARSE_E_INCOMPLETE;
+    if (http_packet[method_end] != ' ' || method_end == 0) {
+        http_log_debug("malformed request line: not able to find method\n");
+        return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    request->method = method_from_packet(http_packet, http_packet_len, method_end);
+    if (request->method == HTTP_METHOD_UNKNOWN) {
+        http_log_debug("unknown method %.*s\n", (int) method_end, (const char *) http_packet);
+        return PARSE_E_HTTP_METHOD_NOT_SUPPORTED;
+    }
+
+    const size_t path_start = method_end + 1;
+    // one octet past the limit tells "too long" apart from "exactly max_url_length"
+    const size_t path_window_end = min_size(http_packet_len, path_start + settings->max_url_length + 1);
+    const size_t path_end = scan_span(http_packet, path_start, path_window_end, HTTP_SCAN_REQUEST_TARGET);
+    if (path_end - path_start > settings->max_url_length) {
+        http_log_debug("malformed request line: path too long\n");
+        return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    if (path_end == http_packet_len) return PARSE_E_INCOMPLETE;
+    if (http_packet[path_end] != ' ' || path_end == path_start) {
+        http_log_debug("malformed request line: not able to find path\n");
+        return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    const uint8_t *query = memchr(http_packet + path_start, '?', path_end - path_start);
+    if (query != nullptr) {
+        request->path = (http_slice){.ptr = http_packet + path_start, .len = (size_t) (query - http_packet) - path_start};
+        request->query = (http_slice){.ptr = query + 1, .len = path_end - (size_t) (query - http_packet) - 1};
+    } else {
+        request->path = (http_slice){.ptr = http_packet + path_start, .len = path_end - path_start};
+        request->query = (http_slice){};
+    }
+
+    const size_t version_start = path_end + 1;
+    if (http_packet_len - version_start < 10) {
+        // "HTTP/1.0\r\n" has not fully arrived; make sure what did arrive can still become one
+        const size_t received = http_packet_len - version_start;
+        return memcmp(http_packet + version_start, "HTTP/", received < 5 ? received : 5) == 0
+                   ? PARSE_E_INCOMPLETE
+                   : PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    if (memcmp(http_packet + version_start, "HTTP/", 5) != 0
+        || memcmp(http_packet + version_start + 8, "\r\n", 2) != 0) {
+        http_log_debug("illegal http packet\n");
+        return PARSE_E_MALFORMED_HTTP_REQUEST_LINE;
+    }
+    if (memcmp(http_packet + version_start + 5, "1.1", 3) == 0) {
+        request->version = HTTP_1_1;
+    } else if (memcmp(http_packet + version_start + 5, "1.0", 3) == 0) {
+        request->version = HTTP_1_0;
+    } else {
+        http_log_debug("right now, only HTTP 1.0 and 1.1 are supported\n");
+        return PARSE_E_HTTP_VERSION_NOT_SUPPORTED;
+    }
+
+    *ptr = version_start + 10;
+    return PARSE_OK;
+}
+
+static enum parse_http_request_status parse_http_request_headers_view(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const request,
+    size_t *ptr) {
+    while (true) {
+        if (http_packet_len - *ptr < 2) return PARSE_E_INCOMPLETE;
+        if (http_packet[*ptr] == '\r' && http_packet[*ptr + 1] == '\n') {
+            // is end-of-headers
+            *ptr += 2;
+            return PARSE_OK;
+        }
+        if (request->headers_cnt == HTTP_REQUEST_VIEW_MAX_HEADERS) {
+            http_log_debug("too many headers\n");
+            return PARSE_E_TOO_MANY_HEADERS;
+        }
+
+        // <header name>:<OWS><header value><OWS><CR><LF>
+        // the name is validated as a token while it is being scanned for the ':'
+        const size_t name_window_end = min_size(http_packet_len, *ptr + settings->max_header_name_length + 1);
+        const size_t colon = scan_span(http_packet, *ptr, name_window_end, HTTP_SCAN_TCHAR);
+        const size_t name_len = colon - *ptr;
+        if (colon == http_packet_len && name_len <= settings->max_header_name_length) return PARSE_E_INCOMPLETE;
+        if (name_len == 0 || name_len > settings->max_header_name_length || http_packet[colon] != ':') {
+            http_log_debug("malformed header\n");
+            return PARSE_E_MALFORMED_HTTP_HEADER;
+        }
+
+        size_t value_start = colon + 1;
+        while (value_start < http_packet_len && (http_packet[value_start] == ' ' || http_packet[value_start] == '\t')) {
+            value_start++;
+        }
+        // likewise, the value is validated as field-content while it is being scanned for the CRLF
+        const size_t value_window_end = min_size(
+            http_packet_len, value_start + settings->max_header_value_length + 1);
+        const size_t line_end = scan_span(http_packet, value_start, value_window_end, HTTP_SCAN_FIELD_CONTENT);
+        if (line_end - value_start <= settings->max_header_value_length
+            && (line_end == http_packet_len || (line_end + 1 == http_packet_len && http_packet[line_end] == '\r'))) {
+            return PARSE_E_INCOMPLETE;
+        }
+        if (line_end + 1 >= http_packet_len || http_packet[line_end] != '\r' || http_packet[line_end + 1] != '\n') {
+            http_log_debug("malformed header: value too long or has invalid octets\n");
+            return PARSE_E_MALFORMED_HTTP_HEADER;
+        }
+        size_t value_end = line_end;
+        while (value_end > value_start && (http_packet[value_end - 1] == ' ' || http_packet[value_end - 1] == '\t')) {
+            value_end--;
+        }
+
+        http_header_view *header = &request->headers[request->headers_cnt++];
+        header->name = (http_slice){.ptr = http_packet + *ptr, .len = name_len};
+        header->value = (http_slice){.ptr = http_packet + value_start, .len = value_end - value_start};
+        header->id = http_header_lookup(header->name.ptr, name_len);
+        if (header->id != HTTP_HEADER_UNKNOWN && request->known_headers[header->id] == 0) {
+            request->known_headers[header->id] = (uint16_t) request->headers_cnt;
+        }
+        *ptr = line_end + 2;
+    }
+}
+
+/**
+ * @return the value of the `Content-Length` headers, -1 if there is none or -2 if one is not a number or
+ * they disagree
+ */
+static ssize_t get_body_size_from_header_view(const http_request_view *const request) {
+    const size_t first = request->known_headers[HTTP_HEADER_CONTENT_LENGTH];
+    if (first == 0) return -1;
+    const http_slice value = request->headers[first - 1].value;
+    const ssize_t content_length = parse_content_length(value);
+    if (content_length < 0) return -2;
+    // every `Content-Length` header counts: differing ones leave the body's length unknown (RFC 9112 §6.3)
+    for (size_t i = first; i < request->headers_cnt; i++) {
+        if (request->headers[i].id != HTTP_HEADER_CONTENT_LENGTH) continue;
+        const http_slice other = request->headers[i].value;
+        if (other.len != value.len || memcmp(other.ptr, value.ptr, value.len) != 0) return -2;
+    }
+    return content_length;
+}
+
+static enum parse_http_request_status parse_http_request_body_view(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const request,
+    const size_t *ptr) {
+    bool chunked = false;
+    size_t body_len = 0;
+    const enum parse_http_request_status status = http_request_view_body_framing(request, &chunked, &body_len);
+    if (status != PARSE_OK) return status;
+    if (chunked) {
+        // the body stays encoded, the decoder only finds where it (and so the request) ends
+        size_t decoded_len = 0;
+        size_t encoded_len = 0;
+        const enum parse_http_request_status chunked_status = decode_chunked_body(
+            settings->max_body_length, http_packet + *ptr, http_packet_len - *ptr, nullptr, &decoded_len, &encoded_len);
+        if (chunked_status != PARSE_OK) return chunked_status;
+        request->body_chunked = true;
+        request->body = (http_slice){.ptr = http_packet + *ptr, .len = encoded_len};
+        request->request_len = *ptr + encoded_len;
+        return PARSE_OK;
+    }
+    // without a `Content-Length` a request has no body (RFC 9112 §6.3): whatever follows is the next request
+    if (body_len > settings->max_body_length) {
+        http_log_debug("Error: body length too large\n");
+        return PARSE_E_BODY_TOO_LARGE;
+    }
+    if (body_len > http_packet_len - *ptr) return PARSE_E_INCOMPLETE;
+    if (body_len > 0) {
+        request->body = (http_slice){.ptr = http_packet + *ptr, .len = body_len};
+    }
+    request->request_len = *ptr + body_len;
+    return PARSE_OK;
+}
+
+enum parse_http_request_status parse_http_request_view_head(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const out_request,
+    size_t *const out_head_len) {
+    if (out_request == nullptr) return PARSE_E_REQ_IS_NULL;
+    out_request->headers_cnt = 0;
+    memset(out_request->known_headers, 0, sizeof(out_request->known_headers));
+    out_request->body = (http_slice){};
+    out_request->request_len = 0;
+    out_request->body_chunked = false;
+    if (http_packet == nullptr) return PARSE_E_INCOMPLETE;
+
+    size_t ptr = 0;
+    enum parse_http_request_status status =
+            parse_http_request_line_view(settings, http_packet, http_packet_len, out_request, &ptr);
+    if (status != PARSE_OK) return status;
+
+    status = parse_http_request_headers_view(settings, http_packet, http_packet_len, out_request, &ptr);
+    if (status != PARSE_OK) return status;
+
+    if (out_head_len != nullptr) *out_head_len = ptr;
+    out_request->request_len = ptr;
+    return PARSE_OK;
+}
+
+ssize_t http_request_view_content_length(const http_request_view *const request) {
+    return get_body_size_from_header_view(request);
+}
+
+enum parse_http_request_status http_request_view_body_framing(
+    const http_request_view *const request,
+    bool *out_chunked,
+    size_t *out_content_length) {
+    *out_chunked = false;
+    *out_content_length = 0;
+    const size_t first_transfer_encoding = request->known_headers[HTTP_HEADER_TRANSFER_ENCODING];
+    for (size_t i = first_transfer_encoding > 0 ? first_transfer_encoding - 1 : request->headers_cnt;
+         i < request->headers_cnt; i++) {
+        if (request->headers[i].id != HTTP_HEADER_TRANSFER_ENCODING) continue;
+        const enum parse_http_request_status status =
+                check_transfer_encoding(request->headers[i].value.ptr, request->headers[i].value.len);
+        if (status != PARSE_OK) return status;
+        *out_chunked = true;
+    }
+
+    const ssize_t content_length = get_body_size_from_header_view(request);
+    if (content_length == -2) {
+        http_log_debug("malformed Content-Length header\n");
+        return PARSE_E_MALFORMED_HTTP_HEADER;
+    }
+    if (content_length >= 0 && *out_chunked) {
+        // a message with both is how requests get smuggled past proxies (RFC 9112 §6.1)
+        http_log_debug("both Content-Length and Transfer-Encoding given\n");
+        return PARSE_E_MALFORMED_HTTP_HEADER;
+    }
+    if (content_length > 0) *out_content_length = (size_t) content_length;
+    return PARSE_OK;
+}
+
+/**
+ * @return the nul-terminated string `slice` becomes once the octet after it, in `head`, is overwritten
+ */
+static char *terminate_in_place(uint8_t *head, const http_slice slice) {
+    uint8_t *octets = head + (slice.ptr - head);
+    octets[slice.len] = '\0';
+    return (char *) octets;
+}
+
+enum parse_http_request_status http_request_from_view(
+    http_arena *arena,
+    uint8_t *head,
+    const http_request_view *const view,
+    uint8_t *body,
+    const size_t body_len,
+    http_request **out_request) {
+    *out_request = nullptr;
+    http_request *request = http_arena_alloc(arena, sizeof(http_request));
+    // one allocation for the headers and the array of pointers to them
+    http_header *headers = http_arena_alloc(arena, view->headers_cnt * (sizeof(http_header) + sizeof(http_header *)));
+    // the normalized path may gain a leading '/'
+    char *path = http_arena_alloc(arena, view->path.len + 2);
+    if (request == nullptr || headers == nullptr || path == nullptr) {
+        http_log_error("cannot allocate memory for the request\n");
+        http_metrics_count_parse_error(PARSE_E_ALLOC_MEM_FOR_HEADERS);
+        return PARSE_E_ALLOC_MEM_FOR_HEADERS;
+    }
+    if (http_path_normalize(view->path.ptr, view->path.len, path) < 0) {
+        http_log_debug("cannot decode URL: %.*s\n", (int) view->path.len, (const char *) view->path.ptr);
+        http_metrics_count_parse_error(PARSE_E_URL_DECODE);
+        return PARSE_E_URL_DECODE;
+    }
+
+    *request = (http_request){
+        .version = view->version,
+        .method = view->method,
+        .path = path,
+        .query = view->query,
+        .headers = (http_header **) (headers + view->headers_cnt),
+        .headers_cnt = view->headers_cnt,
+        .body = body,
+        .body_len = body_len,
+        .arena = arena,
+    };
+    for (size_t i = 0; i < view->headers_cnt; i++) {
+        const http_header_view *header = &view->headers[i];
+        headers[i] = (http_header){
+            .name = terminate_in_place(head, header->name),
+            .value = terminate_in_place(head, header->value),
+            .id = header->id,
+        };
+        request->headers[i] = &headers[i];
+    }
+    memcpy(request->known_headers, view->known_headers, sizeof(request->known_headers));
+    *out_request = request;
+    return PARSE_OK;
+}
+
+enum parse_http_request_status parse_http_request_view(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const out_request) {
+    size_t head_len = 0;
+    const enum parse_http_request_status status =
+            parse_http_request_view_head(settings, http_packet, http_packet_len, out_request, &head_len);
+    if (status != PARSE_OK) {
+        if (status != PARSE_E_INCOMPLETE) http_metrics_count_parse_error(status);
+        return status;
+    }
+
+    const enum parse_http_request_status body_status =
+            parse_http_request_body_view(settings, http_packet, http_packet_len, out_request, &head_len);
+    if (body_status != PARSE_OK && body_status != PARSE_E_INCOMPLETE) http_metrics_count_parse_error(body_status);
+    return body_status;
+}
+
+// endregion zero-copy (borrowed view) parsing
+
+// region persistent connections
+
+/**
+ * @return true if the comma separated, case-insensitive token list `value` holds `token`
+ */
+static bool header_tokens_contain(const uint8_t *value, const size_t value_len, const char *token) {
+    const size_t token_len = strlen(token);
+    size_t i = 0;
+    while (i < value_len) {
+        while (i < value_len && (value[i] == ' ' || value[i] == '\t' || value[i] == ',')) i++;
+        const size_t start = i;
+        while (i < value_len && value[i] != ',') i++;
+        size_t end = i;
+        while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t')) end--;
+        if (end - start == token_len && strncasecmp((const char *) value + start, token, token_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * HTTP/1.1 connections persist unless either side says `Connection: close`;
+ * HTTP/1.0 ones only if the client asks for it with `Connection: keep-alive`.
+ */
+static bool keep_alive_from_connection_header(
+    const http_version version,
+    const uint8_t *value,
+    const size_t value_len) {
+    if (value == nullptr) return version == HTTP_1_1;
+    if (version == HTTP_1_1) return !header_tokens_contain(value, value_len, "close");
+    return header_tokens_contain(value, value_len, "keep-alive");
+}
+
+bool http_request_view_keep_alive(const http_request_view *const request) {
+    const http_header_view *connection = http_request_view_header(request, HTTP_HEADER_CONNECTION);
+    if (connection == nullptr) return keep_alive_from_connection_header(request->version, nullptr, 0);
+    return keep_alive_from_connection_header(request->version, connection->value.ptr, connection->value.len);
+}
+
+bool http_request_keep_alive(const http_request *const request) {
+    const http_header *connection = http_request_header(request, HTTP_HEADER_CONNECTION);
+    if (connection == nullptr) return keep_alive_from_connection_header(request->version, nullptr, 0);
+    return keep_alive_from_connection_header(
+        request->version, (const uint8_t *) connection->value, strlen(connection->value));
+}
+
+// endregion persistent connections
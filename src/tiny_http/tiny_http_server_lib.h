@@ -4,52 +4,235 @@
 
 #ifndef TINY_HTTP_SERVER_LIB_H
 #define TINY_HTTP_SERVER_LIB_H
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "tiny_http_arena.h"
+#include "tiny_http_head.h"
+#include "tiny_http_headers.h"
 
 typedef enum http_version {
     HTTP_1_0 = 1,
+    HTTP_1_1 = 2,
 } http_version;
 
 typedef enum http_method {
+    /// a token that is no method of RFC 9110 or RFC 5789 (see `http_method_lookup`)
+    HTTP_METHOD_UNKNOWN = 0,
     GET = 1,
     HEAD = 2,
     POST = 3,
+    PUT = 4,
+    DELETE = 5,
+    CONNECT = 6,
+    OPTIONS = 7,
+    TRACE = 8,
+    PATCH = 9,
 } http_method;
 
+/// one past the largest `http_method`, for tables indexed by method
+#define HTTP_METHOD_COUNT 10
+
 typedef struct http_header {
     char *name;
     char *value;
+    /// set by the parser; `HTTP_HEADER_UNKNOWN` in responses and for names outside `HTTP_KNOWN_HEADERS`
+    http_header_id id;
 } http_header;
 
+/**
+ * A borrowed, non-owning slice of octets; `ptr` points into a buffer owned by the caller.
+ */
+typedef struct http_slice {
+    const uint8_t *ptr;
+    size_t len;
+} http_slice;
+
 typedef struct http_request {
     http_version version;
     http_method method;
+    /// percent-decoded and normalized, see `http_path_normalize`
     char *path;
+    /// what follows the '?' of the request-target, still percent-encoded (see `http_query_param`);
+    /// `ptr` is nullptr if there is no '?'
+    http_slice query;
     http_header **headers;
     size_t headers_cnt;
+    /// nul-terminated if the request was parsed by `parse_http_request`; borrowed, and not, if it was made
+    /// by `http_request_from_view`
     uint8_t *body;
     size_t body_len;
     struct http_response *response;
+    /// non-null if every allocation of this request came from this arena (see `parse_http_request_in_arena`)
+    http_arena *arena;
+    /// `headers[known_headers[id] - 1]` is the first header named `id`, 0 if there is none; see `http_request_header`
+    uint16_t known_headers[HTTP_HEADER_ID_COUNT];
 } http_request;
 
+/// see `tiny_http_chunked.h`
+typedef struct http_response_writer http_response_writer;
+
+/**
+ * Produces the next piece of a streamed response body by pushing it into `writer`
+ * (`http_response_writer_write`), as much as the writer takes.
+ *
+ * @return true while there is more of the body to come, false once it is complete
+ */
+typedef bool (*http_body_producer)(http_response_writer *writer, void *state);
+
+/**
+ * One piece of a file body sent in parts: `prefix` from memory, then `len` octets of the file from
+ * `offset`, e.g. a part of a `multipart/byteranges` body.
+ */
+typedef struct http_file_part {
+    /// must not be empty
+    http_slice prefix;
+    off_t offset;
+    size_t len;
+} http_file_part;
+
+/**
+ * A response body sent straight from a file descriptor (with `sendfile(2)`) rather than from memory.
+ */
+typedef struct http_file_body {
+    int fd;
+    off_t offset;
+    /// with `parts`, the length of the whole body, the parts' prefixes included
+    size_t len;
+    /// if set, `offset` is ignored and the body is sent as these parts, one after the other; they must
+    /// outlive the response (e.g. in the request's arena)
+    const http_file_part *parts;
+    size_t parts_cnt;
+    /// if set, called with `release_state` once the server no longer needs `fd`
+    void (*release)(void *release_state);
+    void *release_state;
+} http_file_body;
+
 typedef struct http_response {
     http_version version;
     uint16_t status_code;
+    /// if nullptr, the standard reason phrase of `status_code` (see `HTTP_STATUS_CODES`)
     uint8_t *reason_phrase;
     http_header *headers;
     size_t headers_cnt;
+    /// pre-rendered header lines, rendered after `headers`
+    const http_header_fragment *header_fragments;
+    size_t header_fragments_cnt;
     uint8_t *body;
     size_t body_len;
+    /// if set, `body` is ignored and the body is streamed from this producer instead
+    http_body_producer body_producer;
+    void *body_producer_state;
+    /// if `body_file.len` > 0, `body` is ignored and the body is sent from this file instead
+    http_file_body body_file;
 } http_response;
 
+typedef struct http_header_view {
+    http_slice name;
+    http_slice value;
+    http_header_id id;
+} http_header_view;
+
+#ifndef HTTP_REQUEST_VIEW_MAX_HEADERS
+#define HTTP_REQUEST_VIEW_MAX_HEADERS 64
+#endif
+
+/**
+ * Zero-copy counterpart of `http_request`.
+ *
+ * Every slice borrows from the packet passed to `parse_http_request_view`, so the view is only valid
+ * for as long as that packet is alive and unmodified. Unlike `http_request::path`, `path` is the raw
+ * request-target exactly as it appeared on the wire (i.e. still percent-encoded). Unlike
+ * `http_request::body`, a request without `Content-Length` has no body, so that pipelined requests
+ * can be parsed one after the other straight out of the same packet.
+ */
+typedef struct http_request_view {
+    http_version version;
+    http_method method;
+    /// the request-target up to any '?', still percent-encoded
+    http_slice path;
+    /// what follows the '?', still percent-encoded; `ptr` is nullptr if there is no '?'
+    http_slice query;
+    http_header_view headers[HTTP_REQUEST_VIEW_MAX_HEADERS];
+    size_t headers_cnt;
+    http_slice body;
+    /// octets of the packet this request took up; a pipelined request that follows starts right after
+    size_t request_len;
+    /// `Transfer-Encoding: chunked`: `body` is still chunk-encoded, see `http_chunked_decoder`
+    bool body_chunked;
+    /// `headers[known_headers[id] - 1]` is the first header named `id`, 0 if there is none
+    uint16_t known_headers[HTTP_HEADER_ID_COUNT];
+} http_request_view;
+
+/**
+ * How an `http_server` worker waits for its sockets.
+ */
+typedef enum http_io_engine {
+    /// readiness through epoll, then a system call per read and write
+    HTTP_IO_ENGINE_EPOLL = 0,
+    /// completions through io_uring: multishot accept and recv into provided buffers, every operation of
+    /// a loop iteration submitted with one system call; falls back to epoll if the kernel or the build lacks it
+    HTTP_IO_ENGINE_IO_URING = 1,
+} http_io_engine;
+
 typedef struct http_server_settings {
     size_t max_header_name_length;
     size_t max_header_value_length;
     size_t max_body_length;
     size_t max_url_length;
+    /// number of event loop threads of an `http_server`, each with its own `SO_REUSEPORT` listener; 0 means 1
+    size_t worker_count;
+    /// pin the n-th worker thread to the n-th CPU the process may run on
+    bool pin_workers;
+    /// the I/O engine of every `http_server` worker, see `http_server_io_engine` for the one actually used
+    http_io_engine io_engine;
+    /// octets of free buffers of each size an `http_server` worker keeps for reuse; 0 means 4 MiB
+    size_t pool_max_cached_bytes;
+    /// if set, an `http_server` answers `GET` and `HEAD` from this cache and stores what it renders (see `tiny_http_cache.h`)
+    struct http_response_cache *response_cache;
+    /// if set, an `http_server` compresses what its handler renders, where worth it (see `tiny_http_compress.h`)
+    struct http_compressor *compressor;
+    /// if set, an `http_server` sheds load once it falls behind, answering `503` as soon as a request's
+    /// head has arrived (see `tiny_http_admission.h`); must outlive the server
+    const struct http_admission_settings *admission;
+    /// pre-rendered header lines an `http_server` adds to every response it renders, e.g. `Server`
+    const http_header_fragment *header_fragments;
+    size_t header_fragments_cnt;
+    /// have an `http_server` add a `Date` header to every response it renders (see `http_date_header`)
+    bool send_date;
+    /// milliseconds an `http_server` waits for the first octet of a request, on a new connection or
+    /// between requests on a persistent one, before closing the connection; 0 means 60 s
+    uint32_t idle_timeout_ms;
+    /// milliseconds from the first octet of a request until its whole head has arrived, answered with
+    /// `408` and a close past that (a slowloris client never gets there); 0 means 30 s
+    uint32_t header_timeout_ms;
+    /// milliseconds a request body may go without a single octet arriving, answered like the head's; 0 means 30 s
+    uint32_t body_timeout_ms;
+    /// milliseconds a response may go without the client taking a single octet of it before the
+    /// connection is closed; 0 means 60 s
+    uint32_t write_timeout_ms;
 } http_server_settings;
 
+enum parse_http_request_status {
+    PARSE_OK = 0,
+    PARSE_E_REQ_IS_NULL = -11,
+    PARSE_E_MALFORMED_HTTP_HEADER = 1,
+    PARSE_E_ALLOC_MEM_FOR_HEADERS = 2,
+    PARSE_E_HTTP_METHOD_NOT_SUPPORTED = 3,
+    PARSE_E_MALFORMED_HTTP_REQUEST_LINE = 4,
+    PARSE_E_HTTP_VERSION_NOT_SUPPORTED = 5,
+    PARSE_E_BODY_TOO_LARGE = 6,
+    PARSE_E_URL_DECODE = 7,
+    PARSE_E_TOO_MANY_HEADERS = 8,
+    PARSE_E_INCOMPLETE = 9,
+    PARSE_E_HEADERS_TOO_LARGE = 10,
+    PARSE_E_MALFORMED_CHUNKED_BODY = 11,
+    PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED = 12,
+};
+
 /**
  * Parses an HTTP request from the given http packet in octets.
  *
@@ -64,6 +247,23 @@ http_request *parse_http_request(
     const uint8_t *const http_packet,
     const size_t http_packet_len);
 
+/**
+ * Same as `parse_http_request`, but the request, its path, headers and body are all allocated from
+ * `arena`; they are released together by `http_arena_reset(arena)` and `destroy_http_request` is a no-op.
+ *
+ * @param settings
+ * @param arena The arena for this request/response cycle.
+ * @param http_packet A pointer to the HTTP packet to parse.
+ * @param http_packet_len The length of the HTTP packet.
+ *
+ * @return A pointer to the parsed HTTP request, or nullptr if parsing fails.
+ */
+http_request *parse_http_request_in_arena(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len);
+
 /**
  * Frees the memory allocated for the given HTTP request and its components.
  *
@@ -71,12 +271,185 @@ http_request *parse_http_request(
  */
 void destroy_http_request(http_request *http_request);
 
+/**
+ * Parses an HTTP request without allocating: the path, header names/values and body in `out_request`
+ * are slices pointing into `http_packet`.
+ *
+ * @param settings
+ * @param http_packet A pointer to the HTTP packet to parse; must outlive `out_request`.
+ * @param http_packet_len The length of the HTTP packet.
+ * @param out_request The view to fill in.
+ *
+ * @return `PARSE_OK` on success
+ * @retval PARSE_E_INCOMPLETE the packet ends before the headers (or the `Content-Length` body) do
+ * @retval PARSE_E_TOO_MANY_HEADERS more than `HTTP_REQUEST_VIEW_MAX_HEADERS` headers were sent
+ */
+enum parse_http_request_status parse_http_request_view(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const out_request);
+
+/**
+ * Parses only the request line and headers of `http_packet` into `out_request`, leaving `body` empty.
+ *
+ * @param settings
+ * @param http_packet A pointer to the HTTP packet to parse; must outlive `out_request`.
+ * @param http_packet_len The length of the HTTP packet.
+ * @param out_request The view to fill in.
+ * @param out_head_len Set to the number of octets up to and including the blank line ending the headers.
+ *
+ * @return `PARSE_OK` on success, `PARSE_E_INCOMPLETE` if the blank line has not arrived yet
+ */
+enum parse_http_request_status parse_http_request_view_head(
+    const http_server_settings *const settings,
+    const uint8_t *const http_packet,
+    const size_t http_packet_len,
+    http_request_view *const out_request,
+    size_t *const out_head_len);
+
+/**
+ * @return the value of the `Content-Length` headers, -1 if there is none or -2 if one is not a number or
+ * they disagree
+ */
+ssize_t http_request_view_content_length(const http_request_view *const request);
+
+/**
+ * Works out how the body of `request` is delimited (RFC 9112 §6.3).
+ *
+ * @param request
+ * @param out_chunked Set to true if the body is sent with `Transfer-Encoding: chunked`.
+ * @param out_content_length Set to the `Content-Length`, 0 if there is none or the body is chunked.
+ *
+ * @retval PARSE_OK
+ * @retval PARSE_E_MALFORMED_HTTP_HEADER `Content-Length` is not a number, or comes with `Transfer-Encoding`
+ * @retval PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED any transfer coding other than a lone `chunked`
+ */
+enum parse_http_request_status http_request_view_body_framing(
+    const http_request_view *const request,
+    bool *out_chunked,
+    size_t *out_content_length);
+
+/**
+ * Makes the `http_request` a handler is given out of a view that has been parsed already, without
+ * copying what the view borrows: each header name and value is nul-terminated in place, on the ':'
+ * or the whitespace / CR that follows it, so `head` has to be writable; the path is normalized into
+ * `arena`; the query and the body stay where they are.
+ *
+ * The view's slices keep their contents, but `head` no longer holds the request as it came in.
+ *
+ * @param arena Every allocation of the request comes from here, see `http_request::arena`.
+ * @param head The buffer the view's path, query and headers point into.
+ * @param view The request line and headers.
+ * @param body The body, decoded, which the request borrows; not nul-terminated. nullptr if there is none.
+ * @param body_len The length of the body.
+ * @param out_request Receives the request.
+ *
+ * @retval PARSE_OK
+ * @retval PARSE_E_URL_DECODE the path has a malformed escape, or one of a nul octet
+ * @retval PARSE_E_ALLOC_MEM_FOR_HEADERS the arena is exhausted
+ */
+enum parse_http_request_status http_request_from_view(
+    http_arena *arena,
+    uint8_t *head,
+    const http_request_view *const view,
+    uint8_t *body,
+    size_t body_len,
+    http_request **out_request);
+
+/**
+ * Percent-decodes the request path `raw` into `out` in a single pass, normalizing it on the way: empty
+ * segments (a trailing one too) collapse, "." segments are dropped and ".." segments drop the segment
+ * before them, but never step above the root.
+ *
+ * @param out Room for `raw_len + 2` octets; receives a nul-terminated path that starts with '/'.
+ * @return the length of the path, or -1 if `raw` has a malformed escape or one of a nul octet
+ */
+ssize_t http_path_normalize(const uint8_t *raw, size_t raw_len, char *out);
+
+/**
+ * Steps through the `&` separated `key=value` pairs of a raw query string without decoding them;
+ * empty pairs are skipped, a pair without '=' has an empty value.
+ *
+ * @param query What is left of the query; advanced past the pair returned.
+ * @return false once there are no more pairs
+ */
+bool http_query_next(http_slice *query, http_slice *out_key, http_slice *out_value);
+
+/**
+ * Decodes a query key or value: percent escapes, and '+' as a space.
+ *
+ * @param out Receives the decoded octets, nul-terminated.
+ * @return their number, or -1 if `raw` has a malformed escape or does not fit into `cap - 1` octets
+ */
+ssize_t http_query_decode(http_slice raw, char *out, size_t cap);
+
+/**
+ * Looks up the first parameter of `query` whose decoded key is `name` and decodes its value into `out`;
+ * nothing else in the query is decoded.
+ *
+ * @return the length of the value (see `http_query_decode`), or -1 if there is no such parameter or the
+ * value cannot be decoded into `out`
+ */
+ssize_t http_query_param(http_slice query, const char *name, char *out, size_t cap);
+
+/**
+ * Recognises a method token in constant time: its octets are loaded as one integer, which a
+ * multiplicative perfect hash maps to the only method it can be.
+ *
+ * @return the method named exactly `token` (methods are case-sensitive), or `HTTP_METHOD_UNKNOWN`
+ */
+http_method http_method_lookup(const uint8_t *token, size_t token_len);
+
+/**
+ * @return the token of `method`, or nullptr if it is `HTTP_METHOD_UNKNOWN` or out of range
+ */
+const char *http_method_name(http_method method);
+
+/**
+ * @return true if the connection should stay open after responding to `request`: HTTP/1.1 unless it
+ * says `Connection: close`, HTTP/1.0 only if it says `Connection: keep-alive`
+ */
+bool http_request_view_keep_alive(const http_request_view *const request);
+
+/**
+ * @see http_request_view_keep_alive
+ */
+bool http_request_keep_alive(const http_request *const request);
+
+/**
+ * @return the first header of `request` named `id`, or nullptr if it has none
+ */
+const http_header *http_request_header(const http_request *const request, http_header_id id);
+
+/**
+ * @return the first header of `request` named `name` (ignoring case), or nullptr if it has none;
+ * known names are found through the index, only unknown ones are searched for
+ */
+const http_header *http_request_find_header(const http_request *const request, const char *name);
+
+/**
+ * @see http_request_header
+ */
+const http_header_view *http_request_view_header(const http_request_view *const request, http_header_id id);
+
+/**
+ * @see http_request_find_header
+ */
+const http_header_view *http_request_view_find_header(const http_request_view *const request, const char *name);
+
+/**
+ * @return true if the slice holds exactly the octets of the nul-terminated `str`
+ */
+bool http_slice_eq_cstr(http_slice slice, const char *str);
+
 enum render_http_response_status {
     RENDER_OK = 0,
     RENDER_E_MEM_ALLOC_FAILED = -1,
     RENDER_E_RESPONSE_OBJ_IS_NULL = -2,
     RENDER_E_OUT_PARAM_ADDR_IS_NULL = -3,
     RENDER_E_HTTP_VERSION_NOT_SUPPORTED = -4,
+    RENDER_E_STATUS_CODE_INVALID = -5,
 };
 
 enum render_http_response_status render_http_response(
@@ -85,4 +458,35 @@ enum render_http_response_status render_http_response(
     uint8_t **out_response_octets,
     size_t *out_response_len);
 
+/**
+ * Same as `render_http_response`, but `*out_response_octets` is allocated from `arena` and must not be freed.
+ */
+enum render_http_response_status render_http_response_in_arena(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const http_response *http_response,
+    uint8_t **out_response_octets,
+    size_t *out_response_len);
+
+/**
+ * Renders the response for scatter/gather output (e.g. `writev`) without ever copying the body.
+ *
+ * `out_iov[0]` is the status line and headers, rendered into an exactly sized buffer that comes from
+ * `arena` or, if `arena` is nullptr, from malloc (and must then be freed by the caller).
+ * `out_iov[1]`, present only if there is a body, references `http_response->body` in place, so the
+ * body must stay alive until the octets have been written.
+ *
+ * @param settings Unused, responses are sized exactly; may be nullptr.
+ * @param arena The arena to render the head into, or nullptr.
+ * @param http_response The response to render.
+ * @param out_iov Receives up to 2 entries.
+ * @param out_iov_cnt Set to the number of entries of `out_iov` used.
+ */
+enum render_http_response_status render_http_response_iov(
+    const http_server_settings *const settings,
+    http_arena *arena,
+    const http_response *http_response,
+    struct iovec out_iov[static 2],
+    size_t *out_iov_cnt);
+
 #endif //TINY_HTTP_SERVER_LIB_H
@@ -0,0 +1,376 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_static.h"
+#include "tiny_http_log.h"
+#include "tiny_http_lru.h"
+#include "tiny_http_range.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/// cached metadata is trusted for this long before the file is `stat`ed again
+#define STATIC_REVALIDATE_SECONDS 1
+#define STATIC_MAX_PATH_LENGTH 1024
+#define STATIC_INDEX_FILE "index.html"
+
+typedef struct static_file {
+    /// each file is charged 1 against the budget of `max_open_files`
+    http_lru_entry lru;
+    char *path;
+    /// relative to the root, with the index file appended for a directory
+    char *open_path;
+    int fd;
+    size_t size;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    const char *content_type;
+    char last_modified[32];
+    char etag[48];
+    time_t validated_at;
+} static_file;
+
+struct http_static_files {
+    int root_fd;
+    /// by path, in a single shard: its lock also guards `static_file::validated_at`
+    http_lru cache;
+};
+
+// region content types
+
+typedef struct content_type_mapping {
+    const char *extension;
+    const char *content_type;
+} content_type_mapping;
+
+static const content_type_mapping content_types[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/vnd.microsoft.icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+};
+
+static const char *content_type_for(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (dot == nullptr || strchr(dot, '/') != nullptr) return "application/octet-stream";
+    for (size_t i = 0; i < sizeof(content_types) / sizeof(content_types[0]); i++) {
+        if (strcasecmp(dot + 1, content_types[i].extension) == 0) return content_types[i].content_type;
+    }
+    return "application/octet-stream";
+}
+
+// endregion content types
+
+// region cache
+
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (; *path != '\0'; path++) {
+        hash ^= (uint8_t) *path;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static time_t now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return now.tv_sec;
+}
+
+static void static_file_free(static_file *file) {
+    if (file->fd >= 0) close(file->fd);
+    free(file->open_path);
+    free(file->path);
+    free(file);
+}
+
+static bool static_file_matches(const http_lru_entry *entry, const void *path) {
+    return strcmp(((const static_file *) entry)->path, path) == 0;
+}
+
+/**
+ * The last reference dropped closes the file.
+ */
+static void static_file_release(http_lru_entry *entry) {
+    static_file_free((static_file *) entry);
+}
+
+static void release_static_file(void *state) {
+    http_lru_release(&((static_file *) state)->lru);
+}
+
+// endregion cache
+
+// region opening files
+
+/**
+ * Opens `path` relative to the root, refusing to resolve anything (e.g. a symbolic link) outside of it.
+ */
+static int open_beneath(const int root_fd, const char *path) {
+#ifdef SYS_openat2
+    struct open_how how = {.flags = O_RDONLY | O_CLOEXEC, .resolve = RESOLVE_BENEATH};
+    const int fd = (int) syscall(SYS_openat2, root_fd, path, &how, sizeof(how));
+    if (fd >= 0 || errno != ENOSYS) return fd;
+#endif
+    return openat(root_fd, path, O_RDONLY | O_CLOEXEC);
+}
+
+static bool same_file(const static_file *file, const struct stat *st) {
+    return file->dev == st->st_dev
+           && file->ino == st->st_ino
+           && file->size == (size_t) st->st_size
+           && file->mtime.tv_sec == st->st_mtim.tv_sec
+           && file->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * Opens the regular file at `path` (or the index file of the directory at `path`) and reads its metadata.
+ *
+ * @return the file with a single reference, or nullptr with `errno` set
+ */
+static static_file *static_file_open(http_static_files *files, const char *path, const uint64_t hash) {
+    static_file *file = calloc(1, sizeof(static_file));
+    if (file == nullptr) return nullptr;
+    *file = (static_file){.path = strdup(path), .fd = -1};
+    http_lru_entry_init(&files->cache, &file->lru, hash, 1);
+    const size_t path_len = strlen(path);
+    file->open_path = malloc(path_len + sizeof("/" STATIC_INDEX_FILE));
+    if (file->path == nullptr || file->open_path == nullptr) {
+        static_file_free(file);
+        errno = ENOMEM;
+        return nullptr;
+    }
+    memcpy(file->open_path, path, path_len + 1);
+
+    struct stat st;
+    file->fd = open_beneath(files->root_fd, file->open_path);
+    bool opened = file->fd >= 0 && fstat(file->fd, &st) == 0;
+    if (opened && S_ISDIR(st.st_mode)) {
+        close(file->fd);
+        strcpy(file->open_path + path_len, "/" STATIC_INDEX_FILE);
+        file->fd = open_beneath(files->root_fd, file->open_path);
+        opened = file->fd >= 0 && fstat(file->fd, &st) == 0;
+    }
+    if (!opened || !S_ISREG(st.st_mode)) {
+        const int err = !opened ? errno : ENOENT;
+        static_file_free(file);
+        errno = err;
+        return nullptr;
+    }
+
+    file->size = (size_t) st.st_size;
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->mtime = st.st_mtim;
+    file->content_type = content_type_for(file->open_path);
+    struct tm modified;
+    gmtime_r(&st.st_mtim.tv_sec, &modified);
+    strftime(file->last_modified, sizeof(file->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &modified);
+    snprintf(file->etag, sizeof(file->etag), "\"%zx-%llx-%lx\"",
+             file->size, (unsigned long long) st.st_mtim.tv_sec, (unsigned long) st.st_mtim.tv_nsec);
+    file->validated_at = now_seconds();
+    return file;
+}
+
+/**
+ * @return the file at `path` with a reference held for the caller, or nullptr with `errno` set
+ */
+static static_file *static_file_acquire(http_static_files *files, const char *path) {
+    const uint64_t hash = hash_path(path);
+    const time_t now = now_seconds();
+    http_lru_shard *shard = http_lru_shard_of(&files->cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    static_file *file = (static_file *) http_lru_find(&files->cache, shard, hash, path);
+    if (file != nullptr) {
+        http_lru_touch(shard, &file->lru);
+        if (now - file->validated_at < STATIC_REVALIDATE_SECONDS) {
+            pthread_mutex_unlock(&shard->lock);
+            return file;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (file != nullptr) {
+        struct stat st;
+        const bool unchanged = fstatat(files->root_fd, file->open_path, &st, 0) == 0 && same_file(file, &st);
+        pthread_mutex_lock(&shard->lock);
+        if (unchanged) {
+            file->validated_at = now;
+            pthread_mutex_unlock(&shard->lock);
+            return file;
+        }
+        // changed on disk: forget it, responses still sending the old one keep it open until done
+        if (file->lru.cached) http_lru_remove(shard, &file->lru);
+        pthread_mutex_unlock(&shard->lock);
+        http_lru_release(&file->lru);
+    }
+
+    static_file *opened = static_file_open(files, path, hash);
+    if (opened == nullptr) return nullptr;
+    pthread_mutex_lock(&shard->lock);
+    file = (static_file *) http_lru_find(&files->cache, shard, hash, path);
+    if (file != nullptr) {
+        // another worker opened it meanwhile
+        http_lru_touch(shard, &file->lru);
+        pthread_mutex_unlock(&shard->lock);
+        static_file_free(opened);
+        return file;
+    }
+    http_lru_insert(shard, &opened->lru, path);
+    pthread_mutex_unlock(&shard->lock);
+    return opened;
+}
+
+// endregion opening files
+
+http_static_files *http_static_files_create(const char *root, const size_t max_open_files) {
+    http_static_files *files = calloc(1, sizeof(http_static_files));
+    if (files == nullptr) return nullptr;
+    files->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (files->root_fd < 0) {
+        http_log_error("cannot open document root %s: %s\n", root, strerror(errno));
+        free(files);
+        return nullptr;
+    }
+    if (!http_lru_init(&files->cache, 1, max_open_files > 0 ? max_open_files : 1, static_file_matches,
+                       static_file_release)) {
+        close(files->root_fd);
+        free(files);
+        return nullptr;
+    }
+    return files;
+}
+
+void http_static_files_destroy(http_static_files *files) {
+    if (files == nullptr) return;
+    http_lru_destroy(&files->cache);
+    close(files->root_fd);
+    free(files);
+}
+
+// region handler
+
+static http_header allow_headers[] = {
+    {.name = "Allow", .value = "GET, HEAD"},
+};
+
+/**
+ * Turns the decoded request path into a path relative to the document root ("." for the root itself).
+ *
+ * @return 0 on success, 403 if a segment would step outside the root, 404 if the path is too long
+ */
+static int relative_path(const char *request_path, char *out, const size_t out_cap) {
+    size_t path_len = strlen(request_path);
+    while (path_len > 0 && request_path[0] == '/') {
+        request_path++;
+        path_len--;
+    }
+    if (path_len == 0) {
+        strcpy(out, ".");
+        return 0;
+    }
+    if (path_len >= out_cap) return 404;
+    for (size_t start = 0; start < path_len;) {
+        size_t end = start;
+        while (end < path_len && request_path[end] != '/') end++;
+        const size_t segment_len = end - start;
+        if ((segment_len == 1 && request_path[start] == '.')
+            || (segment_len == 2 && request_path[start] == '.' && request_path[start + 1] == '.')) {
+            return 403;
+        }
+        start = end + 1;
+    }
+    memcpy(out, request_path, path_len);
+    out[path_len] = '\0';
+    return 0;
+}
+
+void http_static_files_handler(const http_request *request, http_response *response, void *user_data) {
+    http_static_files *files = user_data;
+    if (request->method != GET && request->method != HEAD) {
+        response->status_code = 405;
+        response->headers = allow_headers;
+        response->headers_cnt = 1;
+        return;
+    }
+
+    char path[STATIC_MAX_PATH_LENGTH];
+    const int path_status = relative_path(request->path, path, sizeof(path));
+    if (path_status == 403) {
+        response->status_code = 403;
+        return;
+    }
+    if (path_status == 404) {
+        response->status_code = 404;
+        return;
+    }
+
+    static_file *file = static_file_acquire(files, path);
+    if (file == nullptr) {
+        if (errno == EXDEV || errno == EACCES || errno == ELOOP) {
+            response->status_code = 403;
+        } else if (errno == ENOENT || errno == ENOTDIR || errno == ENAMETOOLONG) {
+            response->status_code = 404;
+        } else {
+            http_log_error("cannot open %s: %s\n", path, strerror(errno));
+            response->status_code = 500;
+        }
+        return;
+    }
+
+    // the headers go in the request's arena: without one (see `parse_http_request`) there is nowhere to put them
+    http_header *headers =
+            request->arena != nullptr ? http_arena_alloc(request->arena, 4 * sizeof(http_header)) : nullptr;
+    if (headers == nullptr) {
+        release_static_file(file);
+        response->status_code = 500;
+        return;
+    }
+    // the metadata strings live as long as the reference handed to the server along with the fd
+    headers[0] = (http_header){.name = "Content-Type", .value = (char *) file->content_type};
+    headers[1] = (http_header){.name = "Last-Modified", .value = file->last_modified};
+    headers[2] = (http_header){.name = "ETag", .value = file->etag};
+    headers[3] = (http_header){.name = "Accept-Ranges", .value = "bytes"};
+    response->status_code = 200;
+    response->headers = headers;
+    response->headers_cnt = 4;
+    response->body_file = (http_file_body){
+        .fd = file->fd,
+        .offset = 0,
+        .len = file->size,
+        .release = release_static_file,
+        .release_state = file,
+    };
+    http_range_respond(request, response, file->etag, file->last_modified);
+}
+
+// endregion handler
@@ -0,0 +1,46 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_STATIC_H
+#define TINY_HTTP_STATIC_H
+#include <stddef.h>
+
+#include "tiny_http_server_lib.h"
+
+/**
+ * Serves the files under a document root.
+ *
+ * Open file descriptors are kept in an LRU cache together with their `fstat` metadata, so a hot file
+ * costs no `open`/`fstat`/`close` per request; cached files are re-checked against the file system
+ * at most once a second. The body goes out with `sendfile(2)` (see `http_file_body`), never through
+ * user space.
+ */
+typedef struct http_static_files http_static_files;
+
+/**
+ * @param root The document root directory.
+ * @param max_open_files How many file descriptors the cache may hold on to.
+ *
+ * @return the file server, or nullptr if `root` cannot be opened as a directory
+ */
+http_static_files *http_static_files_create(const char *root, size_t max_open_files);
+
+/**
+ * Closes every cached file; no response served from `files` may still be in flight.
+ */
+void http_static_files_destroy(http_static_files *files);
+
+/**
+ * An `http_request_handler` answering `GET` and `HEAD` with the file at `request->path` under the
+ * document root (`index.html` for a directory). `user_data` must be the `http_static_files`.
+ *
+ * Any path segment that is `.` or `..` is rejected with 403, and the file is resolved beneath the
+ * root so symbolic links cannot lead out of it either. `HEAD` answers from the cached metadata
+ * without reading the file. A `GET` with `Range` is answered with just the ranges it asks for (see
+ * `http_range_respond`), sent from the file like the whole of it. The response headers are allocated in
+ * `request->arena`: a request without one is answered with 500.
+ */
+void http_static_files_handler(const http_request *request, http_response *response, void *user_data);
+
+#endif //TINY_HTTP_STATIC_H
@@ -0,0 +1,233 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_stream_parser.h"
+#include "tiny_http_log.h"
+#include "tiny_http_metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int http_stream_parser_init(
+    http_stream_parser *parser,
+    const http_server_settings *settings,
+    const size_t head_capacity) {
+    *parser = (http_stream_parser){
+        .settings = settings,
+        .head = malloc(head_capacity),
+        .head_capacity = head_capacity,
+        .head_size = head_capacity,
+    };
+    if (parser->head == nullptr) {
+        http_log_error("cannot allocate memory for the request head buffer\n");
+        return -1;
+    }
+    return 0;
+}
+
+void http_stream_parser_init_pooled(
+    http_stream_parser *parser,
+    const http_server_settings *settings,
+    const size_t head_capacity,
+    http_buffer_pool *pool) {
+    *parser = (http_stream_parser){
+        .settings = settings,
+        .head_capacity = head_capacity,
+        .pool = pool,
+    };
+}
+
+void http_stream_parser_release_head(http_stream_parser *parser) {
+    if (parser->pool == nullptr || parser->head == nullptr) return;
+    if (parser->state != HTTP_STREAM_STATE_HEAD || parser->head_len > 0) return;
+    http_buffer_pool_release(parser->pool, parser->head, parser->head_size);
+    parser->head = nullptr;
+    parser->head_size = 0;
+}
+
+/**
+ * @return how many octets of `head` the head may use
+ */
+static size_t head_room_limit(const http_stream_parser *parser) {
+    return parser->head_size < parser->head_capacity ? parser->head_size : parser->head_capacity;
+}
+
+/**
+ * Makes room in a pooled head buffer for `needed` octets (as far as `head_capacity` allows), moving
+ * what is there into a buffer at least twice as large.
+ *
+ * @return false if the buffer cannot be acquired
+ */
+static bool grow_head(http_stream_parser *parser, const size_t needed) {
+    if (parser->pool == nullptr || needed <= head_room_limit(parser)) return true;
+    if (parser->head_size >= parser->head_capacity) return true;
+    size_t wanted = parser->head_size * 2 > needed ? parser->head_size * 2 : needed;
+    if (wanted > parser->head_capacity) wanted = parser->head_capacity;
+    size_t new_size = 0;
+    uint8_t *new_head = http_buffer_pool_acquire(parser->pool, wanted, &new_size);
+    if (new_head == nullptr) {
+        http_log_error("cannot allocate memory for the request head buffer\n");
+        return false;
+    }
+    if (parser->head != nullptr) {
+        memcpy(new_head, parser->head, parser->head_len);
+        http_buffer_pool_release(parser->pool, parser->head, parser->head_size);
+    }
+    parser->head = new_head;
+    parser->head_size = new_size;
+    return true;
+}
+
+void http_stream_parser_reset(http_stream_parser *parser) {
+    parser->state = HTTP_STREAM_STATE_HEAD;
+    parser->head_len = 0;
+    parser->request.headers_cnt = 0;
+    parser->request.body = (http_slice){};
+    parser->body_len = 0;
+    parser->body_remaining = 0;
+    parser->chunked = false;
+    parser->error = PARSE_OK;
+}
+
+void http_stream_parser_destroy(http_stream_parser *parser) {
+    if (parser == nullptr) return;
+    if (parser->pool != nullptr) http_buffer_pool_release(parser->pool, parser->head, parser->head_size);
+    else free(parser->head);
+    parser->head = nullptr;
+    parser->head_size = 0;
+    parser->head_capacity = 0;
+}
+
+static enum http_stream_parse_result fail(http_stream_parser *parser, const enum parse_http_request_status error) {
+    parser->state = HTTP_STREAM_STATE_ERROR;
+    parser->error = error;
+    http_metrics_count_parse_error(error);
+    return HTTP_STREAM_MALFORMED;
+}
+
+/**
+ * Copies `data` into the head buffer up to the end of the headers.
+ *
+ * Only the newly arrived octets (plus the 3 before them, in case "\r\n\r\n" straddles two pieces)
+ * are scanned, so a request trickling in octet by octet is still parsed in linear time.
+ */
+static enum http_stream_parse_result feed_head(
+    http_stream_parser *parser,
+    const uint8_t *data,
+    const size_t data_len,
+    size_t *out_consumed) {
+    if (!grow_head(parser, parser->head_len + data_len)) return fail(parser, PARSE_E_ALLOC_MEM_FOR_HEADERS);
+    const size_t scan_from = parser->head_len < 3 ? 0 : parser->head_len - 3;
+    const size_t room = head_room_limit(parser) - parser->head_len;
+    const size_t copy_len = data_len < room ? data_len : room;
+    memcpy(parser->head + parser->head_len, data, copy_len);
+    const size_t filled = parser->head_len + copy_len;
+
+    size_t head_end = 0;
+    for (size_t i = scan_from; i + 3 < filled; i++) {
+        const uint8_t *found = memchr(parser->head + i, '\r', filled - 3 - i);
+        if (found == nullptr) break;
+        i = (size_t) (found - parser->head);
+        if (memcmp(found, "\r\n\r\n", 4) == 0) {
+            head_end = i + 4;
+            break;
+        }
+    }
+
+    if (head_end == 0) {
+        *out_consumed = copy_len;
+        parser->head_len = filled;
+        if (filled == parser->head_capacity) {
+            http_log_debug("request line and headers do not fit in %zu octets\n", parser->head_capacity);
+            return fail(parser, PARSE_E_HEADERS_TOO_LARGE);
+        }
+        return HTTP_STREAM_NEED_MORE;
+    }
+
+    // the octets after the blank line are (part of) the body, leave them to the caller
+    *out_consumed = head_end - parser->head_len;
+    parser->head_len = head_end;
+
+    size_t head_len = 0;
+    const enum parse_http_request_status status = parse_http_request_view_head(
+        parser->settings, parser->head, parser->head_len, &parser->request, &head_len);
+    if (status != PARSE_OK) return fail(parser, status);
+
+    size_t content_length = 0;
+    const enum parse_http_request_status framing_status =
+            http_request_view_body_framing(&parser->request, &parser->chunked, &content_length);
+    if (framing_status != PARSE_OK) return fail(parser, framing_status);
+    if (parser->chunked) {
+        http_chunked_decoder_init(&parser->chunked_decoder, parser->settings->max_body_length);
+        parser->request.body_chunked = true;
+        parser->state = HTTP_STREAM_STATE_BODY;
+        return HTTP_STREAM_HEADERS_COMPLETE;
+    }
+    parser->body_len = content_length;
+    if (parser->body_len > parser->settings->max_body_length) {
+        http_log_debug("Error: body length too large\n");
+        return fail(parser, PARSE_E_BODY_TOO_LARGE);
+    }
+    parser->body_remaining = parser->body_len;
+    parser->state = HTTP_STREAM_STATE_BODY;
+    return HTTP_STREAM_HEADERS_COMPLETE;
+}
+
+static enum http_stream_parse_result feed_chunked_body(
+    http_stream_parser *parser,
+    const uint8_t *data,
+    const size_t data_len,
+    size_t *out_consumed,
+    http_slice *out_body_chunk) {
+    const enum http_chunked_decode_result result =
+            http_chunked_decoder_feed(&parser->chunked_decoder, data, data_len, out_consumed, out_body_chunk);
+    switch (result) {
+        case HTTP_CHUNKED_DATA:
+            parser->body_len += out_body_chunk->len;
+            return HTTP_STREAM_BODY_CHUNK;
+        case HTTP_CHUNKED_COMPLETE:
+            parser->state = HTTP_STREAM_STATE_DONE;
+            return HTTP_STREAM_MESSAGE_COMPLETE;
+        case HTTP_CHUNKED_NEED_MORE:
+            return HTTP_STREAM_NEED_MORE;
+        case HTTP_CHUNKED_TOO_LARGE:
+            return fail(parser, PARSE_E_BODY_TOO_LARGE);
+        case HTTP_CHUNKED_MALFORMED:
+        default:
+            return fail(parser, PARSE_E_MALFORMED_CHUNKED_BODY);
+    }
+}
+
+enum http_stream_parse_result http_stream_parser_feed(
+    http_stream_parser *parser,
+    const uint8_t *data,
+    const size_t data_len,
+    size_t *out_consumed,
+    http_slice *out_body_chunk) {
+    *out_consumed = 0;
+    switch (parser->state) {
+        case HTTP_STREAM_STATE_HEAD:
+            if (data_len == 0) return HTTP_STREAM_NEED_MORE;
+            return feed_head(parser, data, data_len, out_consumed);
+        case HTTP_STREAM_STATE_BODY: {
+            if (parser->chunked) return feed_chunked_body(parser, data, data_len, out_consumed, out_body_chunk);
+            if (parser->body_remaining == 0) {
+                parser->state = HTTP_STREAM_STATE_DONE;
+                return HTTP_STREAM_MESSAGE_COMPLETE;
+            }
+            if (data_len == 0) return HTTP_STREAM_NEED_MORE;
+            const size_t chunk_len = data_len < parser->body_remaining ? data_len : parser->body_remaining;
+            *out_body_chunk = (http_slice){.ptr = data, .len = chunk_len};
+            *out_consumed = chunk_len;
+            parser->body_remaining -= chunk_len;
+            return HTTP_STREAM_BODY_CHUNK;
+        }
+        case HTTP_STREAM_STATE_DONE:
+            return HTTP_STREAM_MESSAGE_COMPLETE;
+        case HTTP_STREAM_STATE_ERROR:
+        default:
+            return HTTP_STREAM_MALFORMED;
+    }
+}
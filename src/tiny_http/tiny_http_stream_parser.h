@@ -0,0 +1,118 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_STREAM_PARSER_H
+#define TINY_HTTP_STREAM_PARSER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiny_http_chunked.h"
+#include "tiny_http_pool.h"
+#include "tiny_http_server_lib.h"
+
+typedef enum http_stream_parser_state {
+    HTTP_STREAM_STATE_HEAD = 0,
+    HTTP_STREAM_STATE_BODY = 1,
+    HTTP_STREAM_STATE_DONE = 2,
+    HTTP_STREAM_STATE_ERROR = 3,
+} http_stream_parser_state;
+
+enum http_stream_parse_result {
+    HTTP_STREAM_NEED_MORE = 0,
+    HTTP_STREAM_HEADERS_COMPLETE = 1,
+    HTTP_STREAM_BODY_CHUNK = 2,
+    HTTP_STREAM_MESSAGE_COMPLETE = 3,
+    HTTP_STREAM_MALFORMED = -1,
+};
+
+/**
+ * A resumable request parser for data that arrives in arbitrary pieces (e.g. from a socket).
+ *
+ * The request line and headers are accumulated in a parser-owned buffer of `head_capacity` octets,
+ * scanning only the newly arrived octets for the end of the headers, and are then parsed once into
+ * `request` (whose slices point into that buffer). The body is never buffered: it is handed back as
+ * slices of the caller's own input, either `Content-Length` octets in total or, for a
+ * `Transfer-Encoding: chunked` body, the chunk data with the framing already stripped.
+ */
+typedef struct http_stream_parser {
+    const http_server_settings *settings;
+    http_stream_parser_state state;
+    uint8_t *head;
+    size_t head_len;
+    /// the most octets the head may take
+    size_t head_capacity;
+    /// the octets `head` currently holds; below `head_capacity` only while a pooled buffer still has tiers to grow through
+    size_t head_size;
+    /// if set, `head` comes from here, see `http_stream_parser_init_pooled`
+    http_buffer_pool *pool;
+    http_request_view request;
+    size_t body_len;
+    size_t body_remaining;
+    bool chunked;
+    http_chunked_decoder chunked_decoder;
+    enum parse_http_request_status error;
+} http_stream_parser;
+
+/**
+ * @param parser
+ * @param settings
+ * @param head_capacity The most octets the request line and headers may take together.
+ *
+ * @return 0 on success, -1 if the head buffer cannot be allocated
+ */
+int http_stream_parser_init(
+    http_stream_parser *parser,
+    const http_server_settings *settings,
+    size_t head_capacity);
+
+/**
+ * Same as `http_stream_parser_init`, but the head buffer comes from `pool`: it is only acquired once
+ * the first octet of a request arrives, starts out at the smallest buffer size that fits and moves up
+ * the pool's sizes as the head grows, up to `head_capacity`.
+ */
+void http_stream_parser_init_pooled(
+    http_stream_parser *parser,
+    const http_server_settings *settings,
+    size_t head_capacity,
+    http_buffer_pool *pool);
+
+/**
+ * Gives a pooled head buffer back to the pool, if no request is in progress (e.g. while a connection
+ * idles between requests); the next request acquires one again.
+ */
+void http_stream_parser_release_head(http_stream_parser *parser);
+
+/**
+ * Gets the parser ready for the next request, keeping its head buffer.
+ */
+void http_stream_parser_reset(http_stream_parser *parser);
+
+void http_stream_parser_destroy(http_stream_parser *parser);
+
+/**
+ * Feeds the next piece of the request to the parser.
+ *
+ * Call repeatedly, advancing `data` by `*out_consumed` each time, until every octet is consumed
+ * or `HTTP_STREAM_MESSAGE_COMPLETE` is returned; any octets left over after that belong to the next request.
+ *
+ * @param parser
+ * @param data The newly received octets.
+ * @param data_len The number of newly received octets.
+ * @param out_consumed Set to the number of octets of `data` this call used up.
+ * @param out_body_chunk Set to the body octets within `data` when `HTTP_STREAM_BODY_CHUNK` is returned.
+ *
+ * @retval HTTP_STREAM_NEED_MORE every octet was consumed and the message is not complete yet
+ * @retval HTTP_STREAM_HEADERS_COMPLETE `parser->request` now holds the request line and headers
+ * @retval HTTP_STREAM_BODY_CHUNK `*out_body_chunk` is the next piece of the body
+ * @retval HTTP_STREAM_MESSAGE_COMPLETE the whole request has been parsed
+ * @retval HTTP_STREAM_MALFORMED the request is invalid, `parser->error` tells why
+ */
+enum http_stream_parse_result http_stream_parser_feed(
+    http_stream_parser *parser,
+    const uint8_t *data,
+    size_t data_len,
+    size_t *out_consumed,
+    http_slice *out_body_chunk);
+
+#endif //TINY_HTTP_STREAM_PARSER_H
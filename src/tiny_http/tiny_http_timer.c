@@ -0,0 +1,133 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_timer.h"
+
+#include <time.h>
+
+/// `http_timer.slot` of a timer taken out of the wheel by `http_timer_wheel_advance` and not handled yet
+#define TIMER_SLOT_PENDING UINT16_MAX
+
+uint64_t http_timer_clock_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+void http_timer_wheel_init(http_timer_wheel *wheel, const uint64_t now) {
+    *wheel = (http_timer_wheel){.now = now};
+}
+
+static void timer_link(http_timer **head, http_timer *timer) {
+    timer->next = *head;
+    if (timer->next != nullptr) timer->next->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void timer_unlink(http_timer *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != nullptr) timer->next->pprev = timer->pprev;
+    timer->next = nullptr;
+    timer->pprev = nullptr;
+}
+
+/**
+ * Puts an unarmed timer in the slot the wheel reaches it in: the level is that of the highest digit
+ * in which its deadline differs from `wheel->now`, so it is looked at again as soon as the wheel gets
+ * to that digit, one level further down.
+ */
+static void timer_place(http_timer_wheel *wheel, http_timer *timer) {
+    const uint64_t at = timer->deadline > wheel->now ? timer->deadline : wheel->now + 1;
+    const unsigned level = (unsigned) (63 - __builtin_clzll(at ^ wheel->now)) / HTTP_TIMER_WHEEL_SLOT_BITS;
+    const unsigned slot = (unsigned) (at >> (level * HTTP_TIMER_WHEEL_SLOT_BITS)) & (HTTP_TIMER_WHEEL_SLOTS - 1);
+    timer_link(&wheel->slots[level][slot], timer);
+    timer->slot = (uint16_t) (level * HTTP_TIMER_WHEEL_SLOTS + slot);
+    wheel->occupied[level] |= 1ULL << slot;
+    wheel->armed++;
+}
+
+void http_timer_arm(http_timer_wheel *wheel, http_timer *timer, const uint64_t deadline) {
+    http_timer_disarm(wheel, timer);
+    timer->deadline = deadline;
+    timer_place(wheel, timer);
+}
+
+void http_timer_disarm(http_timer_wheel *wheel, http_timer *timer) {
+    if (timer->pprev == nullptr) return;
+    timer_unlink(timer);
+    wheel->armed--;
+    if (timer->slot == TIMER_SLOT_PENDING) return;
+    const unsigned level = timer->slot / HTTP_TIMER_WHEEL_SLOTS;
+    const unsigned slot = timer->slot % HTTP_TIMER_WHEEL_SLOTS;
+    if (wheel->slots[level][slot] == nullptr) wheel->occupied[level] &= ~(1ULL << slot);
+}
+
+/**
+ * @return the slots of a level the wheel passes moving from `from` to `to` (in units of the level's
+ * slots), `from` excluded
+ */
+static uint64_t slots_passed(const uint64_t from, const uint64_t to) {
+    if (to - from >= HTTP_TIMER_WHEEL_SLOTS) return ~0ULL;
+    const unsigned first = (unsigned) (from + 1) & (HTTP_TIMER_WHEEL_SLOTS - 1);
+    const uint64_t run = (1ULL << (to - from)) - 1;
+    return first == 0 ? run : run << first | run >> (HTTP_TIMER_WHEEL_SLOTS - first);
+}
+
+size_t http_timer_wheel_advance(
+    http_timer_wheel *wheel, const uint64_t now, const http_timer_callback callback, void *user_data) {
+    if (now <= wheel->now) return 0;
+    // every slot passed is emptied into `pending`, where timers can still be disarmed (or re-armed) by
+    // the callbacks of the ones handled before them
+    http_timer *pending = nullptr;
+    for (unsigned level = 0; level < HTTP_TIMER_WHEEL_LEVELS; level++) {
+        const unsigned shift = level * HTTP_TIMER_WHEEL_SLOT_BITS;
+        const uint64_t from = wheel->now >> shift;
+        const uint64_t to = now >> shift;
+        // the digits above do not change either
+        if (from == to) break;
+        uint64_t passed = slots_passed(from, to) & wheel->occupied[level];
+        wheel->occupied[level] &= ~passed;
+        while (passed != 0) {
+            const unsigned slot = (unsigned) __builtin_ctzll(passed);
+            passed &= passed - 1;
+            http_timer **head = &wheel->slots[level][slot];
+            while (*head != nullptr) {
+                http_timer *timer = *head;
+                timer_unlink(timer);
+                timer_link(&pending, timer);
+                timer->slot = TIMER_SLOT_PENDING;
+            }
+        }
+    }
+    wheel->now = now;
+
+    size_t expired = 0;
+    while (pending != nullptr) {
+        http_timer *timer = pending;
+        timer_unlink(timer);
+        wheel->armed--;
+        if (timer->deadline <= now) {
+            expired++;
+            callback(timer, user_data);
+        } else {
+            timer_place(wheel, timer);
+        }
+    }
+    return expired;
+}
+
+uint64_t http_timer_wheel_next(const http_timer_wheel *wheel, const uint64_t max) {
+    for (unsigned level = 0; level < HTTP_TIMER_WHEEL_LEVELS; level++) {
+        if (wheel->occupied[level] == 0) continue;
+        // every slot in use is ahead of the wheel's digit at its level, and a lower level's slots all
+        // come before the first one of the next
+        const unsigned shift = level * HTTP_TIMER_WHEEL_SLOT_BITS;
+        const unsigned above = shift + HTTP_TIMER_WHEEL_SLOT_BITS;
+        const uint64_t base = above < 64 ? wheel->now >> above << above : 0;
+        const uint64_t at = base | (uint64_t) __builtin_ctzll(wheel->occupied[level]) << shift;
+        return at - wheel->now < max ? at - wheel->now : max;
+    }
+    return max;
+}
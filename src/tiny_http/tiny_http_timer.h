@@ -0,0 +1,89 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_TIMER_H
+#define TINY_HTTP_TIMER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_TIMER_WHEEL_SLOT_BITS 6
+#define HTTP_TIMER_WHEEL_SLOTS (1 << HTTP_TIMER_WHEEL_SLOT_BITS)
+/// enough levels of `HTTP_TIMER_WHEEL_SLOT_BITS` each to cover every 64-bit deadline
+#define HTTP_TIMER_WHEEL_LEVELS 11
+
+/**
+ * A timer, embedded in whatever it times out: the wheel never allocates.
+ */
+typedef struct http_timer {
+    struct http_timer *next;
+    /// the pointer to this timer in its slot's list, nullptr while the timer is not armed
+    struct http_timer **pprev;
+    /// in milliseconds of `http_timer_clock_ms`
+    uint64_t deadline;
+    /// `level * HTTP_TIMER_WHEEL_SLOTS + slot` of the list the timer is in
+    uint16_t slot;
+} http_timer;
+
+/**
+ * A hierarchical timing wheel with millisecond ticks: arming and disarming a timer is a constant-time
+ * list operation, and a timer moves down at most once per level on its way to expiring, so each costs
+ * O(1) amortised however many are armed. Level `n` has `HTTP_TIMER_WHEEL_SLOTS` slots of
+ * `HTTP_TIMER_WHEEL_SLOTS^n` ms each, with a bitmap of the ones in use so that empty slots are skipped.
+ *
+ * Not thread-safe: each thread (e.g. each server worker) keeps a wheel of its own.
+ */
+typedef struct http_timer_wheel {
+    /// the time the wheel was last advanced to; every timer with an earlier or equal deadline has expired
+    uint64_t now;
+    uint64_t occupied[HTTP_TIMER_WHEEL_LEVELS];
+    http_timer *slots[HTTP_TIMER_WHEEL_LEVELS][HTTP_TIMER_WHEEL_SLOTS];
+    /// timers armed
+    size_t armed;
+} http_timer_wheel;
+
+/**
+ * Called for each timer `http_timer_wheel_advance` expires, which is disarmed by then and may be
+ * armed again, or freed.
+ */
+typedef void (*http_timer_callback)(http_timer *timer, void *user_data);
+
+/**
+ * @return milliseconds of `CLOCK_MONOTONIC_COARSE`: a read of the vDSO without a system call, as
+ * precise as the kernel's tick (a few ms), which timeouts of seconds have no use for anyway
+ */
+uint64_t http_timer_clock_ms(void);
+
+void http_timer_wheel_init(http_timer_wheel *wheel, uint64_t now);
+
+/**
+ * Arms `timer` to expire at `deadline` (at the next advance, if that is not after `wheel->now`),
+ * disarming it first if it is armed already.
+ */
+void http_timer_arm(http_timer_wheel *wheel, http_timer *timer, uint64_t deadline);
+
+/**
+ * Disarms `timer`, if it is armed.
+ */
+void http_timer_disarm(http_timer_wheel *wheel, http_timer *timer);
+
+static inline bool http_timer_armed(const http_timer *timer) {
+    return timer->pprev != nullptr;
+}
+
+/**
+ * Moves the wheel on to `now` (nothing happens if it is not later than `wheel->now`), calling
+ * `callback` for every timer whose deadline has come.
+ *
+ * @return the number of timers expired
+ */
+size_t http_timer_wheel_advance(http_timer_wheel *wheel, uint64_t now, http_timer_callback callback, void *user_data);
+
+/**
+ * @return the milliseconds after `wheel->now` by which the wheel has to be advanced next (which may
+ * only move timers closer to their deadline), capped at `max`; `max` if no timer is armed
+ */
+uint64_t http_timer_wheel_next(const http_timer_wheel *wheel, uint64_t max);
+
+#endif //TINY_HTTP_TIMER_H
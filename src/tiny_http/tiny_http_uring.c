@@ -0,0 +1,333 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include "tiny_http_uring.h"
+
+#ifndef TINY_HTTP_IO_URING
+
+bool http_uring_supported(void) {
+    return false;
+}
+
+#else
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// region system calls
+
+static int uring_setup(const unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(
+    const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags, const void *arg,
+    const size_t arg_size) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int uring_register(const int fd, const unsigned opcode, const void *arg, const unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// endregion system calls
+
+bool http_uring_supported(void) {
+    http_uring ring;
+    if (http_uring_init(&ring, 4, 8) != 0) return false;
+    // `IORING_OP_SEND_ZC` came with Linux 6.0, as did multishot recv, which the probe cannot ask about
+    static const uint8_t required_ops[] = {
+        IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_POLL_ADD,
+        IORING_OP_READ, IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC,
+    };
+    const size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    bool supported = probe != nullptr && uring_register(ring.fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(required_ops); i++) {
+        supported = required_ops[i] <= probe->last_op && (probe->ops[required_ops[i]].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+    // provided buffer rings (Linux 5.19)
+    supported = supported && http_uring_setup_buffers(&ring, 0, 2, 64) == 0;
+    http_uring_destroy(&ring);
+    return supported;
+}
+
+int http_uring_init(http_uring *ring, const unsigned entries, const unsigned cq_entries) {
+    *ring = (http_uring){.fd = -1};
+    // only the calling thread ever submits, so completions can wait for it to ask (Linux 6.1), rather than
+    // interrupting it whenever they arrive
+    struct io_uring_params params = {
+        .flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        .cq_entries = cq_entries,
+    };
+    int fd = uring_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        params = (struct io_uring_params){.flags = IORING_SETUP_CQSIZE, .cq_entries = cq_entries};
+        fd = uring_setup(entries, &params);
+    }
+    if (fd < 0) return -1;
+    ring->fd = fd;
+    ring->features = params.features;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = nullptr;
+        http_uring_destroy(ring);
+        return -1;
+    }
+    if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = nullptr;
+            http_uring_destroy(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = nullptr;
+        http_uring_destroy(ring);
+        return -1;
+    }
+
+    uint8_t *sq = ring->sq_ring;
+    ring->sq_head = (atomic_uint *) (sq + params.sq_off.head);
+    ring->sq_tail = (atomic_uint *) (sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    // the n-th slot always submits the n-th entry
+    unsigned *sq_array = (unsigned *) (sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) sq_array[i] = i;
+
+    uint8_t *cq = ring->cq_ring;
+    ring->cq_head = (atomic_uint *) (cq + params.cq_off.head);
+    ring->cq_tail = (atomic_uint *) (cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return 0;
+}
+
+void http_uring_destroy(http_uring *ring) {
+    if (ring->buf_ring != nullptr) {
+        const struct io_uring_buf_reg reg = {.bgid = ring->buf_group};
+        uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(ring->buf_ring, ring->buf_count * sizeof(struct io_uring_buf));
+        ring->buf_ring = nullptr;
+    }
+    free(ring->bufs);
+    ring->bufs = nullptr;
+    if (ring->sqes != nullptr) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != nullptr && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != nullptr) munmap(ring->sq_ring, ring->sq_ring_size);
+    ring->sqes = nullptr;
+    ring->sq_ring = ring->cq_ring = nullptr;
+    if (ring->fd >= 0) close(ring->fd);
+    ring->fd = -1;
+}
+
+// region submission and completion
+
+/**
+ * Makes the entries handed out so far visible to the kernel.
+ *
+ * @return how many entries the kernel has not consumed yet
+ */
+static unsigned flush_sqes(http_uring *ring) {
+    atomic_store_explicit(ring->sq_tail, ring->sqe_tail, memory_order_release);
+    return ring->sqe_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+}
+
+struct io_uring_sqe *http_uring_get_sqe(http_uring *ring) {
+    if (ring->sqe_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) >= ring->sq_entries) {
+        const unsigned to_submit = flush_sqes(ring);
+        if (uring_enter(ring->fd, to_submit, 0, 0, nullptr, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return nullptr;
+        }
+        if (ring->sqe_tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) >= ring->sq_entries) {
+            return nullptr;
+        }
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool http_uring_ready(const http_uring *ring) {
+    return atomic_load_explicit(ring->cq_tail, memory_order_acquire)
+           != atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+}
+
+int http_uring_submit_and_wait(http_uring *ring, const int timeout_ms) {
+    const unsigned to_submit = flush_sqes(ring);
+    const bool ready = http_uring_ready(ring);
+    int entered;
+    if (timeout_ms < 0 || ready) {
+        entered = uring_enter(ring->fd, to_submit, ready ? 0 : 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } else {
+        // the timeout rides along with the wait (Linux 5.11), rather than as an operation of its own
+        const struct __kernel_timespec ts = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_nsec = (long long) (timeout_ms % 1000) * 1000000,
+        };
+        const struct io_uring_getevents_arg arg = {.ts = (uint64_t) (uintptr_t) &ts};
+        entered = uring_enter(
+            ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    if (entered >= 0) return 0;
+    // interrupted, timed out, or the completion queue is full: either way the caller reaps and comes back
+    return errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY ? 0 : -1;
+}
+
+size_t http_uring_reap(http_uring *ring, struct io_uring_cqe *out, const size_t max) {
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+    size_t reaped = 0;
+    while (head != tail && reaped < max) {
+        out[reaped++] = ring->cqes[head & ring->cq_mask];
+        head++;
+    }
+    atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    return reaped;
+}
+
+// endregion submission and completion
+
+// region provided buffers
+
+/**
+ * Puts buffer `bid` at the tail of the ring, for the kernel to pick.
+ */
+static void provide_buffer(http_uring *ring, const uint16_t bid) {
+    const uint16_t tail = ring->buf_ring->tail;
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[tail & (ring->buf_count - 1)];
+    // only the fields of the entry: the ring's tail shares the first entry's last octets
+    buf->addr = (uint64_t) (uintptr_t) (ring->bufs + (size_t) bid * ring->buf_size);
+    buf->len = (uint32_t) ring->buf_size;
+    buf->bid = bid;
+    atomic_store_explicit((_Atomic uint16_t *) &ring->buf_ring->tail, (uint16_t) (tail + 1), memory_order_release);
+}
+
+int http_uring_setup_buffers(http_uring *ring, const uint16_t group, const unsigned count, const size_t size) {
+    if (count == 0 || (count & (count - 1)) != 0 || count > 32768) {
+        errno = EINVAL;
+        return -1;
+    }
+    // the ring has to be page-aligned
+    void *buf_ring = mmap(nullptr, count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED) return -1;
+    uint8_t *bufs = malloc(count * size);
+    if (bufs == nullptr) {
+        munmap(buf_ring, count * sizeof(struct io_uring_buf));
+        errno = ENOMEM;
+        return -1;
+    }
+    const struct io_uring_buf_reg reg = {
+        .ring_addr = (uint64_t) (uintptr_t) buf_ring,
+        .ring_entries = count,
+        .bgid = group,
+    };
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        const int err = errno;
+        free(bufs);
+        munmap(buf_ring, count * sizeof(struct io_uring_buf));
+        errno = err;
+        return -1;
+    }
+    ring->buf_ring = buf_ring;
+    ring->bufs = bufs;
+    ring->buf_count = count;
+    ring->buf_size = size;
+    ring->buf_group = group;
+    for (unsigned i = 0; i < count; i++) provide_buffer(ring, (uint16_t) i);
+    return 0;
+}
+
+uint8_t *http_uring_buffer(const http_uring *ring, const struct io_uring_cqe *cqe) {
+    return ring->bufs + (size_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT) * ring->buf_size;
+}
+
+void http_uring_recycle_buffer(http_uring *ring, const struct io_uring_cqe *cqe) {
+    provide_buffer(ring, (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+}
+
+// endregion provided buffers
+
+// region preparing entries
+
+void http_uring_prep_accept_multishot(struct io_uring_sqe *sqe, const int fd, const int flags, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = (uint32_t) flags;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data;
+}
+
+void http_uring_prep_recv_multishot(
+    struct io_uring_sqe *sqe, const http_uring *ring, const int fd, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = ring->buf_group;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = user_data;
+}
+
+void http_uring_prep_sendmsg(
+    struct io_uring_sqe *sqe, const int fd, const struct msghdr *message, const int flags, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) message;
+    sqe->len = 1;
+    sqe->msg_flags = (uint32_t) flags;
+    sqe->user_data = user_data;
+}
+
+void http_uring_prep_poll(struct io_uring_sqe *sqe, const int fd, const unsigned events, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void http_uring_prep_read(
+    struct io_uring_sqe *sqe, const int fd, void *buf, const unsigned len, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = len;
+    // not seekable: read from wherever it is
+    sqe->off = (uint64_t) -1;
+    sqe->user_data = user_data;
+}
+
+void http_uring_prep_cancel(struct io_uring_sqe *sqe, const uint64_t target, const uint64_t user_data) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+// endregion preparing entries
+
+#endif //TINY_HTTP_IO_URING
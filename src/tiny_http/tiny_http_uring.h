@@ -0,0 +1,142 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_URING_H
+#define TINY_HTTP_URING_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @return whether the running kernel supports everything the io_uring engine of `http_server` needs
+ * (multishot accept and recv, provided buffer rings: Linux 6.0 or newer), and the library was built with it
+ */
+bool http_uring_supported(void);
+
+#ifdef TINY_HTTP_IO_URING
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+
+/**
+ * A minimal io_uring: the submission and completion queues mapped straight from the kernel, driven
+ * with the raw system calls, plus at most one ring of provided receive buffers.
+ *
+ * Not thread-safe: a ring is set up, submitted to and reaped by one thread only.
+ */
+typedef struct http_uring {
+    int fd;
+    unsigned features;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    atomic_uint *sq_head;
+    atomic_uint *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    /// SQEs handed out by `http_uring_get_sqe` but not yet made visible to the kernel
+    unsigned sqe_tail;
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    atomic_uint *cq_head;
+    atomic_uint *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /// provided receive buffers, `buf_count` of `buf_size` octets each, see `http_uring_setup_buffers`
+    struct io_uring_buf_ring *buf_ring;
+    uint8_t *bufs;
+    unsigned buf_count;
+    size_t buf_size;
+    uint16_t buf_group;
+} http_uring;
+
+/**
+ * Sets up a ring with `entries` submission and `cq_entries` completion queue entries (both rounded
+ * up to a power of two by the kernel), for use by the calling thread only.
+ *
+ * @return 0 on success, -1 with `errno` set on failure
+ */
+int http_uring_init(http_uring *ring, unsigned entries, unsigned cq_entries);
+
+/**
+ * Unmaps the queues and closes the ring; anything still in flight is cancelled by the kernel.
+ */
+void http_uring_destroy(http_uring *ring);
+
+/**
+ * @return a zeroed submission queue entry, submitting what is queued first if the queue is full, or
+ * nullptr if it still is
+ */
+struct io_uring_sqe *http_uring_get_sqe(http_uring *ring);
+
+/**
+ * Submits every queued entry and, unless completions are already waiting, waits for at least one, or
+ * for `timeout_ms` to pass (-1 waits as long as it takes).
+ *
+ * @return 0 on success (timing out included), -1 with `errno` set on failure
+ */
+int http_uring_submit_and_wait(http_uring *ring, int timeout_ms);
+
+/**
+ * @return whether completions are waiting to be reaped
+ */
+bool http_uring_ready(const http_uring *ring);
+
+/**
+ * Copies up to `max` completions into `out` and hands their slots back to the kernel, so handling
+ * them is free to submit more.
+ *
+ * @return the number of completions copied
+ */
+size_t http_uring_reap(http_uring *ring, struct io_uring_cqe *out, size_t max);
+
+/**
+ * Registers `count` (a power of two) buffers of `size` octets as buffer group `group`, for
+ * `http_uring_prep_recv_multishot` to pick from.
+ *
+ * @return 0 on success, -1 with `errno` set on failure
+ */
+int http_uring_setup_buffers(http_uring *ring, uint16_t group, unsigned count, size_t size);
+
+/**
+ * @return the buffer a completion flagged with `IORING_CQE_F_BUFFER` received into
+ */
+uint8_t *http_uring_buffer(const http_uring *ring, const struct io_uring_cqe *cqe);
+
+/**
+ * Hands the buffer a completion received into back to the kernel.
+ */
+void http_uring_recycle_buffer(http_uring *ring, const struct io_uring_cqe *cqe);
+
+// region preparing entries
+
+void http_uring_prep_accept_multishot(struct io_uring_sqe *sqe, int fd, int flags, uint64_t user_data);
+
+/**
+ * A recv that stays armed, each completion carrying a buffer of the ring's group, until it fails,
+ * the peer closes or the group runs out of buffers (`-ENOBUFS`).
+ */
+void http_uring_prep_recv_multishot(struct io_uring_sqe *sqe, const http_uring *ring, int fd, uint64_t user_data);
+
+void http_uring_prep_sendmsg(
+    struct io_uring_sqe *sqe, int fd, const struct msghdr *message, int flags, uint64_t user_data);
+
+void http_uring_prep_poll(struct io_uring_sqe *sqe, int fd, unsigned events, uint64_t user_data);
+
+void http_uring_prep_read(struct io_uring_sqe *sqe, int fd, void *buf, unsigned len, uint64_t user_data);
+
+/**
+ * Cancels the request submitted with `target`.
+ */
+void http_uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data);
+
+// endregion preparing entries
+
+#endif //TINY_HTTP_IO_URING
+
+#endif //TINY_HTTP_URING_H
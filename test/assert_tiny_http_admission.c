@@ -0,0 +1,123 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_admission.h"
+
+#define MS 1000000ULL
+
+static const http_admission_settings settings = {
+    .target_delay_us = 5000,
+    .interval_us = 100000,
+    .min_concurrency = 4,
+    .max_concurrency = 100,
+};
+
+static http_admission_stats stats_of(const http_admission *admission) {
+    http_admission_stats stats = {};
+    http_admission_stats_add(admission, &stats);
+    return stats;
+}
+
+void test_admission_sheds_requests_queued_too_long(void) {
+    http_admission admission;
+    http_admission_init(&admission, &settings, 0);
+    // while the server keeps up, a request may queue for up to an interval
+    assert(http_admission_admit(&admission, 1 * MS, 0) == HTTP_ADMISSION_ADMIT);
+    assert(http_admission_admit(&admission, 60 * MS, 10 * MS) == HTTP_ADMISSION_ADMIT);
+    assert(http_admission_admit(&admission, 150 * MS, 20 * MS) == HTTP_ADMISSION_SHED_DELAY);
+    http_admission_complete(&admission);
+    http_admission_complete(&admission);
+
+    const http_admission_stats stats = stats_of(&admission);
+    assert(stats.admitted == 2 && stats.shed_delay == 1 && stats.shed_concurrency == 0);
+    assert(stats.in_flight == 0 && stats.limit == 100 && stats.overloaded == 0);
+}
+
+void test_admission_detects_a_standing_queue(void) {
+    http_admission admission;
+    http_admission_init(&admission, &settings, 0);
+    // a whole interval in which no request got through in under 5 ms
+    assert(http_admission_admit(&admission, 10 * MS, 0) == HTTP_ADMISSION_ADMIT);
+    assert(http_admission_admit(&admission, 50 * MS, 30 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+    http_admission_complete(&admission);
+    // from then on, 5 ms is all a request may wait, and fewer may be in flight
+    assert(http_admission_admit(&admission, 110 * MS, 100 * MS) == HTTP_ADMISSION_SHED_DELAY);
+    http_admission_stats stats = stats_of(&admission);
+    assert(stats.overloaded == 1 && stats.limit == 80);
+    assert(http_admission_admit(&admission, 120 * MS, 117 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+
+    // one quick request is enough to tell the queue drains: the next interval is back to normal
+    assert(http_admission_admit(&admission, 150 * MS, 150 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+    assert(http_admission_admit(&admission, 250 * MS, 230 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+    stats = stats_of(&admission);
+    assert(stats.overloaded == 0 && stats.limit == 80);
+}
+
+void test_admission_bursts_are_no_overload(void) {
+    http_admission admission;
+    http_admission_init(&admission, &settings, 0);
+    // most requests of the interval queued, but the queue emptied in between
+    for (uint64_t i = 0; i < 10; i++) {
+        assert(http_admission_admit(&admission, (10 + i) * MS, 9 * MS) == HTTP_ADMISSION_ADMIT);
+        http_admission_complete(&admission);
+    }
+    assert(http_admission_admit(&admission, 60 * MS, 60 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+    assert(http_admission_admit(&admission, 120 * MS, 100 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_complete(&admission);
+    assert(stats_of(&admission).overloaded == 0);
+}
+
+void test_admission_limits_requests_in_flight(void) {
+    http_admission admission;
+    http_admission_init(&admission, &settings, 0);
+    for (size_t i = 0; i < 100; i++) assert(http_admission_admit(&admission, 1 * MS, 1 * MS) == HTTP_ADMISSION_ADMIT);
+    assert(http_admission_admit(&admission, 1 * MS, 1 * MS) == HTTP_ADMISSION_SHED_CONCURRENCY);
+    http_admission_complete(&admission);
+    assert(http_admission_admit(&admission, 2 * MS, 2 * MS) == HTTP_ADMISSION_ADMIT);
+    http_admission_stats stats = stats_of(&admission);
+    assert(stats.in_flight == 100 && stats.shed_concurrency == 1 && stats.admitted == 101);
+
+    // overloaded intervals cut the limit down to its minimum, but no further
+    uint64_t now = 0;
+    for (size_t i = 0; i < 20; i++) {
+        now += 100 * MS;
+        http_admission_admit(&admission, now, now - 50 * MS);
+    }
+    stats = stats_of(&admission);
+    assert(stats.limit == 4 && stats.overloaded == 1);
+    for (size_t i = 0; i < stats.in_flight; i++) http_admission_complete(&admission);
+
+    // and once the queue is gone, it grows back as far as it is reached
+    now += 100 * MS;
+    for (size_t i = 0; i < 4; i++) assert(http_admission_admit(&admission, now, now) == HTTP_ADMISSION_ADMIT);
+    assert(http_admission_admit(&admission, now, now) == HTTP_ADMISSION_SHED_CONCURRENCY);
+    now += 100 * MS;
+    assert(http_admission_admit(&admission, now, now) == HTTP_ADMISSION_ADMIT);
+    stats = stats_of(&admission);
+    assert(stats.limit == 5 && stats.overloaded == 0);
+    // not reached in this interval: it stays as it is
+    now += 100 * MS;
+    http_admission_complete(&admission);
+    assert(http_admission_admit(&admission, now, now) == HTTP_ADMISSION_ADMIT);
+    assert(stats_of(&admission).limit == 5);
+}
+
+int main() {
+    test_admission_sheds_requests_queued_too_long();
+    test_admission_detects_a_standing_queue();
+    test_admission_bursts_are_no_overload();
+    test_admission_limits_requests_in_flight();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,310 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_cache.h"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024,
+    .max_url_length = 8000
+};
+
+static http_header text_headers[] = {
+    {.name = "Content-Type", .value = "text/plain"},
+    {.name = "Last-Modified", .value = "Tue, 15 Oct 2024 10:00:00 GMT"},
+};
+
+static http_response ok_response(const char *body) {
+    return (http_response){
+        .version = HTTP_1_1,
+        .status_code = 200,
+        .reason_phrase = (uint8_t *) "OK",
+        .headers = text_headers,
+        .headers_cnt = 2,
+        .body = (uint8_t *) body,
+        .body_len = strlen(body),
+    };
+}
+
+static http_request *parse(const char *request) {
+    http_request *parsed = parse_http_request(&settings, (const uint8_t *) request, strlen(request));
+    assert(parsed != nullptr);
+    return parsed;
+}
+
+/**
+ * Stores `response` as the answer to `request`.
+ */
+static bool store(http_response_cache *cache, const char *request, const http_response *response) {
+    http_request *parsed = parse(request);
+    const bool stored = http_response_cache_store(cache, parsed, response);
+    destroy_http_request(parsed);
+    return stored;
+}
+
+/**
+ * Looks `request` up and, unless it misses, writes out what would be sent to `out`.
+ */
+static enum http_cache_lookup_result lookup(http_response_cache *cache, const char *request, char *out, const size_t cap) {
+    http_request *parsed = parse(request);
+    http_cached_response *cached = nullptr;
+    const enum http_cache_lookup_result result = http_response_cache_lookup(cache, parsed, &cached);
+    out[0] = '\0';
+    if (result != HTTP_CACHE_MISS) {
+        struct iovec iov[5];
+        const size_t iov_cnt = http_cached_response_iov(
+            cached, parsed->version, http_request_keep_alive(parsed), result == HTTP_CACHE_NOT_MODIFIED,
+            parsed->method == HEAD, nullptr, iov);
+        size_t len = 0;
+        for (size_t i = 0; i < iov_cnt; i++) {
+            assert(len + iov[i].iov_len < cap);
+            memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+            len += iov[i].iov_len;
+        }
+        out[len] = '\0';
+        http_cached_response_release(cached);
+    } else {
+        assert(cached == nullptr);
+    }
+    destroy_http_request(parsed);
+    return result;
+}
+
+void test_cache_serves_stored_responses(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    assert(cache != nullptr);
+    char out[1024];
+
+    assert(lookup(cache, "GET /a HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    const http_response response = ok_response("hello");
+    assert(store(cache, "GET /a HTTP/1.1\r\n\r\n", &response));
+
+    assert(lookup(cache, "GET /a HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    const char expected_head[] = "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Last-Modified: Tue, 15 Oct 2024 10:00:00 GMT\r\n"
+        "Content-Length: 5\r\n"
+        "ETag: \"";
+    assert(strncmp(out, expected_head, sizeof(expected_head) - 1) == 0);
+    assert(strcmp(out + strlen(out) - 9, "\r\n\r\nhello") == 0);
+
+    // the framing follows the request, not the one the response was stored for
+    assert(lookup(cache, "GET /a HTTP/1.0\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strncmp(out, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    assert(strstr(out, "Connection") == nullptr);
+    assert(lookup(cache, "GET /a HTTP/1.1\r\nConnection: close\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\nConnection: close\r\n\r\nhello") != nullptr);
+    assert(lookup(cache, "HEAD /a HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "Content-Length: 5\r\n") != nullptr);
+    assert(strcmp(out + strlen(out) - 4, "\r\n\r\n") == 0);
+
+    // other paths and queries are other responses
+    assert(lookup(cache, "GET /a?x=1 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    assert(lookup(cache, "GET /b HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    // and so is a request that asks for a fresh one
+    assert(lookup(cache, "GET /a HTTP/1.1\r\nCache-Control: no-cache\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    assert(lookup(cache, "GET /a HTTP/1.1\r\nAuthorization: Basic eA==\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+
+    http_response_cache_destroy(cache);
+}
+
+void test_cache_answers_conditional_requests(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    char out[1024];
+    http_header tagged_headers[] = {
+        {.name = "ETag", .value = "\"v1\""},
+        {.name = "Last-Modified", .value = "Tue, 15 Oct 2024 10:00:00 GMT"},
+        {.name = "Cache-Control", .value = "max-age=60"},
+    };
+    http_response response = ok_response("tagged");
+    response.headers = tagged_headers;
+    response.headers_cnt = 3;
+    assert(store(cache, "GET /t HTTP/1.1\r\n\r\n", &response));
+
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-None-Match: \"v0\", W/\"v1\"\r\n\r\n", out, sizeof(out))
+           == HTTP_CACHE_NOT_MODIFIED);
+    assert(strcmp(out, "HTTP/1.1 304 Not Modified\r\n"
+                  "ETag: \"v1\"\r\n"
+                  "Last-Modified: Tue, 15 Oct 2024 10:00:00 GMT\r\n"
+                  "Cache-Control: max-age=60\r\n"
+                  "\r\n") == 0);
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-None-Match: *\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_NOT_MODIFIED);
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-None-Match: \"v0\"\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\n\r\ntagged") != nullptr);
+
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-Modified-Since: Tue, 15 Oct 2024 10:00:00 GMT\r\n\r\n", out, sizeof(out))
+           == HTTP_CACHE_NOT_MODIFIED);
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-Modified-Since: Wed, 16 Oct 2024 00:00:00 GMT\r\n\r\n", out, sizeof(out))
+           == HTTP_CACHE_NOT_MODIFIED);
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-Modified-Since: Mon, 14 Oct 2024 10:00:00 GMT\r\n\r\n", out, sizeof(out))
+           == HTTP_CACHE_HIT);
+    assert(lookup(cache, "GET /t HTTP/1.1\r\nIf-Modified-Since: yesterday\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    // If-None-Match takes precedence
+    assert(lookup(cache,
+                  "GET /t HTTP/1.1\r\nIf-None-Match: \"v0\"\r\nIf-Modified-Since: Wed, 16 Oct 2024 00:00:00 GMT\r\n\r\n",
+                  out, sizeof(out)) == HTTP_CACHE_HIT);
+
+    // the `Date` is the one given as the response is sent, in either variant
+    const http_header_fragment date = HTTP_HEADER_FRAGMENT("Date", "Thu, 17 Oct 2024 10:00:00 GMT");
+    http_request *parsed = parse("GET /t HTTP/1.1\r\nIf-None-Match: \"v1\"\r\n\r\n");
+    http_cached_response *cached = nullptr;
+    assert(http_response_cache_lookup(cache, parsed, &cached) == HTTP_CACHE_NOT_MODIFIED);
+    struct iovec iov[5];
+    assert(http_cached_response_iov(cached, HTTP_1_1, false, true, false, &date, iov) == 4);
+    assert(strncmp(iov[1].iov_base, " 304 Not Modified\r\n", 19) == 0);
+    assert(iov[2].iov_base == date.octets && iov[2].iov_len == date.len);
+    assert(strncmp(iov[3].iov_base, "Connection: close\r\n\r\n", iov[3].iov_len) == 0);
+    assert(http_cached_response_iov(cached, HTTP_1_1, true, false, false, &date, iov) == 5);
+    assert(strncmp(iov[1].iov_base, " 200 OK\r\n", 9) == 0);
+    assert(iov[2].iov_base == date.octets && iov[2].iov_len == date.len);
+    assert(strncmp(iov[3].iov_base, "\r\n", iov[3].iov_len) == 0);
+    assert(strncmp(iov[4].iov_base, "tagged", iov[4].iov_len) == 0);
+    http_cached_response_release(cached);
+    destroy_http_request(parsed);
+
+    http_response_cache_destroy(cache);
+}
+
+void test_cache_refuses_uncacheable_responses(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    http_response response = ok_response("x");
+    assert(!store(cache, "POST /p HTTP/1.1\r\nContent-Length: 0\r\n\r\n", &response));
+    response.status_code = 404;
+    assert(!store(cache, "GET /p HTTP/1.1\r\n\r\n", &response));
+
+    http_header private_headers[] = {{.name = "Cache-Control", .value = "max-age=0, private"}};
+    response = ok_response("x");
+    response.headers = private_headers;
+    response.headers_cnt = 1;
+    assert(!store(cache, "GET /p HTTP/1.1\r\n\r\n", &response));
+    http_header cookie_headers[] = {{.name = "Set-Cookie", .value = "a=b"}};
+    response.headers = cookie_headers;
+    assert(!store(cache, "GET /p HTTP/1.1\r\n\r\n", &response));
+
+    response = ok_response("x");
+    response.body_file = (http_file_body){.fd = 0, .len = 10};
+    assert(!store(cache, "GET /p HTTP/1.1\r\n\r\n", &response));
+    http_response_cache_destroy(cache);
+}
+
+void test_cache_varies_on_request_headers(void) {
+    const http_header_id vary[] = {HTTP_HEADER_ACCEPT_ENCODING};
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024, .vary = vary, .vary_cnt = 1};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    char out[1024];
+    const http_response plain = ok_response("plain");
+    const http_response gzip = ok_response("gzipped");
+    assert(store(cache, "GET /v HTTP/1.1\r\n\r\n", &plain));
+    assert(store(cache, "GET /v HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n", &gzip));
+
+    assert(lookup(cache, "GET /v HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\n\r\nplain") != nullptr);
+    assert(lookup(cache, "GET /v HTTP/1.1\r\naccept-encoding: gzip\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\n\r\ngzipped") != nullptr);
+    // an empty value is not the same as none
+    assert(lookup(cache, "GET /v HTTP/1.1\r\nAccept-Encoding: \r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    http_response_cache_destroy(cache);
+}
+
+void test_cache_varies_on_content_coding(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024, .vary_content_coding = true};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    char out[1024];
+    http_header gzip_headers[] = {
+        {.name = "Content-Type", .value = "text/plain"},
+        {.name = "Vary", .value = "Accept-Encoding"},
+        {.name = "Content-Encoding", .value = "gzip"},
+    };
+    http_response gzip = ok_response("gzipped");
+    gzip.headers = gzip_headers;
+    gzip.headers_cnt = 3;
+    http_response plain = ok_response("plain");
+    plain.headers = gzip_headers;
+    plain.headers_cnt = 2;
+    assert(store(cache, "GET /c HTTP/1.1\r\nAccept-Encoding: gzip, br\r\n\r\n", &gzip));
+    assert(store(cache, "GET /c HTTP/1.1\r\n\r\n", &plain));
+
+    // keyed by what is negotiated, not by how it is asked for
+    assert(lookup(cache, "GET /c HTTP/1.1\r\nAccept-Encoding: deflate;q=0.5, x-gzip\r\n\r\n", out, sizeof(out))
+        == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\n\r\ngzipped") != nullptr);
+    assert(lookup(cache, "GET /c HTTP/1.1\r\nAccept-Encoding: br\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(strstr(out, "\r\n\r\nplain") != nullptr);
+    assert(lookup(cache, "GET /c HTTP/1.1\r\nAccept-Encoding: deflate\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+
+    // a response varying on something the key does not have is not stored
+    http_header origin_headers[] = {{.name = "Vary", .value = "Accept-Encoding, Origin"}};
+    http_response origin = ok_response("origin");
+    origin.headers = origin_headers;
+    origin.headers_cnt = 1;
+    assert(!store(cache, "GET /o HTTP/1.1\r\n\r\n", &origin));
+    origin_headers[0].value = "*";
+    assert(!store(cache, "GET /o HTTP/1.1\r\n\r\n", &origin));
+    http_response_cache_destroy(cache);
+
+    // nor is a compressed one in a cache that does not vary on the coding
+    cache = http_response_cache_create(&(http_response_cache_settings){.max_bytes = 64 * 1024});
+    assert(!store(cache, "GET /c HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n", &gzip));
+    http_response_cache_destroy(cache);
+}
+
+void test_cache_evicts_and_expires(void) {
+    // a single shard with room for about three of these responses
+    char body[1024];
+    memset(body, 'b', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+    const http_response_cache_settings cache_settings = {.max_bytes = 3 * 1500, .shards = 1, .ttl_seconds = 1};
+    http_response_cache *cache = http_response_cache_create(&cache_settings);
+    char out[2048];
+    char request[64];
+    const http_response response = ok_response(body);
+    for (int i = 0; i < 4; i++) {
+        snprintf(request, sizeof(request), "GET /%d HTTP/1.1\r\n\r\n", i);
+        assert(store(cache, request, &response));
+        if (i == 1) {
+            // /0 is now the most recently used, /1 the least
+            assert(lookup(cache, "GET /0 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+        }
+    }
+    assert(lookup(cache, "GET /1 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    assert(lookup(cache, "GET /0 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+    assert(lookup(cache, "GET /3 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_HIT);
+
+    // an entry still being sent survives its eviction
+    http_request *parsed = parse("GET /3 HTTP/1.1\r\n\r\n");
+    http_cached_response *in_flight = nullptr;
+    assert(http_response_cache_lookup(cache, parsed, &in_flight) == HTTP_CACHE_HIT);
+    const http_response replacement = ok_response("new");
+    assert(store(cache, "GET /3 HTTP/1.1\r\n\r\n", &replacement));
+    struct iovec iov[5];
+    assert(http_cached_response_iov(in_flight, HTTP_1_1, true, false, false, nullptr, iov) == 4);
+    assert(iov[3].iov_len == sizeof(body) - 1);
+    http_cached_response_release(in_flight);
+    destroy_http_request(parsed);
+
+    sleep(2);
+    assert(lookup(cache, "GET /0 HTTP/1.1\r\n\r\n", out, sizeof(out)) == HTTP_CACHE_MISS);
+    http_response_cache_destroy(cache);
+}
+
+int main() {
+    test_cache_serves_stored_responses();
+    test_cache_answers_conditional_requests();
+    test_cache_refuses_uncacheable_responses();
+    test_cache_varies_on_request_headers();
+    test_cache_varies_on_content_coding();
+    test_cache_evicts_and_expires();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_chunked.h"
+
+/**
+ * Decodes `encoded` in pieces of `piece_len` octets into `body`.
+ *
+ * @return the final result, with `*consumed` octets of `encoded` used up
+ */
+static enum http_chunked_decode_result decode_in_pieces(
+    const uint8_t *encoded,
+    const size_t encoded_len,
+    const size_t piece_len,
+    const size_t max_body_len,
+    uint8_t *body,
+    size_t *body_len,
+    size_t *consumed) {
+    http_chunked_decoder decoder;
+    http_chunked_decoder_init(&decoder, max_body_len);
+    *body_len = 0;
+    *consumed = 0;
+    while (true) {
+        const size_t available = *consumed + piece_len < encoded_len ? piece_len : encoded_len - *consumed;
+        size_t piece_consumed = 0;
+        http_slice data = {};
+        const enum http_chunked_decode_result result =
+                http_chunked_decoder_feed(&decoder, encoded + *consumed, available, &piece_consumed, &data);
+        *consumed += piece_consumed;
+        if (result == HTTP_CHUNKED_DATA) {
+            memcpy(body + *body_len, data.ptr, data.len);
+            *body_len += data.len;
+            continue;
+        }
+        if (result == HTTP_CHUNKED_NEED_MORE && *consumed < encoded_len) continue;
+        assert(decoder.body_len == *body_len);
+        return result;
+    }
+}
+
+void test_chunked_decode_in_every_piece_size(void) {
+    const uint8_t encoded[] = "4\r\nWiki\r\n"
+            "7;ext=\"quoted\"\r\npedia i\r\n"
+            "0000B\r\nn \r\nchunks.\r\n"
+            "0\r\n"
+            "Trailer-One: 1\r\n"
+            "Trailer-Two: 2\r\n"
+            "\r\n"
+            "next";
+    const size_t encoded_len = strlen((char *) encoded);
+    for (size_t piece_len = 1; piece_len <= encoded_len; piece_len++) {
+        uint8_t body[64];
+        size_t body_len = 0;
+        size_t consumed = 0;
+        assert(decode_in_pieces(encoded, encoded_len, piece_len, 1024, body, &body_len, &consumed)
+            == HTTP_CHUNKED_COMPLETE);
+        assert(consumed == encoded_len - 4);
+        assert(body_len == 22);
+        assert(memcmp(body, "Wikipedia in \r\nchunks.", 22) == 0);
+    }
+}
+
+void test_chunked_decode_rejects_bad_framing(void) {
+    const char *malformed[] = {
+        "\r\n",                       // no chunk size
+        "g\r\n",                      // not hex
+        "5\nhello\r\n0\r\n\r\n",      // bare LF
+        "5\r\nhelloX\r\n0\r\n\r\n",   // data longer than its size
+        "1234567890abcdef0\r\n",      // size overflows
+        "0\r\nbad trailer\n\r\n",     // bare LF in the trailer section
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        uint8_t body[64];
+        size_t body_len = 0;
+        size_t consumed = 0;
+        assert(decode_in_pieces((const uint8_t *) malformed[i], strlen(malformed[i]), 1000, 1024, body, &body_len,
+            &consumed) == HTTP_CHUNKED_MALFORMED);
+    }
+
+    uint8_t body[64];
+    size_t body_len = 0;
+    size_t consumed = 0;
+    const uint8_t too_large[] = "8\r\n12345678\r\n9\r\n123456789\r\n0\r\n\r\n";
+    assert(decode_in_pieces(too_large, strlen((char *) too_large), 1000, 16, body, &body_len, &consumed)
+        == HTTP_CHUNKED_TOO_LARGE);
+    assert(body_len == 8);
+
+    const uint8_t truncated[] = "5\r\nhel";
+    assert(decode_in_pieces(truncated, strlen((char *) truncated), 2, 1024, body, &body_len, &consumed)
+        == HTTP_CHUNKED_NEED_MORE);
+    assert(consumed == strlen((char *) truncated));
+}
+
+void test_response_writer_chunked(void) {
+    uint8_t buf[HTTP_RESPONSE_WRITER_MIN_CAPACITY];
+    http_response_writer writer;
+    http_response_writer_init(&writer, buf, sizeof(buf), true);
+    assert(http_response_writer_write(&writer, "hello", 5) == 5);
+    // 32 - 10 ("5\r\nhello\r\n") - 5 (last chunk) leaves 17: 12 octets of data framed as "c\r\n...\r\n"
+    const char *long_data = "a piece of data longer than the buffer";
+    const size_t taken = http_response_writer_write(&writer, long_data, strlen(long_data));
+    assert(taken == 12);
+    assert(http_response_writer_write(&writer, long_data + taken, strlen(long_data) - taken) == 0);
+    http_response_writer_end(&writer);
+    assert(writer.len == sizeof(buf));
+    assert(memcmp(buf, "5\r\nhello\r\nc\r\na piece of d\r\n0\r\n\r\n", sizeof(buf)) == 0);
+    assert(http_response_writer_write(&writer, "late", 4) == 0);
+
+    http_response_writer_clear(&writer);
+    assert(writer.len == 0);
+}
+
+void test_response_writer_identity(void) {
+    uint8_t buf[HTTP_RESPONSE_WRITER_MIN_CAPACITY];
+    http_response_writer writer;
+    http_response_writer_init(&writer, buf, sizeof(buf), false);
+    const char *long_data = "a piece of data longer than the buffer";
+    assert(http_response_writer_write(&writer, long_data, strlen(long_data)) == sizeof(buf));
+    http_response_writer_end(&writer);
+    assert(writer.len == sizeof(buf));
+    assert(memcmp(buf, long_data, sizeof(buf)) == 0);
+}
+
+int main() {
+    test_chunked_decode_in_every_piece_size();
+    test_chunked_decode_rejects_bad_framing();
+    test_response_writer_chunked();
+    test_response_writer_identity();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,314 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "../src/tiny_http/tiny_http_compress.h"
+#include "tiny_http_test_helpers.h"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024,
+    .max_url_length = 2000,
+};
+
+/**
+ * @return a JSON document of `len` octets that compresses well
+ */
+static uint8_t *json_body(const size_t len) {
+    uint8_t *body = malloc(len);
+    assert(body != nullptr);
+    for (size_t i = 0; i < len; i++) body[i] = (uint8_t) "{\"id\":42,\"name\":\"tiny\"},"[i % 24];
+    return body;
+}
+
+/**
+ * Inflates `octets` (gzip or zlib, told apart by their header) and compares them with `expected`.
+ */
+static void assert_inflates_to(const uint8_t *octets, const size_t len, const uint8_t *expected, const size_t expected_len) {
+    uint8_t *inflated = malloc(expected_len + 1);
+    z_stream z = {};
+    assert(inflateInit2(&z, 15 + 32) == Z_OK);
+    z.next_in = (Bytef *) octets;
+    z.avail_in = (uInt) len;
+    z.next_out = inflated;
+    z.avail_out = (uInt) expected_len + 1;
+    assert(inflate(&z, Z_FINISH) == Z_STREAM_END);
+    assert(z.total_out == expected_len && memcmp(inflated, expected, expected_len) == 0);
+    inflateEnd(&z);
+    free(inflated);
+}
+
+void test_negotiate_content_coding(void) {
+    static const struct {
+        const char *accept_encoding;
+        http_content_coding coding;
+    } cases[] = {
+        {"gzip, deflate, br", HTTP_CODING_GZIP},
+        {"deflate, gzip", HTTP_CODING_GZIP},
+        {"deflate", HTTP_CODING_DEFLATE},
+        {"br, zstd", HTTP_CODING_IDENTITY},
+        {"gzip;q=0.5, deflate", HTTP_CODING_DEFLATE},
+        {"gzip; q=0.8, deflate;q=0.9", HTTP_CODING_DEFLATE},
+        {"GZIP;Q=1.000", HTTP_CODING_GZIP},
+        {"x-gzip", HTTP_CODING_GZIP},
+        {"gzip;q=0, deflate;q=0", HTTP_CODING_IDENTITY},
+        {"*", HTTP_CODING_GZIP},
+        {"*;q=0.1, gzip;q=0", HTTP_CODING_DEFLATE},
+        {"identity", HTTP_CODING_IDENTITY},
+        {"gzip;q=2", HTTP_CODING_IDENTITY},
+        {"", HTTP_CODING_IDENTITY},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char request[256];
+        snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nAccept-Encoding: %s\r\n\r\n", cases[i].accept_encoding);
+        http_request *parsed = parse(request);
+        assert(http_content_coding_negotiate(parsed) == cases[i].coding);
+        destroy_http_request(parsed);
+    }
+    http_request *parsed = parse("GET / HTTP/1.1\r\n\r\n");
+    assert(http_content_coding_negotiate(parsed) == HTTP_CODING_IDENTITY);
+    destroy_http_request(parsed);
+    assert(strcmp(http_content_coding_name(HTTP_CODING_GZIP), "gzip") == 0);
+    assert(http_content_coding_name(HTTP_CODING_IDENTITY) == nullptr);
+}
+
+void test_compress_in_memory_body(void) {
+    const http_compression_settings compression = {.max_cached_bytes = 1024 * 1024};
+    http_compressor *compressor = http_compressor_create(&compression);
+    assert(compressor != nullptr);
+    const size_t body_len = 8 * 1024;
+    uint8_t *body = json_body(body_len);
+    http_header headers[] = {
+        {.name = "Content-Type", .value = "application/json"},
+        {.name = "Content-Length", .value = "8192"},
+        {.name = "ETag", .value = "\"v1\""},
+    };
+
+    http_compressed_variant *variants[2];
+    for (size_t i = 0; i < 2; i++) {
+        http_request *request = parse("GET /items HTTP/1.1\r\nAccept-Encoding: gzip, deflate, br\r\n\r\n");
+        http_response response = {
+            .version = HTTP_1_1, .status_code = 200, .headers = headers, .headers_cnt = 3,
+            .body = body, .body_len = body_len,
+        };
+        assert(http_compress_response(compressor, request, &response, &variants[i]));
+        assert(variants[i] != nullptr);
+        assert(strcmp(header_value(&response, "Content-Encoding"), "gzip") == 0);
+        assert(strcmp(header_value(&response, "Vary"), "Accept-Encoding") == 0);
+        assert(strcmp(header_value(&response, "ETag"), "\"v1-gzip\"") == 0);
+        assert(header_value(&response, "Content-Length") == nullptr);
+        assert(response.body_len < body_len / 10);
+        assert_inflates_to(response.body, response.body_len, body, body_len);
+        destroy_http_request(request);
+    }
+    // the second time round the body was found, not compressed again
+    assert(variants[0] == variants[1]);
+    // the handler's headers are left alone
+    assert(strcmp(headers[2].value, "\"v1\"") == 0);
+    http_compressed_variant_release(variants[0]);
+    http_compressed_variant_release(variants[1]);
+
+    // the same body, asked for in another coding, is another variant
+    http_request *request = parse("GET /items HTTP/1.1\r\nAccept-Encoding: deflate\r\nConnection: close\r\n\r\n");
+    http_response response = {
+        .version = HTTP_1_1, .status_code = 200, .headers = headers, .headers_cnt = 1,
+        .body = body, .body_len = body_len,
+    };
+    http_compressed_variant *deflated = nullptr;
+    assert(http_compress_response(compressor, request, &response, &deflated));
+    assert(deflated != nullptr && deflated != variants[0]);
+    assert(strcmp(header_value(&response, "Content-Encoding"), "deflate") == 0);
+    assert(response.body[0] == 0x78); // a zlib header, no gzip one
+    assert_inflates_to(response.body, response.body_len, body, body_len);
+    http_compressed_variant_release(deflated);
+    destroy_http_request(request);
+
+    http_compressor_destroy(compressor);
+    free(body);
+}
+
+void test_compress_skips_what_is_not_worth_it(void) {
+    const http_compression_settings compression = {.min_length = 100, .max_cached_bytes = 1024 * 1024};
+    http_compressor *compressor = http_compressor_create(&compression);
+    uint8_t *body = json_body(4096);
+    uint8_t noise[4096];
+    uint32_t state = 1;
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        state = state * 1103515245 + 12345;
+        noise[i] = (uint8_t) (state >> 16);
+    }
+    http_header json[] = {{.name = "Content-Type", .value = "application/json; charset=utf-8"}};
+    http_header png[] = {{.name = "Content-Type", .value = "image/png"}};
+    http_header encoded[] = {
+        {.name = "Content-Type", .value = "text/plain"},
+        {.name = "Content-Encoding", .value = "br"},
+    };
+    http_header no_transform[] = {
+        {.name = "Content-Type", .value = "text/plain"},
+        {.name = "Cache-Control", .value = "public, no-transform"},
+    };
+    http_header vary[] = {
+        {.name = "Content-Type", .value = "text/plain"},
+        {.name = "Vary", .value = "Origin"},
+    };
+    const struct {
+        http_response response;
+        /// whether `Vary: Accept-Encoding` is expected: the response would be compressed for some client
+        const char *vary;
+    } cases[] = {
+        {{.status_code = 200, .headers = json, .headers_cnt = 1, .body = body, .body_len = 99}, nullptr},
+        {{.status_code = 200, .headers = png, .headers_cnt = 1, .body = body, .body_len = 4096}, nullptr},
+        {{.status_code = 200, .headers = encoded, .headers_cnt = 2, .body = body, .body_len = 4096}, nullptr},
+        {{.status_code = 200, .headers = no_transform, .headers_cnt = 2, .body = body, .body_len = 4096}, nullptr},
+        {{.status_code = 206, .headers = json, .headers_cnt = 1, .body = body, .body_len = 4096}, nullptr},
+        {{.status_code = 404, .headers = json, .headers_cnt = 1, .body = body, .body_len = 4096}, nullptr},
+        {{.status_code = 200, .headers = json, .headers_cnt = 1}, nullptr},
+        // does not get any smaller: left as it is, but it was worth a try
+        {{.status_code = 200, .headers = json, .headers_cnt = 1, .body = noise, .body_len = sizeof(noise)}, "Accept-Encoding"},
+        {{.status_code = 200, .headers = vary, .headers_cnt = 2, .body = noise, .body_len = sizeof(noise)}, "Origin, Accept-Encoding"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        // twice: the noise is remembered as not worth compressing the second time
+        for (size_t round = 0; round < 2; round++) {
+            http_request *request = parse("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+            http_response response = cases[i].response;
+            http_compressed_variant *variant = nullptr;
+            assert(http_compress_response(compressor, request, &response, &variant));
+            assert(variant == nullptr);
+            assert(response.body == cases[i].response.body && response.body_len == cases[i].response.body_len);
+            assert(header_value(&response, "Content-Encoding") == header_value(&cases[i].response, "Content-Encoding"));
+            const char *vary_value = header_value(&response, "Vary");
+            assert(cases[i].vary != nullptr
+                       ? vary_value != nullptr && strcmp(vary_value, cases[i].vary) == 0
+                       : vary_value == header_value(&cases[i].response, "Vary"));
+            destroy_http_request(request);
+        }
+    }
+
+    // a client without compression still learns that the response varies
+    http_request *request = parse("GET / HTTP/1.1\r\n\r\n");
+    http_response response = {.status_code = 200, .headers = json, .headers_cnt = 1, .body = body, .body_len = 4096};
+    http_compressed_variant *variant = nullptr;
+    assert(http_compress_response(compressor, request, &response, &variant));
+    assert(variant == nullptr && response.body == body && header_value(&response, "Content-Encoding") == nullptr);
+    assert(strcmp(header_value(&response, "Vary"), "Accept-Encoding") == 0);
+    destroy_http_request(request);
+
+    http_compressor_destroy(compressor);
+    free(body);
+}
+
+void test_compress_file_body(void) {
+    const http_compression_settings compression = {.max_cached_bytes = 1024 * 1024, .shards = 1};
+    http_compressor *compressor = http_compressor_create(&compression);
+    char path[] = "/tmp/tiny_http_compress_XXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    const size_t body_len = 16 * 1024;
+    uint8_t *body = json_body(body_len);
+    assert(write(fd, body, body_len) == (ssize_t) body_len);
+    http_header headers[] = {
+        {.name = "Content-Type", .value = "text/html"},
+        {.name = "ETag", .value = "W/\"weak\""},
+    };
+
+    size_t released = 0;
+    http_compressed_variant *first = nullptr;
+    for (size_t i = 0; i < 3; i++) {
+        if (i == 2) {
+            // changed on disk: compressed afresh
+            assert(pwrite(fd, "[", 1, 0) == 1);
+            body[0] = '[';
+            struct timespec later[2] = {{.tv_nsec = UTIME_OMIT}, {.tv_sec = 1}};
+            assert(futimens(fd, later) == 0);
+        }
+        http_request *request = parse("GET /index.html HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+        http_response response = {
+            .status_code = 200, .headers = headers, .headers_cnt = 2,
+            .body_file = {.fd = fd, .len = body_len, .release = count_release, .release_state = &released},
+        };
+        http_compressed_variant *variant = nullptr;
+        assert(http_compress_response(compressor, request, &response, &variant));
+        assert(variant != nullptr && released == i + 1 && response.body_file.len == 0);
+        // a weak validator stays as it is
+        assert(strcmp(header_value(&response, "ETag"), "W/\"weak\"") == 0);
+        assert_inflates_to(response.body, response.body_len, body, body_len);
+        if (i == 0) first = variant;
+        if (i == 1) assert(variant == first);
+        if (i == 2) assert(variant != first);
+        if (i > 0) http_compressed_variant_release(variant);
+        destroy_http_request(request);
+    }
+    http_compressed_variant_release(first);
+
+    close(fd);
+    unlink(path);
+    http_compressor_destroy(compressor);
+    free(body);
+}
+
+void test_compress_variant_outlives_eviction(void) {
+    // a single shard with room for about one variant of these bodies
+    const http_compression_settings compression = {.min_length = 16, .max_cached_bytes = 6 * 1024, .shards = 1};
+    http_compressor *compressor = http_compressor_create(&compression);
+    http_header headers[] = {{.name = "Content-Type", .value = "text/plain"}};
+    uint8_t *bodies[4];
+    http_compressed_variant *held = nullptr;
+    for (size_t i = 0; i < 4; i++) {
+        bodies[i] = json_body(4096);
+        bodies[i][0] = (uint8_t) ('a' + i);
+        http_request *request = parse("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+        http_response response = {.status_code = 200, .headers = headers, .headers_cnt = 1, .body = bodies[i], .body_len = 4096};
+        http_compressed_variant *variant = nullptr;
+        assert(http_compress_response(compressor, request, &response, &variant) && variant != nullptr);
+        if (i == 0) held = variant;
+        else http_compressed_variant_release(variant);
+        destroy_http_request(request);
+    }
+    // evicted long since, still readable
+    http_request *request = parse("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    http_response response = {.status_code = 200, .headers = headers, .headers_cnt = 1, .body = bodies[0], .body_len = 4096};
+    http_compressed_variant *again = nullptr;
+    assert(http_compress_response(compressor, request, &response, &again) && again != held);
+    assert_inflates_to(response.body, response.body_len, bodies[0], 4096);
+    http_compressed_variant_release(again);
+    destroy_http_request(request);
+    http_compressed_variant_release(held);
+
+    // no cache at all: every variant is the caller's alone
+    http_compressor_destroy(compressor);
+    compressor = http_compressor_create(&(http_compression_settings){});
+    request = parse("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    response = (http_response){.status_code = 200, .headers = headers, .headers_cnt = 1, .body = bodies[1], .body_len = 4096};
+    http_compressed_variant *variant = nullptr;
+    assert(http_compress_response(compressor, request, &response, &variant) && variant != nullptr);
+    assert_inflates_to(response.body, response.body_len, bodies[1], 4096);
+    http_compressed_variant_release(variant);
+    destroy_http_request(request);
+    http_compressor_destroy(compressor);
+    for (size_t i = 0; i < 4; i++) free(bodies[i]);
+}
+
+int main() {
+    arena = http_arena_create(4096);
+    assert(arena != nullptr);
+    test_negotiate_content_coding();
+    test_compress_in_memory_body();
+    test_compress_skips_what_is_not_worth_it();
+    test_compress_file_body();
+    test_compress_variant_outlives_eviction();
+    http_arena_destroy(arena);
+
+    return EXIT_SUCCESS;
+}
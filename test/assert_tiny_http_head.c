@@ -0,0 +1,74 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/tiny_http/tiny_http_head.h"
+
+static bool status_line_is(const bool http_1_1, const uint16_t status_code, const char *expected) {
+    size_t len = 0;
+    const char *line = http_status_line(http_1_1, status_code, &len);
+    return line != nullptr && len == strlen(expected) && memcmp(line, expected, len) == 0;
+}
+
+#define ASSERT_STATUS_LINE(code, reason) \
+    assert(strcmp(http_status_reason(code), reason) == 0); \
+    assert(status_line_is(false, code, "HTTP/1.0 " #code " " reason "\r\n")); \
+    assert(status_line_is(true, code, "HTTP/1.1 " #code " " reason "\r\n"));
+
+void test_every_status_code_has_its_line(void) {
+    HTTP_STATUS_CODES(ASSERT_STATUS_LINE)
+    assert(status_line_is(true, 404, "HTTP/1.1 404 Not Found\r\n"));
+}
+
+void test_unknown_status_codes_have_no_line(void) {
+    size_t len = 42;
+    assert(http_status_line(true, 299, &len) == nullptr);
+    assert(http_status_line(true, 99, &len) == nullptr);
+    assert(http_status_line(false, 600, &len) == nullptr);
+    assert(http_status_line(false, 0, &len) == nullptr);
+    assert(len == 42);
+    assert(http_status_reason(299) == nullptr);
+    assert(http_status_reason(1000) == nullptr);
+}
+
+void test_header_fragments(void) {
+    const http_header_fragment fragment = HTTP_HEADER_FRAGMENT("Content-Type", "application/json");
+    assert(fragment.len == strlen("Content-Type: application/json\r\n"));
+    assert(strcmp(fragment.octets, "Content-Type: application/json\r\n") == 0);
+}
+
+void test_date_header(void) {
+    const http_header_fragment date = http_date_header();
+    assert(date.len == strlen("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"));
+    assert(strncmp(date.octets, "Date: ", 6) == 0);
+    assert(memcmp(date.octets + date.len - 6, " GMT\r\n", 6) == 0);
+
+    // the same second, formatted the way strptime reads it back
+    struct tm tm = {0};
+    char copy[64];
+    memcpy(copy, date.octets, date.len);
+    copy[date.len] = '\0';
+    assert(strptime(copy, "Date: %a, %d %b %Y %H:%M:%S GMT", &tm) != nullptr);
+    const time_t formatted = timegm(&tm);
+    const time_t now = time(nullptr);
+    assert(formatted <= now && now - formatted <= 2);
+
+    // formatted once per second: within the second the same octets come back
+    const http_header_fragment again = http_date_header();
+    assert(again.octets == date.octets);
+}
+
+int main() {
+    test_every_status_code_has_its_line();
+    test_unknown_status_codes_have_no_line();
+    test_header_fragments();
+    test_date_header();
+
+    return EXIT_SUCCESS;
+}
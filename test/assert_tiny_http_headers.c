@@ -0,0 +1,59 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_headers.h"
+
+static http_header_id lookup(const char *name) {
+    return http_header_lookup((const uint8_t *) name, strlen(name));
+}
+
+#define ASSERT_KNOWN_HEADER(id, name, first, last) \
+    assert((first) == (name)[0] && (last) == (name)[sizeof(name) - 2]); \
+    assert(lookup(name) == HTTP_HEADER_##id); \
+    assert(strcmp(http_header_id_name(HTTP_HEADER_##id), name) == 0);
+
+void test_every_known_header_interns_to_itself(void) {
+    HTTP_KNOWN_HEADERS(ASSERT_KNOWN_HEADER)
+}
+
+void test_lookup_ignores_case(void) {
+    char name[32];
+    for (int id = HTTP_HEADER_UNKNOWN + 1; id < HTTP_HEADER_ID_COUNT; id++) {
+        const char *canonical = http_header_id_name(id);
+        const size_t len = strlen(canonical);
+        for (size_t i = 0; i < len; i++) name[i] = (char) tolower((unsigned char) canonical[i]);
+        assert(http_header_lookup((const uint8_t *) name, len) == (http_header_id) id);
+        for (size_t i = 0; i < len; i++) name[i] = (char) toupper((unsigned char) canonical[i]);
+        assert(http_header_lookup((const uint8_t *) name, len) == (http_header_id) id);
+    }
+}
+
+void test_lookup_rejects_unknown_names(void) {
+    assert(http_header_lookup(nullptr, 0) == HTTP_HEADER_UNKNOWN);
+    assert(lookup("X-Custom") == HTTP_HEADER_UNKNOWN);
+    assert(lookup("Hosts") == HTTP_HEADER_UNKNOWN);
+    assert(lookup("Content-Lengt") == HTTP_HEADER_UNKNOWN);
+    // same length, first and last octet as a known name: the hash matches, the comparison must not
+    assert(lookup("Content-Lxngth") == HTTP_HEADER_UNKNOWN);
+    assert(lookup("H!st") == HTTP_HEADER_UNKNOWN);
+    assert(lookup("If-Unmodified-Since-Ever-Again") == HTTP_HEADER_UNKNOWN);
+    // only the first `len` octets are the name
+    assert(http_header_lookup((const uint8_t *) "Hostname", 4) == HTTP_HEADER_HOST);
+    assert(http_header_id_name(HTTP_HEADER_UNKNOWN) == nullptr);
+    assert(http_header_id_name(HTTP_HEADER_ID_COUNT) == nullptr);
+}
+
+int main() {
+    test_every_known_header_interns_to_itself();
+    test_lookup_ignores_case();
+    test_lookup_rejects_unknown_names();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_lru.h"
+
+typedef struct test_entry {
+    http_lru_entry lru;
+    int key;
+} test_entry;
+
+static size_t freed;
+
+static bool test_entry_matches(const http_lru_entry *entry, const void *key) {
+    return ((const test_entry *) entry)->key == *(const int *) key;
+}
+
+static void test_entry_free(http_lru_entry *entry) {
+    freed++;
+    free(entry);
+}
+
+/**
+ * @return a new entry of `size` for `key`, hashed as the key itself: small keys all go in the first shard
+ */
+static test_entry *new_entry(http_lru *lru, const int key, const size_t size) {
+    test_entry *entry = malloc(sizeof(test_entry));
+    assert(entry != nullptr);
+    entry->key = key;
+    http_lru_entry_init(lru, &entry->lru, (uint64_t) key, size);
+    return entry;
+}
+
+void test_lru_evicts_least_recently_used(void) {
+    http_lru lru;
+    assert(http_lru_init(&lru, 1, 3, test_entry_matches, test_entry_free));
+    freed = 0;
+    for (int key = 1; key <= 3; key++) {
+        test_entry *entry = new_entry(&lru, key, 1);
+        assert(http_lru_add(&lru, &entry->lru, &key));
+        http_lru_release(&entry->lru);
+    }
+    // 1 is used again, so 2 is the one to go
+    const int one = 1;
+    http_lru_entry *held = http_lru_acquire(&lru, 1, &one);
+    assert(held != nullptr && ((test_entry *) held)->key == 1);
+    http_lru_release(held);
+
+    const int four = 4;
+    test_entry *entry = new_entry(&lru, four, 1);
+    assert(http_lru_add(&lru, &entry->lru, &four));
+    http_lru_release(&entry->lru);
+    const int two = 2;
+    assert(http_lru_acquire(&lru, 2, &two) == nullptr);
+    assert(freed == 1);
+
+    // larger than the whole budget: never kept
+    const int five = 5;
+    entry = new_entry(&lru, five, 4);
+    assert(!http_lru_add(&lru, &entry->lru, &five));
+    http_lru_release(&entry->lru);
+    assert(freed == 2);
+
+    http_lru_destroy(&lru);
+    assert(freed == 5);
+}
+
+void test_lru_keeps_held_entries_alive(void) {
+    http_lru lru;
+    assert(http_lru_init(&lru, 4, 4 * 8, test_entry_matches, test_entry_free));
+    freed = 0;
+    const int key = 7;
+    test_entry *first = new_entry(&lru, key, 1);
+    assert(http_lru_add(&lru, &first->lru, &key));
+
+    // replaced while still held: out of the cache, but not freed until released
+    test_entry *second = new_entry(&lru, key, 1);
+    assert(http_lru_add(&lru, &second->lru, &key));
+    assert(!first->lru.cached && second->lru.cached);
+    assert(freed == 0);
+    http_lru_release(&first->lru);
+    assert(freed == 1);
+
+    http_lru_entry *found = http_lru_acquire(&lru, (uint64_t) key, &key);
+    assert(found == &second->lru);
+    http_lru_release(found);
+    http_lru_release(&second->lru);
+
+    http_lru_destroy(&lru);
+    assert(freed == 2);
+}
+
+void test_lru_without_shards(void) {
+    http_lru lru;
+    assert(http_lru_init(&lru, 0, 0, test_entry_matches, test_entry_free));
+    freed = 0;
+    const int key = 1;
+    test_entry *entry = new_entry(&lru, key, 1);
+    assert(!http_lru_add(&lru, &entry->lru, &key));
+    assert(http_lru_acquire(&lru, 1, &key) == nullptr);
+    http_lru_release(&entry->lru);
+    assert(freed == 1);
+    http_lru_destroy(&lru);
+}
+
+int main() {
+    test_lru_evicts_least_recently_used();
+    test_lru_keeps_held_entries_alive();
+    test_lru_without_shards();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_log.h"
+#include "../src/tiny_http/tiny_http_metrics.h"
+
+#define COUNTING_THREADS 4
+#define COUNTS_PER_THREAD 10000
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024,
+    .max_url_length = 2000,
+};
+
+static void *count_requests(void *arg) {
+    (void) arg;
+    for (size_t i = 0; i < COUNTS_PER_THREAD; i++) {
+        http_metrics_count(HTTP_METRIC_REQUESTS, 1);
+        http_metrics_count(HTTP_METRIC_BYTES_IN, 3);
+    }
+    return nullptr;
+}
+
+void test_metrics_add_up_across_threads(void) {
+    http_metrics_snapshot before;
+    http_metrics_load(&before);
+    pthread_t threads[COUNTING_THREADS];
+    for (size_t i = 0; i < COUNTING_THREADS; i++) {
+        assert(pthread_create(&threads[i], nullptr, count_requests, nullptr) == 0);
+    }
+    for (size_t i = 0; i < COUNTING_THREADS; i++) {
+        assert(pthread_join(threads[i], nullptr) == 0);
+    }
+    // the threads are gone, their shards are not
+    http_metrics_snapshot after;
+    http_metrics_load(&after);
+    assert(after.counters[HTTP_METRIC_REQUESTS] - before.counters[HTTP_METRIC_REQUESTS]
+        == COUNTING_THREADS * COUNTS_PER_THREAD);
+    assert(after.counters[HTTP_METRIC_BYTES_IN] - before.counters[HTTP_METRIC_BYTES_IN]
+        == 3 * COUNTING_THREADS * COUNTS_PER_THREAD);
+}
+
+void test_metrics_histogram_buckets(void) {
+    http_metrics_snapshot before;
+    http_metrics_load(&before);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 0);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 64);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 65);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 128);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 1000);
+    http_metrics_observe_ns(HTTP_METRIC_HANDLER_TIME, 60ULL * 1000000000ULL);
+    http_metrics_snapshot after;
+    http_metrics_load(&after);
+
+    uint64_t observed[HTTP_METRICS_HISTOGRAM_BUCKETS + 1];
+    for (size_t i = 0; i <= HTTP_METRICS_HISTOGRAM_BUCKETS; i++) {
+        observed[i] = after.histograms[HTTP_METRIC_HANDLER_TIME].buckets[i]
+                      - before.histograms[HTTP_METRIC_HANDLER_TIME].buckets[i];
+    }
+    assert(observed[0] == 2); // 0 and 64 ns
+    assert(observed[1] == 2); // 65 and 128 ns
+    assert(observed[4] == 1); // 1 µs, at most 1024 ns
+    assert(observed[HTTP_METRICS_HISTOGRAM_BUCKETS] == 1); // a minute is beyond the last bound
+    assert(after.histograms[HTTP_METRIC_HANDLER_TIME].sum_ns - before.histograms[HTTP_METRIC_HANDLER_TIME].sum_ns
+        == 64 + 65 + 128 + 1000 + 60ULL * 1000000000ULL);
+    // the other histograms are untouched
+    assert(memcmp(&after.histograms[HTTP_METRIC_PARSE_TIME], &before.histograms[HTTP_METRIC_PARSE_TIME],
+                  sizeof(after.histograms[0])) == 0);
+}
+
+void test_metrics_count_parse_and_render_errors(void) {
+    http_metrics_snapshot before;
+    http_metrics_load(&before);
+
+    const uint8_t bad_version[] = "GET / HTTP/2.0\r\nHost: a\r\n\r\n";
+    http_request_view view;
+    assert(parse_http_request_view(&settings, bad_version, sizeof(bad_version) - 1, &view)
+        == PARSE_E_HTTP_VERSION_NOT_SUPPORTED);
+    // a request that has not fully arrived yet is no error
+    const uint8_t partial[] = "GET / HTTP/1.1\r\nHo";
+    assert(parse_http_request_view(&settings, partial, sizeof(partial) - 1, &view) == PARSE_E_INCOMPLETE);
+    const uint8_t bad_header[] = "GET / HTTP/1.1\r\nHost\r\n\r\n";
+    assert(parse_http_request(&settings, bad_header, sizeof(bad_header) - 1) == nullptr);
+
+    const http_response response = {.version = HTTP_1_1, .status_code = 42};
+    uint8_t *octets = nullptr;
+    size_t len = 0;
+    assert(render_http_response(&settings, &response, &octets, &len) == RENDER_E_STATUS_CODE_INVALID);
+
+    http_metrics_snapshot after;
+    http_metrics_load(&after);
+    for (size_t slot = 0; slot < HTTP_METRICS_PARSE_STATUS_SLOTS; slot++) {
+        const enum parse_http_request_status status = http_metrics_parse_status(slot);
+        const uint64_t counted = after.parse_errors[slot] - before.parse_errors[slot];
+        if (status == PARSE_E_HTTP_VERSION_NOT_SUPPORTED || status == PARSE_E_MALFORMED_HTTP_HEADER) {
+            assert(counted == 1);
+        } else {
+            assert(counted == 0);
+        }
+    }
+    for (size_t slot = 0; slot < HTTP_METRICS_RENDER_STATUS_SLOTS; slot++) {
+        const uint64_t counted = after.render_errors[slot] - before.render_errors[slot];
+        assert(counted == (http_metrics_render_status(slot) == RENDER_E_STATUS_CODE_INVALID ? 1 : 0));
+    }
+}
+
+void test_metrics_render_prometheus_text(void) {
+    http_metrics_snapshot snapshot = {};
+    snapshot.counters[HTTP_METRIC_REQUESTS] = 12;
+    snapshot.responses[3] = 5;
+    snapshot.parse_errors[PARSE_E_BODY_TOO_LARGE + 11] = 2;
+    snapshot.render_errors[-RENDER_E_MEM_ALLOC_FAILED] = 1;
+    snapshot.histograms[HTTP_METRIC_PARSE_TIME].buckets[0] = 3;
+    snapshot.histograms[HTTP_METRIC_PARSE_TIME].buckets[2] = 1;
+    snapshot.histograms[HTTP_METRIC_PARSE_TIME].sum_ns = 1500000000;
+
+    char text[16 * 1024];
+    const size_t len = http_metrics_render(&snapshot, text, sizeof(text));
+    assert(len < sizeof(text) && strlen(text) == len);
+    assert(strstr(text, "# TYPE tiny_http_requests_total counter\ntiny_http_requests_total 12\n") != nullptr);
+    assert(strstr(text, "tiny_http_responses_total{code=\"4xx\"} 5\n") != nullptr);
+    assert(strstr(text, "tiny_http_parse_errors_total{status=\"body_too_large\"} 2\n") != nullptr);
+    assert(strstr(text, "tiny_http_parse_errors_total{status=\"incomplete\"}") == nullptr);
+    assert(strstr(text, "tiny_http_render_errors_total{status=\"mem_alloc_failed\"} 1\n") != nullptr);
+    // buckets are cumulative, in seconds
+    assert(strstr(text, "# TYPE tiny_http_parse_duration_seconds histogram\n"
+                        "tiny_http_parse_duration_seconds_bucket{le=\"6.4e-08\"} 3\n"
+                        "tiny_http_parse_duration_seconds_bucket{le=\"1.28e-07\"} 3\n"
+                        "tiny_http_parse_duration_seconds_bucket{le=\"2.56e-07\"} 4\n") != nullptr);
+    assert(strstr(text, "tiny_http_parse_duration_seconds_bucket{le=\"+Inf\"} 4\n"
+                        "tiny_http_parse_duration_seconds_sum 1.500000000\n"
+                        "tiny_http_parse_duration_seconds_count 4\n") != nullptr);
+    assert(text[len - 1] == '\n');
+
+    // too small a buffer: truncated, but the full length is reported
+    char small[64];
+    assert(http_metrics_render(&snapshot, small, sizeof(small)) == len);
+    assert(strlen(small) == sizeof(small) - 1 && strncmp(small, text, sizeof(small) - 1) == 0);
+}
+
+void test_metrics_handler(void) {
+    http_metrics_count(HTTP_METRIC_CACHE_HITS, 1);
+    http_arena *arena = http_arena_create(1024);
+    assert(arena != nullptr);
+    const http_request request = {.method = GET, .version = HTTP_1_1, .arena = arena};
+    http_response response = {.version = HTTP_1_1};
+    http_metrics_handler(&request, &response, nullptr);
+    assert(response.status_code == 200);
+    assert(response.headers_cnt >= 1 && strcmp(response.headers[0].name, "Content-Type") == 0);
+    assert(strncmp(response.headers[0].value, "text/plain; version=0.0.4", 25) == 0);
+    assert(response.body_len > 0 && memmem(response.body, response.body_len, "tiny_http_cache_hits_total ", 27) != nullptr);
+    http_arena_destroy(arena);
+
+    // a request without an arena has nowhere to hold the text
+    const http_request no_arena = {.method = GET, .version = HTTP_1_1};
+    response = (http_response){.version = HTTP_1_1};
+    http_metrics_handler(&no_arena, &response, nullptr);
+    assert(response.status_code == 500 && response.body == nullptr);
+}
+
+typedef struct captured_log {
+    char lines[256];
+    size_t len;
+    size_t calls;
+    http_log_level last_level;
+} captured_log;
+
+static void capture_log(const http_log_level level, const char *line, const size_t len, void *user_data) {
+    captured_log *captured = user_data;
+    assert(captured->len + len < sizeof(captured->lines));
+    memcpy(captured->lines + captured->len, line, len);
+    captured->len += len;
+    captured->lines[captured->len] = '\0';
+    captured->calls++;
+    captured->last_level = level;
+}
+
+void test_log_levels_and_sink(void) {
+    captured_log captured = {};
+    http_log_configure(HTTP_LOG_INFO, capture_log, &captured);
+    http_log_debug("not %s\n", "logged");
+    http_log_info("request %d\n", 1);
+    http_log_error("failed\n");
+    assert(captured.calls == 2 && strcmp(captured.lines, "request 1\nfailed\n") == 0);
+    assert(captured.last_level == HTTP_LOG_ERROR);
+
+    http_log_set_level(HTTP_LOG_DEBUG);
+    http_log_debug("now %s\n", "logged");
+    assert(captured.calls == 3 && captured.last_level == HTTP_LOG_DEBUG);
+
+    // the library's own parse errors are debug lines
+    const uint8_t bad_header[] = "GET / HTTP/1.1\r\nHost\r\n\r\n";
+    assert(parse_http_request(&settings, bad_header, sizeof(bad_header) - 1) == nullptr);
+    assert(captured.calls == 4 && strstr(captured.lines, "malformed header\n") != nullptr);
+
+    // back to stderr at the default level
+    http_log_configure(HTTP_LOG_WARN, nullptr, nullptr);
+    http_log_info("to nowhere\n");
+    assert(captured.calls == 4);
+}
+
+int main() {
+    test_metrics_add_up_across_threads();
+    test_metrics_histogram_buckets();
+    test_metrics_count_parse_and_render_errors();
+    test_metrics_render_prometheus_text();
+    test_metrics_handler();
+    test_log_levels_and_sink();
+
+    return EXIT_SUCCESS;
+}
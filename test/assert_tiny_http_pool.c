@@ -0,0 +1,124 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_pool.h"
+
+typedef struct pooled_object {
+    uint64_t id;
+    char name[40];
+} pooled_object;
+
+void test_slab_recycles_objects(void) {
+    http_slab slab;
+    http_slab_init(&slab, sizeof(pooled_object), 4);
+    pooled_object *objects[10];
+    for (size_t i = 0; i < 10; i++) {
+        objects[i] = http_slab_alloc(&slab);
+        assert(objects[i] != nullptr);
+        assert(objects[i]->id == 0 && objects[i]->name[0] == '\0');
+        assert((uintptr_t) objects[i] % alignof(max_align_t) == 0);
+        objects[i]->id = i + 1;
+        snprintf(objects[i]->name, sizeof(objects[i]->name), "object %zu", i);
+    }
+    for (size_t i = 0; i < 10; i++) {
+        for (size_t j = i + 1; j < 10; j++) assert(objects[i] != objects[j]);
+        assert(objects[i]->id == i + 1);
+    }
+    http_pool_stats stats = http_pool_counters_load(&slab.counters);
+    // three chunks of 4: the first object of each came with a new chunk, the rest off the free list
+    assert(stats.acquired == 10 && stats.reused == 7);
+    assert(stats.in_use == 10 && stats.high_water == 10 && stats.cached == 2);
+
+    http_slab_free(&slab, objects[3]);
+    http_slab_free(&slab, objects[7]);
+    pooled_object *again = http_slab_alloc(&slab);
+    assert(again == objects[7]);
+    // handed out zeroed, whatever it held before
+    assert(again->id == 0 && again->name[0] == '\0');
+    stats = http_pool_counters_load(&slab.counters);
+    assert(stats.in_use == 9 && stats.high_water == 10 && stats.cached == 3);
+    http_slab_destroy(&slab);
+}
+
+void test_buffer_pool_picks_the_smallest_tier(void) {
+    http_buffer_pool pool;
+    http_buffer_pool_init(&pool, 64 * 1024);
+    size_t size = 0;
+    void *small = http_buffer_pool_acquire(&pool, 100, &size);
+    assert(small != nullptr && size == 4 * 1024);
+    memset(small, 1, size);
+    void *exact = http_buffer_pool_acquire(&pool, 16 * 1024, &size);
+    assert(exact != nullptr && size == 16 * 1024);
+    memset(exact, 2, size);
+    void *large = http_buffer_pool_acquire(&pool, 40 * 1024, &size);
+    assert(large != nullptr && size == 64 * 1024);
+    void *oversized = http_buffer_pool_acquire(&pool, 100 * 1024, &size);
+    assert(oversized != nullptr && size == 100 * 1024);
+    memset(oversized, 3, size);
+
+    http_buffer_pool_release(&pool, small, 4 * 1024);
+    http_buffer_pool_release(&pool, exact, 16 * 1024);
+    http_buffer_pool_release(&pool, large, 64 * 1024);
+    http_buffer_pool_release(&pool, oversized, 100 * 1024);
+
+    assert(http_buffer_pool_acquire(&pool, 4000, &size) == small && size == 4 * 1024);
+    http_buffer_pool_stats stats;
+    http_buffer_pool_stats_load(&pool, &stats);
+    assert(stats.tiers[0].acquired == 2 && stats.tiers[0].reused == 1 && stats.tiers[0].in_use == 1);
+    assert(stats.tiers[1].cached == 1 && stats.tiers[2].cached == 1);
+    assert(stats.oversized.acquired == 1 && stats.oversized.in_use == 0 && stats.oversized.cached == 0);
+    http_buffer_pool_release(&pool, small, 4 * 1024);
+    http_buffer_pool_destroy(&pool);
+}
+
+void test_buffer_pool_bounds_what_it_keeps(void) {
+    http_buffer_pool pool;
+    // room for two 16 KiB buffers (and no 64 KiB one at all)
+    http_buffer_pool_init(&pool, 32 * 1024);
+    void *buffers[5];
+    size_t size = 0;
+    for (size_t i = 0; i < 5; i++) buffers[i] = http_buffer_pool_acquire(&pool, 10 * 1024, &size);
+    for (size_t i = 0; i < 5; i++) http_buffer_pool_release(&pool, buffers[i], size);
+    void *large = http_buffer_pool_acquire(&pool, 64 * 1024, &size);
+    http_buffer_pool_release(&pool, large, size);
+
+    http_buffer_pool_stats stats;
+    http_buffer_pool_stats_load(&pool, &stats);
+    assert(stats.tiers[1].high_water == 5 && stats.tiers[1].in_use == 0 && stats.tiers[1].cached == 2);
+    assert(stats.tiers[2].cached == 0);
+
+    // a steady state that fits serves every buffer from the free list
+    for (size_t i = 0; i < 1000; i++) {
+        void *buffer = http_buffer_pool_acquire(&pool, 10 * 1024, &size);
+        http_buffer_pool_release(&pool, buffer, size);
+    }
+    http_buffer_pool_stats_load(&pool, &stats);
+    assert(stats.tiers[1].acquired == 1005 && stats.tiers[1].reused == 1000);
+    http_buffer_pool_destroy(&pool);
+}
+
+void test_pool_stats_add_up(void) {
+    http_pool_stats sum = {};
+    const http_pool_stats a = {.acquired = 10, .reused = 8, .in_use = 1, .high_water = 3, .cached = 2};
+    const http_pool_stats b = {.acquired = 5, .reused = 5, .in_use = 0, .high_water = 2, .cached = 4};
+    http_pool_stats_add(&sum, &a);
+    http_pool_stats_add(&sum, &b);
+    assert(sum.acquired == 15 && sum.reused == 13 && sum.in_use == 1 && sum.high_water == 5 && sum.cached == 6);
+}
+
+int main() {
+    test_slab_recycles_objects();
+    test_buffer_pool_picks_the_smallest_tier();
+    test_buffer_pool_bounds_what_it_keeps();
+    test_pool_stats_add_up();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_range.h"
+#include "tiny_http_test_helpers.h"
+
+#define ETAG "\"2710-6717f1a0\""
+#define LAST_MODIFIED "Tue, 22 Oct 2024 18:30:24 GMT"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024,
+    .max_url_length = 2000,
+};
+
+static size_t releases;
+
+static http_header file_headers[] = {
+    {.name = "Content-Type", .value = "text/plain"},
+    {.name = "ETag", .value = ETAG},
+};
+
+/**
+ * @return the full response to a `GET` of a 10000 octet file
+ */
+static http_response file_response(void) {
+    return (http_response){
+        .version = HTTP_1_1,
+        .status_code = 200,
+        .headers = file_headers,
+        .headers_cnt = 2,
+        .body_file = {.fd = 3, .offset = 100, .len = 10000, .release = count_release, .release_state = &releases},
+    };
+}
+
+/**
+ * Asserts that `value` parses against 10000 octets to `result` and, for a partial one, to the
+ * `expected_cnt` ranges of `expected`, as offset and length pairs.
+ */
+static void assert_parses(const char *value, const http_range_result result, const uint64_t *expected, const size_t expected_cnt) {
+    http_byte_range ranges[4];
+    size_t cnt = 99;
+    assert(http_range_parse(value, 10000, ranges, 4, &cnt) == result);
+    assert(cnt == expected_cnt);
+    for (size_t i = 0; i < cnt; i++) {
+        assert(ranges[i].offset == expected[2 * i] && ranges[i].len == expected[2 * i + 1]);
+    }
+}
+
+void test_parse_ranges(void) {
+    assert_parses("bytes=0-499", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 500}, 1);
+    assert_parses("bytes=9500-", HTTP_RANGE_PARTIAL, (uint64_t[]){9500, 500}, 1);
+    assert_parses("bytes=-500", HTTP_RANGE_PARTIAL, (uint64_t[]){9500, 500}, 1);
+    assert_parses("Bytes=0-0, -1", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 1, 9999, 1}, 2);
+    // past the end: cut short, the whole file for a suffix longer than it
+    assert_parses("bytes=9000-20000", HTTP_RANGE_PARTIAL, (uint64_t[]){9000, 1000}, 1);
+    assert_parses("bytes=-20000", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 10000}, 1);
+    assert_parses("bytes=0-99999999999999999999999", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 10000}, 1);
+    // empty list elements and whitespace around them
+    assert_parses("bytes= ,0-9 ,\t500-599, ", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 10, 500, 100}, 2);
+    // unsatisfiable ones are dropped, and only if none is left is the whole lot
+    assert_parses("bytes=20000-30000, 100-199", HTTP_RANGE_PARTIAL, (uint64_t[]){100, 100}, 1);
+    assert_parses("bytes=10000-", HTTP_RANGE_NOT_SATISFIABLE, nullptr, 0);
+    assert_parses("bytes=-0", HTTP_RANGE_NOT_SATISFIABLE, nullptr, 0);
+    assert_parses("bytes=10000-10001, -0", HTTP_RANGE_NOT_SATISFIABLE, nullptr, 0);
+
+    // anything it does not understand is ignored
+    assert_parses("items=0-9", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=5", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=9-5", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=a-b", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=0-9;x", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes=0-9, 1 0-19", HTTP_RANGE_FULL, nullptr, 0);
+    assert_parses("bytes = 0-9", HTTP_RANGE_FULL, nullptr, 0);
+    // more than fit
+    assert_parses("bytes=0-0,2-2,4-4,6-6,8-8", HTTP_RANGE_FULL, nullptr, 0);
+}
+
+void test_parse_merges_ranges(void) {
+    // overlapping, touching, contained
+    assert_parses("bytes=0-99, 50-149", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 150}, 1);
+    assert_parses("bytes=0-99, 100-199", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 200}, 1);
+    assert_parses("bytes=0-999, 10-19", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 1000}, 1);
+    assert_parses("bytes=-100, 9000-", HTTP_RANGE_PARTIAL, (uint64_t[]){9000, 1000}, 1);
+    // the gap between two others closed: all three become one, where the first was
+    assert_parses("bytes=500-599, 0-99, 100-499", HTTP_RANGE_PARTIAL, (uint64_t[]){0, 600}, 1);
+    assert_parses("bytes=900-999, 0-9, 300-399, 400-899", HTTP_RANGE_PARTIAL, (uint64_t[]){300, 700, 0, 10}, 2);
+    // otherwise the order asked for stays
+    assert_parses("bytes=9000-9099, 0-99, 5000-5099", HTTP_RANGE_PARTIAL, (uint64_t[]){9000, 100, 0, 100, 5000, 100}, 3);
+}
+
+void test_if_range(void) {
+    assert(http_range_if_range_matches(ETAG, ETAG, LAST_MODIFIED));
+    assert(http_range_if_range_matches(" " ETAG " ", ETAG, nullptr));
+    assert(!http_range_if_range_matches("\"other\"", ETAG, LAST_MODIFIED));
+    // strong comparison: weak tags never match
+    assert(!http_range_if_range_matches("W/" ETAG, ETAG, LAST_MODIFIED));
+    assert(!http_range_if_range_matches("W/" ETAG, "W/" ETAG, LAST_MODIFIED));
+    assert(!http_range_if_range_matches(ETAG, nullptr, LAST_MODIFIED));
+
+    assert(http_range_if_range_matches(LAST_MODIFIED, ETAG, LAST_MODIFIED));
+    assert(!http_range_if_range_matches("Tue, 22 Oct 2024 18:30:25 GMT", ETAG, LAST_MODIFIED));
+    assert(!http_range_if_range_matches(LAST_MODIFIED, ETAG, nullptr));
+}
+
+void test_respond_single_range(void) {
+    http_request *request = parse("GET /f HTTP/1.1\r\nRange: bytes=-500\r\n\r\n");
+    http_response response = file_response();
+    assert(http_range_respond(request, &response, ETAG, LAST_MODIFIED) == HTTP_RANGE_PARTIAL);
+    assert(response.status_code == 206);
+    assert(strcmp(header_value(&response, "Content-Range"), "bytes 9500-9999/10000") == 0);
+    assert(strcmp(header_value(&response, "Content-Type"), "text/plain") == 0);
+    assert(strcmp(header_value(&response, "ETag"), ETAG) == 0);
+    // relative to where the body starts in the file
+    assert(response.body_file.offset == 9600 && response.body_file.len == 500);
+    assert(response.body_file.parts_cnt == 0);
+    // the handler's headers are left alone
+    assert(file_headers[0].value[0] == 't' && response.headers != file_headers);
+    destroy_http_request(request);
+}
+
+void test_respond_multiple_ranges(void) {
+    http_request *request = parse("GET /f HTTP/1.1\r\nRange: bytes=0-9, 9990-\r\nIf-Range: " ETAG "\r\n\r\n");
+    http_response response = file_response();
+    assert(http_range_respond(request, &response, ETAG, LAST_MODIFIED) == HTTP_RANGE_PARTIAL);
+    assert(response.status_code == 206);
+    assert(header_value(&response, "Content-Range") == nullptr);
+    const char *content_type = header_value(&response, "Content-Type");
+    assert(strncmp(content_type, "multipart/byteranges; boundary=", 31) == 0);
+    const char *boundary = content_type + 31;
+    assert(strlen(boundary) == 16);
+
+    assert(response.body_file.parts_cnt == 3);
+    const http_file_part *parts = response.body_file.parts;
+    char expected[256];
+    snprintf(expected, sizeof(expected),
+             "--%s\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-9/10000\r\n\r\n", boundary);
+    assert(parts[0].prefix.len == strlen(expected) && memcmp(parts[0].prefix.ptr, expected, strlen(expected)) == 0);
+    assert(parts[0].offset == 100 && parts[0].len == 10);
+    snprintf(expected, sizeof(expected),
+             "\r\n--%s\r\nContent-Type: text/plain\r\nContent-Range: bytes 9990-9999/10000\r\n\r\n", boundary);
+    assert(parts[1].prefix.len == strlen(expected) && memcmp(parts[1].prefix.ptr, expected, strlen(expected)) == 0);
+    assert(parts[1].offset == 10090 && parts[1].len == 10);
+    snprintf(expected, sizeof(expected), "\r\n--%s--\r\n", boundary);
+    assert(parts[2].prefix.len == strlen(expected) && memcmp(parts[2].prefix.ptr, expected, strlen(expected)) == 0);
+    assert(parts[2].len == 0);
+    // `len` is all of it, for `Content-Length`
+    assert(response.body_file.len == parts[0].prefix.len + 10 + parts[1].prefix.len + 10 + parts[2].prefix.len);
+
+    // every response gets a boundary of its own
+    char first_boundary[17];
+    strcpy(first_boundary, boundary);
+    destroy_http_request(request);
+    request = parse("GET /f HTTP/1.1\r\nRange: bytes=0-9, 20-29\r\n\r\n");
+    response = file_response();
+    assert(http_range_respond(request, &response, ETAG, LAST_MODIFIED) == HTTP_RANGE_PARTIAL);
+    assert(strcmp(header_value(&response, "Content-Type") + 31, first_boundary) != 0);
+    destroy_http_request(request);
+}
+
+void test_respond_not_satisfiable(void) {
+    releases = 0;
+    http_request *request = parse("GET /f HTTP/1.1\r\nRange: bytes=10000-\r\n\r\n");
+    http_response response = file_response();
+    assert(http_range_respond(request, &response, ETAG, LAST_MODIFIED) == HTTP_RANGE_NOT_SATISFIABLE);
+    assert(response.status_code == 416);
+    assert(strcmp(header_value(&response, "Content-Range"), "bytes */10000") == 0);
+    // no body, but the file is left for the server to release
+    assert(response.body_file.len == 0 && response.body_file.release == count_release && releases == 0);
+    destroy_http_request(request);
+}
+
+void test_respond_leaves_full_responses(void) {
+    const char *requests[] = {
+        "GET /f HTTP/1.1\r\n\r\n",
+        "HEAD /f HTTP/1.1\r\nRange: bytes=0-9\r\n\r\n",
+        "GET /f HTTP/1.1\r\nRange: bytes=9-0\r\n\r\n",
+        // the file changed since the client got its first part
+        "GET /f HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: \"old\"\r\n\r\n",
+        "GET /f HTTP/1.1\r\nRange: bytes=0-9\r\nIf-Range: Mon, 21 Oct 2024 18:30:24 GMT\r\n\r\n",
+    };
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        http_request *request = parse(requests[i]);
+        http_response response = file_response();
+        assert(http_range_respond(request, &response, ETAG, LAST_MODIFIED) == HTTP_RANGE_FULL);
+        assert(response.status_code == 200 && response.headers == file_headers);
+        assert(response.body_file.offset == 100 && response.body_file.len == 10000);
+        destroy_http_request(request);
+    }
+
+    // only a file body can be served in ranges
+    http_request *request = parse("GET /f HTTP/1.1\r\nRange: bytes=0-9\r\n\r\n");
+    http_response response = {.status_code = 200, .body = (uint8_t *) "in memory", .body_len = 9};
+    assert(http_range_respond(request, &response, nullptr, nullptr) == HTTP_RANGE_FULL);
+    response = file_response();
+    response.status_code = 404;
+    assert(http_range_respond(request, &response, nullptr, nullptr) == HTTP_RANGE_FULL);
+    destroy_http_request(request);
+}
+
+int main() {
+    arena = http_arena_create(4096);
+    assert(arena != nullptr);
+    test_parse_ranges();
+    test_parse_merges_ranges();
+    test_if_range();
+    test_respond_single_range();
+    test_respond_multiple_ranges();
+    test_respond_not_satisfiable();
+    test_respond_leaves_full_responses();
+    http_arena_destroy(arena);
+
+    return EXIT_SUCCESS;
+}
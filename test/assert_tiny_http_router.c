@@ -0,0 +1,213 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_router.h"
+
+static void route_handler(const http_request *request, const http_route_match *match, http_response *response, void *user_data) {
+    (void) request;
+    (void) match;
+    response->status_code = 200;
+    response->body = user_data;
+    response->body_len = strlen(user_data);
+}
+
+static enum http_route_result match(const http_router *router, const http_method method, const char *path, http_route_match *out) {
+    return http_router_match(router, method, path, strlen(path), out);
+}
+
+static bool param_is(const http_route_match *match, const char *name, const char *value) {
+    const http_slice *captured = http_route_param_value(match, name);
+    return captured != nullptr && http_slice_eq_cstr(*captured, value);
+}
+
+static http_router *create_api_router(void) {
+    http_router *router = http_router_create();
+    assert(router != nullptr);
+    assert(http_router_add(router, GET, "/", route_handler, "root") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/users", route_handler, "users") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, POST, "/users", route_handler, "new user") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/users/me", route_handler, "me") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/users/:id", route_handler, "user") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/users/:id/posts/:post", route_handler, "post") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/user-agents", route_handler, "agents") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/static/*file", route_handler, "static") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, HEAD, "/health", route_handler, "head health") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/health", route_handler, "health") == HTTP_ROUTER_OK);
+    assert(http_router_compile(router) == HTTP_ROUTER_OK);
+    return router;
+}
+
+void test_router_static_and_captures(void) {
+    http_router *router = create_api_router();
+    http_route_match m;
+
+    assert(match(router, GET, "/", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "root") == 0 && m.params_cnt == 0);
+    assert(match(router, GET, "/users", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "users") == 0);
+    assert(match(router, POST, "/users", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "new user") == 0);
+    assert(match(router, GET, "/user-agents", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "agents") == 0);
+
+    // static beats a capture at the same place
+    assert(match(router, GET, "/users/me", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "me") == 0 && m.params_cnt == 0);
+    assert(match(router, GET, "/users/42", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "user") == 0 && param_is(&m, "id", "42"));
+    // "me" is a static prefix of "mel", the lookup has to come back and try the capture
+    assert(match(router, GET, "/users/mel", &m) == HTTP_ROUTE_FOUND);
+    assert(param_is(&m, "id", "mel"));
+    assert(match(router, GET, "/users/me/posts/7?draft=1", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "post") == 0);
+    assert(m.params_cnt == 2 && param_is(&m, "id", "me") && param_is(&m, "post", "7"));
+    assert(http_route_param_value(&m, "missing") == nullptr);
+
+    const char path[] = "/static/css/site.css";
+    assert(match(router, GET, path, &m) == HTTP_ROUTE_FOUND);
+    assert(param_is(&m, "file", "css/site.css"));
+    // the captures point into the path, nothing was copied
+    assert(m.params[0].value.ptr == (const uint8_t *) path + 8);
+    assert(match(router, GET, "/static/", &m) == HTTP_ROUTE_FOUND);
+    assert(param_is(&m, "file", ""));
+
+    http_router_destroy(router);
+}
+
+void test_router_misses_and_methods(void) {
+    http_router *router = create_api_router();
+    http_route_match m;
+
+    assert(match(router, GET, "/nope", &m) == HTTP_ROUTE_NOT_FOUND);
+    assert(match(router, GET, "/users/", &m) == HTTP_ROUTE_NOT_FOUND);
+    assert(match(router, GET, "/users/42/posts", &m) == HTTP_ROUTE_NOT_FOUND);
+    assert(m.params_cnt == 0);
+    assert(match(router, GET, "/static", &m) == HTTP_ROUTE_NOT_FOUND);
+    assert(match(router, GET, "", &m) == HTTP_ROUTE_NOT_FOUND);
+
+    assert(match(router, POST, "/users/42", &m) == HTTP_ROUTE_METHOD_NOT_ALLOWED);
+    assert(m.allowed_methods == (1u << GET | 1u << HEAD));
+    // HEAD falls back to GET, unless it has a route of its own
+    assert(match(router, HEAD, "/users/42", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "user") == 0);
+    assert(match(router, HEAD, "/health", &m) == HTTP_ROUTE_FOUND);
+    assert(strcmp(m.user_data, "head health") == 0);
+
+    http_router_destroy(router);
+}
+
+void test_router_rest_methods(void) {
+    http_router *router = http_router_create();
+    assert(http_router_add(router, GET, "/items/:id", route_handler, "get") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, PUT, "/items/:id", route_handler, "put") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, PATCH, "/items/:id", route_handler, "patch") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, DELETE, "/items/:id", route_handler, "delete") == HTTP_ROUTER_OK);
+    assert(http_router_compile(router) == HTTP_ROUTER_OK);
+
+    http_route_match m;
+    assert(match(router, PUT, "/items/3", &m) == HTTP_ROUTE_FOUND && strcmp(m.user_data, "put") == 0);
+    assert(match(router, PATCH, "/items/3", &m) == HTTP_ROUTE_FOUND && strcmp(m.user_data, "patch") == 0);
+    assert(match(router, DELETE, "/items/3", &m) == HTTP_ROUTE_FOUND && strcmp(m.user_data, "delete") == 0);
+    assert(param_is(&m, "id", "3"));
+    assert(match(router, POST, "/items/3", &m) == HTTP_ROUTE_METHOD_NOT_ALLOWED);
+    assert(m.allowed_methods == (1u << GET | 1u << HEAD | 1u << PUT | 1u << DELETE | 1u << PATCH));
+
+    http_arena *arena = http_arena_create(1024);
+    http_request request = {.version = HTTP_1_1, .method = POST, .path = "/items/3", .arena = arena};
+    http_response response = {.version = HTTP_1_1};
+    http_router_handler(&request, &response, router);
+    assert(response.status_code == 405);
+    assert(strcmp(response.headers[0].value, "GET, HEAD, PUT, DELETE, PATCH") == 0);
+    http_arena_destroy(arena);
+    http_router_destroy(router);
+}
+
+void test_router_rejects_bad_routes(void) {
+    http_router *router = http_router_create();
+    assert(http_router_add(router, GET, "users", route_handler, "") == HTTP_ROUTER_E_MALFORMED_PATTERN);
+    assert(http_router_add(router, GET, "/users/:", route_handler, "") == HTTP_ROUTER_E_MALFORMED_PATTERN);
+    assert(http_router_add(router, GET, "/files/*path/more", route_handler, "") == HTTP_ROUTER_E_MALFORMED_PATTERN);
+    assert(http_router_add(router, GET, "/users/:id", nullptr, "") == HTTP_ROUTER_E_MALFORMED_PATTERN);
+    assert(http_router_add(router, HTTP_METHOD_UNKNOWN, "/users/:id", route_handler, "") == HTTP_ROUTER_E_MALFORMED_PATTERN);
+    assert(http_router_add(router, GET, "/users/:id", route_handler, "") == HTTP_ROUTER_OK);
+    assert(http_router_add(router, GET, "/users/:id", route_handler, "") == HTTP_ROUTER_E_CONFLICT);
+    assert(http_router_add(router, GET, "/users/:name/x", route_handler, "") == HTTP_ROUTER_E_CONFLICT);
+    assert(http_router_add(router, GET, "/:a/:b/:c/:d/:e/:f/:g/:h/:i", route_handler, "")
+           == HTTP_ROUTER_E_TOO_MANY_PARAMS);
+
+    // routes only take effect once compiled
+    http_route_match m;
+    assert(match(router, GET, "/users/1", &m) == HTTP_ROUTE_NOT_FOUND);
+    assert(http_router_compile(router) == HTTP_ROUTER_OK);
+    assert(match(router, GET, "/users/1", &m) == HTTP_ROUTE_FOUND);
+    http_router_destroy(router);
+}
+
+void test_router_many_routes(void) {
+    http_router *router = http_router_create();
+    char pattern[64];
+    for (int i = 0; i < 500; i++) {
+        snprintf(pattern, sizeof(pattern), "/api/v%d/items/:item/part%d", i % 7, i);
+        assert(http_router_add(router, GET, pattern, route_handler, "item") == HTTP_ROUTER_OK);
+    }
+    assert(http_router_compile(router) == HTTP_ROUTER_OK);
+    http_route_match m;
+    for (int i = 0; i < 500; i++) {
+        snprintf(pattern, sizeof(pattern), "/api/v%d/items/x%d/part%d", i % 7, i, i);
+        assert(match(router, GET, pattern, &m) == HTTP_ROUTE_FOUND);
+        snprintf(pattern, sizeof(pattern), "x%d", i);
+        assert(param_is(&m, "item", pattern));
+    }
+    assert(match(router, GET, "/api/v1/items/x/part2", &m) == HTTP_ROUTE_NOT_FOUND);
+    http_router_destroy(router);
+}
+
+void test_router_handler_answers_404_and_405(void) {
+    http_router *router = create_api_router();
+    http_arena *arena = http_arena_create(1024);
+    http_request request = {.version = HTTP_1_1, .method = GET, .path = "/users/7", .arena = arena};
+    http_response response = {.version = HTTP_1_1};
+    http_router_handler(&request, &response, router);
+    assert(response.status_code == 200);
+    assert(strcmp((char *) response.body, "user") == 0);
+
+    request.path = "/missing";
+    response = (http_response){.version = HTTP_1_1};
+    http_router_handler(&request, &response, router);
+    assert(response.status_code == 404);
+
+    request.method = POST;
+    request.path = "/users/7";
+    response = (http_response){.version = HTTP_1_1};
+    http_router_handler(&request, &response, router);
+    assert(response.status_code == 405);
+    assert(response.headers_cnt == 1);
+    assert(strcmp(response.headers[0].name, "Allow") == 0);
+    assert(strcmp(response.headers[0].value, "GET, HEAD") == 0);
+
+    request.method = OPTIONS;
+    response = (http_response){.version = HTTP_1_1};
+    http_router_handler(&request, &response, router);
+    assert(response.status_code == 204);
+    assert(response.headers_cnt == 1 && strcmp(response.headers[0].value, "GET, HEAD, OPTIONS") == 0);
+
+    http_arena_destroy(arena);
+    http_router_destroy(router);
+}
+
+int main() {
+    test_router_static_and_captures();
+    test_router_misses_and_methods();
+    test_router_rest_methods();
+    test_router_rejects_bad_routes();
+    test_router_many_routes();
+    test_router_handler_answers_404_and_405();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_scan.h"
+
+static bool reference_is_in_class(const http_scan_class cls, const uint8_t octet) {
+    switch (cls) {
+        case HTTP_SCAN_TCHAR:
+            return (octet >= '0' && octet <= '9') || (octet >= 'A' && octet <= 'Z') || (octet >= 'a' && octet <= 'z')
+                   || (octet != '\0' && strchr("!#$%&'*+-.^_`|~", octet) != nullptr);
+        case HTTP_SCAN_FIELD_CONTENT:
+            return octet == '\t' || (octet >= 0x20 && octet != 0x7f);
+        case HTTP_SCAN_REQUEST_TARGET:
+            return octet > 0x20 && octet != 0x7f;
+    }
+    return false;
+}
+
+static size_t reference_span(const uint8_t *buf, const size_t len, const http_scan_class cls) {
+    for (size_t i = 0; i < len; i++) {
+        if (!reference_is_in_class(cls, buf[i])) return i;
+    }
+    return len;
+}
+
+/**
+ * Every kernel must agree with the byte-at-a-time reference for every octet value at every position,
+ * including the tails shorter than a vector.
+ */
+static void assert_kernel_matches_reference(void) {
+    uint8_t buf[80];
+    for (int cls = HTTP_SCAN_TCHAR; cls <= HTTP_SCAN_REQUEST_TARGET; cls++) {
+        for (int octet = 0; octet < 256; octet++) {
+            for (size_t pos = 0; pos < sizeof(buf); pos += 7) {
+                memset(buf, 'a', sizeof(buf));
+                buf[pos] = (uint8_t) octet;
+                for (size_t len = 0; len <= sizeof(buf); len += 13) {
+                    assert(http_scan_span(buf, len, cls) == reference_span(buf, len, cls));
+                }
+                assert(http_scan_span(buf, sizeof(buf), cls) == reference_span(buf, sizeof(buf), cls));
+                const size_t expected = octet == 'a' ? 0 : pos;
+                assert(http_scan_find_octet(buf, sizeof(buf), (uint8_t) octet) == expected);
+            }
+        }
+    }
+}
+
+static void assert_kernel_on_http_text(void) {
+    const uint8_t line[] = "Accept-Encoding: gzip, deflate, br\r\n";
+    const size_t len = strlen((char *) line);
+    assert(http_scan_span(line, len, HTTP_SCAN_TCHAR) == 15);
+    assert(http_scan_span(line + 17, len - 17, HTTP_SCAN_FIELD_CONTENT) == 17);
+    assert(http_scan_find_crlf(line, len) == len - 2);
+
+    const uint8_t target[] = "/one/🐌/three?x=%20 HTTP/1.0";
+    assert(http_scan_span(target, strlen((char *) target), HTTP_SCAN_REQUEST_TARGET) == 21);
+
+    const uint8_t lone_cr[] = "abc\rdef\r\nxyz";
+    assert(http_scan_find_crlf(lone_cr, strlen((char *) lone_cr)) == 7);
+    assert(http_scan_find_crlf(lone_cr, 8) == 8);
+}
+
+void test_scan_every_kernel(void) {
+    const http_scan_kernel best = http_scan_active_kernel();
+    for (http_scan_kernel kernel = HTTP_SCAN_KERNEL_SWAR; kernel <= HTTP_SCAN_KERNEL_AVX2; kernel++) {
+        if (!http_scan_select_kernel(kernel)) {
+            assert(kernel > best);
+            continue;
+        }
+        assert(http_scan_active_kernel() == kernel);
+        assert_kernel_matches_reference();
+        assert_kernel_on_http_text();
+    }
+    assert(http_scan_select_kernel(best));
+}
+
+int main() {
+    test_scan_every_kernel();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,873 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_cache.h"
+#include "../src/tiny_http/tiny_http_chunked.h"
+#include "../src/tiny_http/tiny_http_compress.h"
+#include "../src/tiny_http/tiny_http_metrics.h"
+#include "../src/tiny_http/tiny_http_server.h"
+#include "tiny_http_test_helpers.h"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024 * 8, // 8M
+    .max_url_length = 8000
+};
+
+static http_header text_headers[] = {
+    {.name = "Content-Type", .value = "text/plain"},
+};
+
+/**
+ * Answers with "<method> <path> <body length>" as text.
+ */
+static void echo_handler(const http_request *request, http_response *response, void *user_data) {
+    (void) user_data;
+    char *body = http_arena_alloc(request->arena, 512);
+    const int body_len = snprintf(body, 512, "%d %s %zu", request->method, request->path, request->body_len);
+    response->status_code = 200;
+    response->reason_phrase = (uint8_t *) "OK";
+    response->headers = text_headers;
+    response->headers_cnt = 1;
+    response->body = (uint8_t *) body;
+    response->body_len = (size_t) body_len;
+}
+
+void test_server_serves_requests_over_loopback(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    assert(port != 0);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    char response[4096];
+    round_trip(port, "GET /some%20path HTTP/1.0\r\nHost: localhost\r\n\r\n", 0, response, sizeof(response));
+    assert(strcmp(response, "HTTP/1.0 200 OK\r\n"
+               "Content-Type: text/plain\r\n"
+               "Content-Length: 14\r\n"
+               "\r\n"
+               "1 /some path 0") == 0);
+
+    // the request arrives in two pieces, the split falling inside the body
+    round_trip(port,
+               "POST /upload HTTP/1.0\r\nContent-Length: 11\r\n\r\nhello world",
+               50, response, sizeof(response));
+    assert(strstr(response, "\r\n\r\n3 /upload 11") != nullptr);
+
+    // HEAD gets the head only
+    const size_t head_len = round_trip(port, "HEAD /x HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    assert(head_len == strlen("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\n\r\n"));
+
+    round_trip(port, "GET / HTTP/2.0\r\n\r\n", 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 505 ", 13) == 0);
+    round_trip(port, "BREW / HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 501 ", 13) == 0);
+    round_trip(port, "GET / HTTP/1.0\r\nbad header\r\n\r\n", 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 400 ", 13) == 0);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+/**
+ * Answers with the path, query, headers and body of the request as text, one line each.
+ */
+static void request_echo_handler(const http_request *request, http_response *response, void *user_data) {
+    (void) user_data;
+    const size_t cap = 1024 + request->body_len;
+    char *body = http_arena_alloc(request->arena, cap);
+    size_t body_len = (size_t) snprintf(body, cap, "%s?%.*s\n", request->path, (int) request->query.len,
+                                        request->query.ptr != nullptr ? (const char *) request->query.ptr : "");
+    for (size_t i = 0; i < request->headers_cnt; i++) {
+        body_len += (size_t) snprintf(body + body_len, cap - body_len, "%s=%s\n",
+                                      request->headers[i]->name, request->headers[i]->value);
+    }
+    // copied: the body is only borrowed while the handler runs
+    if (request->body_len > 0) memcpy(body + body_len, request->body, request->body_len);
+    body_len += request->body_len;
+    response->status_code = 200;
+    response->body = (uint8_t *) body;
+    response->body_len = body_len;
+}
+
+void test_server_hands_over_the_parsed_request(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, request_echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    const size_t cap = 256 * 1024;
+    char *response = malloc(cap);
+    // no whitespace after the colon, or none at all after it, is as valid as any
+    round_trip(port,
+               "POST /a%20b/../c?x=1&y HTTP/1.0\r\nHost:example.com\r\nX-Empty:\r\nUser-Agent: \tx \r\n"
+               "Content-Length:5\r\n\r\nhello",
+               0, response, cap);
+    assert(strcmp(strstr(response, "\r\n\r\n") + 4,
+                  "/c?x=1&y\nHost=example.com\nX-Empty=\nUser-Agent=x\nContent-Length=5\nhello") == 0);
+
+    // chunked bodies are decoded where they arrived, and the request pipelined after one still parses
+    round_trip(port,
+               "PUT /chunked HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+               "5\r\nhello\r\n1\r\n \r\n5;ext=1\r\nworld\r\n0\r\nX-Trailer: 1\r\n\r\n"
+               "GET /next HTTP/1.1\r\nConnection: close\r\n\r\n",
+               70, response, cap);
+    assert(strstr(response, "\r\n\r\n/chunked?\nTransfer-Encoding=chunked\nhello worldHTTP/1.1 200 OK\r\n") != nullptr);
+    const char *last = "\r\n\r\n/next?\nConnection=close\n";
+    assert(strcmp(response + strlen(response) - strlen(last), last) == 0);
+
+    // a large body, arriving in many pieces, reaches the handler whole
+    const size_t large_len = 200 * 1024;
+    char *request = malloc(large_len + 128);
+    const size_t request_len =
+            (size_t) snprintf(request, 128, "POST /large HTTP/1.0\r\nContent-Length: %zu\r\n\r\n", large_len);
+    for (size_t i = 0; i < large_len; i++) request[request_len + i] = (char) ('a' + i % 26);
+    request[request_len + large_len] = '\0';
+    const size_t response_len = round_trip(port, request, request_len + 10, response, cap);
+    const char *length_line = "\nContent-Length=204800\n";
+    const char *echoed = strstr(response, length_line) + strlen(length_line);
+    assert(response_len - (size_t) (echoed - response) == large_len);
+    assert(memcmp(echoed, request + request_len, large_len) == 0);
+
+    free(request);
+    free(response);
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+void test_server_keeps_connections_alive(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    // three pipelined requests in a single write (the last one split from the rest), the last one closing
+    char response[4096];
+    round_trip(port,
+               "GET /a HTTP/1.1\r\nHost: localhost\r\n\r\n"
+               "POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+               "GET /c HTTP/1.1\r\nConnection: close\r\n\r\n",
+               80, response, sizeof(response));
+    assert(strcmp(response,
+               "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\n\r\n1 /a 0"
+               "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\n\r\n3 /b 5"
+               "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\nConnection: close\r\n\r\n1 /c 0")
+           == 0);
+
+    // HTTP/1.0 only stays open when asked to
+    round_trip(port,
+               "GET /a HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+               "GET /b HTTP/1.0\r\n\r\n"
+               "GET /never HTTP/1.0\r\n\r\n",
+               0, response, sizeof(response));
+    assert(strcmp(response,
+               "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\nConnection: keep-alive\r\n\r\n1 /a 0"
+               "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 6\r\n\r\n1 /b 0")
+           == 0);
+
+    // a bad request ends the connection, the requests behind it are never answered
+    round_trip(port,
+               "GET /a HTTP/1.1\r\n\r\n"
+               "GET / HTTP/1.1\r\nbad header\r\n\r\n"
+               "GET /never HTTP/1.1\r\n\r\n",
+               0, response, sizeof(response));
+    assert(strstr(response, "\r\n\r\n1 /a 0HTTP/1.0 400 Bad Request\r\n") != nullptr);
+    assert(strstr(response, "Connection: close\r\n\r\n") != nullptr);
+    assert(strstr(response, "/never") == nullptr);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+typedef struct numbered_lines {
+    size_t next_line;
+    size_t lines;
+    size_t line_offset;
+} numbered_lines;
+
+/**
+ * Streams "line <n>\n" for every n below `lines`, taking up where the writer's buffer filled up last time.
+ */
+static bool produce_numbered_lines(http_response_writer *writer, void *state) {
+    numbered_lines *body = state;
+    char line[32];
+    while (body->next_line < body->lines) {
+        const size_t len = (size_t) snprintf(line, sizeof(line), "line %zu\n", body->next_line);
+        body->line_offset += http_response_writer_write(writer, line + body->line_offset, len - body->line_offset);
+        if (body->line_offset < len) return true;
+        body->line_offset = 0;
+        body->next_line++;
+    }
+    return false;
+}
+
+/**
+ * Streams 5000 numbered lines for "/stream", echoes anything else.
+ */
+static void streaming_handler(const http_request *request, http_response *response, void *user_data) {
+    if (strcmp(request->path, "/stream") != 0) {
+        echo_handler(request, response, user_data);
+        return;
+    }
+    numbered_lines *body = http_arena_alloc(request->arena, sizeof(numbered_lines));
+    *body = (numbered_lines){.lines = 5000};
+    response->status_code = 200;
+    response->reason_phrase = (uint8_t *) "OK";
+    response->headers = text_headers;
+    response->headers_cnt = 1;
+    response->body_producer = produce_numbered_lines;
+    response->body_producer_state = body;
+}
+
+static bool is_numbered_lines(const char *body, const size_t body_len, const size_t lines) {
+    size_t offset = 0;
+    char line[32];
+    for (size_t i = 0; i < lines; i++) {
+        const size_t len = (size_t) snprintf(line, sizeof(line), "line %zu\n", i);
+        if (offset + len > body_len || memcmp(body + offset, line, len) != 0) return false;
+        offset += len;
+    }
+    return offset == body_len;
+}
+
+void test_server_streams_chunked_bodies(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, streaming_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    const size_t cap = 256 * 1024;
+    char *response = malloc(cap);
+    char *body = malloc(cap);
+
+    // a streamed HTTP/1.1 body is chunked, and the connection stays open for the request after it
+    size_t response_len = round_trip(port,
+                                     "GET /stream HTTP/1.1\r\n\r\n"
+                                     "GET /after HTTP/1.1\r\nConnection: close\r\n\r\n",
+                                     0, response, cap);
+    const char *head_end = strstr(response, "\r\n\r\n");
+    assert(head_end != nullptr);
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "Transfer-Encoding: chunked\r\n") < head_end);
+    assert(strstr(response, "Content-Length") > head_end);
+
+    const uint8_t *encoded = (const uint8_t *) head_end + 4;
+    const size_t encoded_len = response_len - (size_t) (encoded - (const uint8_t *) response);
+    http_chunked_decoder decoder;
+    http_chunked_decoder_init(&decoder, cap);
+    size_t offset = 0;
+    size_t body_len = 0;
+    enum http_chunked_decode_result result;
+    do {
+        size_t consumed = 0;
+        http_slice data = {};
+        result = http_chunked_decoder_feed(&decoder, encoded + offset, encoded_len - offset, &consumed, &data);
+        offset += consumed;
+        if (data.len > 0) memcpy(body + body_len, data.ptr, data.len);
+        body_len += data.len;
+    } while (result == HTTP_CHUNKED_DATA);
+    assert(result == HTTP_CHUNKED_COMPLETE);
+    assert(is_numbered_lines(body, body_len, 5000));
+    assert(strcmp((char *) encoded + offset,
+               "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\n"
+               "1 /after 0") == 0);
+
+    // HTTP/1.0 has no chunked coding: the body ends with the connection
+    response_len = round_trip(port, "GET /stream HTTP/1.0\r\n\r\n", 0, response, cap);
+    head_end = strstr(response, "\r\n\r\n");
+    assert(strncmp(response, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n", (size_t) (head_end + 4 - response))
+        == 0);
+    assert(is_numbered_lines(head_end + 4, response_len - (size_t) (head_end + 4 - response), 5000));
+
+    // a chunked request body reaches the handler decoded
+    round_trip(port,
+               "POST /upload HTTP/1.1\r\n"
+               "Transfer-Encoding: chunked\r\n"
+               "Connection: close\r\n"
+               "\r\n"
+               "5\r\nhello\r\n6;ext\r\n world\r\n0\r\n\r\n",
+               60, response, cap);
+    assert(strstr(response, "\r\n\r\n3 /upload 11") != nullptr);
+
+    round_trip(port, "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 0, response, cap);
+    assert(strncmp(response, "HTTP/1.0 501 ", 13) == 0);
+
+    free(body);
+    free(response);
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+static atomic_size_t requests_handled;
+
+static void counting_handler(const http_request *request, http_response *response, void *user_data) {
+    atomic_fetch_add(&requests_handled, 1);
+    echo_handler(request, response, user_data);
+}
+
+typedef struct client_args {
+    uint16_t port;
+    size_t requests;
+    size_t ok;
+} client_args;
+
+static void *run_client(void *args) {
+    client_args *client = args;
+    char response[1024];
+    for (size_t i = 0; i < client->requests; i++) {
+        round_trip(client->port, "GET /multi HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+        if (strstr(response, "\r\n\r\n1 /multi 0") != nullptr) client->ok++;
+    }
+    return nullptr;
+}
+
+void test_server_with_reuseport_workers(void) {
+    http_server_settings multi_worker_settings = settings;
+    multi_worker_settings.worker_count = 4;
+    multi_worker_settings.pin_workers = true;
+    atomic_store(&requests_handled, 0);
+    http_server *server = http_server_create(&multi_worker_settings, "127.0.0.1", 0, counting_handler, nullptr);
+    assert(server != nullptr);
+    pthread_t server_thread;
+    assert(pthread_create(&server_thread, nullptr, run_server, server) == 0);
+
+    client_args clients[8];
+    pthread_t client_threads[8];
+    for (size_t i = 0; i < 8; i++) {
+        clients[i] = (client_args){.port = http_server_port(server), .requests = 25};
+        assert(pthread_create(&client_threads[i], nullptr, run_client, &clients[i]) == 0);
+    }
+    for (size_t i = 0; i < 8; i++) {
+        assert(pthread_join(client_threads[i], nullptr) == 0);
+        assert(clients[i].ok == clients[i].requests);
+    }
+    assert(atomic_load(&requests_handled) == 8 * 25);
+
+    http_server_stop(server);
+    assert(pthread_join(server_thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+void test_server_serves_from_response_cache(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024};
+    http_server_settings cached_settings = settings;
+    cached_settings.response_cache = http_response_cache_create(&cache_settings);
+    assert(cached_settings.response_cache != nullptr);
+    atomic_store(&requests_handled, 0);
+    http_server *server = http_server_create(&cached_settings, "127.0.0.1", 0, counting_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    char response[4096];
+    char first[4096];
+    round_trip(port, "GET /cached HTTP/1.0\r\n\r\n", 0, first, sizeof(first));
+    for (int i = 0; i < 3; i++) {
+        round_trip(port, "GET /cached HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+        assert(strcmp(response, first) == 0);
+    }
+    assert(atomic_load(&requests_handled) == 1);
+    assert(strstr(first, "\r\n\r\n1 /cached 0") != nullptr);
+
+    const char *etag = strstr(first, "ETag: ");
+    assert(etag != nullptr);
+    char conditional[256];
+    snprintf(conditional, sizeof(conditional), "GET /cached HTTP/1.0\r\nIf-None-Match: %.*s\r\n\r\n",
+             (int) strcspn(etag + 6, "\r"), etag + 6);
+    round_trip(port, conditional, 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 304 Not Modified\r\n", 27) == 0);
+    assert(strcmp(response + strlen(response) - 4, "\r\n\r\n") == 0);
+
+    // not cached: a different method
+    round_trip(port, "POST /cached HTTP/1.0\r\nContent-Length: 0\r\n\r\n", 0, response, sizeof(response));
+    assert(atomic_load(&requests_handled) == 2);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+    http_response_cache_destroy(cached_settings.response_cache);
+}
+
+void test_server_adds_server_headers(void) {
+    static const http_header_fragment server_fragments[] = {HTTP_HEADER_FRAGMENT("Server", "TinyLittleHTTP")};
+    http_server_settings header_settings = settings;
+    header_settings.header_fragments = server_fragments;
+    header_settings.header_fragments_cnt = 1;
+    header_settings.send_date = true;
+    http_server *server = http_server_create(&header_settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    char response[4096];
+    round_trip(http_server_port(server), "GET /dated HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    const char head[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nServer: TinyLittleHTTP\r\nDate: ";
+    assert(strncmp(response, head, sizeof(head) - 1) == 0);
+    // "Sun, 06 Nov 1994 08:49:37" GMT, then the framing headers
+    const char *date_end = strstr(response, " GMT\r\nContent-Length: 10\r\n\r\n1 /dated 0");
+    assert(date_end != nullptr && date_end - response == (ptrdiff_t) (sizeof(head) - 1 + 25));
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+void test_server_dates_cached_responses(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024};
+    http_server_settings cached_settings = settings;
+    cached_settings.response_cache = http_response_cache_create(&cache_settings);
+    cached_settings.send_date = true;
+    assert(cached_settings.response_cache != nullptr);
+    http_server *server = http_server_create(&cached_settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    char first[4096];
+    char response[4096];
+    round_trip(port, "GET /dated HTTP/1.0\r\n\r\n", 0, first, sizeof(first));
+    const char *first_date = strstr(first, "\r\nDate: ");
+    assert(first_date != nullptr && strstr(first_date + 1, "\r\nDate: ") == nullptr);
+    // a hit in a later second is dated in that second, not in the one the response was stored in
+    sleep(1);
+    round_trip(port, "GET /dated HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    const char *date = strstr(response, "\r\nDate: ");
+    assert(date != nullptr && strstr(date + 1, "\r\nDate: ") == nullptr);
+    assert(strncmp(date, first_date, 37) != 0);
+    assert(strcmp(strstr(response, "\r\n\r\n"), "\r\n\r\n1 /dated 0") == 0);
+
+    const char *etag = strstr(first, "ETag: ");
+    char conditional[256];
+    snprintf(conditional, sizeof(conditional), "GET /dated HTTP/1.0\r\nIf-None-Match: %.*s\r\n\r\n",
+             (int) strcspn(etag + 6, "\r"), etag + 6);
+    round_trip(port, conditional, 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 304 Not Modified\r\n", 27) == 0);
+    date = strstr(response, "\r\nDate: ");
+    assert(date != nullptr && strstr(date + 1, "\r\nDate: ") == nullptr);
+    assert(strstr(date, " GMT\r\n") - date == 2 + 6 + 25);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+    http_response_cache_destroy(cached_settings.response_cache);
+}
+
+#ifndef TINY_HTTP_NO_COMPRESSION
+/**
+ * Answers with 4 KiB of text, counting the calls in the `atomic_size_t` `user_data`.
+ */
+static void text_handler(const http_request *request, http_response *response, void *user_data) {
+    atomic_fetch_add((atomic_size_t *) user_data, 1);
+    uint8_t *body = http_arena_alloc(request->arena, 4096);
+    for (size_t i = 0; i < 4096; i++) body[i] = (uint8_t) "tiny little http\n"[i % 17];
+    response->status_code = 200;
+    response->headers = text_headers;
+    response->headers_cnt = 1;
+    response->body = body;
+    response->body_len = 4096;
+}
+
+void test_server_compresses_responses(void) {
+    const http_response_cache_settings cache_settings = {.max_bytes = 64 * 1024, .vary_content_coding = true};
+    const http_compression_settings compression = {.max_cached_bytes = 64 * 1024};
+    http_server_settings compressed_settings = settings;
+    compressed_settings.response_cache = http_response_cache_create(&cache_settings);
+    compressed_settings.compressor = http_compressor_create(&compression);
+    assert(compressed_settings.response_cache != nullptr && compressed_settings.compressor != nullptr);
+    atomic_size_t handled = 0;
+    http_server *server = http_server_create(&compressed_settings, "127.0.0.1", 0, text_handler, &handled);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    char response[8192];
+    char first[8192];
+    const size_t first_len = round_trip(port, "GET /text HTTP/1.0\r\nAccept-Encoding: gzip, deflate, br\r\n\r\n", 0,
+                                        first, sizeof(first));
+    assert(strstr(first, "\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n") != nullptr);
+    const char *body = strstr(first, "\r\n\r\n") + 4;
+    char content_length[32];
+    snprintf(content_length, sizeof(content_length), "Content-Length: %zu\r\n", first_len - (size_t) (body - first));
+    assert(strstr(first, content_length) != nullptr);
+    assert(first_len - (size_t) (body - first) < 200);
+    assert((uint8_t) body[0] == 0x1f && (uint8_t) body[1] == 0x8b); // the gzip magic
+
+    // the compressed response is cached under its coding...
+    round_trip(port, "GET /text HTTP/1.0\r\nAccept-Encoding: gzip\r\n\r\n", 0, response, sizeof(response));
+    assert(memcmp(response, first, first_len) == 0);
+    assert(atomic_load(&handled) == 1);
+    // ...and a client without compression gets another one
+    const size_t plain_len = round_trip(port, "GET /text HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    assert(strstr(response, "Content-Encoding") == nullptr && strstr(response, "\r\nVary: Accept-Encoding\r\n") != nullptr);
+    assert(strstr(response, "\r\nContent-Length: 4096\r\n") != nullptr && plain_len > 4096);
+    assert(atomic_load(&handled) == 2);
+    round_trip(port, "GET /text HTTP/1.0\r\nAccept-Encoding: deflate\r\n\r\n", 0, response, sizeof(response));
+    assert(strstr(response, "\r\nContent-Encoding: deflate\r\n") != nullptr);
+    assert(atomic_load(&handled) == 3);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+    http_response_cache_destroy(compressed_settings.response_cache);
+    http_compressor_destroy(compressed_settings.compressor);
+}
+#endif
+
+static int connect_to(const uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    assert(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+/**
+ * Sends `request` on the open connection and reads until `expected_end` has arrived.
+ */
+static void exchange(const int fd, const char *request, const char *expected_end) {
+    assert(send(fd, request, strlen(request), 0) == (ssize_t) strlen(request));
+    char response[1024];
+    size_t response_len = 0;
+    while (true) {
+        const ssize_t received = recv(fd, response + response_len, sizeof(response) - 1 - response_len, 0);
+        assert(received > 0);
+        response_len += (size_t) received;
+        response[response_len] = '\0';
+        if (strstr(response, expected_end) != nullptr) return;
+    }
+}
+
+void test_server_pools_idle_connection_buffers(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    int fds[20];
+    for (size_t i = 0; i < 20; i++) {
+        fds[i] = connect_to(port);
+        exchange(fds[i], "GET /idle HTTP/1.1\r\n\r\n", "1 /idle 0");
+    }
+    usleep(50 * 1000);
+    http_server_pool_stats stats;
+    http_server_pool_stats_load(server, &stats);
+    // twenty open connections, but none of them is holding on to a buffer while it waits
+    assert(stats.connections.in_use == 20);
+    for (size_t tier = 0; tier < HTTP_BUFFER_POOL_TIERS; tier++) assert(stats.buffers.tiers[tier].in_use == 0);
+    assert(stats.buffers.oversized.acquired == 0);
+
+    for (size_t i = 0; i < 20; i++) exchange(fds[i], "GET /again HTTP/1.1\r\n\r\n", "1 /again 0");
+    usleep(50 * 1000);
+    http_server_pool_stats again;
+    http_server_pool_stats_load(server, &again);
+    // the second round of requests was served from the free lists alone
+    for (size_t tier = 0; tier < HTTP_BUFFER_POOL_TIERS; tier++) {
+        const size_t acquired = again.buffers.tiers[tier].acquired - stats.buffers.tiers[tier].acquired;
+        const size_t reused = again.buffers.tiers[tier].reused - stats.buffers.tiers[tier].reused;
+        assert(acquired == reused);
+        assert(again.buffers.tiers[tier].in_use == 0);
+    }
+
+    for (size_t i = 0; i < 20; i++) close(fds[i]);
+    usleep(50 * 1000);
+    http_server_pool_stats_load(server, &stats);
+    assert(stats.connections.in_use == 0 && stats.connections.high_water == 20);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+/**
+ * Reads from the open connection until the server closes it.
+ */
+static size_t read_until_closed(const int fd, char *response, const size_t cap) {
+    size_t response_len = 0;
+    ssize_t received;
+    while ((received = recv(fd, response + response_len, cap - 1 - response_len, 0)) > 0) {
+        response_len += (size_t) received;
+    }
+    response[response_len] = '\0';
+    return response_len;
+}
+
+void test_server_times_out_slow_clients(void) {
+    http_server_settings quick = settings;
+    quick.idle_timeout_ms = 100;
+    quick.header_timeout_ms = 150;
+    quick.body_timeout_ms = 150;
+    http_server *server = http_server_create(&quick, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+    char response[1024];
+
+    // a connection that never sends anything is just closed
+    int fd = connect_to(port);
+    assert(read_until_closed(fd, response, sizeof(response)) == 0);
+    close(fd);
+
+    // as is a persistent one once it has gone quiet
+    fd = connect_to(port);
+    exchange(fd, "GET /first HTTP/1.1\r\n\r\n", "1 /first 0");
+    assert(read_until_closed(fd, response, sizeof(response)) == 0);
+    close(fd);
+
+    // a head trickling in does not buy itself more time
+    fd = connect_to(port);
+    const char *head_lines[] = {"GET /slow HTTP/1.1\r\n", "Host: a\r\n", "X-A: a\r\n", "X-B: b\r\n", "X-C: c\r\n"};
+    for (size_t i = 0; i < sizeof(head_lines) / sizeof(head_lines[0]); i++) {
+        send(fd, head_lines[i], strlen(head_lines[i]), MSG_NOSIGNAL);
+        usleep(50 * 1000);
+    }
+    read_until_closed(fd, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 408 ", 13) == 0);
+    close(fd);
+
+    // a body that stalls is answered the same
+    fd = connect_to(port);
+    const char *stalled = "POST /upload HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc";
+    assert(send(fd, stalled, strlen(stalled), 0) == (ssize_t) strlen(stalled));
+    read_until_closed(fd, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 408 ", 13) == 0);
+    close(fd);
+
+    // but one that keeps arriving, however slowly, gets through
+    fd = connect_to(port);
+    const char *head = "POST /upload HTTP/1.0\r\nContent-Length: 5\r\n\r\n";
+    assert(send(fd, head, strlen(head), 0) == (ssize_t) strlen(head));
+    for (size_t i = 0; i < 5; i++) {
+        usleep(60 * 1000);
+        assert(send(fd, "x", 1, 0) == 1);
+    }
+    read_until_closed(fd, response, sizeof(response));
+    assert(strstr(response, "\r\n\r\n3 /upload 5") != nullptr);
+    close(fd);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+void test_server_sheds_load(void) {
+    const http_admission_settings admission = {.min_concurrency = 1, .max_concurrency = 1, .retry_after_s = 7};
+    http_server_settings shedding = settings;
+    shedding.admission = &admission;
+    http_server *server = http_server_create(&shedding, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+    char response[1024];
+
+    // a request is in flight from its head on, its body still on the way
+    const int slow = connect_to(port);
+    const char *head = "POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nab";
+    assert(send(slow, head, strlen(head), 0) == (ssize_t) strlen(head));
+    usleep(20 * 1000);
+    int fd = connect_to(port);
+    const char *request = "GET /b HTTP/1.1\r\n\r\n";
+    assert(send(fd, request, strlen(request), 0) == (ssize_t) strlen(request));
+    read_until_closed(fd, response, sizeof(response));
+    assert(strcmp(response, "HTTP/1.0 503 Service Unavailable\r\nRetry-After: 7\r\n"
+               "Content-Length: 0\r\nConnection: close\r\n\r\n") == 0);
+    close(fd);
+
+    http_admission_stats stats;
+    http_server_admission_stats_load(server, &stats);
+    assert(stats.limit == 1 && stats.in_flight == 1 && stats.admitted == 1 && stats.shed_concurrency == 1);
+
+    // once it has been answered, the next one gets through
+    exchange(slow, "cde", "3 /a 5");
+    fd = connect_to(port);
+    exchange(fd, request, "1 /b 0");
+    close(fd);
+    close(slow);
+    usleep(20 * 1000);
+    http_server_admission_stats_load(server, &stats);
+    assert(stats.in_flight == 0 && stats.admitted == 2 && stats.shed_delay == 0);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+/**
+ * `echo_handler`, 5 ms late.
+ */
+static void slow_handler(const http_request *request, http_response *response, void *user_data) {
+    usleep(5 * 1000);
+    echo_handler(request, response, user_data);
+}
+
+static atomic_bool load_stopped;
+
+/**
+ * Sends requests one after the other, each on a connection of its own, until `load_stopped`.
+ */
+static void *keep_requesting(void *port) {
+    char response[1024];
+    while (!atomic_load(&load_stopped)) {
+        round_trip(*(const uint16_t *) port, "GET /slow HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+        assert(strncmp(response, "HTTP/1.0 200 ", 13) == 0 || strncmp(response, "HTTP/1.0 503 ", 13) == 0);
+    }
+    return nullptr;
+}
+
+void test_server_sheds_a_standing_queue(void) {
+    // a 5 ms handler cannot keep to a 1 ms target once a few clients are always waiting on it
+    const http_admission_settings admission = {.target_delay_us = 1000, .interval_us = 20 * 1000};
+    http_server_settings shedding = settings;
+    shedding.admission = &admission;
+    shedding.worker_count = 1;
+    http_server *server = http_server_create(&shedding, "127.0.0.1", 0, slow_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    atomic_store(&load_stopped, false);
+    pthread_t clients[4];
+    for (size_t i = 0; i < 4; i++) assert(pthread_create(&clients[i], nullptr, keep_requesting, (void *) &port) == 0);
+    // the queue stands from the first request on, but only counts once a whole interval has seen it
+    http_admission_stats stats;
+    bool overloaded = false;
+    size_t limit = SIZE_MAX;
+    for (size_t i = 0; i < 200 && !(overloaded && limit < 1024); i++) {
+        usleep(5 * 1000);
+        http_server_admission_stats_load(server, &stats);
+        if (stats.overloaded == 1) overloaded = true;
+        if (stats.limit < limit) limit = stats.limit;
+    }
+    atomic_store(&load_stopped, true);
+    for (size_t i = 0; i < 4; i++) assert(pthread_join(clients[i], nullptr) == 0);
+    assert(overloaded && limit < 1024);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+}
+
+static uint64_t histogram_count(const http_metrics_snapshot *snapshot, const http_metric_histogram histogram) {
+    uint64_t count = 0;
+    for (size_t i = 0; i <= HTTP_METRICS_HISTOGRAM_BUCKETS; i++) count += snapshot->histograms[histogram].buckets[i];
+    return count;
+}
+
+void test_server_exports_metrics(void) {
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, http_metrics_handler, nullptr);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+    http_metrics_snapshot before;
+    http_metrics_load(&before);
+
+    char response[64 * 1024];
+    round_trip(port, "GET /metrics HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n") != nullptr);
+    assert(strstr(response, "\n# TYPE tiny_http_requests_total counter\n") != nullptr);
+    assert(strstr(response, "\ntiny_http_handler_duration_seconds_count ") != nullptr);
+    round_trip(port, "GET /metrics HTTP/1.0\r\n\r\n", 0, response, sizeof(response));
+    round_trip(port, "GET / HTTP/2.0\r\n\r\n", 0, response, sizeof(response));
+    assert(strncmp(response, "HTTP/1.0 505 ", 13) == 0);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+
+    // every connection was closed by the time the worker stopped, so the counts are complete
+    http_metrics_snapshot after;
+    http_metrics_load(&after);
+    assert(after.counters[HTTP_METRIC_REQUESTS] - before.counters[HTTP_METRIC_REQUESTS] == 2);
+    assert(after.counters[HTTP_METRIC_CONNECTIONS_OPENED] - before.counters[HTTP_METRIC_CONNECTIONS_OPENED] == 3);
+    assert(after.counters[HTTP_METRIC_CONNECTIONS_CLOSED] - before.counters[HTTP_METRIC_CONNECTIONS_CLOSED] == 3);
+    assert(after.counters[HTTP_METRIC_BYTES_IN] - before.counters[HTTP_METRIC_BYTES_IN]
+        == 2 * strlen("GET /metrics HTTP/1.0\r\n\r\n") + strlen("GET / HTTP/2.0\r\n\r\n"));
+    assert(after.counters[HTTP_METRIC_BYTES_OUT] - before.counters[HTTP_METRIC_BYTES_OUT] > 2 * 1000);
+    assert(after.responses[1] - before.responses[1] == 2);
+    assert(after.responses[4] - before.responses[4] == 1);
+    assert(after.parse_errors[PARSE_E_HTTP_VERSION_NOT_SUPPORTED + 11]
+        - before.parse_errors[PARSE_E_HTTP_VERSION_NOT_SUPPORTED + 11] == 1);
+    assert(histogram_count(&after, HTTP_METRIC_PARSE_TIME) - histogram_count(&before, HTTP_METRIC_PARSE_TIME) == 2);
+    assert(histogram_count(&after, HTTP_METRIC_HANDLER_TIME) - histogram_count(&before, HTTP_METRIC_HANDLER_TIME) == 2);
+    assert(histogram_count(&after, HTTP_METRIC_RENDER_TIME) - histogram_count(&before, HTTP_METRIC_RENDER_TIME) == 2);
+}
+
+void test_server_on_io_uring(void) {
+    settings.io_engine = HTTP_IO_ENGINE_IO_URING;
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, echo_handler, nullptr);
+    assert(server != nullptr);
+    const bool supported = http_server_io_engine(server) == HTTP_IO_ENGINE_IO_URING;
+    http_server_destroy(server);
+    if (!supported) {
+        printf("io_uring is not supported here, skipping\n");
+    } else {
+        // the same requests, answered the same way
+        test_server_serves_requests_over_loopback();
+        test_server_hands_over_the_parsed_request();
+        test_server_keeps_connections_alive();
+        test_server_streams_chunked_bodies();
+        test_server_with_reuseport_workers();
+        test_server_pools_idle_connection_buffers();
+        test_server_times_out_slow_clients();
+        test_server_sheds_load();
+        test_server_sheds_a_standing_queue();
+#ifndef TINY_HTTP_NO_METRICS
+        test_server_exports_metrics();
+#endif
+    }
+    settings.io_engine = HTTP_IO_ENGINE_EPOLL;
+}
+
+int main() {
+    test_server_serves_requests_over_loopback();
+    test_server_hands_over_the_parsed_request();
+    test_server_keeps_connections_alive();
+    test_server_streams_chunked_bodies();
+    test_server_with_reuseport_workers();
+    test_server_serves_from_response_cache();
+    test_server_adds_server_headers();
+    test_server_dates_cached_responses();
+#ifndef TINY_HTTP_NO_COMPRESSION
+    test_server_compresses_responses();
+#endif
+    test_server_pools_idle_connection_buffers();
+    test_server_times_out_slow_clients();
+    test_server_sheds_load();
+    test_server_sheds_a_standing_queue();
+#ifndef TINY_HTTP_NO_METRICS
+    test_server_exports_metrics();
+#endif
+    test_server_on_io_uring();
+
+    return EXIT_SUCCESS;
+}
@@ -5,6 +5,8 @@
 #define DEBUG 1
 
 #include <assert.h>
+#include <stdalign.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -156,6 +158,19 @@ void test_response_render_200_no_body(void) {
     free(response_octets);
 }
 
+void test_response_render_http_1_1(void) {
+    const http_response response = {
+        .version = HTTP_1_1,
+        .status_code = 204,
+        .reason_phrase = (uint8_t *) "No Content",
+    };
+    uint8_t *response_octets = nullptr;
+    size_t response_octets_len = 0;
+    assert(render_http_response(&settings, &response, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(strcmp((char *) response_octets, "HTTP/1.1 204 No Content\r\n") == 0);
+    free(response_octets);
+}
+
 void test_response_render_404_no_body(void) {
     const http_response response = {
         .version = HTTP_1_0,
@@ -206,6 +221,7 @@ void test_response_render_200_with_body(void) {
         assert(strncmp((char *)response_octets, expected_response, expected_response_len) == 0);
         assert(strnlen((char *) response_octets, expected_response_len) == response_octets_len);
         free(response_octets);
+        free(response.headers);
     }
 }
 
@@ -232,6 +248,585 @@ void test_request_parse_get_urlencoded_path() {
     destroy_http_request(http_req);
 }
 
+void test_request_view_parse_get_root_curl(void) {
+    const uint8_t request[] = "GET / HTTP/1.0\r\n"
+            "Host: localhost:8085\r\n"
+            "User-Agent: curl/8.7.1\r\n"
+            "Accept: */*\r\n"
+            "\r\n";
+    http_request_view http_req = {};
+    const enum parse_http_request_status status =
+            parse_http_request_view(&settings, request, strlen((char *) request), &http_req);
+    assert(status == PARSE_OK);
+    assert(http_req.method == GET);
+    assert(http_req.version == HTTP_1_0);
+    assert(http_slice_eq_cstr(http_req.path, "/"));
+    assert(http_req.headers_cnt == 3);
+    assert(http_slice_eq_cstr(http_req.headers[0].name, "Host"));
+    assert(http_slice_eq_cstr(http_req.headers[0].value, "localhost:8085"));
+    assert(http_slice_eq_cstr(http_req.headers[1].name, "User-Agent"));
+    assert(http_slice_eq_cstr(http_req.headers[1].value, "curl/8.7.1"));
+    assert(http_slice_eq_cstr(http_req.headers[2].name, "Accept"));
+    assert(http_slice_eq_cstr(http_req.headers[2].value, "*/*"));
+    assert(http_req.body.ptr == nullptr);
+    assert(http_req.body.len == 0);
+}
+
+void test_request_view_post_root_curl(void) {
+    const uint8_t request[] = "POST /one/two/three HTTP/1.0\r\n"
+            "Content-Type: application/json\r\n"
+            "User-Agent: PostmanRuntime/7.42.0\r\n"
+            "Accept: */*\r\n"
+            "Host: localhost:8085\r\n"
+            "Accept-Encoding: gzip, deflate, br\r\n"
+            "Content-Length: 68\r\n"
+            "\r\n"
+            "{\n    \"key1\": \"value1\",\n    \"key2\": \"value2\",\n    \"key3\": \"value3\"\n}";
+    const size_t request_len = strlen((char *) request);
+    http_request_view http_req = {};
+    const enum parse_http_request_status status =
+            parse_http_request_view(&settings, request, request_len, &http_req);
+    assert(status == PARSE_OK);
+    assert(http_req.method == POST);
+    assert(http_req.version == HTTP_1_0);
+    assert(http_slice_eq_cstr(http_req.path, "/one/two/three"));
+    assert(http_req.headers_cnt == 6);
+    assert(http_slice_eq_cstr(http_req.headers[0].name, "Content-Type"));
+    assert(http_slice_eq_cstr(http_req.headers[0].value, "application/json"));
+    assert(http_slice_eq_cstr(http_req.headers[4].name, "Accept-Encoding"));
+    assert(http_slice_eq_cstr(http_req.headers[4].value, "gzip, deflate, br"));
+    assert(http_slice_eq_cstr(http_req.headers[5].name, "Content-Length"));
+    assert(http_slice_eq_cstr(http_req.headers[5].value, "68"));
+    assert(http_req.body.len == 68);
+    // borrowed, not copied
+    assert(http_req.body.ptr == request + request_len - 68);
+    assert(http_req.path.ptr == request + 5);
+}
+
+void test_request_view_post_root_curl_with_wide_chars(void) {
+    const uint8_t request[] = "POST /one/🐌/three HTTP/1.0\r\n"
+            "Content-Type: application/json\r\n"
+            "Test-Header: 🐍\r\n"
+            "Content-Length: 66\r\n" // "🐌" is 4 octets, two fewer than "value1"
+            "\r\n"
+            "{\n    \"key1\": \"🐌\",\n    \"key2\": \"value2\",\n    \"key3\": \"value3\"\n}";
+    http_request_view http_req = {};
+    const enum parse_http_request_status status =
+            parse_http_request_view(&settings, request, strlen((char *) request), &http_req);
+    assert(status == PARSE_OK);
+    assert(http_req.method == POST);
+    assert(http_slice_eq_cstr(http_req.path, "/one/🐌/three"));
+    assert(http_req.headers_cnt == 3);
+    assert(http_slice_eq_cstr(http_req.headers[1].name, "Test-Header"));
+    assert(http_slice_eq_cstr(http_req.headers[1].value, "🐍"));
+    assert(http_req.body.len == 66);
+    assert(strncmp((char *) http_req.body.ptr,
+        "{\n    \"key1\": \"🐌\",\n    \"key2\": \"value2\",\n    \"key3\": \"value3\"\n}", 66) == 0);
+}
+
+void test_request_view_parse_head(void) {
+    const uint8_t request[] = "HEAD /test HTTP/1.0\r\n"
+            "Host: localhost:8085\r\n"
+            "\r\n";
+    http_request_view http_req = {};
+    const enum parse_http_request_status status =
+            parse_http_request_view(&settings, request, strlen((char *) request), &http_req);
+    assert(status == PARSE_OK);
+    assert(http_req.method == HEAD);
+    assert(http_slice_eq_cstr(http_req.path, "/test"));
+    assert(http_req.headers_cnt == 1);
+    assert(http_req.body.len == 0);
+}
+
+void test_request_view_parse_get_urlencoded_path(void) {
+    const uint8_t request[] = "GET /some%20path%20with%20spaces HTTP/1.0\r\n"
+            "Host: localhost:8085\r\n"
+            "\r\n";
+    http_request_view http_req = {};
+    const enum parse_http_request_status status =
+            parse_http_request_view(&settings, request, strlen((char *) request), &http_req);
+    assert(status == PARSE_OK);
+    // the view is raw: no decoding happens without a buffer to decode into
+    assert(http_slice_eq_cstr(http_req.path, "/some%20path%20with%20spaces"));
+}
+
+void test_request_view_incomplete_and_malformed(void) {
+    const uint8_t partial[] = "GET / HTTP/1.0\r\n"
+            "Host: local";
+    http_request_view http_req = {};
+    assert(parse_http_request_view(&settings, partial, strlen((char *) partial), &http_req)
+        == PARSE_E_INCOMPLETE);
+
+    const uint8_t short_body[] = "POST / HTTP/1.0\r\n"
+            "Content-Length: 10\r\n"
+            "\r\n"
+            "12345";
+    assert(parse_http_request_view(&settings, short_body, strlen((char *) short_body), &http_req)
+        == PARSE_E_INCOMPLETE);
+
+    const uint8_t no_colon[] = "GET / HTTP/1.0\r\n"
+            "Host localhost\r\n"
+            "\r\n";
+    assert(parse_http_request_view(&settings, no_colon, strlen((char *) no_colon), &http_req)
+        == PARSE_E_MALFORMED_HTTP_HEADER);
+
+    const uint8_t bad_method[] = "BREW / HTTP/1.0\r\n\r\n";
+    assert(parse_http_request_view(&settings, bad_method, strlen((char *) bad_method), &http_req)
+        == PARSE_E_HTTP_METHOD_NOT_SUPPORTED);
+}
+
+void test_request_methods(void) {
+    static const struct {
+        const char *token;
+        http_method method;
+    } methods[] = {
+        {"GET", GET}, {"HEAD", HEAD}, {"POST", POST}, {"PUT", PUT}, {"DELETE", DELETE},
+        {"CONNECT", CONNECT}, {"OPTIONS", OPTIONS}, {"TRACE", TRACE}, {"PATCH", PATCH},
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        const size_t len = strlen(methods[i].token);
+        assert(http_method_lookup((const uint8_t *) methods[i].token, len) == methods[i].method);
+        assert(strcmp(http_method_name(methods[i].method), methods[i].token) == 0);
+        // a prefix or an extension of a method is none
+        assert(http_method_lookup((const uint8_t *) methods[i].token, len - 1) == HTTP_METHOD_UNKNOWN);
+
+        // both parsers, the request line long enough to be loaded 8 octets at a time or not
+        uint8_t packet[64];
+        const int packet_len = snprintf((char *) packet, sizeof(packet), "%s /x HTTP/1.1\r\n\r\n", methods[i].token);
+        http_request_view view;
+        assert(parse_http_request_view(&settings, packet, (size_t) packet_len, &view) == PARSE_OK);
+        assert(view.method == methods[i].method);
+        http_request *request = parse_http_request(&settings, packet, (size_t) packet_len);
+        assert(request != nullptr && request->method == methods[i].method && strcmp(request->path, "/x") == 0);
+        destroy_http_request(request);
+        assert(parse_http_request_view(&settings, packet, len + 1, &view) == PARSE_E_INCOMPLETE);
+    }
+    assert(http_method_lookup((const uint8_t *) "GET\0", 4) == HTTP_METHOD_UNKNOWN);
+    assert(http_method_lookup((const uint8_t *) "get", 3) == HTTP_METHOD_UNKNOWN);
+    assert(http_method_lookup((const uint8_t *) "PROPFIND", 8) == HTTP_METHOD_UNKNOWN);
+    assert(http_method_lookup((const uint8_t *) "", 0) == HTTP_METHOD_UNKNOWN);
+    assert(http_method_name(HTTP_METHOD_UNKNOWN) == nullptr && http_method_name(HTTP_METHOD_COUNT) == nullptr);
+
+    http_request_view view;
+    const uint8_t postx[] = "POSTX / HTTP/1.1\r\n\r\n";
+    assert(parse_http_request_view(&settings, postx, sizeof(postx) - 1, &view) == PARSE_E_HTTP_METHOD_NOT_SUPPORTED);
+    assert(parse_http_request(&settings, postx, sizeof(postx) - 1) == nullptr);
+    const uint8_t long_method[] = "MKCALENDAR / HTTP/1.1\r\n\r\n";
+    assert(parse_http_request_view(&settings, long_method, sizeof(long_method) - 1, &view)
+        == PARSE_E_HTTP_METHOD_NOT_SUPPORTED);
+    const uint8_t no_space[] = "GET\t/ HTTP/1.1\r\n\r\n";
+    assert(parse_http_request_view(&settings, no_space, sizeof(no_space) - 1, &view)
+        == PARSE_E_MALFORMED_HTTP_REQUEST_LINE);
+}
+
+void test_path_normalize(void) {
+    static const struct {
+        const char *raw;
+        const char *path;
+    } paths[] = {
+        {"/", "/"},
+        {"/a/./b/../c//d", "/a/c/d"},
+        {"/a/b/", "/a/b"},
+        {"/a/b/..", "/a"},
+        {"/a//.", "/a"},
+        {"/..", "/"},
+        {"/../../a", "/a"},
+        {"/a/%2e%2E/b", "/b"},
+        {"/a/.%2e", "/"},
+        {"/a/..b/.c", "/a/..b/.c"},
+        {"/a%2fb", "/a/b"},
+        {"/%7e%20x", "/~ x"},
+        {"*", "/*"},
+        {"", "/"},
+    };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        const size_t raw_len = strlen(paths[i].raw);
+        char out[32];
+        assert(raw_len + 2 <= sizeof(out));
+        const ssize_t len = http_path_normalize((const uint8_t *) paths[i].raw, raw_len, out);
+        assert(len == (ssize_t) strlen(paths[i].path) && strcmp(out, paths[i].path) == 0);
+    }
+    const char *malformed[] = {"/a%", "/a%2", "/a%zz", "/a%00b"};
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        char out[32];
+        assert(http_path_normalize((const uint8_t *) malformed[i], strlen(malformed[i]), out) == -1);
+    }
+
+    const uint8_t traversal[] = "GET /static/%2e%2e/../etc/./passwd HTTP/1.1\r\n\r\n";
+    http_request *request = parse_http_request(&settings, traversal, sizeof(traversal) - 1);
+    assert(request != nullptr && strcmp(request->path, "/etc/passwd") == 0);
+    destroy_http_request(request);
+    const uint8_t nul[] = "GET /a%00 HTTP/1.1\r\n\r\n";
+    assert(parse_http_request(&settings, nul, sizeof(nul) - 1) == nullptr);
+}
+
+void test_request_query(void) {
+    const uint8_t packet[] = "GET /search/../find?q=tiny+http&lang=c%2B%2B&&flag&empty= HTTP/1.1\r\n\r\n";
+    http_request *request = parse_http_request(&settings, packet, sizeof(packet) - 1);
+    assert(request != nullptr);
+    assert(strcmp(request->path, "/find") == 0);
+    assert(http_slice_eq_cstr(request->query, "q=tiny+http&lang=c%2B%2B&&flag&empty="));
+    http_request_view view;
+    assert(parse_http_request_view(&settings, packet, sizeof(packet) - 1, &view) == PARSE_OK);
+    assert(http_slice_eq_cstr(view.path, "/search/../find"));
+    assert(http_slice_eq_cstr(view.query, "q=tiny+http&lang=c%2B%2B&&flag&empty="));
+
+    // the pairs as they are, empty ones skipped
+    static const char *pairs[][2] = {{"q", "tiny+http"}, {"lang", "c%2B%2B"}, {"flag", ""}, {"empty", ""}};
+    http_slice rest = request->query;
+    http_slice key;
+    http_slice value;
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        assert(http_query_next(&rest, &key, &value));
+        assert(http_slice_eq_cstr(key, pairs[i][0]) && http_slice_eq_cstr(value, pairs[i][1]));
+    }
+    assert(!http_query_next(&rest, &key, &value));
+
+    char out[16];
+    assert(http_query_param(request->query, "q", out, sizeof(out)) == 9 && strcmp(out, "tiny http") == 0);
+    assert(http_query_param(request->query, "lang", out, sizeof(out)) == 3 && strcmp(out, "c++") == 0);
+    assert(http_query_param(request->query, "flag", out, sizeof(out)) == 0 && out[0] == '\0');
+    assert(http_query_param(request->query, "missing", out, sizeof(out)) == -1);
+    assert(http_query_param(request->query, "q", out, 9) == -1);
+    const http_slice bad = {.ptr = (const uint8_t *) "a=%4", .len = 4};
+    assert(http_query_param(bad, "a", out, sizeof(out)) == -1);
+    destroy_http_request(request);
+
+    // no '?', no query; a bare '?', an empty one
+    const uint8_t plain[] = "GET /find HTTP/1.1\r\n\r\n";
+    request = parse_http_request(&settings, plain, sizeof(plain) - 1);
+    assert(request != nullptr && request->query.ptr == nullptr && request->query.len == 0);
+    destroy_http_request(request);
+    assert(parse_http_request_view(&settings, plain, sizeof(plain) - 1, &view) == PARSE_OK);
+    assert(view.query.ptr == nullptr && http_slice_eq_cstr(view.path, "/find"));
+    const uint8_t bare[] = "GET /find? HTTP/1.1\r\n\r\n";
+    assert(parse_http_request_view(&settings, bare, sizeof(bare) - 1, &view) == PARSE_OK);
+    assert(view.query.ptr != nullptr && view.query.len == 0 && http_slice_eq_cstr(view.path, "/find"));
+}
+
+void test_request_view_pipelined_http_1_1(void) {
+    const uint8_t requests[] = "POST /a HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Content-Length: 5\r\n"
+            "\r\n"
+            "hello"
+            "GET /b HTTP/1.1\r\n"
+            "Connection: Keep-Alive, Close\r\n"
+            "\r\n";
+    const size_t requests_len = strlen((char *) requests);
+    http_request_view http_req = {};
+    assert(parse_http_request_view(&settings, requests, requests_len, &http_req) == PARSE_OK);
+    assert(http_req.version == HTTP_1_1);
+    assert(http_slice_eq_cstr(http_req.body, "hello"));
+    assert(http_request_view_keep_alive(&http_req));
+
+    // no Content-Length: no body, the next request is left alone
+    const size_t first_len = http_req.request_len;
+    assert(memcmp(requests + first_len, "GET /b", 6) == 0);
+    assert(parse_http_request_view(&settings, requests + first_len, requests_len - first_len, &http_req) == PARSE_OK);
+    assert(http_slice_eq_cstr(http_req.path, "/b"));
+    assert(http_req.body.len == 0);
+    assert(http_req.request_len == requests_len - first_len);
+    assert(!http_request_view_keep_alive(&http_req));
+
+    const uint8_t http_1_0[] = "GET / HTTP/1.0\r\n\r\n";
+    assert(parse_http_request_view(&settings, http_1_0, strlen((char *) http_1_0), &http_req) == PARSE_OK);
+    assert(!http_request_view_keep_alive(&http_req));
+
+    const uint8_t legacy_request[] = "GET /c HTTP/1.1\r\nconnection: close\r\n\r\n";
+    http_request *request = parse_http_request(&settings, legacy_request, strlen((char *) legacy_request));
+    assert(request != nullptr);
+    assert(request->version == HTTP_1_1);
+    assert(!http_request_keep_alive(request));
+    destroy_http_request(request);
+}
+
+void test_request_known_headers_ignore_case(void) {
+    const uint8_t request[] = "POST /upload HTTP/1.1\r\n"
+            "host: localhost\r\n"
+            "X-Trace: abc\r\n"
+            "content-length: 5\r\n"
+            "CONTENT-TYPE: text/plain\r\n"
+            "Host: ignored\r\n"
+            "\r\n"
+            "hello trailing";
+    http_request *http_req = parse_http_request(&settings, request, strlen((char *) request));
+    assert(http_req != nullptr);
+    assert(http_req->headers[0]->id == HTTP_HEADER_HOST);
+    assert(http_req->headers[1]->id == HTTP_HEADER_UNKNOWN);
+    assert(http_req->body_len == 5);
+    assert(strncmp((char *) http_req->body, "hello", 5) == 0);
+    // the first of repeated headers wins
+    assert(strcmp(http_request_header(http_req, HTTP_HEADER_HOST)->value, "localhost") == 0);
+    assert(strcmp(http_request_header(http_req, HTTP_HEADER_CONTENT_TYPE)->value, "text/plain") == 0);
+    assert(http_request_header(http_req, HTTP_HEADER_ACCEPT) == nullptr);
+    assert(http_request_header(http_req, HTTP_HEADER_UNKNOWN) == nullptr);
+    assert(strcmp(http_request_find_header(http_req, "x-trace")->value, "abc") == 0);
+    assert(strcmp(http_request_find_header(http_req, "Content-Length")->value, "5") == 0);
+    assert(http_request_find_header(http_req, "X-Missing") == nullptr);
+    destroy_http_request(http_req);
+
+    http_request_view view = {};
+    assert(parse_http_request_view(&settings, request, strlen((char *) request), &view) == PARSE_OK);
+    assert(http_slice_eq_cstr(view.body, "hello"));
+    assert(view.headers[2].id == HTTP_HEADER_CONTENT_LENGTH);
+    assert(http_slice_eq_cstr(http_request_view_header(&view, HTTP_HEADER_HOST)->value, "localhost"));
+    assert(http_slice_eq_cstr(http_request_view_find_header(&view, "X-TRACE")->value, "abc"));
+    assert(http_request_view_header(&view, HTTP_HEADER_CONNECTION) == nullptr);
+
+    // a reused view forgets the headers of the request parsed into it before
+    const uint8_t next[] = "GET / HTTP/1.1\r\nAccept: */*\r\n\r\n";
+    assert(parse_http_request_view(&settings, next, strlen((char *) next), &view) == PARSE_OK);
+    assert(http_request_view_header(&view, HTTP_HEADER_HOST) == nullptr);
+    assert(http_slice_eq_cstr(http_request_view_header(&view, HTTP_HEADER_ACCEPT)->value, "*/*"));
+}
+
+void test_request_parse_chunked_body(void) {
+    const uint8_t request[] = "POST /upload HTTP/1.1\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "\r\n"
+            "5\r\nhello\r\n"
+            "6\r\n world\r\n"
+            "0\r\n\r\n"
+            "GET /next HTTP/1.1\r\n\r\n";
+    const size_t request_len = strlen((char *) request);
+    http_request *http_req = parse_http_request(&settings, request, request_len);
+    assert(http_req != nullptr);
+    assert(http_req->body_len == 11);
+    assert(memcmp(http_req->body, "hello world", 11) == 0);
+    destroy_http_request(http_req);
+
+    // the view keeps the body encoded, but knows where the request ends
+    http_request_view view = {};
+    assert(parse_http_request_view(&settings, request, request_len, &view) == PARSE_OK);
+    assert(view.body_chunked);
+    assert(http_slice_eq_cstr(view.body, "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"));
+    assert(memcmp(request + view.request_len, "GET /next", 9) == 0);
+
+    const uint8_t truncated[] = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel";
+    assert(parse_http_request_view(&settings, truncated, strlen((char *) truncated), &view) == PARSE_E_INCOMPLETE);
+    assert(parse_http_request(&settings, truncated, strlen((char *) truncated)) == nullptr);
+}
+
+void test_request_invalid_content_lengths(void) {
+    const uint8_t conflicting[] = "POST / HTTP/1.1\r\n"
+            "Content-Length: 5\r\n"
+            "Host: localhost\r\n"
+            "Content-Length: 50\r\n"
+            "\r\n"
+            "hello";
+    const size_t conflicting_len = strlen((char *) conflicting);
+    http_request_view view = {};
+    assert(parse_http_request_view(&settings, conflicting, conflicting_len, &view) == PARSE_E_MALFORMED_HTTP_HEADER);
+    assert(parse_http_request(&settings, conflicting, conflicting_len) == nullptr);
+
+    // nothing but digits is a length, in either parser
+    const char *const invalid[] = {
+        "POST / HTTP/1.1\r\nContent-Length: -2\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: -5\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: 5abc\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: +5\r\n\r\nhello",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        const uint8_t *packet = (const uint8_t *) invalid[i];
+        assert(parse_http_request_view(&settings, packet, strlen(invalid[i]), &view) == PARSE_E_MALFORMED_HTTP_HEADER);
+        assert(parse_http_request(&settings, packet, strlen(invalid[i])) == nullptr);
+    }
+
+    // repeating the same value is harmless
+    const uint8_t repeated[] = "POST / HTTP/1.1\r\n"
+            "Content-Length: 5\r\n"
+            "content-length: 5\r\n"
+            "\r\n"
+            "hello";
+    const size_t repeated_len = strlen((char *) repeated);
+    assert(parse_http_request_view(&settings, repeated, repeated_len, &view) == PARSE_OK);
+    assert(http_slice_eq_cstr(view.body, "hello"));
+    http_request *http_req = parse_http_request(&settings, repeated, repeated_len);
+    assert(http_req != nullptr);
+    assert(http_req->body_len == 5);
+    destroy_http_request(http_req);
+}
+
+void test_request_parse_and_render_in_arena(void) {
+    const uint8_t request[] = "POST /one/%F0%9F%90%8C//three/ HTTP/1.0\r\n"
+            "Content-Type: application/json\r\n"
+            "Host: localhost:8085\r\n"
+            "Content-Length: 2\r\n"
+            "\r\n"
+            "{}";
+    http_arena *arena = http_arena_create(128); // deliberately too small: forces overflow, then growth
+    assert(arena != nullptr);
+    for (int cycle = 0; cycle < 3; cycle++) {
+        http_request *http_req = parse_http_request_in_arena(&settings, arena, request, strlen((char *) request));
+        assert(http_req != nullptr);
+        assert(http_req->arena == arena);
+        assert(http_req->method == POST);
+        assert(strncmp(http_req->path, "/one/🐌/three", 255) == 0);
+        assert(http_req->headers_cnt == 3);
+        assert(strncmp(http_req->headers[2]->name, "Content-Length", 255) == 0);
+        assert(strncmp(http_req->headers[2]->value, "2", 255) == 0);
+        assert(http_req->body_len == 2);
+        assert(strncmp((char *) http_req->body, "{}", 2) == 0);
+
+        const http_response response = {
+            .version = HTTP_1_0,
+            .status_code = 204,
+            .reason_phrase = (uint8_t *) "No Content",
+        };
+        uint8_t *response_octets = nullptr;
+        size_t response_octets_len = 0;
+        assert(render_http_response_in_arena(&settings, arena, &response, &response_octets, &response_octets_len)
+            == RENDER_OK);
+        assert(strncmp((char *) response_octets, "HTTP/1.0 204 No Content\r\n", 32) == 0);
+
+        destroy_http_request(http_req); // no-op, the arena owns it
+        http_arena_reset(arena);
+        if (cycle > 0) {
+            assert(arena->capacity > 128);
+            assert(arena->overflow == nullptr);
+        }
+    }
+    http_arena_destroy(arena);
+}
+
+void test_arena_over_caller_block(void) {
+    alignas(max_align_t) uint8_t block[64];
+    http_arena arena;
+    http_arena_init(&arena, block, sizeof(block));
+    uint8_t *first = http_arena_alloc(&arena, 8);
+    assert(first == block);
+    uint8_t *grown = http_arena_realloc(&arena, first, 8, 24);
+    assert(grown == first); // last allocation grows in place
+    uint8_t *second = http_arena_alloc(&arena, 8);
+    assert(second >= block + 24 && second < block + sizeof(block));
+    uint8_t *spilled = http_arena_alloc(&arena, 256);
+    assert(spilled != nullptr && (spilled < block || spilled >= block + sizeof(block)));
+    http_arena_reset(&arena);
+    assert(arena.used == 0 && arena.capacity == sizeof(block) && arena.block == block);
+    assert(http_arena_alloc(&arena, 8) == block);
+    http_arena_destroy(&arena);
+}
+
+void test_response_render_binary_body_exact_size(void) {
+    const uint8_t body[] = {'a', '\0', 'b', '\0', '\r', '\n'};
+    http_header headers[] = {
+        {.name = "Content-Type", .value = "application/octet-stream"},
+        {.name = "Content-Length", .value = "6"},
+    };
+    const http_response response = {
+        .version = HTTP_1_0,
+        .status_code = 200,
+        .reason_phrase = (uint8_t *) "OK",
+        .headers = headers,
+        .headers_cnt = 2,
+        .body = (uint8_t *) body,
+        .body_len = sizeof(body),
+    };
+    uint8_t *response_octets = nullptr;
+    size_t response_octets_len = 0;
+    assert(render_http_response(&settings, &response, &response_octets, &response_octets_len) == RENDER_OK);
+    const char *expected_head = "HTTP/1.0 200 OK\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Length: 6\r\n"
+            "\r\n";
+    const size_t expected_head_len = strlen(expected_head);
+    assert(response_octets_len == expected_head_len + sizeof(body));
+    assert(memcmp(response_octets, expected_head, expected_head_len) == 0);
+    // nul octets in the body are copied too
+    assert(memcmp(response_octets + expected_head_len, body, sizeof(body)) == 0);
+    free(response_octets);
+}
+
+void test_response_render_iov_references_body(void) {
+    uint8_t body[] = "{\"key1\": \"value1\"}";
+    http_header headers[] = {
+        {.name = "Content-Type", .value = "application/json"},
+        {.name = "Content-Length", .value = "18"},
+    };
+    const http_response response = {
+        .version = HTTP_1_0,
+        .status_code = 201,
+        .reason_phrase = (uint8_t *) "Created",
+        .headers = headers,
+        .headers_cnt = 2,
+        .body = body,
+        .body_len = 18,
+    };
+    struct iovec iov[2];
+    size_t iov_cnt = 0;
+    assert(render_http_response_iov(&settings, nullptr, &response, iov, &iov_cnt) == RENDER_OK);
+    assert(iov_cnt == 2);
+    assert(iov[1].iov_base == body);
+    assert(iov[1].iov_len == 18);
+
+    uint8_t *response_octets = nullptr;
+    size_t response_octets_len = 0;
+    assert(render_http_response(&settings, &response, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(iov[0].iov_len + iov[1].iov_len == response_octets_len);
+    assert(memcmp(iov[0].iov_base, response_octets, iov[0].iov_len) == 0);
+    free(response_octets);
+    free(iov[0].iov_base);
+
+    const http_response no_body = {.version = HTTP_1_0, .status_code = 204, .reason_phrase = (uint8_t *) "No Content"};
+    assert(render_http_response_iov(&settings, nullptr, &no_body, iov, &iov_cnt) == RENDER_OK);
+    assert(iov_cnt == 1);
+    assert(iov[0].iov_len == strlen("HTTP/1.0 204 No Content\r\n"));
+    free(iov[0].iov_base);
+
+    const http_response bad_status = {.version = HTTP_1_0, .status_code = 2000};
+    assert(render_http_response_iov(&settings, nullptr, &bad_status, iov, &iov_cnt) == RENDER_E_STATUS_CODE_INVALID);
+    assert(iov_cnt == 0);
+}
+
+void test_response_render_prebuilt_status_and_fragments(void) {
+    static const http_header_fragment fragments[] = {
+        HTTP_HEADER_FRAGMENT("Server", "TinyLittleHTTP"),
+        HTTP_HEADER_FRAGMENT("Content-Type", "application/json"),
+    };
+    http_header headers[] = {{.name = "X-Request", .value = "1"}};
+    const http_response response = {
+        .version = HTTP_1_1,
+        .status_code = 201,
+        .headers = headers,
+        .headers_cnt = 1,
+        .header_fragments = fragments,
+        .header_fragments_cnt = 2,
+        .body = (uint8_t *) "{}",
+        .body_len = 2,
+    };
+    uint8_t *response_octets = nullptr;
+    size_t response_octets_len = 0;
+    assert(render_http_response(&settings, &response, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(strcmp((char *) response_octets, "HTTP/1.1 201 Created\r\n"
+                  "X-Request: 1\r\n"
+                  "Server: TinyLittleHTTP\r\n"
+                  "Content-Type: application/json\r\n"
+                  "\r\n"
+                  "{}") == 0);
+    assert(response_octets_len == strlen((char *) response_octets));
+    free(response_octets);
+
+    // fragments alone still end the head with a blank line
+    const http_response fragments_only = {
+        .version = HTTP_1_0, .status_code = 204, .header_fragments = fragments, .header_fragments_cnt = 1
+    };
+    assert(render_http_response(&settings, &fragments_only, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(strcmp((char *) response_octets, "HTTP/1.0 204 No Content\r\nServer: TinyLittleHTTP\r\n\r\n") == 0);
+    free(response_octets);
+
+    // an explicit reason phrase wins, a code without a standard one is left without
+    const http_response custom = {.version = HTTP_1_0, .status_code = 200, .reason_phrase = (uint8_t *) "Fine"};
+    assert(render_http_response(&settings, &custom, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(strcmp((char *) response_octets, "HTTP/1.0 200 Fine\r\n") == 0);
+    free(response_octets);
+    const http_response unknown = {.version = HTTP_1_1, .status_code = 299};
+    assert(render_http_response(&settings, &unknown, &response_octets, &response_octets_len) == RENDER_OK);
+    assert(strcmp((char *) response_octets, "HTTP/1.1 299 \r\n") == 0);
+    free(response_octets);
+}
+
 int main() {
     test_request_parse_get_root_curl();
     test_request_post_root_curl();
@@ -239,9 +834,29 @@ int main() {
     test_request_parse_head();
     test_request_parse_get_urlencoded_path();
 
+    test_request_view_parse_get_root_curl();
+    test_request_view_post_root_curl();
+    test_request_view_post_root_curl_with_wide_chars();
+    test_request_view_parse_head();
+    test_request_view_parse_get_urlencoded_path();
+    test_request_view_incomplete_and_malformed();
+    test_request_view_pipelined_http_1_1();
+    test_request_methods();
+    test_path_normalize();
+    test_request_query();
+    test_request_known_headers_ignore_case();
+    test_request_parse_chunked_body();
+    test_request_invalid_content_lengths();
+    test_request_parse_and_render_in_arena();
+    test_arena_over_caller_block();
+
     test_response_render_200_no_body();
+    test_response_render_http_1_1();
     test_response_render_404_no_body();
     test_response_render_200_with_body();
+    test_response_render_binary_body_exact_size();
+    test_response_render_iov_references_body();
+    test_response_render_prebuilt_status_and_fragments();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,206 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_server.h"
+#include "../src/tiny_http/tiny_http_static.h"
+#include "tiny_http_test_helpers.h"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024 * 8, // 8M
+    .max_url_length = 8000
+};
+
+static char root[64];
+
+static void write_file(const char *relative_path, const char *content, const size_t content_len) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, relative_path);
+    FILE *file = fopen(path, "wb");
+    assert(file != nullptr);
+    assert(fwrite(content, 1, content_len, file) == content_len);
+    fclose(file);
+}
+
+static bool starts_with(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+void test_static_files_over_loopback(void) {
+    strcpy(root, "/tmp/tiny_http_static_XXXXXX");
+    assert(mkdtemp(root) != nullptr);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/assets", root);
+    assert(mkdir(path, 0755) == 0);
+    write_file("index.html", "<h1>home</h1>", 13);
+    write_file("assets/app.js", "console.log(1);", 15);
+    write_file("empty.txt", "", 0);
+    const size_t big_len = 3 * 1024 * 1024 + 7;
+    char *big = malloc(big_len);
+    for (size_t i = 0; i < big_len; i++) big[i] = (char) ('a' + i % 26);
+    write_file("assets/big.bin", big, big_len);
+    snprintf(path, sizeof(path), "%s/escape", root);
+    assert(symlink("/etc", path) == 0);
+
+    // a single cached descriptor: every other request evicts the previous file
+    http_static_files *files = http_static_files_create(root, 1);
+    assert(files != nullptr);
+
+    // a request without an arena has nowhere to hold the headers
+    const http_request no_arena = {.method = GET, .version = HTTP_1_1, .path = "/index.html"};
+    http_response direct = {.version = HTTP_1_1};
+    http_static_files_handler(&no_arena, &direct, files);
+    assert(direct.status_code == 500 && direct.body_file.release == nullptr);
+    http_server *server = http_server_create(&settings, "127.0.0.1", 0, http_static_files_handler, files);
+    assert(server != nullptr);
+    const uint16_t port = http_server_port(server);
+    pthread_t thread;
+    assert(pthread_create(&thread, nullptr, run_server, server) == 0);
+
+    const size_t cap = 4 * 1024 * 1024;
+    char *response = malloc(cap);
+
+    // two requests for the same file on one connection: the second one is served from the cache
+    round_trip(port,
+               "GET /assets/app.js HTTP/1.1\r\n\r\n"
+               "GET /assets/app.js HTTP/1.1\r\nConnection: close\r\n\r\n",
+               0, response, cap);
+    assert(starts_with(response, "HTTP/1.1 200 OK\r\nContent-Type: text/javascript; charset=utf-8\r\n"));
+    assert(strstr(response, "\r\nLast-Modified: ") != nullptr);
+    assert(strstr(response, " GMT\r\nETag: \"f-") != nullptr);
+    assert(strstr(response, "\r\nContent-Length: 15\r\n") != nullptr);
+    assert(strstr(response, "\r\nAccept-Ranges: bytes\r\n") != nullptr);
+    const char *first_body = strstr(response, "\r\n\r\nconsole.log(1);HTTP/1.1 200 OK\r\n");
+    assert(first_body != nullptr);
+    assert(strcmp(response + strlen(response) - 19, "\r\n\r\nconsole.log(1);") == 0);
+
+    round_trip(port, "GET / HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strstr(response, "Content-Type: text/html; charset=utf-8\r\n") != nullptr);
+    assert(strstr(response, "\r\n\r\n<h1>home</h1>") != nullptr);
+
+    const size_t big_response_len = round_trip(port, "GET /assets/big.bin HTTP/1.0\r\n\r\n", 0, response, cap);
+    const char *big_body = strstr(response, "\r\n\r\n") + 4;
+    assert(big_response_len - (size_t) (big_body - response) == big_len);
+    assert(memcmp(big_body, big, big_len) == 0);
+
+    // HEAD has the length of the file, but not the file
+    const size_t head_len = round_trip(port, "HEAD /assets/big.bin HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strstr(response, "Content-Length: 3145735\r\n") != nullptr);
+    assert(strcmp(response + head_len - 4, "\r\n\r\n") == 0);
+
+    // a download picking up where it broke off
+    size_t response_len = round_trip(port, "GET /assets/big.bin HTTP/1.0\r\nRange: bytes=3145700-\r\n\r\n", 0, response, cap);
+    assert(starts_with(response, "HTTP/1.0 206 Partial Content\r\n"));
+    assert(strstr(response, "\r\nContent-Range: bytes 3145700-3145734/3145735\r\n") != nullptr);
+    assert(strstr(response, "\r\nContent-Length: 35\r\n") != nullptr);
+    const char *range_body = strstr(response, "\r\n\r\n") + 4;
+    assert(response_len - (size_t) (range_body - response) == 35 && memcmp(range_body, big + 3145700, 35) == 0);
+    // the validator still matches: the range; it does not: the whole file
+    round_trip(port, "GET /assets/big.bin HTTP/1.0\r\nRange: bytes=26-51\r\n\r\n", 0, response, cap);
+    const char *etag = strstr(response, "\r\nETag: ") + 8;
+    char request[256];
+    snprintf(request, sizeof(request), "GET /assets/big.bin HTTP/1.0\r\nRange: bytes=26-51\r\nIf-Range: %.*s\r\n\r\n",
+             (int) strcspn(etag, "\r"), etag);
+    round_trip(port, request, 0, response, cap);
+    assert(starts_with(response, "HTTP/1.0 206 Partial Content\r\n"));
+    assert(strcmp(strstr(response, "\r\n\r\n") + 4, "abcdefghijklmnopqrstuvwxyz") == 0);
+    response_len = round_trip(port, "GET /assets/big.bin HTTP/1.0\r\nRange: bytes=26-51\r\nIf-Range: \"old\"\r\n\r\n", 0, response, cap);
+    assert(starts_with(response, "HTTP/1.0 200 OK\r\n"));
+    assert(response_len - (size_t) (strstr(response, "\r\n\r\n") + 4 - response) == big_len);
+
+    // several ranges in one multipart/byteranges body, and the connection goes on after it
+    round_trip(port,
+               "GET /assets/big.bin HTTP/1.1\r\nRange: bytes=0-2, 1048576-1048578, -3\r\n\r\n"
+               "GET /assets/app.js HTTP/1.1\r\nConnection: close\r\n\r\n",
+               0, response, cap);
+    assert(starts_with(response, "HTTP/1.1 206 Partial Content\r\n"));
+    const char *boundary = strstr(response, "\r\nContent-Type: multipart/byteranges; boundary=") + 47;
+    const size_t boundary_len = strcspn(boundary, "\r");
+    size_t content_length = 0;
+    assert(sscanf(strstr(response, "\r\nContent-Length: "), "\r\nContent-Length: %zu", &content_length) == 1);
+    const char *part = strstr(response, "\r\n\r\n") + 4;
+    const char *body_end = part + content_length;
+    const char *next_response = "HTTP/1.1 200 OK\r\n";
+    assert(strncmp(body_end, next_response, strlen(next_response)) == 0);
+    assert(strcmp(response + strlen(response) - 19, "\r\n\r\nconsole.log(1);") == 0);
+    const uint64_t part_offsets[] = {0, 1048576, 3145732};
+    for (size_t i = 0; i < 3; i++) {
+        if (i > 0) {
+            assert(strncmp(part, "\r\n", 2) == 0);
+            part += 2;
+        }
+        assert(strncmp(part, "--", 2) == 0 && strncmp(part + 2, boundary, boundary_len) == 0);
+        part = strstr(part, "\r\nContent-Range: bytes ");
+        char content_range[64];
+        snprintf(content_range, sizeof(content_range), "\r\nContent-Range: bytes %lu-%lu/3145735\r\n\r\n",
+                 (unsigned long) part_offsets[i], (unsigned long) part_offsets[i] + 2);
+        assert(starts_with(part, content_range));
+        part += strlen(content_range);
+        assert(memcmp(part, big + part_offsets[i], 3) == 0);
+        part += 3;
+    }
+    assert(strncmp(part, "\r\n--", 4) == 0 && strncmp(part + 4, boundary, boundary_len) == 0);
+    assert(part + 4 + boundary_len + 4 == body_end && strncmp(body_end - 4, "--\r\n", 4) == 0);
+
+    round_trip(port, "GET /assets/big.bin HTTP/1.0\r\nRange: bytes=3145735-\r\n\r\n", 0, response, cap);
+    assert(starts_with(response, "HTTP/1.0 416 Range Not Satisfiable\r\n"));
+    assert(strstr(response, "\r\nContent-Range: bytes */3145735\r\n") != nullptr);
+    assert(strstr(response, "\r\nContent-Length: 0\r\n") != nullptr);
+
+    round_trip(port, "GET /empty.txt HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strstr(response, "Content-Length: 0\r\n") != nullptr);
+
+    round_trip(port, "GET /missing.txt HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strncmp(response, "HTTP/1.0 404 ", 13) == 0);
+    // dot segments are resolved by the parser and never climb above the root
+    round_trip(port, "GET /assets/%2e%2e/%2e%2e/etc/passwd HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strncmp(response, "HTTP/1.0 404 ", 13) == 0);
+    round_trip(port, "GET /escape/passwd HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strncmp(response, "HTTP/1.0 403 ", 13) == 0);
+    round_trip(port, "POST /index.html HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(starts_with(response, "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET, HEAD\r\n"));
+
+    // a file changed on disk is noticed once the cached metadata is due for revalidation
+    round_trip(port, "GET /assets/app.js HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strstr(response, "\r\n\r\nconsole.log(1);") != nullptr);
+    write_file("assets/app.js", "console.log(22);", 16);
+    sleep(2);
+    round_trip(port, "GET /assets/app.js HTTP/1.0\r\n\r\n", 0, response, cap);
+    assert(strstr(response, "\r\n\r\nconsole.log(22);") != nullptr);
+
+    http_server_stop(server);
+    assert(pthread_join(thread, nullptr) == 0);
+    http_server_destroy(server);
+    http_static_files_destroy(files);
+
+    free(response);
+    free(big);
+    const char *cleanup[] = {"assets/app.js", "assets/big.bin", "index.html", "empty.txt", "escape", "assets"};
+    for (size_t i = 0; i < sizeof(cleanup) / sizeof(cleanup[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", root, cleanup[i]);
+        assert(remove(path) == 0);
+    }
+    assert(rmdir(root) == 0);
+}
+
+int main() {
+    test_static_files_over_loopback();
+    // file bodies go out with sendfile on io_uring too, polling for the socket to take more
+    settings.io_engine = HTTP_IO_ENGINE_IO_URING;
+    test_static_files_over_loopback();
+
+    return EXIT_SUCCESS;
+}
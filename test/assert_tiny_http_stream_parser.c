@@ -0,0 +1,245 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_stream_parser.h"
+
+http_server_settings settings = {
+    .max_header_name_length = 256,
+    .max_header_value_length = 512,
+    .max_body_length = 1024 * 1024 * 8, // 8M
+    .max_url_length = 8000
+};
+
+static const uint8_t post_request[] = "POST /one/two/three HTTP/1.0\r\n"
+        "Content-Type: application/json\r\n"
+        "Host: localhost:8085\r\n"
+        "Content-Length: 68\r\n"
+        "\r\n"
+        "{\n    \"key1\": \"value1\",\n    \"key2\": \"value2\",\n    \"key3\": \"value3\"\n}";
+
+/**
+ * Feeds `request` in pieces of `piece_len` octets and re-assembles the streamed body into `body`.
+ *
+ * @return the number of octets of `request` consumed once the message completed
+ */
+static size_t feed_in_pieces(
+    http_stream_parser *parser,
+    const uint8_t *request,
+    const size_t request_len,
+    const size_t piece_len,
+    uint8_t *body,
+    size_t *body_len) {
+    size_t offset = 0;
+    bool headers_complete = false;
+    *body_len = 0;
+    while (true) {
+        const size_t available = offset + piece_len < request_len ? piece_len : request_len - offset;
+        size_t consumed = 0;
+        http_slice chunk = {};
+        const enum http_stream_parse_result result =
+                http_stream_parser_feed(parser, request + offset, available, &consumed, &chunk);
+        offset += consumed;
+        switch (result) {
+            case HTTP_STREAM_NEED_MORE:
+                assert(consumed == available);
+                assert(offset < request_len);
+                break;
+            case HTTP_STREAM_HEADERS_COMPLETE:
+                assert(!headers_complete);
+                headers_complete = true;
+                break;
+            case HTTP_STREAM_BODY_CHUNK:
+                assert(headers_complete);
+                assert(chunk.ptr >= request && chunk.ptr + chunk.len <= request + request_len); // not copied
+                memcpy(body + *body_len, chunk.ptr, chunk.len);
+                *body_len += chunk.len;
+                break;
+            case HTTP_STREAM_MESSAGE_COMPLETE:
+                assert(headers_complete);
+                return offset;
+            case HTTP_STREAM_MALFORMED:
+            default:
+                assert(false);
+        }
+    }
+}
+
+void test_stream_parse_post_in_every_piece_size(void) {
+    const size_t request_len = strlen((char *) post_request);
+    for (size_t piece_len = 1; piece_len <= request_len; piece_len++) {
+        http_stream_parser parser;
+        assert(http_stream_parser_init(&parser, &settings, 1024) == 0);
+        uint8_t body[128];
+        size_t body_len = 0;
+        const size_t consumed = feed_in_pieces(&parser, post_request, request_len, piece_len, body, &body_len);
+        assert(consumed == request_len);
+        assert(parser.request.method == POST);
+        assert(http_slice_eq_cstr(parser.request.path, "/one/two/three"));
+        assert(parser.request.headers_cnt == 3);
+        assert(http_slice_eq_cstr(parser.request.headers[1].name, "Host"));
+        assert(http_slice_eq_cstr(parser.request.headers[1].value, "localhost:8085"));
+        assert(body_len == 68);
+        assert(memcmp(body, post_request + request_len - 68, 68) == 0);
+        http_stream_parser_destroy(&parser);
+    }
+}
+
+void test_stream_parse_chunked_post_in_every_piece_size(void) {
+    const uint8_t request[] = "POST /upload HTTP/1.1\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "\r\n"
+            "5;name=value\r\nhello\r\n"
+            "1\r\n \r\n"
+            "B\r\nchunked wor\r\n"
+            "2\r\nld\r\n"
+            "0\r\n"
+            "Expires: never\r\n"
+            "\r\n"
+            "GET /next HTTP/1.1\r\n\r\n";
+    const size_t request_len = strlen((char *) request);
+    const size_t first_len = request_len - strlen("GET /next HTTP/1.1\r\n\r\n");
+    for (size_t piece_len = 1; piece_len <= request_len; piece_len++) {
+        http_stream_parser parser;
+        assert(http_stream_parser_init(&parser, &settings, 1024) == 0);
+        uint8_t body[128];
+        size_t body_len = 0;
+        const size_t consumed = feed_in_pieces(&parser, request, request_len, piece_len, body, &body_len);
+        assert(consumed == first_len);
+        assert(parser.request.body_chunked);
+        assert(parser.body_len == 19);
+        assert(body_len == 19);
+        assert(memcmp(body, "hello chunked world", 19) == 0);
+        http_stream_parser_destroy(&parser);
+    }
+}
+
+void test_stream_parse_back_to_back_requests(void) {
+    const uint8_t requests[] = "GET /first HTTP/1.0\r\n"
+            "Host: localhost:8085\r\n"
+            "\r\n"
+            "GET /second HTTP/1.0\r\n"
+            "Host: localhost:8085\r\n"
+            "\r\n";
+    const size_t requests_len = strlen((char *) requests);
+    http_stream_parser parser;
+    assert(http_stream_parser_init(&parser, &settings, 1024) == 0);
+    uint8_t body[16];
+    size_t body_len = 0;
+    const size_t first_len = feed_in_pieces(&parser, requests, requests_len, 7, body, &body_len);
+    assert(http_slice_eq_cstr(parser.request.path, "/first"));
+    assert(body_len == 0);
+
+    http_stream_parser_reset(&parser);
+    const size_t second_len = feed_in_pieces(
+        &parser, requests + first_len, requests_len - first_len, 1000, body, &body_len);
+    assert(http_slice_eq_cstr(parser.request.path, "/second"));
+    assert(first_len + second_len == requests_len);
+    http_stream_parser_destroy(&parser);
+}
+
+void test_stream_parse_rejects_malformed_and_oversized(void) {
+    http_stream_parser parser;
+    assert(http_stream_parser_init(&parser, &settings, 32) == 0);
+    const uint8_t too_large[] = "GET / HTTP/1.0\r\n"
+            "Host: a-very-long-host-name-that-does-not-fit:8085\r\n"
+            "\r\n";
+    size_t consumed = 0;
+    http_slice chunk = {};
+    assert(http_stream_parser_feed(&parser, too_large, strlen((char *) too_large), &consumed, &chunk)
+        == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_HEADERS_TOO_LARGE);
+
+    http_stream_parser_reset(&parser);
+    const uint8_t bad_method[] = "BREW / HTTP/1.0\r\n\r\n";
+    assert(http_stream_parser_feed(&parser, bad_method, strlen((char *) bad_method), &consumed, &chunk)
+        == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_HTTP_METHOD_NOT_SUPPORTED);
+    // stays failed until reset
+    assert(http_stream_parser_feed(&parser, bad_method, 1, &consumed, &chunk) == HTTP_STREAM_MALFORMED);
+    http_stream_parser_destroy(&parser);
+
+    assert(http_stream_parser_init(&parser, &settings, 1024) == 0);
+    const uint8_t both_lengths[] = "POST / HTTP/1.1\r\n"
+            "Content-Length: 5\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "\r\n";
+    assert(http_stream_parser_feed(&parser, both_lengths, strlen((char *) both_lengths), &consumed, &chunk)
+        == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_MALFORMED_HTTP_HEADER);
+
+    http_stream_parser_reset(&parser);
+    const uint8_t gzipped[] = "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n";
+    assert(http_stream_parser_feed(&parser, gzipped, strlen((char *) gzipped), &consumed, &chunk)
+        == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_TRANSFER_ENCODING_NOT_SUPPORTED);
+
+    http_stream_parser_reset(&parser);
+    const uint8_t bad_chunk[] = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+    assert(http_stream_parser_feed(&parser, bad_chunk, strlen((char *) bad_chunk), &consumed, &chunk)
+        == HTTP_STREAM_HEADERS_COMPLETE);
+    const size_t head_len = consumed;
+    assert(http_stream_parser_feed(&parser, bad_chunk + head_len, strlen((char *) bad_chunk) - head_len, &consumed, &chunk)
+        == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_MALFORMED_CHUNKED_BODY);
+    http_stream_parser_destroy(&parser);
+}
+
+void test_stream_parse_with_pooled_head(void) {
+    http_buffer_pool pool;
+    http_buffer_pool_init(&pool, 1024 * 1024);
+    // a head larger than the smallest pooled buffer, so that it has to move up a size on the way
+    uint8_t request[8 * 1024];
+    size_t request_len = (size_t) snprintf((char *) request, sizeof(request), "GET /");
+    memset(request + request_len, 'p', 6000);
+    request_len += 6000;
+    request_len += (size_t) snprintf((char *) request + request_len, sizeof(request) - request_len,
+                                     " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    http_stream_parser parser;
+    http_stream_parser_init_pooled(&parser, &settings, 16 * 1024, &pool);
+    assert(parser.head == nullptr);
+    for (size_t piece_len = 1000; piece_len <= request_len; piece_len += 1000) {
+        uint8_t body[16];
+        size_t body_len = 0;
+        assert(feed_in_pieces(&parser, request, request_len, piece_len, body, &body_len) == request_len);
+        assert(parser.request.path.len == 6001);
+        assert(http_slice_eq_cstr(parser.request.headers[0].value, "localhost"));
+        // the head still holds the request, it can only go back once the parser is reset
+        http_stream_parser_release_head(&parser);
+        assert(parser.head != nullptr);
+        http_stream_parser_reset(&parser);
+        http_stream_parser_release_head(&parser);
+        assert(parser.head == nullptr);
+    }
+    http_buffer_pool_stats stats;
+    http_buffer_pool_stats_load(&pool, &stats);
+    assert(stats.tiers[0].in_use == 0 && stats.tiers[1].in_use == 0);
+    // every request after the first one found its buffers in the pool
+    assert(stats.tiers[1].reused == stats.tiers[1].acquired - 1);
+
+    // still bounded by head_capacity, whatever size the pool handed out
+    http_stream_parser_reset(&parser);
+    parser.head_capacity = 5000;
+    size_t consumed = 0;
+    http_slice chunk = {};
+    assert(http_stream_parser_feed(&parser, request, request_len, &consumed, &chunk) == HTTP_STREAM_MALFORMED);
+    assert(parser.error == PARSE_E_HEADERS_TOO_LARGE);
+    http_stream_parser_destroy(&parser);
+    http_buffer_pool_destroy(&pool);
+}
+
+int main() {
+    test_stream_parse_post_in_every_piece_size();
+    test_stream_parse_chunked_post_in_every_piece_size();
+    test_stream_parse_back_to_back_requests();
+    test_stream_parse_rejects_malformed_and_oversized();
+    test_stream_parse_with_pooled_head();
+
+    return EXIT_SUCCESS;
+}
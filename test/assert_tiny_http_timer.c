@@ -0,0 +1,147 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/tiny_http/tiny_http_timer.h"
+
+#define RANDOM_TIMERS 4096
+
+typedef struct test_timer {
+    http_timer timer;
+    size_t fired;
+    /// the wheel's time when it fired
+    uint64_t fired_at;
+} test_timer;
+
+typedef struct test_clock {
+    http_timer_wheel *wheel;
+    /// if set, whichever of the two fires first disarms the other
+    http_timer *rivals[2];
+} test_clock;
+
+static void on_expired(http_timer *timer, void *user_data) {
+    test_clock *clock = user_data;
+    test_timer *fired = (test_timer *) timer;
+    fired->fired++;
+    fired->fired_at = clock->wheel->now;
+    assert(!http_timer_armed(timer));
+    if (clock->rivals[0] != nullptr) {
+        http_timer_disarm(clock->wheel, clock->rivals[clock->rivals[0] == timer ? 1 : 0]);
+    }
+}
+
+void test_timers_fire_at_their_deadline(void) {
+    http_timer_wheel wheel;
+    http_timer_wheel_init(&wheel, 1000);
+    test_clock clock = {.wheel = &wheel};
+    // one per level, or so
+    const uint64_t deadlines[] = {1001, 1063, 1064, 1100, 5000, 300000, 1000 + 40000000, 1000 + (1ULL << 40)};
+    const size_t cnt = sizeof(deadlines) / sizeof(deadlines[0]);
+    test_timer timers[sizeof(deadlines) / sizeof(deadlines[0])] = {};
+    for (size_t i = 0; i < cnt; i++) http_timer_arm(&wheel, &timers[i].timer, deadlines[i]);
+    assert(wheel.armed == cnt);
+    assert(http_timer_wheel_next(&wheel, UINT64_MAX) == 1);
+
+    for (size_t i = 0; i < cnt; i++) {
+        // just before: nothing, then exactly at the deadline
+        assert(http_timer_wheel_advance(&wheel, deadlines[i] - 1, on_expired, &clock) == 0);
+        assert(timers[i].fired == 0);
+        assert(http_timer_wheel_advance(&wheel, deadlines[i], on_expired, &clock) == 1);
+        assert(timers[i].fired == 1 && timers[i].fired_at == deadlines[i]);
+    }
+    assert(wheel.armed == 0);
+    assert(http_timer_wheel_next(&wheel, 500) == 500);
+}
+
+void test_timers_disarm_and_rearm(void) {
+    http_timer_wheel wheel;
+    http_timer_wheel_init(&wheel, 0);
+    test_clock clock = {.wheel = &wheel};
+    test_timer a = {}, b = {}, c = {};
+    http_timer_arm(&wheel, &a.timer, 100);
+    http_timer_arm(&wheel, &b.timer, 100);
+    http_timer_arm(&wheel, &c.timer, 5000);
+    http_timer_disarm(&wheel, &a.timer);
+    http_timer_disarm(&wheel, &a.timer);
+    assert(!http_timer_armed(&a.timer) && wheel.armed == 2);
+    // re-arming moves it, earlier or later
+    http_timer_arm(&wheel, &c.timer, 50);
+    http_timer_arm(&wheel, &b.timer, 7000);
+    assert(wheel.armed == 2);
+    assert(http_timer_wheel_next(&wheel, UINT64_MAX) <= 50);
+
+    assert(http_timer_wheel_advance(&wheel, 6999, on_expired, &clock) == 1);
+    assert(a.fired == 0 && b.fired == 0 && c.fired == 1 && c.fired_at == 6999);
+    assert(http_timer_wheel_advance(&wheel, 10000, on_expired, &clock) == 1);
+    assert(b.fired == 1);
+
+    // a deadline that has passed already expires at the next advance
+    http_timer_arm(&wheel, &a.timer, 3);
+    assert(http_timer_wheel_next(&wheel, UINT64_MAX) == 1);
+    assert(http_timer_wheel_advance(&wheel, 10000, on_expired, &clock) == 0);
+    assert(http_timer_wheel_advance(&wheel, 10001, on_expired, &clock) == 1 && a.fired == 1);
+}
+
+void test_timer_disarmed_by_an_earlier_callback(void) {
+    http_timer_wheel wheel;
+    http_timer_wheel_init(&wheel, 0);
+    test_timer a = {}, b = {};
+    http_timer_arm(&wheel, &a.timer, 10);
+    http_timer_arm(&wheel, &b.timer, 10);
+    // both are taken out of the wheel at once, but the second is disarmed before its turn
+    test_clock clock = {.wheel = &wheel, .rivals = {&a.timer, &b.timer}};
+    assert(http_timer_wheel_advance(&wheel, 10, on_expired, &clock) == 1);
+    assert(a.fired + b.fired == 1 && wheel.armed == 0);
+    assert(http_timer_wheel_next(&wheel, 1000) == 1000);
+}
+
+void test_random_timers_fire_once_and_on_time(void) {
+    srand(23);
+    http_timer_wheel wheel;
+    const uint64_t start = 123456789;
+    http_timer_wheel_init(&wheel, start);
+    test_clock clock = {.wheel = &wheel};
+    test_timer *timers = calloc(RANDOM_TIMERS, sizeof(test_timer));
+    assert(timers != nullptr);
+    for (size_t i = 0; i < RANDOM_TIMERS; i++) {
+        const uint64_t spread = i % 3 == 0 ? 100 : i % 3 == 1 ? 10000 : 2000000;
+        http_timer_arm(&wheel, &timers[i].timer, start + 1 + (uint64_t) rand() % spread);
+    }
+    uint64_t now = start;
+    while (wheel.armed > 0) {
+        const uint64_t next = http_timer_wheel_next(&wheel, UINT64_MAX);
+        assert(next > 0);
+        // sometimes exactly to the next slot, sometimes past it
+        now += rand() % 2 == 0 ? next : 1 + (uint64_t) rand() % 5000;
+        http_timer_wheel_advance(&wheel, now, on_expired, &clock);
+        for (size_t i = 0; i < RANDOM_TIMERS; i++) {
+            if (timers[i].fired == 0) assert(timers[i].timer.deadline > now);
+        }
+    }
+    for (size_t i = 0; i < RANDOM_TIMERS; i++) {
+        assert(timers[i].fired == 1);
+        assert(timers[i].fired_at >= timers[i].timer.deadline);
+    }
+    free(timers);
+}
+
+void test_clock_is_monotonic(void) {
+    const uint64_t first = http_timer_clock_ms();
+    const uint64_t second = http_timer_clock_ms();
+    assert(first > 0 && second >= first);
+}
+
+int main() {
+    test_timers_fire_at_their_deadline();
+    test_timers_disarm_and_rearm();
+    test_timer_disarmed_by_an_earlier_callback();
+    test_random_timers_fire_once_and_on_time();
+    test_clock_is_monotonic();
+
+    return EXIT_SUCCESS;
+}
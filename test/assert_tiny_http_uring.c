@@ -0,0 +1,177 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_uring.h"
+
+/**
+ * Submits what is queued and reaps until `want` completions have arrived.
+ */
+static void wait_for(http_uring *ring, struct io_uring_cqe *out, const size_t want) {
+    size_t reaped = 0;
+    while (reaped < want) {
+        assert(http_uring_submit_and_wait(ring, -1) == 0);
+        reaped += http_uring_reap(ring, out + reaped, want - reaped);
+    }
+}
+
+void test_uring_sends_and_receives(void) {
+    http_uring ring;
+    assert(http_uring_init(&ring, 8, 16) == 0);
+    assert(http_uring_setup_buffers(&ring, 3, 4, 64) == 0);
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    http_uring_prep_recv_multishot(http_uring_get_sqe(&ring), &ring, fds[0], 1);
+    struct iovec iov[2] = {
+        {.iov_base = "hello ", .iov_len = 6},
+        {.iov_base = "world", .iov_len = 5},
+    };
+    const struct msghdr message = {.msg_iov = iov, .msg_iovlen = 2};
+    http_uring_prep_sendmsg(http_uring_get_sqe(&ring), fds[1], &message, MSG_NOSIGNAL, 2);
+
+    char received[64];
+    size_t received_len = 0;
+    bool sent = false;
+    while (!sent || received_len < 11) {
+        struct io_uring_cqe cqe;
+        wait_for(&ring, &cqe, 1);
+        if (cqe.user_data == 2) {
+            assert(cqe.res == 11);
+            sent = true;
+            continue;
+        }
+        assert(cqe.user_data == 1 && cqe.res > 0);
+        // the recv stays armed, every completion in a buffer of its own
+        assert((cqe.flags & IORING_CQE_F_MORE) && (cqe.flags & IORING_CQE_F_BUFFER));
+        memcpy(received + received_len, http_uring_buffer(&ring, &cqe), (size_t) cqe.res);
+        received_len += (size_t) cqe.res;
+        http_uring_recycle_buffer(&ring, &cqe);
+    }
+    assert(received_len == 11 && memcmp(received, "hello world", 11) == 0);
+
+    // the peer closing ends the recv
+    close(fds[1]);
+    struct io_uring_cqe cqe;
+    wait_for(&ring, &cqe, 1);
+    assert(cqe.user_data == 1 && cqe.res == 0 && (cqe.flags & IORING_CQE_F_MORE) == 0);
+
+    close(fds[0]);
+    http_uring_destroy(&ring);
+}
+
+void test_uring_runs_out_of_buffers(void) {
+    http_uring ring;
+    assert(http_uring_init(&ring, 8, 16) == 0);
+    assert(http_uring_setup_buffers(&ring, 0, 2, 8) == 0);
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    assert(write(fds[1], "0123456789abcdefghijklmnopqrstuv", 32) == 32);
+
+    http_uring_prep_recv_multishot(http_uring_get_sqe(&ring), &ring, fds[0], 7);
+    struct io_uring_cqe cqes[3];
+    wait_for(&ring, cqes, 3);
+    assert(cqes[0].res == 8 && memcmp(http_uring_buffer(&ring, &cqes[0]), "01234567", 8) == 0);
+    assert(cqes[1].res == 8 && memcmp(http_uring_buffer(&ring, &cqes[1]), "89abcdef", 8) == 0);
+    // both buffers are taken: the recv ends, to be armed again once they are back
+    assert(cqes[2].res == -ENOBUFS && (cqes[2].flags & IORING_CQE_F_MORE) == 0);
+    http_uring_recycle_buffer(&ring, &cqes[0]);
+    http_uring_recycle_buffer(&ring, &cqes[1]);
+
+    http_uring_prep_recv_multishot(http_uring_get_sqe(&ring), &ring, fds[0], 7);
+    wait_for(&ring, cqes, 2);
+    assert(cqes[0].res == 8 && memcmp(http_uring_buffer(&ring, &cqes[0]), "ghijklmn", 8) == 0);
+    assert(cqes[1].res == 8 && memcmp(http_uring_buffer(&ring, &cqes[1]), "opqrstuv", 8) == 0);
+    http_uring_recycle_buffer(&ring, &cqes[0]);
+    http_uring_recycle_buffer(&ring, &cqes[1]);
+
+    close(fds[1]);
+    wait_for(&ring, cqes, 1);
+    assert(cqes[0].res == 0);
+    close(fds[0]);
+    http_uring_destroy(&ring);
+}
+
+void test_uring_reads_and_cancels(void) {
+    http_uring ring;
+    assert(http_uring_init(&ring, 4, 8) == 0);
+    const int event_fd = eventfd(0, EFD_CLOEXEC);
+    assert(event_fd >= 0);
+    uint64_t value = 0;
+    http_uring_prep_read(http_uring_get_sqe(&ring), event_fd, &value, sizeof(value), 1);
+    const uint64_t one = 1;
+    assert(write(event_fd, &one, sizeof(one)) == sizeof(one));
+    struct io_uring_cqe cqes[2];
+    wait_for(&ring, cqes, 1);
+    assert(cqes[0].user_data == 1 && cqes[0].res == sizeof(value) && value == 1);
+
+    // a read nobody writes for, until it is cancelled
+    http_uring_prep_read(http_uring_get_sqe(&ring), event_fd, &value, sizeof(value), 2);
+    http_uring_prep_cancel(http_uring_get_sqe(&ring), 2, 3);
+    wait_for(&ring, cqes, 2);
+    for (size_t i = 0; i < 2; i++) {
+        if (cqes[i].user_data == 2) assert(cqes[i].res == -ECANCELED);
+        else assert(cqes[i].user_data == 3 && cqes[i].res == 0);
+    }
+    close(event_fd);
+    http_uring_destroy(&ring);
+}
+
+void test_uring_submits_more_than_the_queue_holds(void) {
+    http_uring ring;
+    assert(http_uring_init(&ring, 4, 64) == 0);
+    // a full queue is submitted to make room, so twenty entries fit through a queue of four
+    for (uint64_t i = 0; i < 20; i++) {
+        struct io_uring_sqe *sqe = http_uring_get_sqe(&ring);
+        assert(sqe != nullptr);
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = i;
+    }
+    struct io_uring_cqe cqes[20];
+    wait_for(&ring, cqes, 20);
+    bool seen[20] = {};
+    for (size_t i = 0; i < 20; i++) {
+        assert(cqes[i].user_data < 20 && !seen[cqes[i].user_data]);
+        seen[cqes[i].user_data] = true;
+    }
+    http_uring_destroy(&ring);
+}
+
+void test_uring_wait_times_out(void) {
+    http_uring ring;
+    assert(http_uring_init(&ring, 4, 8) == 0);
+    struct timespec before, after;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    // nothing in flight: only the timeout ends the wait
+    assert(http_uring_submit_and_wait(&ring, 20) == 0);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    const long long waited_ms = (after.tv_sec - before.tv_sec) * 1000LL + (after.tv_nsec - before.tv_nsec) / 1000000;
+    assert(waited_ms >= 19);
+    struct io_uring_cqe cqe;
+    assert(http_uring_reap(&ring, &cqe, 1) == 0);
+    http_uring_destroy(&ring);
+}
+
+int main() {
+    if (!http_uring_supported()) {
+        printf("io_uring is not supported here, skipping\n");
+        return EXIT_SUCCESS;
+    }
+    test_uring_sends_and_receives();
+    test_uring_runs_out_of_buffers();
+    test_uring_reads_and_cancels();
+    test_uring_submits_more_than_the_queue_holds();
+    test_uring_wait_times_out();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+//
+// Created by Samuel Vishesh Paul on 28/10/24.
+//
+
+#ifndef TINY_HTTP_TEST_HELPERS_H
+#define TINY_HTTP_TEST_HELPERS_H
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/tiny_http/tiny_http_arena.h"
+#include "../src/tiny_http/tiny_http_server.h"
+
+// what the tests share; every one of them defines its own `settings`
+
+extern http_server_settings settings;
+
+// region requests and responses
+
+/// what the requests of `parse` and the headers of their responses are allocated in, reset by every `parse`;
+/// created by the test that uses it
+[[maybe_unused]] static http_arena *arena;
+
+static inline http_request *parse(const char *request) {
+    http_arena_reset(arena);
+    http_request *parsed = parse_http_request_in_arena(&settings, arena, (const uint8_t *) request, strlen(request));
+    assert(parsed != nullptr);
+    return parsed;
+}
+
+static inline const char *header_value(const http_response *response, const char *name) {
+    for (size_t i = 0; i < response->headers_cnt; i++) {
+        if (strcasecmp(response->headers[i].name, name) == 0) return response->headers[i].value;
+    }
+    return nullptr;
+}
+
+/**
+ * A `http_file_body::release` counting its calls in the `size_t` `release_state`.
+ */
+static inline void count_release(void *release_state) {
+    (*(size_t *) release_state)++;
+}
+
+// endregion requests and responses
+
+// region loopback
+
+static inline void *run_server(void *server) {
+    assert(http_server_run(server) == 0);
+    return nullptr;
+}
+
+/**
+ * Sends `request` (optionally split into two writes at `split`) and reads the response until the server closes.
+ */
+static inline size_t round_trip(
+    const uint16_t port, const char *request, const size_t split, char *response, const size_t cap) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    assert(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+
+    const size_t request_len = strlen(request);
+    const size_t first = split > 0 && split < request_len ? split : request_len;
+    assert(send(fd, request, first, 0) == (ssize_t) first);
+    if (first < request_len) {
+        usleep(20 * 1000);
+        assert(send(fd, request + first, request_len - first, 0) == (ssize_t) (request_len - first));
+    }
+
+    size_t response_len = 0;
+    ssize_t received;
+    while ((received = recv(fd, response + response_len, cap - 1 - response_len, 0)) > 0) {
+        response_len += (size_t) received;
+    }
+    response[response_len] = '\0';
+    close(fd);
+    return response_len;
+}
+
+// endregion loopback
+
+#endif //TINY_HTTP_TEST_HELPERS_H